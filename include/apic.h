@@ -0,0 +1,63 @@
+#ifndef APIC_H
+#define APIC_H
+
+#include <stdint.h>
+
+// Default Local APIC physical base (overridden by the MADT)
+#define LAPIC_DEFAULT_BASE 0xFEE00000
+
+// Local APIC register offsets
+#define LAPIC_REG_ID       0x020
+#define LAPIC_REG_VERSION  0x030
+#define LAPIC_REG_TPR      0x080
+#define LAPIC_REG_EOI      0x0B0
+#define LAPIC_REG_SVR      0x0F0
+#define LAPIC_REG_ESR      0x280
+#define LAPIC_REG_ICR_LOW  0x300
+#define LAPIC_REG_ICR_HIGH 0x310
+#define LAPIC_REG_LVT_TIMER 0x320
+#define LAPIC_REG_LVT_LINT0 0x350
+#define LAPIC_REG_LVT_LINT1 0x360
+#define LAPIC_REG_LVT_ERROR 0x370
+#define LAPIC_REG_TIMER_INIT  0x380
+#define LAPIC_REG_TIMER_CUR   0x390
+#define LAPIC_REG_TIMER_DIV   0x3E0
+
+// Spurious vector register bits
+#define LAPIC_SVR_ENABLE   0x100
+
+// ICR bits
+#define LAPIC_ICR_FIXED    0x00000
+#define LAPIC_ICR_INIT     0x00500
+#define LAPIC_ICR_STARTUP  0x00600
+#define LAPIC_ICR_PENDING  0x01000
+#define LAPIC_ICR_ASSERT   0x04000
+#define LAPIC_ICR_LEVEL    0x08000
+
+// LVT bits
+#define LAPIC_LVT_MASKED   0x10000
+
+// Vectors owned by the Local APIC
+#define IPI_VECTOR_WAKEUP     0xF0
+#define LAPIC_SPURIOUS_VECTOR 0xFF
+
+// Initialize the Local APIC of the calling CPU
+void lapic_init(void);
+
+// Whether a Local APIC was found and enabled
+int lapic_available(void);
+
+// Local APIC ID of the calling CPU
+uint8_t lapic_id(void);
+
+// Signal end of interrupt
+void lapic_eoi(void);
+
+// Send a fixed-delivery IPI to one CPU
+void lapic_send_ipi(uint8_t apic_id, uint8_t vector);
+
+// INIT and STARTUP IPIs for AP bring-up
+void lapic_send_init(uint8_t apic_id);
+void lapic_send_startup(uint8_t apic_id, uint32_t trampoline_addr);
+
+#endif // APIC_H
@@ -0,0 +1,103 @@
+#ifndef DHCP_H
+#define DHCP_H
+
+#include <stdint.h>
+
+// DHCP client (RFC 2131). Runs in the background: the timer tick queues
+// a work item whenever a reply is waiting or a timer expires, and the
+// work item drives the state machine, so net_init() returns at once and
+// the address appears when the lease is acknowledged. Without a server
+// the QEMU user-network defaults are used after DHCP_FALLBACK_TICKS
+// while discovery carries on. Addresses are in host order.
+
+#define DHCP_SERVER_PORT    67
+#define DHCP_CLIENT_PORT    68
+
+// Timers, in timer ticks (100 Hz)
+#define DHCP_RETRY_TICKS    400          // First retransmission, doubled per try (RFC 2131 4.1)
+#define DHCP_RETRY_MAX      6400
+#define DHCP_REQUEST_TRIES  4            // REQUESTs before starting over
+#define DHCP_RENEW_MIN      6000         // Floor for RENEWING/REBINDING retries (RFC 2131 4.4.5)
+#define DHCP_FALLBACK_TICKS 1000         // Unleased this long: use the static defaults
+
+// How long commands wait for an address (past the fallback)
+#define DHCP_WAIT_MS        12000
+
+// Lease times are clamped so they fit in the tick counter
+#define DHCP_LEASE_MAX      (30 * 24 * 3600)
+
+// Static defaults (QEMU user networking)
+#define DHCP_FALLBACK_IP      0x0A00020F     // 10.0.2.15
+#define DHCP_FALLBACK_NETMASK 0xFFFFFF00
+#define DHCP_FALLBACK_GATEWAY 0x0A000202     // 10.0.2.2
+#define DHCP_FALLBACK_DNS     0x0A000203     // 10.0.2.3
+
+// BOOTP message (multi-byte fields in network order); options follow
+typedef struct {
+    uint8_t op;
+    uint8_t htype;
+    uint8_t hlen;
+    uint8_t hops;
+    uint32_t xid;
+    uint16_t secs;
+    uint16_t flags;
+    uint32_t ciaddr;             // Our address while renewing
+    uint32_t yiaddr;             // Address offered to us
+    uint32_t siaddr;
+    uint32_t giaddr;
+    uint8_t chaddr[16];
+    uint8_t sname[64];
+    uint8_t file[128];
+    uint32_t cookie;
+} __attribute__((packed)) dhcp_msg_t;
+
+#define DHCP_OPTIONS_MAX    64           // Option bytes we send
+
+typedef enum {
+    DHCP_OFF = 0,       // Not started
+    DHCP_SELECTING,      // DISCOVER sent, waiting for an offer
+    DHCP_REQUESTING,     // Offer taken, REQUEST broadcast
+    DHCP_BOUND,
+    DHCP_RENEWING,       // Past T1: REQUEST unicast to the leasing server
+    DHCP_REBINDING       // Past T2: REQUEST broadcast to any server
+} dhcp_state_t;
+
+typedef struct {
+    uint8_t state;           // dhcp_state_t
+    uint8_t fallback;        // Static defaults in use, no lease
+    uint32_t ip;
+    uint32_t netmask;
+    uint32_t gateway;
+    uint32_t dns;
+    uint32_t server;         // Server identifier of the lease
+    uint32_t lease_secs;     // 0 without a lease
+    uint32_t remaining_secs; // Until the lease expires
+    uint32_t t1_secs;
+    uint32_t t2_secs;
+    uint32_t discovers;
+    uint32_t offers;
+    uint32_t requests;
+    uint32_t acks;
+    uint32_t naks;
+    uint32_t renewals;       // Leases extended by RENEWING or REBINDING
+    uint32_t expired;
+} dhcp_info_t;
+
+// Open the client port and start discovery (task context, from net_init())
+int dhcp_start(void);
+
+// Queue the state machine when there is work; called from the network tick
+void dhcp_tick(void);
+
+// Drop the address and discover again; returns once the address is
+// gone (task context)
+void dhcp_restart(void);
+
+// Idle until the interface has an address, for up to ms milliseconds.
+// Returns 0 once configured, -1 on timeout. Task context.
+int dhcp_wait(uint32_t ms);
+
+void dhcp_get_info(dhcp_info_t* info);
+const char* dhcp_state_name(int state);
+
+#endif // DHCP_H
@@ -2,6 +2,8 @@
 #define E1000_H
 
 #include <stdint.h>
+#include "pktbuf.h"
+#include "netdev.h"
 
 // E1000 Vendor and Device IDs
 #define E1000_VENDOR_ID 0x8086
@@ -16,6 +18,7 @@
 #define E1000_REG_MDIC     0x0020
 #define E1000_REG_ICR      0x00C0
 #define E1000_REG_IMS      0x00D0
+#define E1000_REG_IMC      0x00D8
 #define E1000_REG_RCTL     0x0100
 #define E1000_REG_TCTL     0x0400
 #define E1000_REG_RDBAL    0x2800
@@ -28,6 +31,7 @@
 #define E1000_REG_TDLEN    0x3808
 #define E1000_REG_TDH      0x3810
 #define E1000_REG_TDT      0x3818
+#define E1000_REG_RXCSUM   0x5000
 #define E1000_REG_RAL      0x5400
 #define E1000_REG_RAH      0x5404
 
@@ -36,18 +40,61 @@
 #define E1000_CTRL_ASDE    0x00000020
 #define E1000_CTRL_SLU     0x00000040
 
+// Interrupt cause bits (ICR/IMS/IMC)
+#define E1000_ICR_TXDW     0x00000001
+#define E1000_ICR_LSC      0x00000004
+#define E1000_ICR_RXDMT0   0x00000010
+#define E1000_ICR_RXO      0x00000040
+#define E1000_ICR_RXT0     0x00000080
+
+// Receive causes masked while the NAPI poll loop owns the ring
+#define E1000_RX_IRQ_MASK  (E1000_ICR_RXT0 | E1000_ICR_RXDMT0 | E1000_ICR_RXO)
+
+// Descriptor status/error bits
+#define E1000_RXD_STAT_DD  0x01
+#define E1000_RXD_STAT_EOP 0x02
+#define E1000_RXD_STAT_IXSM  0x04   // Ignore the checksum indications
+#define E1000_RXD_STAT_TCPCS 0x20   // TCP/UDP checksum was calculated
+#define E1000_RXD_STAT_IPCS  0x40   // IPv4 checksum was calculated
+#define E1000_RXD_ERR_TCPE   0x20
+#define E1000_RXD_ERR_IPE    0x40
+
+#define E1000_TXD_CMD_EOP  0x01
+#define E1000_TXD_CMD_IFCS 0x02
+#define E1000_TXD_CMD_IC   0x04   // Insert checksum at CSO, summed from CSS
+#define E1000_TXD_CMD_RS   0x08
+#define E1000_TXD_STAT_DD  0x01
+
+// Frames drained per NET_RX softirq pass before yielding
+#define E1000_NAPI_BUDGET  64
+
 // Receive Control bits
 #define E1000_RCTL_EN      0x00000002
 #define E1000_RCTL_BAM     0x00008000
 #define E1000_RCTL_BSIZE_2048 0x00000000
 
+// Receive checksum offload
+#define E1000_RXCSUM_IPOFL 0x00000100   // IPv4 header checksum
+#define E1000_RXCSUM_TUOFL 0x00000200   // TCP/UDP checksum
+
 // Transmit Control bits
 #define E1000_TCTL_EN      0x00000002
 #define E1000_TCTL_PSP     0x00000008
 
-// Descriptor counts
-#define E1000_NUM_RX_DESC 32
-#define E1000_NUM_TX_DESC 32
+// Descriptor ring sizes: powers of two from 8 (RDLEN/TDLEN must be a
+// multiple of 128 bytes) to 4096. Defaults can be overridden at build
+// time (make E1000_RX_RING=1024) or with e1000_set_ring_sizes().
+#define E1000_MIN_DESC 8
+#define E1000_MAX_DESC 4096
+#ifndef E1000_RX_RING_SIZE
+#define E1000_RX_RING_SIZE 256
+#endif
+#ifndef E1000_TX_RING_SIZE
+#define E1000_TX_RING_SIZE 256
+#endif
+
+// Rings need 16-byte alignment; 128 keeps them on whole cache-line pairs
+#define E1000_RING_ALIGN 128
 
 // Receive Descriptor
 typedef struct {
@@ -71,9 +118,21 @@ typedef struct {
 } __attribute__((packed)) e1000_tx_desc_t;
 
 // E1000 functions
-int e1000_driver_init(void);
-void e1000_driver_send(uint8_t* data, uint32_t length);
-int e1000_driver_receive(uint8_t* buffer, uint32_t max_length);
+
+// Choose ring sizes before e1000_driver_init(); -1 if either is invalid
+int e1000_set_ring_sizes(uint32_t rx, uint32_t tx);
+void e1000_get_ring_sizes(uint32_t* rx, uint32_t* tx);
+
+// Bring up the first 82540EM; returns its netdev or 0 if absent
+netdev_t* e1000_driver_init(void);
+
+// netdev ops, see netdev.h
+int e1000_driver_xmit(pktbuf_t* pb);
+void e1000_driver_flush(void);
+int e1000_driver_tx_wait(void);
+
 void e1000_get_mac(uint8_t* mac);
+void e1000_get_irq_info(netdev_irq_info_t* info);
+void e1000_get_stats(netdev_stats_t* stats);
 
 #endif // E1000_H
@@ -3,6 +3,10 @@
 
 #include <stdint.h>
 
+// Null, kernel code, kernel data, per-CPU data
+#define GDT_ENTRIES 4
+#define GDT_PERCPU_SELECTOR 0x18
+
 // GDT entry structure
 typedef struct gdt_entry {
     uint16_t limit_low;
@@ -19,7 +23,10 @@ typedef struct gdt_ptr {
     uint32_t base;
 } __attribute__((packed)) gdt_ptr_t;
 
-// Initialize GDT
+// Initialize GDT (boot CPU)
 void gdt_init(void);
 
+// Build and load the GDT of the given CPU, including its %gs segment
+void gdt_init_cpu(uint32_t cpu);
+
 #endif // GDT_H
@@ -25,6 +25,29 @@ typedef void (*isr_t)(struct registers*);
 #define IRQ14 46
 #define IRQ15 47
 
+// Dynamically allocated device vectors (MSI, MSI-X)
+#define IRQ_VECTOR_BASE 48
+#define IRQ_VECTOR_LAST 239
+
+// Per-CPU hard-IRQ statistics (cycles with interrupts disabled)
+typedef struct {
+    uint32_t irqs;
+    uint32_t max_vector;        // Vector of the longest handler run
+    uint64_t hard_cycles;
+    uint64_t max_hard_cycles;
+} irq_stats_t;
+
+// Interrupt controller modes
+#define IRQ_MODE_PIC  0
+#define IRQ_MODE_APIC 1
+
+// Timer IRQ entry-to-handler latency (includes the EOI)
+typedef struct {
+    uint32_t samples;
+    uint64_t total_cycles;
+    uint64_t max_cycles;
+} irq_latency_t;
+
 // Initialize IRQs
 void irq_init(void);
 
@@ -34,4 +57,30 @@ void irq_install_handler(int irq, isr_t handler);
 // Uninstall IRQ handler
 void irq_uninstall_handler(int irq);
 
+// Allocate a free device vector; returns -1 when none are left
+int irq_alloc_vector(void);
+void irq_free_vector(int vector);
+
+// Install a handler directly on a vector (MSI/MSI-X)
+void irq_install_vector(int vector, isr_t handler);
+void irq_uninstall_vector(int vector);
+
+// Enable or disable an ISA IRQ line at the active controller
+void irq_unmask(int irq);
+void irq_mask(int irq);
+
+// Deliver an ISA IRQ to another CPU (I/O APIC mode only takes effect)
+int irq_set_affinity(int irq, uint32_t cpu);
+
+// Switch between the 8259 PIC and the I/O APIC. Returns -1 if the
+// system has no I/O APIC.
+int irq_set_mode(int mode);
+int irq_get_mode(void);
+
+void irq_get_latency(int mode, irq_latency_t* latency);
+void irq_reset_latency(void);
+
+void irq_get_stats(uint32_t cpu, irq_stats_t* stats);
+void irq_reset_stats(void);
+
 #endif // IRQ_H
@@ -0,0 +1,93 @@
+#ifndef LOCK_H
+#define LOCK_H
+
+#include <stdint.h>
+
+// Maximum number of distinct lock classes tracked in LOCK_STATS builds
+#define LOCK_CLASS_MAX 32
+
+// Contention statistics of one lock class (summed over all CPUs)
+typedef struct {
+    uint64_t acquires;
+    uint64_t contended;
+    uint64_t spin_cycles;
+    uint64_t hold_cycles;
+    uint64_t max_hold;
+} lock_stats_t;
+
+typedef struct lock_class lock_class_t;
+
+// Test-and-test-and-set spinlock
+typedef struct {
+    volatile uint32_t locked;
+#ifdef LOCK_STATS
+    lock_class_t* cls;
+    uint64_t acquired_at;
+#endif
+} spinlock_t;
+
+// FIFO ticket lock
+typedef struct {
+    volatile uint32_t next;
+    volatile uint32_t owner;
+#ifdef LOCK_STATS
+    lock_class_t* cls;
+    uint64_t acquired_at;
+#endif
+} ticket_lock_t;
+
+// MCS queue lock: each waiter spins on its own node
+typedef struct mcs_node {
+    struct mcs_node* volatile next;
+    volatile uint32_t locked;
+} mcs_node_t;
+
+typedef struct {
+    mcs_node_t* volatile tail;
+#ifdef LOCK_STATS
+    lock_class_t* cls;
+    uint64_t acquired_at;
+#endif
+} mcs_lock_t;
+
+// Save EFLAGS and disable interrupts
+static inline uint32_t irq_save(void) {
+    uint32_t flags;
+    __asm__ volatile ("pushfl; popl %0; cli" : "=r"(flags) : : "memory");
+    return flags;
+}
+
+// Restore the interrupt flag saved by irq_save()
+static inline void irq_restore(uint32_t flags) {
+    if (flags & 0x200) {
+        __asm__ volatile ("sti" : : : "memory");
+    }
+}
+
+// Spinlocks
+void spin_lock_init(spinlock_t* lock, const char* name);
+void spin_lock(spinlock_t* lock);
+int spin_trylock(spinlock_t* lock);
+void spin_unlock(spinlock_t* lock);
+
+// IRQ-safe spinlock: disables interrupts for the critical section
+uint32_t spin_lock_irqsave(spinlock_t* lock);
+void spin_unlock_irqrestore(spinlock_t* lock, uint32_t flags);
+
+// Ticket locks
+void ticket_lock_init(ticket_lock_t* lock, const char* name);
+void ticket_lock(ticket_lock_t* lock);
+void ticket_unlock(ticket_lock_t* lock);
+
+// MCS locks (node must stay valid until mcs_unlock)
+void mcs_lock_init(mcs_lock_t* lock, const char* name);
+void mcs_lock(mcs_lock_t* lock, mcs_node_t* node);
+void mcs_unlock(mcs_lock_t* lock, mcs_node_t* node);
+
+// Contention statistics (empty unless built with LOCK_STATS)
+int lock_stats_enabled(void);
+uint32_t lock_class_count(void);
+const char* lock_class_get(uint32_t index, lock_stats_t* stats);
+void lock_stats_reset(void);
+
+#endif // LOCK_H
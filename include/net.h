@@ -2,6 +2,8 @@
 #define NET_H
 
 #include <stdint.h>
+#include "pktbuf.h"
+#include "netdev.h"
 
 // Ethernet frame
 typedef struct {
@@ -10,7 +12,7 @@ typedef struct {
     uint16_t ethertype;
 } __attribute__((packed)) eth_header_t;
 
-// IP header
+// IP header (multi-byte fields in network order)
 typedef struct {
     uint8_t version_ihl;
     uint8_t tos;
@@ -54,25 +56,94 @@ typedef struct {
     uint32_t gateway;
 } net_interface_t;
 
+// Ethertypes (host order)
+#define ETH_TYPE_IPV4 0x0800
+#define ETH_TYPE_ARP  0x0806
+
+#define ETH_HLEN      14
+#define ETH_ALEN      6
+
+// Byte order: the wire is big endian, the CPU little endian
+static inline uint16_t htons(uint16_t v) {
+    return (uint16_t)((v << 8) | (v >> 8));
+}
+
+static inline uint32_t htonl(uint32_t v) {
+    return __builtin_bswap32(v);
+}
+
+#define ntohs(v) htons(v)
+#define ntohl(v) htonl(v)
+
+#define NET_MAX_PROTOCOLS 8
+
+// Receive handler for one ethertype. Gets the whole Ethernet frame and
+// borrows the buffer: pktbuf_get() it to keep it past the call.
+typedef void (*net_rx_handler_t)(pktbuf_t* pb);
+
+typedef struct {
+    uint32_t rx_packets;
+    uint32_t rx_bytes;
+    uint32_t rx_dropped;     // Runt frames
+    uint32_t rx_unhandled;   // No handler for the ethertype
+    uint32_t tx_packets;
+    uint32_t tx_csum_offload;    // Checksums left to the NIC
+    uint32_t tx_csum_sw;         // Checksums computed by the CPU
+    uint32_t rx_csum_hw;         // Verified by the NIC
+    uint32_t rx_csum_hw_bad;     // Rejected by the NIC
+    uint32_t rx_csum_sw;         // Verified by the CPU
+} net_stats_t;
+
+// Layers for net_rx_csum_ok()
+#define NET_CSUM_IP 0
+#define NET_CSUM_L4 1
+
 // Network functions
 int net_init(void);
 void net_set_ip(uint32_t ip, uint32_t netmask, uint32_t gateway);
 void net_get_mac(uint8_t* mac);
+void net_get_interface(net_interface_t* nif);
+
+// Prepend an Ethernet header addressed to dest_mac and transmit
+int net_eth_xmit(pktbuf_t* pb, const uint8_t* dest_mac, uint16_t ethertype);
 void net_send_packet(uint8_t* data, uint32_t length);
-void net_receive_packet(uint8_t* data, uint32_t length);
-int net_ping(uint32_t dest_ip);
+
+// Batched transmit: queue frames, then hand them over with one flush.
+// net_xmit() sends the buffer itself (zero-copy) and always consumes
+// the caller's reference; net_queue_packet() copies a flat frame.
+int net_xmit(pktbuf_t* pb);
+
+// Transmit checksum for the region from start to the end of the packet,
+// stored at start + offset. The field must hold the seed (0, or the
+// pseudo-header sum for TCP/UDP). Offloaded to the NIC when possible.
+void net_tx_csum(pktbuf_t* pb, uint8_t* start, uint32_t offset);
+
+// Receive check that trusts the NIC's verdict when it has one and falls
+// back to summing data in software, starting from seed (0, or the
+// pseudo-header sum for TCP/UDP). Returns 1 when the checksum is good.
+int net_rx_csum_ok(pktbuf_t* pb, int layer, void* data, int length, uint32_t seed);
+
+void net_set_csum_offload(int enable);
+int net_csum_offload(void);
+int net_queue_packet(uint8_t* data, uint32_t length);
+void net_flush(void);
+
+// Flush and wait until the NIC has sent everything queued
+int net_tx_wait(void);
+
+// NIC picked by net_init(), 0 if none was found
+netdev_t* net_get_device(void);
+void net_receive(pktbuf_t* pb);
+void net_register_protocol(uint16_t ethertype, net_rx_handler_t handler);
+void net_get_stats(net_stats_t* stats);
 uint16_t net_checksum(void* data, int length);
 
 // E1000 driver functions
 void e1000_init(void);
 void e1000_send(uint8_t* data, uint32_t length);
-int e1000_receive(uint8_t* buffer, uint32_t max_length);
 
 // Utility functions
 uint32_t ip_from_string(const char* str);
 void ip_to_string(uint32_t ip, char* str);
 
-// HTTP functions
-int net_http_get(const char* url, char* buffer, int max_size);
-
 #endif // NET_H
@@ -0,0 +1,71 @@
+#ifndef NETDEV_H
+#define NETDEV_H
+
+#include <stdint.h>
+#include "pktbuf.h"
+
+// Interface between the network stack and a NIC driver. A driver's
+// init function returns its netdev_t (or 0 when the device is absent)
+// and net_init() sends everything through the ops of the one it picked.
+
+// How the device interrupt is delivered
+typedef enum {
+    NETDEV_IRQ_NONE = 0,
+    NETDEV_IRQ_LEGACY,
+    NETDEV_IRQ_MSI,
+    NETDEV_IRQ_MSIX
+} netdev_irq_mode_t;
+
+typedef struct {
+    netdev_irq_mode_t mode;
+    uint32_t vector;       // IDT vector (legacy: ISA IRQ line + 32)
+    uint32_t count;        // Interrupts taken
+    uint32_t link_changes;
+} netdev_irq_info_t;
+
+typedef struct {
+    uint32_t rx_packets;
+    uint32_t rx_bytes;
+    uint32_t rx_errors;
+    uint32_t rx_polls;           // NET_RX softirq passes
+    uint32_t rx_budget_hits;     // Passes that used the whole budget
+    uint32_t rx_no_buf;          // Frames dropped, packet pool empty
+    uint32_t irq_count;
+    uint32_t tx_packets;
+    uint32_t tx_bytes;
+    uint32_t tx_batches;         // Doorbell writes (TDT, queue notify)
+    uint32_t tx_kicks_skipped;   // Flushes the device said it did not need
+    uint32_t tx_reclaimed;
+    uint32_t tx_full_stalls;     // Times the sender found the ring full
+    uint32_t tx_dropped;         // Still full after a reclaim: frame refused
+} netdev_stats_t;
+
+// Capabilities
+#define NETDEV_F_TX_CSUM  0x01   // Honors PKTBUF_CSUM_PARTIAL
+#define NETDEV_F_RX_CSUM  0x02   // Sets PKTBUF_CSUM_*_OK/BAD on receive
+
+typedef struct {
+    // Queue a buffer without notifying the device. On success the driver
+    // owns the reference; on -1 (ring stayed full) the caller keeps it.
+    int (*xmit)(pktbuf_t* pb);
+
+    // Hand everything queued to the device
+    void (*flush)(void);
+
+    // Flush and wait until every queued frame has been transmitted
+    int (*tx_wait)(void);
+
+    void (*get_stats)(netdev_stats_t* stats);
+    void (*get_irq_info)(netdev_irq_info_t* info);
+    void (*get_ring_sizes)(uint32_t* rx, uint32_t* tx);
+} netdev_ops_t;
+
+typedef struct {
+    const char* name;
+    uint8_t mac[6];
+    uint32_t features;           // NETDEV_F_*
+    uint32_t napi_budget;        // Frames per NET_RX softirq pass
+    const netdev_ops_t* ops;
+} netdev_t;
+
+#endif // NETDEV_H
@@ -6,23 +6,160 @@
 #define PCI_CONFIG_ADDRESS 0xCF8
 #define PCI_CONFIG_DATA    0xCFC
 
+// Configuration access mechanisms
+#define PCI_CONFIG_PORTIO  0   // Legacy 0xCF8/0xCFC address/data pair
+#define PCI_CONFIG_ECAM    1   // PCIe memory-mapped (MCFG)
+
+// Size of a function's config space with and without ECAM
+#define PCI_CONFIG_SPACE_SIZE     256
+#define PCI_CONFIG_EXT_SPACE_SIZE 4096
+
+// Configuration space registers
+#define PCI_REG_VENDOR     0x00
+#define PCI_REG_COMMAND    0x04
+#define PCI_REG_CLASS      0x08
+#define PCI_REG_HEADER     0x0C
+#define PCI_REG_BAR0       0x10
+#define PCI_REG_BUS_NUMBERS 0x18   // Bridges: primary/secondary/subordinate
+#define PCI_REG_CAP_PTR    0x34
+#define PCI_REG_INTERRUPT  0x3C
+
+// Header type (bits 0-6) and multi-function flag
+#define PCI_HEADER_TYPE_MASK     0x7F
+#define PCI_HEADER_MULTIFUNC     0x80
+#define PCI_HEADER_TYPE_NORMAL   0x00
+#define PCI_HEADER_TYPE_BRIDGE   0x01
+
+// Class codes used during enumeration
+#define PCI_CLASS_BRIDGE         0x06
+#define PCI_SUBCLASS_PCI_BRIDGE  0x04
+
+// BAR bits
+#define PCI_BAR_IO               0x00000001
+#define PCI_BAR_MEM_TYPE_64      0x00000004
+#define PCI_BAR_PREFETCH         0x00000008
+
+// Enumeration limits
+#define PCI_MAX_DEVICES    64
+#define PCI_NUM_BARS       6
+#define PCI_MAX_CAPS       16   // virtio alone uses five vendor capabilities
+#define PCI_HASH_BITS      6
+#define PCI_HASH_SIZE      (1 << PCI_HASH_BITS)   // Lookup buckets
+
+// Command register bits
+#define PCI_COMMAND_IO           0x0001
+#define PCI_COMMAND_MEMORY       0x0002
+#define PCI_COMMAND_MASTER       0x0004
+#define PCI_COMMAND_INTX_DISABLE 0x0400
+
+// Status register bits (upper half of PCI_REG_COMMAND)
+#define PCI_STATUS_CAP_LIST      0x0010
+
+// Capability IDs
+#define PCI_CAP_ID_MSI     0x05
+#define PCI_CAP_ID_VNDR    0x09
+#define PCI_CAP_ID_MSIX    0x11
+
+// MSI capability
+#define PCI_MSI_CTRL_ENABLE      0x0001
+#define PCI_MSI_CTRL_MME_MASK    0x0070
+#define PCI_MSI_CTRL_64BIT       0x0080
+
+// MSI-X capability
+#define PCI_MSIX_CTRL_TABLE_SIZE 0x07FF
+#define PCI_MSIX_CTRL_FUNC_MASK  0x4000
+#define PCI_MSIX_CTRL_ENABLE     0x8000
+#define PCI_MSIX_ENTRY_SIZE      16
+#define PCI_MSIX_ENTRY_MASKED    0x00000001
+
+// Message address of a fixed, physical-destination interrupt
+#define MSI_ADDRESS_BASE   0xFEE00000
+
 // PCI device structure
+typedef struct {
+    uint8_t id;
+    uint8_t offset;
+} pci_cap_t;
+
+// One enumerated function. Entries live in a static table filled once by
+// pci_init(), so pointers stay valid for the life of the kernel.
 typedef struct {
     uint16_t vendor_id;
     uint16_t device_id;
     uint8_t bus;
     uint8_t slot;
     uint8_t func;
-    uint32_t bar0;
-    uint32_t bar1;
+    uint8_t header_type;
+    uint8_t class_code;
+    uint8_t subclass;
+    uint8_t prog_if;
+    uint8_t revision;
+    uint32_t bar[PCI_NUM_BARS];      // Decoded base (flag bits masked off)
+    uint32_t bar_size[PCI_NUM_BARS]; // 0 if unimplemented
+    uint8_t bar_is_io;               // Bit n set for an I/O BAR n
     uint8_t irq;
+    uint8_t num_caps;
+    pci_cap_t caps[PCI_MAX_CAPS];
+    uint8_t msi_cap;     // Config offset of the MSI capability (0 if none)
+    uint8_t msix_cap;    // Config offset of the MSI-X capability (0 if none)
+    int16_t id_next;     // Hash chains (table index, -1 ends)
+    int16_t class_next;
 } pci_device_t;
 
 // PCI functions
+
+// Enumerate every bus, bridge and function once (idempotent)
 void pci_init(void);
 uint32_t pci_read_config(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset);
 void pci_write_config(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset, uint32_t value);
+
+// Extended (0x100-0xFFF) config space; needs ECAM, reads 0xFFFFFFFF without
+uint32_t pci_read_config_ext(uint8_t bus, uint8_t slot, uint8_t func, uint16_t offset);
+void pci_write_config_ext(uint8_t bus, uint8_t slot, uint8_t func, uint16_t offset, uint32_t value);
+
+// Switch the access mechanism; returns -1 if ECAM is unavailable
+int pci_set_config_mode(int mode);
+int pci_get_config_mode(void);
+int pci_ecam_available(void);
+
+typedef struct {
+    uint64_t cycles;
+    uint32_t reads;
+    uint32_t functions;
+} pci_scan_result_t;
+
+// Time a brute-force scan of every bus/slot/function plus a full header
+// read of each function found, using the given access mechanism
+int pci_bench_scan(int mode, pci_scan_result_t* result);
+
+// Table lookups; return the first match or 0
 pci_device_t* pci_find_device(uint16_t vendor_id, uint16_t device_id);
+pci_device_t* pci_find_class(uint8_t class_code, uint8_t subclass);
+
+// Next device with the same vendor/device or class after prev
+pci_device_t* pci_find_next_device(pci_device_t* prev);
+pci_device_t* pci_find_next_class(pci_device_t* prev);
+
+uint32_t pci_device_count(void);
+pci_device_t* pci_get_device(uint32_t index);
+
 uint32_t pci_get_bar(uint8_t bus, uint8_t slot, uint8_t func, uint8_t bar_num);
 
+// Short human-readable name for a class code
+const char* pci_class_name(uint8_t class_code, uint8_t subclass);
+
+// Cached capability lookup; returns the config offset or 0
+uint8_t pci_find_capability(pci_device_t* dev, uint8_t cap_id);
+
+// Deliver the device's MSI to vector on the given CPU (disables INTx)
+int pci_enable_msi(pci_device_t* dev, uint8_t vector, uint32_t cpu);
+void pci_disable_msi(pci_device_t* dev);
+
+// Number of MSI-X table entries, 0 without MSI-X
+uint32_t pci_msix_table_size(pci_device_t* dev);
+
+// Program one MSI-X table entry and enable MSI-X (disables INTx)
+int pci_enable_msix(pci_device_t* dev, uint16_t entry, uint8_t vector, uint32_t cpu);
+void pci_disable_msix(pci_device_t* dev);
+
 #endif // PCI_H
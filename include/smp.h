@@ -0,0 +1,60 @@
+#ifndef SMP_H
+#define SMP_H
+
+#include <stdint.h>
+
+#define MAX_CPUS 16
+
+// Physical address the AP trampoline is copied to (must be below 1 MB)
+#define AP_TRAMPOLINE_ADDR 0x8000
+
+// Kernel stack per application processor
+#define AP_STACK_SIZE 16384
+
+typedef void (*smp_call_fn_t)(void*);
+
+// Per-CPU data, reached through the %gs segment set up by gdt_init_cpu()
+typedef struct cpu {
+    struct cpu* self;             // Must stay first: this_cpu() reads %gs:0
+    uint32_t id;                  // Logical CPU index (0 = BSP)
+    uint8_t apic_id;
+    volatile uint32_t online;
+
+    // Cross-CPU function call slot
+    volatile smp_call_fn_t call_fn;
+    void* volatile call_arg;
+    volatile uint32_t call_pending;
+} cpu_t;
+
+extern cpu_t cpus[MAX_CPUS];
+
+static inline cpu_t* this_cpu(void) {
+    cpu_t* cpu;
+    __asm__ volatile ("movl %%gs:0, %0" : "=r"(cpu));
+    return cpu;
+}
+
+static inline uint32_t smp_cpu_id(void) {
+    return this_cpu()->id;
+}
+
+// Discover CPUs from the MADT and start every application processor
+int smp_init(void);
+
+// Number of CPUs that are online (including the BSP)
+uint32_t smp_num_cpus(void);
+
+// Run fn(arg) on another CPU; returns -1 if the CPU is offline or busy
+int smp_call_on_cpu(uint32_t cpu, smp_call_fn_t fn, void* arg);
+
+// Run the pending cross-CPU call of the calling CPU, if any
+int smp_process_calls(void);
+
+// Wait until a previous smp_call_on_cpu() on that CPU has finished
+void smp_wait_cpu(uint32_t cpu);
+
+// Parallel framebuffer fill benchmark using the first ncpus CPUs.
+// Returns throughput in MB/s.
+uint32_t smp_bench_fill(uint32_t ncpus, uint32_t frames);
+
+#endif // SMP_H
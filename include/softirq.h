@@ -0,0 +1,46 @@
+#ifndef SOFTIRQ_H
+#define SOFTIRQ_H
+
+#include <stdint.h>
+
+// Softirq vectors, run in priority order (lowest number first)
+enum {
+    SOFTIRQ_TIMER = 0,
+    SOFTIRQ_NET_RX,
+    SOFTIRQ_NET_TX,
+    SOFTIRQ_KEYBOARD,
+    NR_SOFTIRQS
+};
+
+// Rounds do_softirq() makes before leaving the rest to the scheduler loop
+#define SOFTIRQ_MAX_RESTART 10
+
+typedef void (*softirq_fn_t)(void);
+
+// Per-CPU softirq statistics
+typedef struct {
+    uint32_t runs[NR_SOFTIRQS];
+    uint64_t cycles;
+    uint64_t max_cycles;
+} softirq_stats_t;
+
+void softirq_init(void);
+
+// Register the handler of a softirq vector
+void open_softirq(uint32_t nr, softirq_fn_t fn);
+
+// Mark a softirq pending on the calling CPU (safe from hard IRQ context)
+void raise_softirq(uint32_t nr);
+
+// Run pending softirqs of the calling CPU with interrupts enabled.
+// Called on hard-IRQ exit and from the scheduler loop; does nothing
+// when already running softirqs on this CPU.
+void do_softirq(void);
+
+// Whether the calling CPU has softirqs pending
+int softirq_pending(void);
+
+void softirq_get_stats(uint32_t cpu, softirq_stats_t* stats);
+void softirq_reset_stats(void);
+
+#endif // SOFTIRQ_H
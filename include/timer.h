@@ -9,4 +9,35 @@ void timer_init(uint32_t frequency);
 // Get tick count
 uint32_t timer_get_ticks(void);
 
+// Periodic callback run from the timer softirq on every tick, on the CPU
+// that takes the timer interrupt. Must not block.
+typedef void (*timer_hook_t)(void);
+
+#define TIMER_MAX_HOOKS 4
+
+// Returns -1 when all hook slots are taken
+int timer_add_hook(timer_hook_t fn);
+
+// Read the CPU timestamp counter
+static inline uint64_t rdtsc(void) {
+    uint32_t lo, hi;
+    __asm__ volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+// Calibrate the TSC against the PIT (call once interrupts are enabled)
+void timer_calibrate_tsc(void);
+
+// TSC frequency in kHz (cycles per millisecond)
+uint32_t timer_tsc_khz(void);
+
+// Convert TSC cycles to microseconds
+uint64_t timer_cycles_to_us(uint64_t cycles);
+
+// Convert TSC cycles to nanoseconds (cycles below about 2^44)
+uint64_t timer_cycles_to_ns(uint64_t cycles);
+
+// Busy-wait for the given number of microseconds
+void timer_udelay(uint32_t us);
+
 #endif // TIMER_H
@@ -0,0 +1,195 @@
+#ifndef VIRTIO_H
+#define VIRTIO_H
+
+#include <stdint.h>
+#include "pci.h"
+
+// Virtio 1.0 over PCI ("modern" interface) and split virtqueues.
+// Transitional devices also expose the legacy I/O BAR; only the
+// capability-based interface is used here.
+
+#define VIRTIO_VENDOR_ID 0x1AF4
+
+// Vendor capability types (cfg_type byte)
+#define VIRTIO_PCI_CAP_COMMON_CFG 1
+#define VIRTIO_PCI_CAP_NOTIFY_CFG 2
+#define VIRTIO_PCI_CAP_ISR_CFG    3
+#define VIRTIO_PCI_CAP_DEVICE_CFG 4
+#define VIRTIO_PCI_CAP_PCI_CFG    5
+
+// Offsets inside a virtio vendor capability
+#define VIRTIO_PCI_CAP_CFG_TYPE   3
+#define VIRTIO_PCI_CAP_BAR        4
+#define VIRTIO_PCI_CAP_OFFSET     8
+#define VIRTIO_PCI_CAP_LENGTH     12
+#define VIRTIO_PCI_NOTIFY_MULT    16   // notify_off_multiplier (notify cap only)
+
+// Device status bits
+#define VIRTIO_STATUS_ACKNOWLEDGE 0x01
+#define VIRTIO_STATUS_DRIVER      0x02
+#define VIRTIO_STATUS_DRIVER_OK   0x04
+#define VIRTIO_STATUS_FEATURES_OK 0x08
+#define VIRTIO_STATUS_NEEDS_RESET 0x40
+#define VIRTIO_STATUS_FAILED      0x80
+
+// Device-independent feature bits
+#define VIRTIO_F_RING_EVENT_IDX   (1ULL << 29)
+#define VIRTIO_F_VERSION_1        (1ULL << 32)
+
+// ISR status bits (INTx only; reading acknowledges)
+#define VIRTIO_ISR_QUEUE          0x01
+#define VIRTIO_ISR_CONFIG         0x02
+
+// MSI-X vector number meaning "no interrupt"
+#define VIRTIO_MSI_NO_VECTOR      0xFFFF
+
+// Common configuration structure (VIRTIO_PCI_CAP_COMMON_CFG). The 64-bit
+// queue addresses are written as two 32-bit halves, low first.
+typedef struct {
+    uint32_t device_feature_select;
+    uint32_t device_feature;
+    uint32_t driver_feature_select;
+    uint32_t driver_feature;
+    uint16_t msix_config;
+    uint16_t num_queues;
+    uint8_t device_status;
+    uint8_t config_generation;
+    uint16_t queue_select;
+    uint16_t queue_size;
+    uint16_t queue_msix_vector;
+    uint16_t queue_enable;
+    uint16_t queue_notify_off;
+    uint32_t queue_desc_lo;
+    uint32_t queue_desc_hi;
+    uint32_t queue_avail_lo;
+    uint32_t queue_avail_hi;
+    uint32_t queue_used_lo;
+    uint32_t queue_used_hi;
+} __attribute__((packed)) virtio_pci_common_cfg_t;
+
+// Split virtqueue layout (naturally aligned, no padding)
+#define VIRTQ_DESC_F_NEXT         0x0001
+#define VIRTQ_DESC_F_WRITE        0x0002   // Device writes the buffer
+#define VIRTQ_AVAIL_F_NO_INTERRUPT 0x0001
+#define VIRTQ_USED_F_NO_NOTIFY    0x0001
+
+typedef struct {
+    uint64_t addr;
+    uint32_t len;
+    uint16_t flags;
+    uint16_t next;
+} virtq_desc_t;
+
+// Followed by used_event when VIRTIO_F_RING_EVENT_IDX is negotiated
+typedef struct {
+    uint16_t flags;
+    uint16_t idx;
+    uint16_t ring[];
+} virtq_avail_t;
+
+typedef struct {
+    uint32_t id;
+    uint32_t len;
+} virtq_used_elem_t;
+
+// Followed by avail_event when VIRTIO_F_RING_EVENT_IDX is negotiated
+typedef struct {
+    uint16_t flags;
+    uint16_t idx;
+    virtq_used_elem_t ring[];
+} virtq_used_t;
+
+// Each ring part gets its own cache lines: the driver writes the avail
+// ring and the device the used ring, so they must not share a line
+#define VIRTQ_ALIGN 64
+
+// Driver-side state of one split virtqueue. Each buffer takes a single
+// descriptor; the head index doubles as the slot for its cookie.
+typedef struct {
+    uint16_t index;                  // Queue number
+    uint16_t size;                   // Entries (power of two)
+    volatile virtq_desc_t* desc;
+    volatile virtq_avail_t* avail;
+    volatile virtq_used_t* used;
+    volatile uint16_t* notify;       // Doorbell for this queue
+    void** cookies;                  // Caller's pointer per descriptor
+    uint16_t free_head;              // Free descriptors, chained by next
+    uint16_t num_free;
+    uint16_t avail_idx;              // Next avail slot (shadow of avail->idx)
+    uint16_t published_idx;          // avail->idx as last published
+    uint16_t last_used;              // Next used entry to consume
+    int event_idx;                   // VIRTIO_F_RING_EVENT_IDX negotiated
+} virtqueue_t;
+
+// One virtio PCI function with its capability windows mapped
+typedef struct {
+    pci_device_t* pci;
+    volatile virtio_pci_common_cfg_t* common;
+    volatile uint8_t* isr;
+    volatile uint8_t* device_cfg;
+    volatile uint8_t* notify_base;
+    uint32_t notify_mult;
+    uint64_t features;               // Negotiated
+} virtio_device_t;
+
+// Event index test (virtio 1.0, 2.4.7.2): true when the index moving
+// from old to new_idx passed the event the other side asked for
+static inline int virtq_need_event(uint16_t event, uint16_t new_idx, uint16_t old) {
+    return (uint16_t)(new_idx - event - 1) < (uint16_t)(new_idx - old);
+}
+
+static inline int virtio_has_feature(virtio_device_t* vdev, uint64_t feature) {
+    return (vdev->features & feature) != 0;
+}
+
+// Map the modern capability windows and enable memory decoding and bus
+// mastering; -1 if the device has no usable virtio 1.0 interface
+int virtio_pci_init(pci_device_t* pci, virtio_device_t* vdev);
+
+// Reset the device and negotiate the subset of supported it offers.
+// VIRTIO_F_VERSION_1 is required. Returns -1 (device marked FAILED) if
+// the device rejects the set.
+int virtio_negotiate(virtio_device_t* vdev, uint64_t supported);
+
+// Allocate and register queue index with up to max_size entries,
+// interrupting on msix_vector (VIRTIO_MSI_NO_VECTOR for INTx). Returns
+// -1 if the queue does not exist, memory ran out or the device refused
+// the vector.
+int virtq_setup(virtio_device_t* vdev, virtqueue_t* vq, uint16_t index,
+                uint16_t max_size, uint16_t msix_vector);
+
+// Set DRIVER_OK; queues may be kicked from here on
+void virtio_driver_ok(virtio_device_t* vdev);
+
+// Read and acknowledge the INTx status (VIRTIO_ISR_*)
+uint8_t virtio_read_isr(virtio_device_t* vdev);
+
+// Consistent read of device-specific configuration bytes
+void virtio_read_config(virtio_device_t* vdev, uint32_t offset, void* buf, uint32_t len);
+
+// Make a buffer available without publishing it; -1 if the ring is full
+int virtq_add(virtqueue_t* vq, void* buf, uint32_t len, int device_writes, void* cookie);
+
+// Publish everything added since the last kick and ring the doorbell
+// unless the device has suppressed notifications. Returns 1 if it
+// notified, 0 if it was suppressed, -1 if there was nothing to publish.
+int virtq_kick(virtqueue_t* vq);
+
+// Next completed buffer's cookie (and bytes written), or 0 if none
+void* virtq_get(virtqueue_t* vq, uint32_t* len);
+
+static inline int virtq_has_used(virtqueue_t* vq) {
+    return vq->used->idx != vq->last_used;
+}
+
+// Interrupt suppression: stop used-buffer interrupts while polling
+void virtq_disable_cb(virtqueue_t* vq);
+
+// Interrupt on the next completion; returns 1 if completions slipped in
+// while disabled, so the caller polls again instead of sleeping
+int virtq_enable_cb(virtqueue_t* vq);
+
+// Interrupt once everything made available so far has completed
+void virtq_enable_cb_delayed(virtqueue_t* vq);
+
+#endif // VIRTIO_H
@@ -0,0 +1,68 @@
+#ifndef VIRTIO_NET_H
+#define VIRTIO_NET_H
+
+#include <stdint.h>
+#include "netdev.h"
+#include "pktbuf.h"
+
+// virtio-net PCI IDs: 1.0-only and transitional
+#define VIRTIO_NET_DEVICE_ID_MODERN       0x1041
+#define VIRTIO_NET_DEVICE_ID_TRANSITIONAL 0x1000
+
+// Feature bits
+#define VIRTIO_NET_F_CSUM          (1ULL << 0)    // Device completes TX checksums
+#define VIRTIO_NET_F_GUEST_CSUM    (1ULL << 1)    // Device validates RX checksums
+#define VIRTIO_NET_F_MAC           (1ULL << 5)
+#define VIRTIO_NET_F_MRG_RXBUF     (1ULL << 15)
+#define VIRTIO_NET_F_STATUS        (1ULL << 16)
+
+// Device configuration layout
+#define VIRTIO_NET_CFG_MAC         0
+#define VIRTIO_NET_CFG_STATUS      6
+
+// Queue numbers of the first (only used) queue pair
+#define VIRTIO_NET_RX_QUEUE        0
+#define VIRTIO_NET_TX_QUEUE        1
+
+// Header in front of every frame in both directions. With VERSION_1 it
+// always carries num_buffers, which is only meaningful with MRG_RXBUF;
+// that is not negotiated, so each received frame fills one buffer.
+typedef struct {
+    uint8_t flags;
+    uint8_t gso_type;
+    uint16_t hdr_len;
+    uint16_t gso_size;
+    uint16_t csum_start;        // From the start of the frame
+    uint16_t csum_offset;       // From csum_start
+    uint16_t num_buffers;       // RX: buffers this frame spans (MRG_RXBUF)
+} __attribute__((packed)) virtio_net_hdr_t;
+
+#define VIRTIO_NET_HDR_F_NEEDS_CSUM 0x01
+#define VIRTIO_NET_HDR_F_DATA_VALID 0x02
+#define VIRTIO_NET_HDR_GSO_NONE     0
+
+// Requested queue sizes, capped at what the device offers. Powers of
+// two; override at build time like the e1000 rings.
+#ifndef VIRTIO_NET_RX_RING_SIZE
+#define VIRTIO_NET_RX_RING_SIZE 256
+#endif
+#ifndef VIRTIO_NET_TX_RING_SIZE
+#define VIRTIO_NET_TX_RING_SIZE 256
+#endif
+
+// Frames drained per NET_RX softirq pass before yielding
+#define VIRTIO_NET_NAPI_BUDGET 64
+
+// Bring up the first virtio-net function; returns its netdev or 0 if
+// there is none (or it only speaks the legacy interface)
+netdev_t* virtio_net_driver_init(void);
+
+// netdev ops, see netdev.h
+int virtio_net_xmit(pktbuf_t* pb);
+void virtio_net_flush(void);
+int virtio_net_tx_wait(void);
+void virtio_net_get_stats(netdev_stats_t* stats);
+void virtio_net_get_irq_info(netdev_irq_info_t* info);
+void virtio_net_get_ring_sizes(uint32_t* rx, uint32_t* tx);
+
+#endif // VIRTIO_NET_H
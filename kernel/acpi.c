@@ -0,0 +1,197 @@
+#include "acpi.h"
+#include "serial.h"
+#include <stddef.h>
+
+static acpi_rsdp_t* rsdp = NULL;
+static acpi_sdt_header_t* rsdt = NULL;
+static int use_xsdt = 0;
+static acpi_madt_info_t madt_info;
+static int madt_found = 0;
+
+static int sig_match(const char* a, const char* b, int len) {
+    for (int i = 0; i < len; i++) {
+        if (a[i] != b[i]) return 0;
+    }
+    return 1;
+}
+
+static uint8_t checksum(const void* data, uint32_t length) {
+    const uint8_t* p = (const uint8_t*)data;
+    uint8_t sum = 0;
+    for (uint32_t i = 0; i < length; i++) {
+        sum += p[i];
+    }
+    return sum;
+}
+
+// Scan a physical range on 16-byte boundaries for "RSD PTR "
+static acpi_rsdp_t* rsdp_scan(uint32_t start, uint32_t length) {
+    for (uint32_t addr = start; addr < start + length; addr += 16) {
+        acpi_rsdp_t* candidate = (acpi_rsdp_t*)addr;
+        if (sig_match(candidate->signature, "RSD PTR ", 8) && checksum(candidate, 20) == 0) {
+            return candidate;
+        }
+    }
+    return NULL;
+}
+
+void acpi_set_rsdp(void* ptr) {
+    acpi_rsdp_t* candidate = (acpi_rsdp_t*)ptr;
+    if (sig_match(candidate->signature, "RSD PTR ", 8)) {
+        rsdp = candidate;
+    }
+}
+
+static void print_dec(uint32_t value) {
+    char buf[12];
+    int i = 0;
+    char temp[12];
+    int j = 0;
+    if (value == 0) buf[i++] = '0';
+    while (value > 0) {
+        temp[j++] = '0' + (value % 10);
+        value /= 10;
+    }
+    while (j > 0) buf[i++] = temp[--j];
+    buf[i] = '\0';
+    serial_write(buf);
+}
+
+static void madt_parse(acpi_madt_t* madt) {
+    madt_info.lapic_address = madt->lapic_address;
+    madt_info.pcat_compat = (madt->flags & ACPI_MADT_PCAT_COMPAT) != 0;
+
+    uint8_t* p = (uint8_t*)madt + sizeof(acpi_madt_t);
+    uint8_t* end = (uint8_t*)madt + madt->header.length;
+
+    while (p + sizeof(acpi_madt_entry_t) <= end) {
+        acpi_madt_entry_t* entry = (acpi_madt_entry_t*)p;
+        if (entry->length < sizeof(acpi_madt_entry_t)) break;
+
+        switch (entry->type) {
+            case ACPI_MADT_LAPIC: {
+                acpi_madt_lapic_t* lapic = (acpi_madt_lapic_t*)entry;
+                if ((lapic->flags & ACPI_LAPIC_ENABLED) && madt_info.num_cpus < ACPI_MAX_CPUS) {
+                    madt_info.cpu_apic_ids[madt_info.num_cpus++] = lapic->apic_id;
+                }
+                break;
+            }
+            case ACPI_MADT_IOAPIC: {
+                acpi_madt_ioapic_t* ioapic = (acpi_madt_ioapic_t*)entry;
+                if (madt_info.num_ioapics < ACPI_MAX_IOAPICS) {
+                    acpi_ioapic_info_t* info = &madt_info.ioapics[madt_info.num_ioapics++];
+                    info->id = ioapic->ioapic_id;
+                    info->address = ioapic->address;
+                    info->gsi_base = ioapic->gsi_base;
+                }
+                break;
+            }
+            case ACPI_MADT_OVERRIDE: {
+                acpi_madt_override_t* iso = (acpi_madt_override_t*)entry;
+                if (iso->bus == 0 && madt_info.num_overrides < ACPI_MAX_OVERRIDES) {
+                    acpi_override_info_t* info = &madt_info.overrides[madt_info.num_overrides++];
+                    info->source = iso->source;
+                    info->gsi = iso->gsi;
+                    info->flags = iso->flags;
+                }
+                break;
+            }
+            case ACPI_MADT_LAPIC_OVERRIDE: {
+                acpi_madt_lapic_override_t* ovr = (acpi_madt_lapic_override_t*)entry;
+                if ((ovr->address >> 32) == 0) {
+                    madt_info.lapic_address = (uint32_t)ovr->address;
+                }
+                break;
+            }
+        }
+
+        p += entry->length;
+    }
+
+    madt_found = 1;
+
+    serial_write("ACPI: MADT lists ");
+    print_dec(madt_info.num_cpus);
+    serial_write(" CPU(s), ");
+    print_dec(madt_info.num_ioapics);
+    serial_write(" I/O APIC(s), ");
+    print_dec(madt_info.num_overrides);
+    serial_write(" override(s)\n");
+}
+
+int acpi_init(void) {
+    serial_write("ACPI: Initializing...\n");
+
+    if (!rsdp) {
+        // EBDA segment is stored at 0x40E, then the BIOS read-only area
+        uint32_t ebda = (uint32_t)(*(uint16_t*)0x40E) << 4;
+        if (ebda) {
+            rsdp = rsdp_scan(ebda, 1024);
+        }
+        if (!rsdp) {
+            rsdp = rsdp_scan(0xE0000, 0x20000);
+        }
+    }
+
+    if (!rsdp) {
+        serial_write("ACPI: RSDP not found\n");
+        return -1;
+    }
+
+    // Prefer the XSDT when it is reachable from 32-bit code
+    if (rsdp->revision >= 2 && rsdp->xsdt_address && (rsdp->xsdt_address >> 32) == 0) {
+        rsdt = (acpi_sdt_header_t*)(uint32_t)rsdp->xsdt_address;
+        use_xsdt = 1;
+    } else {
+        rsdt = (acpi_sdt_header_t*)rsdp->rsdt_address;
+        use_xsdt = 0;
+    }
+
+    if (checksum(rsdt, rsdt->length) != 0) {
+        serial_write("ACPI: Bad RSDT checksum\n");
+        rsdt = NULL;
+        return -1;
+    }
+
+    serial_write(use_xsdt ? "ACPI: Using XSDT\n" : "ACPI: Using RSDT\n");
+
+    acpi_madt_t* madt = (acpi_madt_t*)acpi_find_table("APIC");
+    if (madt) {
+        madt_parse(madt);
+    } else {
+        serial_write("ACPI: No MADT\n");
+    }
+
+    serial_write("ACPI: Initialized successfully\n");
+    return 0;
+}
+
+void* acpi_find_table(const char* signature) {
+    if (!rsdt) return NULL;
+
+    uint32_t entry_size = use_xsdt ? 8 : 4;
+    uint32_t count = (rsdt->length - sizeof(acpi_sdt_header_t)) / entry_size;
+    uint8_t* entries = (uint8_t*)rsdt + sizeof(acpi_sdt_header_t);
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t addr;
+        if (use_xsdt) {
+            uint64_t addr64 = *(uint64_t*)(entries + i * 8);
+            if (addr64 >> 32) continue;
+            addr = (uint32_t)addr64;
+        } else {
+            addr = *(uint32_t*)(entries + i * 4);
+        }
+
+        acpi_sdt_header_t* header = (acpi_sdt_header_t*)addr;
+        if (sig_match(header->signature, signature, 4) && checksum(header, header->length) == 0) {
+            return header;
+        }
+    }
+
+    return NULL;
+}
+
+const acpi_madt_info_t* acpi_get_madt(void) {
+    return madt_found ? &madt_info : NULL;
+}
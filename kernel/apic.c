@@ -0,0 +1,101 @@
+#include "apic.h"
+#include "acpi.h"
+#include "serial.h"
+#include <stddef.h>
+
+#define IA32_APIC_BASE_MSR    0x1B
+#define IA32_APIC_BASE_ENABLE 0x800
+
+static volatile uint8_t* lapic_base = NULL;
+
+static inline uint64_t rdmsr(uint32_t msr) {
+    uint32_t lo, hi;
+    __asm__ volatile ("rdmsr" : "=a"(lo), "=d"(hi) : "c"(msr));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static inline void wrmsr(uint32_t msr, uint64_t value) {
+    __asm__ volatile ("wrmsr" : : "c"(msr), "a"((uint32_t)value), "d"((uint32_t)(value >> 32)));
+}
+
+static inline uint32_t lapic_read(uint32_t reg) {
+    return *(volatile uint32_t*)(lapic_base + reg);
+}
+
+static inline void lapic_write(uint32_t reg, uint32_t value) {
+    *(volatile uint32_t*)(lapic_base + reg) = value;
+}
+
+static void lapic_wait_icr(void) {
+    while (lapic_read(LAPIC_REG_ICR_LOW) & LAPIC_ICR_PENDING) {
+        __asm__ volatile("pause");
+    }
+}
+
+void lapic_init(void) {
+    if (!lapic_base) {
+        const acpi_madt_info_t* madt = acpi_get_madt();
+        uint32_t base = madt ? madt->lapic_address : LAPIC_DEFAULT_BASE;
+        lapic_base = (volatile uint8_t*)base;
+        serial_write("LAPIC: Mapped at MADT base\n");
+    }
+
+    // Make sure the APIC is globally enabled
+    uint64_t msr = rdmsr(IA32_APIC_BASE_MSR);
+    if (!(msr & IA32_APIC_BASE_ENABLE)) {
+        wrmsr(IA32_APIC_BASE_MSR, msr | IA32_APIC_BASE_ENABLE);
+    }
+
+    // Accept all priorities, mask the LVT entries we do not use
+    lapic_write(LAPIC_REG_TPR, 0);
+    lapic_write(LAPIC_REG_LVT_TIMER, LAPIC_LVT_MASKED);
+    lapic_write(LAPIC_REG_LVT_ERROR, LAPIC_LVT_MASKED);
+
+    // Software-enable with the spurious vector
+    lapic_write(LAPIC_REG_SVR, LAPIC_SVR_ENABLE | LAPIC_SPURIOUS_VECTOR);
+
+    // Clear any stale error status (ESR needs a write before read)
+    lapic_write(LAPIC_REG_ESR, 0);
+    lapic_read(LAPIC_REG_ESR);
+
+    lapic_eoi();
+}
+
+int lapic_available(void) {
+    return lapic_base != NULL;
+}
+
+uint8_t lapic_id(void) {
+    return (uint8_t)(lapic_read(LAPIC_REG_ID) >> 24);
+}
+
+void lapic_eoi(void) {
+    lapic_write(LAPIC_REG_EOI, 0);
+}
+
+void lapic_send_ipi(uint8_t apic_id, uint8_t vector) {
+    lapic_wait_icr();
+    lapic_write(LAPIC_REG_ICR_HIGH, (uint32_t)apic_id << 24);
+    lapic_write(LAPIC_REG_ICR_LOW, LAPIC_ICR_FIXED | LAPIC_ICR_ASSERT | vector);
+    lapic_wait_icr();
+}
+
+void lapic_send_init(uint8_t apic_id) {
+    lapic_write(LAPIC_REG_ESR, 0);
+    lapic_wait_icr();
+    lapic_write(LAPIC_REG_ICR_HIGH, (uint32_t)apic_id << 24);
+    lapic_write(LAPIC_REG_ICR_LOW, LAPIC_ICR_INIT | LAPIC_ICR_LEVEL | LAPIC_ICR_ASSERT);
+    lapic_wait_icr();
+
+    // De-assert (ignored by modern CPUs but required by the MP spec)
+    lapic_write(LAPIC_REG_ICR_HIGH, (uint32_t)apic_id << 24);
+    lapic_write(LAPIC_REG_ICR_LOW, LAPIC_ICR_INIT | LAPIC_ICR_LEVEL);
+    lapic_wait_icr();
+}
+
+void lapic_send_startup(uint8_t apic_id, uint32_t trampoline_addr) {
+    lapic_wait_icr();
+    lapic_write(LAPIC_REG_ICR_HIGH, (uint32_t)apic_id << 24);
+    lapic_write(LAPIC_REG_ICR_LOW, LAPIC_ICR_STARTUP | ((trampoline_addr >> 12) & 0xFF));
+    lapic_wait_icr();
+}
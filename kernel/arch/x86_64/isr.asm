@@ -88,6 +88,45 @@ IRQ 13, 45
 IRQ 14, 46
 IRQ 15, 47
 
+; Local APIC vectors
+%macro APIC_VECTOR 1
+global apic_vector%1
+apic_vector%1:
+    cli
+    push 0              ; Push dummy error code
+    push %1             ; Push vector number
+    jmp irq_common_stub
+%endmacro
+
+APIC_VECTOR 240     ; IPI wakeup
+
+; Device vectors 48-239 handed out to MSI/MSI-X and I/O APIC users
+%assign vec 48
+%rep 192
+apic_vector%+vec:
+    cli
+    push 0              ; Push dummy error code
+    push vec            ; Push vector number
+    jmp irq_common_stub
+%assign vec vec+1
+%endrep
+
+; Stub addresses for vectors 48-239, installed by irq_init()
+section .data
+global irq_vector_stubs
+irq_vector_stubs:
+%assign vec 48
+%rep 192
+    dd apic_vector%+vec
+%assign vec vec+1
+%endrep
+section .text
+
+; Spurious interrupts must not be acknowledged
+global apic_spurious
+apic_spurious:
+    iret
+
 ; Common ISR stub
 isr_common_stub:
     pusha               ; Push all general purpose registers
@@ -95,19 +134,19 @@ isr_common_stub:
     mov ax, ds
     push eax            ; Save data segment
     
-    mov ax, 0x10        ; Load kernel data segment
+    mov ax, 0x10        ; Load kernel data segment (gs holds per-CPU data)
     mov ds, ax
     mov es, ax
     mov fs, ax
-    mov gs, ax
     
+    push esp            ; Pass pointer to the saved registers
     call isr_handler    ; Call C handler
+    add esp, 4
     
     pop eax             ; Restore data segment
     mov ds, ax
     mov es, ax
     mov fs, ax
-    mov gs, ax
     
     popa                ; Pop all general purpose registers
     add esp, 8          ; Clean up error code and interrupt number
@@ -121,19 +160,19 @@ irq_common_stub:
     mov ax, ds
     push eax            ; Save data segment
     
-    mov ax, 0x10        ; Load kernel data segment
+    mov ax, 0x10        ; Load kernel data segment (gs holds per-CPU data)
     mov ds, ax
     mov es, ax
     mov fs, ax
-    mov gs, ax
     
+    push esp            ; Pass pointer to the saved registers
     call irq_handler    ; Call C handler
+    add esp, 4
     
     pop eax             ; Restore data segment
     mov ds, ax
     mov es, ax
     mov fs, ax
-    mov gs, ax
     
     popa                ; Pop all general purpose registers
     add esp, 8          ; Clean up error code and interrupt number
@@ -0,0 +1,64 @@
+; AP startup trampoline
+; Copied to AP_TRAMPOLINE_ADDR (0x8000) and entered in real mode by the
+; STARTUP IPI. Switches to 32-bit protected mode, loads the stack handed
+; over in the parameter block and calls entry(cpu).
+
+TRAMPOLINE_BASE equ 0x8000
+%define TADDR(x) (TRAMPOLINE_BASE + ((x) - ap_trampoline_start))
+
+section .text
+bits 16
+
+global ap_trampoline_start
+global ap_trampoline_end
+global ap_trampoline_params
+
+ap_trampoline_start:
+    cli
+    cld
+    xor ax, ax
+    mov ds, ax
+
+    o32 lgdt [TADDR(tramp_gdt_ptr)]  ; Load temporary flat GDT
+
+    mov eax, cr0
+    or eax, 1                        ; Set PE bit
+    mov cr0, eax
+
+    jmp dword 0x08:TADDR(ap_pmode)   ; Far jump into 32-bit code
+
+bits 32
+ap_pmode:
+    mov ax, 0x10
+    mov ds, ax
+    mov es, ax
+    mov fs, ax
+    mov gs, ax
+    mov ss, ax
+
+    mov esp, [TADDR(ap_trampoline_params)]        ; Stack top
+    push dword [TADDR(ap_trampoline_params) + 8]  ; CPU index
+    mov eax, [TADDR(ap_trampoline_params) + 4]    ; Entry point
+    call eax
+
+.hang:
+    cli
+    hlt
+    jmp .hang
+
+align 8
+tramp_gdt:
+    dq 0                    ; Null descriptor
+    dq 0x00CF9A000000FFFF   ; Code segment: base=0, limit=4GB
+    dq 0x00CF92000000FFFF   ; Data segment: base=0, limit=4GB
+tramp_gdt_ptr:
+    dw tramp_gdt_ptr - tramp_gdt - 1
+    dd TADDR(tramp_gdt)
+
+; Filled in by smp.c before each STARTUP IPI
+align 4
+ap_trampoline_params:
+    dd 0                    ; Stack top
+    dd 0                    ; Entry point
+    dd 0                    ; CPU index
+ap_trampoline_end:
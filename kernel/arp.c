@@ -0,0 +1,394 @@
+#include "arp.h"
+#include "net.h"
+#include "lock.h"
+#include "timer.h"
+#include "string.h"
+#include "serial.h"
+#include <stddef.h>
+
+// Neighbor cache entry. Entries live in a fixed pool and are chained
+// into hash buckets; pending frames are linked through pktbuf next.
+typedef struct arp_entry {
+    struct arp_entry* next;      // Bucket chain / free list
+    uint32_t ip;
+    uint8_t mac[6];
+    uint8_t state;               // arp_state_t
+    uint8_t retries;             // Requests sent while INCOMPLETE
+    uint32_t updated;            // Tick of the last confirmation or request
+    uint32_t probed;             // Tick of the last refresh of a STALE entry
+    pktbuf_t* pending;           // Frames waiting for the address
+    pktbuf_t* pending_tail;
+    uint32_t num_pending;
+} arp_entry_t;
+
+// ARP over Ethernet/IPv4 as it appears on the wire
+#define ARP_HW_ETHERNET 1
+#define ARP_PACKET_LEN  28
+
+static arp_entry_t entries[ARP_MAX_ENTRIES];
+static arp_entry_t* buckets[ARP_HASH_SIZE];
+static arp_entry_t* free_entries = NULL;
+static arp_stats_t stats;
+static uint32_t last_scan = 0;
+
+// Taken from the receive softirq, the timer softirq and task context
+static spinlock_t arp_lock;
+
+static const uint8_t broadcast_mac[6] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+
+static inline uint32_t arp_hash(uint32_t ip) {
+    // Fibonacci hashing: the low bits of neighbors differ, the top bits
+    // of the product mix all of them
+    return (ip * 2654435761u) >> (32 - ARP_HASH_BITS);
+}
+
+static arp_entry_t* arp_find(uint32_t ip) {
+    for (arp_entry_t* e = buckets[arp_hash(ip)]; e; e = e->next) {
+        if (e->ip == ip) return e;
+    }
+    return NULL;
+}
+
+static arp_entry_t* arp_create(uint32_t ip) {
+    arp_entry_t* e = free_entries;
+    if (!e) {
+        stats.table_full++;
+        return NULL;
+    }
+    free_entries = e->next;
+
+    uint32_t b = arp_hash(ip);
+    memset(e, 0, sizeof(*e));
+    e->ip = ip;
+    e->next = buckets[b];
+    buckets[b] = e;
+    return e;
+}
+
+// Unlink an entry and hand its pending frames to the caller
+static pktbuf_t* arp_remove(arp_entry_t* e) {
+    arp_entry_t** link = &buckets[arp_hash(e->ip)];
+    while (*link != e) link = &(*link)->next;
+    *link = e->next;
+
+    pktbuf_t* pending = e->pending;
+    e->state = ARP_FREE;
+    e->next = free_entries;
+    free_entries = e;
+    return pending;
+}
+
+static void arp_drop_chain(pktbuf_t* pb) {
+    while (pb) {
+        pktbuf_t* next = pb->next;
+        pb->next = NULL;
+        pktbuf_put(pb);
+        pb = next;
+    }
+}
+
+static void arp_send(uint16_t op, const uint8_t* dest_mac, const uint8_t* target_mac,
+                     uint32_t target_ip, uint32_t sender_ip) {
+    pktbuf_t* pb = pktbuf_alloc();
+    if (!pb) return;
+
+    uint8_t our_mac[6];
+    net_get_mac(our_mac);
+
+    arp_packet_t* arp = (arp_packet_t*)pktbuf_append(pb, sizeof(arp_packet_t));
+    arp->hw_type = htons(ARP_HW_ETHERNET);
+    arp->proto_type = htons(ETH_TYPE_IPV4);
+    arp->hw_size = ETH_ALEN;
+    arp->proto_size = 4;
+    arp->opcode = htons(op);
+    memcpy(arp->sender_mac, our_mac, ETH_ALEN);
+    arp->sender_ip = htonl(sender_ip);
+    memcpy(arp->target_mac, target_mac, ETH_ALEN);
+    arp->target_ip = htonl(target_ip);
+
+    // Pad to the Ethernet minimum; the NIC does not
+    uint8_t* pad = pktbuf_append(pb, 60 - ETH_HLEN - sizeof(arp_packet_t));
+    memset(pad, 0, 60 - ETH_HLEN - sizeof(arp_packet_t));
+
+    if (net_eth_xmit(pb, dest_mac, ETH_TYPE_ARP) == 0) net_flush();
+}
+
+static void arp_request(uint32_t ip, const uint8_t* dest_mac) {
+    static const uint8_t zero_mac[6] = { 0 };
+    net_interface_t nif;
+    net_get_interface(&nif);
+    arp_send(ARP_OP_REQUEST, dest_mac, zero_mac, ip, nif.ip);
+    stats.requests_sent++;
+}
+
+// Transmit frames that were waiting for mac
+static void arp_send_pending(pktbuf_t* pb, const uint8_t* mac) {
+    if (!pb) return;
+    while (pb) {
+        pktbuf_t* next = pb->next;
+        pb->next = NULL;
+        net_eth_xmit(pb, mac, ETH_TYPE_IPV4);
+        pb = next;
+    }
+    net_flush();
+}
+
+int arp_output(pktbuf_t* pb, uint32_t next_hop) {
+    net_interface_t nif;
+    net_get_interface(&nif);
+
+    // Broadcasts need no resolution
+    if (next_hop == 0xFFFFFFFF || next_hop == (nif.ip | ~nif.netmask)) {
+        return net_eth_xmit(pb, broadcast_mac, ETH_TYPE_IPV4) < 0 ? -1 : 0;
+    }
+
+    uint8_t mac[6];
+    int probe = 0;
+    int request = 0;
+
+    uint32_t flags = spin_lock_irqsave(&arp_lock);
+    arp_entry_t* e = arp_find(next_hop);
+    if (e && e->state != ARP_INCOMPLETE) {
+        // Known address: send now. A stale one is still used while a
+        // unicast request checks the host is there (RFC 1122 2.3.2.1).
+        memcpy(mac, e->mac, ETH_ALEN);
+        uint32_t now = timer_get_ticks();
+        if (e->state == ARP_STALE && now - e->probed >= ARP_RETRY_TICKS) {
+            e->probed = now;
+            probe = 1;
+        }
+        stats.hits++;
+        spin_unlock_irqrestore(&arp_lock, flags);
+
+        if (probe) arp_request(next_hop, mac);
+        return net_eth_xmit(pb, mac, ETH_TYPE_IPV4) < 0 ? -1 : 0;
+    }
+
+    stats.misses++;
+    if (!e) {
+        e = arp_create(next_hop);
+        if (!e) {
+            stats.queue_drops++;
+            spin_unlock_irqrestore(&arp_lock, flags);
+            pktbuf_put(pb);
+            return -1;
+        }
+        e->state = ARP_INCOMPLETE;
+        e->updated = timer_get_ticks();
+        e->retries = 1;
+        request = 1;
+    }
+
+    // Keep the newest frames: the oldest are the likeliest to have been
+    // retransmitted by their sender already
+    pktbuf_t* dropped = NULL;
+    if (e->num_pending >= ARP_MAX_PENDING) {
+        dropped = e->pending;
+        e->pending = dropped->next;
+        e->num_pending--;
+        dropped->next = NULL;
+        stats.queue_drops++;
+    }
+    pb->next = NULL;
+    if (e->pending) e->pending_tail->next = pb;
+    else e->pending = pb;
+    e->pending_tail = pb;
+    e->num_pending++;
+    stats.queued++;
+    spin_unlock_irqrestore(&arp_lock, flags);
+
+    if (dropped) pktbuf_put(dropped);
+    if (request) arp_request(next_hop, broadcast_mac);
+    return 1;
+}
+
+int arp_lookup(uint32_t ip, uint8_t* mac) {
+    int found = 0;
+    uint32_t flags = spin_lock_irqsave(&arp_lock);
+    arp_entry_t* e = arp_find(ip);
+    if (e && e->state != ARP_INCOMPLETE) {
+        memcpy(mac, e->mac, ETH_ALEN);
+        found = 1;
+    }
+    spin_unlock_irqrestore(&arp_lock, flags);
+    return found;
+}
+
+void arp_announce(void) {
+    net_interface_t nif;
+    net_get_interface(&nif);
+    if (!nif.ip) return;
+
+    // Sender and target are both our address (RFC 5227 2.3)
+    static const uint8_t zero_mac[6] = { 0 };
+    arp_send(ARP_OP_REQUEST, broadcast_mac, zero_mac, nif.ip, nif.ip);
+    stats.gratuitous_sent++;
+}
+
+static void arp_rx(pktbuf_t* pb) {
+    if (pb->len < ETH_HLEN + ARP_PACKET_LEN) return;
+
+    arp_packet_t* arp = (arp_packet_t*)(pb->data + ETH_HLEN);
+    if (ntohs(arp->hw_type) != ARP_HW_ETHERNET || ntohs(arp->proto_type) != ETH_TYPE_IPV4 ||
+        arp->hw_size != ETH_ALEN || arp->proto_size != 4) {
+        return;
+    }
+
+    uint16_t op = ntohs(arp->opcode);
+    uint32_t sender_ip = ntohl(arp->sender_ip);
+    uint32_t target_ip = ntohl(arp->target_ip);
+    uint8_t sender_mac[6];
+    memcpy(sender_mac, arp->sender_mac, ETH_ALEN);
+
+    net_interface_t nif;
+    net_get_interface(&nif);
+
+    if (op == ARP_OP_REQUEST) stats.requests_received++;
+    else if (op == ARP_OP_REPLY) stats.replies_received++;
+
+    if (sender_ip == 0) return;    // Probe (RFC 5227), nothing to learn
+    if (sender_ip == nif.ip) {
+        if (memcmp(sender_mac, nif.mac, ETH_ALEN) != 0) {
+            stats.conflicts++;
+            serial_write("ARP: Address conflict detected\n");
+        }
+        return;
+    }
+
+    // RFC 826 merge: refresh a known sender; learn a new one only when
+    // the packet is meant for us, so the table does not fill with every
+    // host that broadcasts
+    pktbuf_t* pending = NULL;
+    uint32_t flags = spin_lock_irqsave(&arp_lock);
+    arp_entry_t* e = arp_find(sender_ip);
+    if (!e && target_ip == nif.ip) e = arp_create(sender_ip);
+    if (e) {
+        memcpy(e->mac, sender_mac, ETH_ALEN);
+        e->state = ARP_REACHABLE;
+        e->updated = timer_get_ticks();
+        e->retries = 0;
+        pending = e->pending;
+        e->pending = NULL;
+        e->pending_tail = NULL;
+        e->num_pending = 0;
+    }
+    spin_unlock_irqrestore(&arp_lock, flags);
+
+    arp_send_pending(pending, sender_mac);
+
+    if (op == ARP_OP_REQUEST && target_ip == nif.ip) {
+        arp_send(ARP_OP_REPLY, sender_mac, sender_mac, sender_ip, nif.ip);
+        stats.replies_sent++;
+    }
+}
+
+void arp_tick(void) {
+    // Timers have 100 ms resolution; no need to walk the table every tick
+    uint32_t now = timer_get_ticks();
+    if (now - last_scan < 10) return;
+    last_scan = now;
+
+    uint32_t retry_ip[8];
+    uint32_t num_retry = 0;
+    pktbuf_t* dropped = NULL;
+
+    uint32_t flags = spin_lock_irqsave(&arp_lock);
+    for (uint32_t i = 0; i < ARP_MAX_ENTRIES; i++) {
+        arp_entry_t* e = &entries[i];
+        uint32_t age = now - e->updated;
+
+        switch (e->state) {
+        case ARP_INCOMPLETE:
+            if (age < ARP_RETRY_TICKS) break;
+            if (e->retries >= ARP_MAX_RETRIES) {
+                // Nobody answered: fail the queued frames
+                pktbuf_t* pending = arp_remove(e);
+                stats.resolve_failed++;
+                while (pending) {
+                    pktbuf_t* next = pending->next;
+                    pending->next = dropped;
+                    dropped = pending;
+                    stats.queue_drops++;
+                    pending = next;
+                }
+            } else if (num_retry < 8) {
+                e->retries++;
+                e->updated = now;
+                retry_ip[num_retry++] = e->ip;
+            }
+            break;
+        case ARP_REACHABLE:
+            if (age >= ARP_REACHABLE_TICKS) {
+                e->state = ARP_STALE;
+                e->probed = now - ARP_RETRY_TICKS;
+            }
+            break;
+        case ARP_STALE:
+            if (age >= ARP_REACHABLE_TICKS + ARP_STALE_TICKS) {
+                arp_remove(e);
+                stats.expired++;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    spin_unlock_irqrestore(&arp_lock, flags);
+
+    arp_drop_chain(dropped);
+    for (uint32_t i = 0; i < num_retry; i++) arp_request(retry_ip[i], broadcast_mac);
+}
+
+void arp_flush(void) {
+    pktbuf_t* dropped = NULL;
+    uint32_t flags = spin_lock_irqsave(&arp_lock);
+    for (uint32_t i = 0; i < ARP_MAX_ENTRIES; i++) {
+        if (entries[i].state == ARP_FREE) continue;
+        pktbuf_t* pending = arp_remove(&entries[i]);
+        while (pending) {
+            pktbuf_t* next = pending->next;
+            pending->next = dropped;
+            dropped = pending;
+            pending = next;
+        }
+    }
+    spin_unlock_irqrestore(&arp_lock, flags);
+    arp_drop_chain(dropped);
+}
+
+uint32_t arp_get_entries(arp_entry_info_t* out, uint32_t max) {
+    uint32_t n = 0;
+    uint32_t now = timer_get_ticks();
+    uint32_t flags = spin_lock_irqsave(&arp_lock);
+    for (uint32_t i = 0; i < ARP_MAX_ENTRIES && n < max; i++) {
+        arp_entry_t* e = &entries[i];
+        if (e->state == ARP_FREE) continue;
+        out[n].ip = e->ip;
+        memcpy(out[n].mac, e->mac, ETH_ALEN);
+        out[n].state = e->state;
+        out[n].pending = e->num_pending;
+        out[n].age = now - e->updated;
+        n++;
+    }
+    spin_unlock_irqrestore(&arp_lock, flags);
+    return n;
+}
+
+void arp_get_stats(arp_stats_t* out) {
+    *out = stats;
+}
+
+void arp_init(void) {
+    serial_write("ARP: Initializing...\n");
+    spin_lock_init(&arp_lock, "arp");
+
+    for (uint32_t i = 0; i < ARP_MAX_ENTRIES; i++) {
+        entries[i].state = ARP_FREE;
+        entries[i].next = (i + 1 < ARP_MAX_ENTRIES) ? &entries[i + 1] : NULL;
+    }
+    free_entries = &entries[0];
+
+    net_register_protocol(ETH_TYPE_ARP, arp_rx);
+    arp_announce();
+    serial_write("ARP: Initialized successfully\n");
+}
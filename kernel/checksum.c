@@ -0,0 +1,80 @@
+#include "checksum.h"
+
+// Packet data is rarely 4-byte aligned; x86 handles unaligned loads, and
+// may_alias keeps the compiler from assuming anything about the buffer
+typedef uint32_t __attribute__((may_alias, aligned(1))) u32_unaligned;
+typedef uint16_t __attribute__((may_alias, aligned(1))) u16_unaligned;
+
+// Fold a 64-bit accumulator of 32-bit words into a 32-bit partial sum
+static inline uint32_t csum_fold64(uint64_t acc) {
+    acc = (acc & 0xFFFFFFFF) + (acc >> 32);
+    acc = (acc & 0xFFFFFFFF) + (acc >> 32);
+    return (uint32_t)acc;
+}
+
+static inline uint16_t csum_swab16(uint16_t x) {
+    return (uint16_t)((x >> 8) | (x << 8));
+}
+
+uint32_t csum_partial(const void* buf, uint32_t len, uint32_t sum) {
+    const uint8_t* p = (const uint8_t*)buf;
+
+    // 32-bit words into a 64-bit accumulator: the carries pile up in the
+    // top half instead of being folded per add, and it cannot overflow
+    // below 16 GB of input
+    uint64_t acc = sum;
+
+    // Eight words per iteration, in two independent chains
+    while (len >= 32) {
+        const u32_unaligned* w = (const u32_unaligned*)p;
+        uint64_t a = (uint64_t)w[0] + w[1] + w[2] + w[3];
+        uint64_t b = (uint64_t)w[4] + w[5] + w[6] + w[7];
+        acc += a + b;
+        p += 32;
+        len -= 32;
+    }
+    while (len >= 4) {
+        acc += *(const u32_unaligned*)p;
+        p += 4;
+        len -= 4;
+    }
+    if (len >= 2) {
+        acc += *(const u16_unaligned*)p;
+        p += 2;
+        len -= 2;
+    }
+    if (len) {
+        // Odd trailing byte, padded with a zero byte
+        acc += *p;
+    }
+
+    return csum_fold64(acc);
+}
+
+uint32_t csum_tcpudp_nofold(uint32_t saddr, uint32_t daddr, uint16_t len,
+                            uint8_t proto, uint32_t sum) {
+    uint64_t acc = sum;
+    acc += saddr;
+    acc += daddr;
+
+    // Zero byte, protocol, then length, as they appear on the wire
+    acc += csum_swab16(proto);
+    acc += csum_swab16(len);
+    return csum_fold64(acc);
+}
+
+uint16_t csum_update16(uint16_t check, uint16_t old_val, uint16_t new_val) {
+    uint32_t sum = (uint16_t)~check;
+    sum += (uint16_t)~old_val;
+    sum += new_val;
+    return csum_fold(sum);
+}
+
+uint16_t csum_update32(uint16_t check, uint32_t old_val, uint32_t new_val) {
+    uint32_t sum = (uint16_t)~check;
+    sum += (uint16_t)~(old_val & 0xFFFF);
+    sum += (uint16_t)~(old_val >> 16);
+    sum += new_val & 0xFFFF;
+    sum += new_val >> 16;
+    return csum_fold(sum);
+}
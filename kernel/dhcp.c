@@ -0,0 +1,462 @@
+#include "dhcp.h"
+#include "dns.h"
+#include "udp.h"
+#include "ip.h"
+#include "net.h"
+#include "lock.h"
+#include "workqueue.h"
+#include "sched.h"
+#include "timer.h"
+#include "serial.h"
+#include "string.h"
+#include <stddef.h>
+
+#define DHCP_OP_REQUEST     1
+#define DHCP_OP_REPLY       2
+#define DHCP_HTYPE_ETHER    1
+#define DHCP_MAGIC          0x63825363
+#define DHCP_FLAG_BROADCAST 0x8000
+#define DHCP_MSG_MIN        300          // BOOTP size; some servers drop shorter
+
+// Message types (option 53)
+#define DHCPDISCOVER        1
+#define DHCPOFFER           2
+#define DHCPREQUEST         3
+#define DHCPACK             5
+#define DHCPNAK             6
+
+// Options
+#define OPT_PAD             0
+#define OPT_NETMASK         1
+#define OPT_ROUTER          3
+#define OPT_DNS             6
+#define OPT_REQUESTED_IP    50
+#define OPT_LEASE_TIME      51
+#define OPT_MSG_TYPE        53
+#define OPT_SERVER_ID       54
+#define OPT_PARAMS          55
+#define OPT_T1              58
+#define OPT_T2              59
+#define OPT_CLIENT_ID       61
+#define OPT_END             255
+
+#define DHCP_INFINITE       0xFFFFFFFF
+
+// Fields of a reply we act on (host order)
+typedef struct {
+    uint8_t type;
+    uint32_t yiaddr;
+    uint32_t netmask;
+    uint32_t router;
+    uint32_t dns;
+    uint32_t server;
+    uint32_t lease;
+    uint32_t t1;
+    uint32_t t2;
+} dhcp_reply_t;
+
+// Everything below is owned by the work item, a task on an ordered
+// workqueue, except the three volatile fields the tick reads to decide
+// whether to queue it. The lease is published to readers under
+// info_lock.
+static udp_socket_t* volatile sock;
+static workqueue_t dhcp_wq;
+static work_t dhcp_work;
+static spinlock_t info_lock;
+static dhcp_info_t info;
+
+static volatile uint32_t deadline;       // Next timer (ticks), valid while armed
+static volatile uint8_t armed;
+static volatile uint8_t restart_pending;
+
+static uint32_t xid;
+static uint32_t exchange_start;          // For the secs field
+static uint32_t discover_start;          // For the fallback
+static uint32_t next_send;               // Next retransmission
+static uint32_t retry_ticks;
+static uint32_t tries;
+static uint32_t offered_ip;
+static uint32_t offered_server;
+static uint32_t t1_at, t2_at, expire_at;
+
+static inline int tick_due(uint32_t now, uint32_t at) {
+    return (int32_t)(now - at) >= 0;
+}
+
+static void set_state(uint8_t state) {
+    uint32_t flags = spin_lock_irqsave(&info_lock);
+    info.state = state;
+    spin_unlock_irqrestore(&info_lock, flags);
+}
+
+static uint32_t default_netmask(uint32_t ip) {
+    if ((ip >> 24) < 128) return 0xFF000000;
+    if ((ip >> 24) < 192) return 0xFFFF0000;
+    return 0xFFFFFF00;
+}
+
+static uint8_t* put_option(uint8_t* p, uint8_t code, uint8_t len, const void* data) {
+    *p++ = code;
+    *p++ = len;
+    memcpy(p, data, len);
+    return p + len;
+}
+
+static void dhcp_send(uint8_t type, uint32_t now) {
+    pktbuf_t* pb = pktbuf_alloc();
+    if (!pb) return;
+    uint32_t len = sizeof(dhcp_msg_t) + DHCP_OPTIONS_MAX;
+    if (len < DHCP_MSG_MIN) len = DHCP_MSG_MIN;
+    uint8_t* data = pktbuf_append(pb, len);
+    memset(data, 0, len);
+
+    uint8_t state = info.state;
+    dhcp_msg_t* msg = (dhcp_msg_t*)data;
+    msg->op = DHCP_OP_REQUEST;
+    msg->htype = DHCP_HTYPE_ETHER;
+    msg->hlen = ETH_ALEN;
+    msg->xid = htonl(xid);
+    msg->secs = htons((uint16_t)((now - exchange_start) / 100));
+    net_get_mac(msg->chaddr);
+    msg->cookie = htonl(DHCP_MAGIC);
+
+    // Until a lease is bound the reply cannot be unicast to us
+    uint32_t dest = IP_BROADCAST;
+    if (state == DHCP_RENEWING || state == DHCP_REBINDING) {
+        msg->ciaddr = htonl(info.ip);
+        if (state == DHCP_RENEWING) dest = info.server;
+    } else {
+        msg->flags = htons(DHCP_FLAG_BROADCAST);
+    }
+
+    uint8_t* p = data + sizeof(dhcp_msg_t);
+    p = put_option(p, OPT_MSG_TYPE, 1, &type);
+    uint8_t client_id[1 + ETH_ALEN] = { DHCP_HTYPE_ETHER };
+    memcpy(client_id + 1, msg->chaddr, ETH_ALEN);
+    p = put_option(p, OPT_CLIENT_ID, sizeof(client_id), client_id);
+    if (type == DHCPREQUEST && state == DHCP_REQUESTING) {
+        uint32_t requested = htonl(offered_ip);
+        uint32_t server = htonl(offered_server);
+        p = put_option(p, OPT_REQUESTED_IP, 4, &requested);
+        p = put_option(p, OPT_SERVER_ID, 4, &server);
+    }
+    static const uint8_t params[] = { OPT_NETMASK, OPT_ROUTER, OPT_DNS, OPT_LEASE_TIME, OPT_T1, OPT_T2 };
+    p = put_option(p, OPT_PARAMS, sizeof(params), params);
+    *p = OPT_END;
+
+    if (type == DHCPDISCOVER) info.discovers++;
+    else info.requests++;
+    udp_sendto(sock, pb, dest, DHCP_SERVER_PORT);
+}
+
+static uint32_t get_be32(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static int dhcp_parse(const uint8_t* data, uint32_t len, dhcp_reply_t* r) {
+    if (len < sizeof(dhcp_msg_t)) return -1;
+    const dhcp_msg_t* msg = (const dhcp_msg_t*)data;
+    uint8_t mac[ETH_ALEN];
+    net_get_mac(mac);
+    if (msg->op != DHCP_OP_REPLY || ntohl(msg->xid) != xid || ntohl(msg->cookie) != DHCP_MAGIC ||
+        memcmp(msg->chaddr, mac, ETH_ALEN) != 0) {
+        return -1;
+    }
+
+    memset(r, 0, sizeof(*r));
+    r->yiaddr = ntohl(msg->yiaddr);
+    const uint8_t* p = data + sizeof(dhcp_msg_t);
+    const uint8_t* end = data + len;
+    while (p < end && *p != OPT_END) {
+        if (*p == OPT_PAD) {
+            p++;
+            continue;
+        }
+        if (end - p < 2 || end - p - 2 < p[1]) break;
+        uint8_t code = p[0], olen = p[1];
+        const uint8_t* v = p + 2;
+        p += 2 + olen;
+
+        // Lists (routers, name servers) use their first entry
+        if (code == OPT_MSG_TYPE && olen >= 1) r->type = v[0];
+        if (olen < 4) continue;
+        switch (code) {
+        case OPT_NETMASK:    r->netmask = get_be32(v); break;
+        case OPT_ROUTER:     r->router = get_be32(v); break;
+        case OPT_DNS:        r->dns = get_be32(v); break;
+        case OPT_SERVER_ID:  r->server = get_be32(v); break;
+        case OPT_LEASE_TIME: r->lease = get_be32(v); break;
+        case OPT_T1:         r->t1 = get_be32(v); break;
+        case OPT_T2:         r->t2 = get_be32(v); break;
+        }
+    }
+    return r->type ? 0 : -1;
+}
+
+// Arm the timer for whichever comes first: a retransmission or, while
+// nothing is configured, the switch to the static defaults
+static void arm_selecting(uint32_t now) {
+    uint32_t at = next_send;
+    uint32_t fallback_at = discover_start + DHCP_FALLBACK_TICKS;
+    if (!info.ip && tick_due(fallback_at, now) && !tick_due(fallback_at, at)) at = fallback_at;
+    deadline = at;
+    armed = 1;
+}
+
+static void dhcp_discover(uint32_t now) {
+    set_state(DHCP_SELECTING);
+    xid = (uint32_t)rdtsc() ^ ((uint32_t)(rdtsc() >> 32) << 16);
+    exchange_start = now;
+    retry_ticks = DHCP_RETRY_TICKS;
+    dhcp_send(DHCPDISCOVER, now);
+    next_send = now + retry_ticks;
+    arm_selecting(now);
+}
+
+// Forget the lease and give up the address
+static void dhcp_unconfigure(void) {
+    uint32_t flags = spin_lock_irqsave(&info_lock);
+    info.ip = info.netmask = info.gateway = info.server = 0;
+    info.lease_secs = info.t1_secs = info.t2_secs = 0;
+    info.fallback = 0;
+    spin_unlock_irqrestore(&info_lock, flags);
+    net_set_ip(0, 0, 0);
+}
+
+static void dhcp_bind(const dhcp_reply_t* r, uint32_t src_ip, uint32_t now) {
+    uint32_t lease = r->lease ? r->lease : DHCP_INFINITE;
+    uint32_t t1 = 0, t2 = 0;
+    if (lease != DHCP_INFINITE) {
+        if (lease > DHCP_LEASE_MAX) lease = DHCP_LEASE_MAX;
+        t1 = (r->t1 && r->t1 < lease) ? r->t1 : lease / 2;
+        t2 = (r->t2 && r->t2 < lease && r->t2 >= t1) ? r->t2 : lease - lease / 8;
+    }
+    uint32_t netmask = r->netmask ? r->netmask : default_netmask(r->yiaddr);
+    uint8_t state = info.state;
+    int renewal = (state == DHCP_RENEWING || state == DHCP_REBINDING) && info.ip == r->yiaddr;
+
+    net_interface_t nif;
+    net_get_interface(&nif);
+    if (nif.ip != r->yiaddr || nif.netmask != netmask || nif.gateway != r->router) {
+        net_set_ip(r->yiaddr, netmask, r->router);
+    }
+    if (r->dns) dns_set_server(r->dns);
+
+    uint32_t flags = spin_lock_irqsave(&info_lock);
+    info.state = DHCP_BOUND;
+    info.fallback = 0;
+    info.ip = r->yiaddr;
+    info.netmask = netmask;
+    info.gateway = r->router;
+    info.dns = dns_get_server();
+    info.server = r->server ? r->server : src_ip;
+    info.lease_secs = lease;
+    info.t1_secs = t1;
+    info.t2_secs = t2;
+    info.acks++;
+    if (renewal) info.renewals++;
+    spin_unlock_irqrestore(&info_lock, flags);
+
+    if (lease == DHCP_INFINITE) {
+        armed = 0;
+    } else {
+        t1_at = now + t1 * 100;
+        t2_at = now + t2 * 100;
+        expire_at = now + lease * 100;
+        deadline = t1_at;
+        armed = 1;
+    }
+
+    if (!renewal) {
+        char ip_str[16], line[80];
+        ip_to_string(r->yiaddr, ip_str);
+        sprintf(line, "DHCP: Bound to %s, lease %u s\n", ip_str, lease);
+        serial_write(line);
+    }
+}
+
+static void dhcp_input(const dhcp_reply_t* r, uint32_t src_ip, uint32_t now) {
+    uint8_t state = info.state;
+    if (state == DHCP_SELECTING) {
+        // The first offer wins
+        if (r->type != DHCPOFFER || !r->yiaddr) return;
+        info.offers++;
+        offered_ip = r->yiaddr;
+        offered_server = r->server ? r->server : src_ip;
+        set_state(DHCP_REQUESTING);
+        tries = 0;
+        retry_ticks = DHCP_RETRY_TICKS;
+        dhcp_send(DHCPREQUEST, now);
+        deadline = now + retry_ticks;
+        armed = 1;
+    } else if (state == DHCP_REQUESTING || state == DHCP_RENEWING || state == DHCP_REBINDING) {
+        if (r->type == DHCPACK && r->yiaddr) {
+            dhcp_bind(r, src_ip, now);
+        } else if (r->type == DHCPNAK) {
+            info.naks++;
+            if (state != DHCP_REQUESTING) dhcp_unconfigure();
+            discover_start = now;
+            dhcp_discover(now);
+        }
+    }
+}
+
+// Retransmit renewals at half the time left, but not more often than
+// once a minute (RFC 2131 4.4.5)
+static uint32_t renew_interval(uint32_t now, uint32_t until) {
+    uint32_t half = (until - now) / 2;
+    return half > DHCP_RENEW_MIN ? half : DHCP_RENEW_MIN;
+}
+
+static void dhcp_timeout(uint32_t now) {
+    switch (info.state) {
+    case DHCP_SELECTING:
+        if (!info.ip && tick_due(now, discover_start + DHCP_FALLBACK_TICKS)) {
+            // Nobody answered: use the QEMU defaults and keep asking
+            net_set_ip(DHCP_FALLBACK_IP, DHCP_FALLBACK_NETMASK, DHCP_FALLBACK_GATEWAY);
+            dns_set_server(DHCP_FALLBACK_DNS);
+            uint32_t flags = spin_lock_irqsave(&info_lock);
+            info.fallback = 1;
+            info.ip = DHCP_FALLBACK_IP;
+            info.netmask = DHCP_FALLBACK_NETMASK;
+            info.gateway = DHCP_FALLBACK_GATEWAY;
+            info.dns = DHCP_FALLBACK_DNS;
+            spin_unlock_irqrestore(&info_lock, flags);
+            serial_write("DHCP: No server, using 10.0.2.15/24\n");
+        }
+        if (tick_due(now, next_send)) {
+            retry_ticks = retry_ticks * 2 < DHCP_RETRY_MAX ? retry_ticks * 2 : DHCP_RETRY_MAX;
+            dhcp_send(DHCPDISCOVER, now);
+            next_send = now + retry_ticks;
+        }
+        arm_selecting(now);
+        break;
+
+    case DHCP_REQUESTING:
+        if (++tries >= DHCP_REQUEST_TRIES) {
+            dhcp_discover(now);
+            break;
+        }
+        retry_ticks *= 2;
+        dhcp_send(DHCPREQUEST, now);
+        deadline = now + retry_ticks;
+        break;
+
+    case DHCP_BOUND:
+    case DHCP_RENEWING:
+    case DHCP_REBINDING:
+        if (tick_due(now, expire_at)) {
+            serial_write("DHCP: Lease expired\n");
+            info.expired++;
+            dhcp_unconfigure();
+            discover_start = now;
+            dhcp_discover(now);
+            break;
+        }
+        if (info.state == DHCP_BOUND) {
+            set_state(DHCP_RENEWING);
+            xid = (uint32_t)rdtsc();
+            exchange_start = now;
+        }
+        if (info.state == DHCP_RENEWING && tick_due(now, t2_at)) set_state(DHCP_REBINDING);
+
+        dhcp_send(DHCPREQUEST, now);
+        if (info.state == DHCP_RENEWING) {
+            uint32_t next = now + renew_interval(now, t2_at);
+            deadline = tick_due(next, t2_at) ? t2_at : next;
+        } else {
+            uint32_t next = now + renew_interval(now, expire_at);
+            deadline = tick_due(next, expire_at) ? expire_at : next;
+        }
+        break;
+    }
+}
+
+static void dhcp_run(void* arg) {
+    (void)arg;
+    uint32_t now = timer_get_ticks();
+
+    if (restart_pending) {
+        restart_pending = 0;
+        if (info.ip) dhcp_unconfigure();
+        discover_start = now;
+        dhcp_discover(now);
+    }
+
+    pktbuf_t* pb;
+    uint32_t src_ip;
+    uint16_t src_port;
+    while ((pb = udp_recvfrom(sock, &src_ip, &src_port)) != NULL) {
+        dhcp_reply_t reply;
+        if (src_port == DHCP_SERVER_PORT && dhcp_parse(pb->data, pb->len, &reply) == 0) {
+            dhcp_input(&reply, src_ip, now);
+        }
+        pktbuf_put(pb);
+    }
+
+    if (armed && tick_due(now, deadline)) dhcp_timeout(now);
+    net_flush();
+}
+
+int dhcp_start(void) {
+    if (sock) return 0;
+
+    serial_write("DHCP: Initializing...\n");
+    udp_socket_t* s = udp_open(DHCP_CLIENT_PORT);
+    if (!s) {
+        serial_write("DHCP: Client port in use\n");
+        return -1;
+    }
+    spin_lock_init(&info_lock, "dhcp");
+    workqueue_create(&dhcp_wq, "dhcp", -1, 1);
+    init_work(&dhcp_work, dhcp_run, NULL);
+
+    // The first run starts discovery
+    restart_pending = 1;
+    sock = s;
+    queue_work(&dhcp_wq, &dhcp_work);
+    serial_write("DHCP: Initialized successfully\n");
+    return 0;
+}
+
+void dhcp_tick(void) {
+    if (!sock) return;
+    if (udp_pending(sock) || restart_pending || (armed && tick_due(timer_get_ticks(), deadline))) {
+        queue_work(&dhcp_wq, &dhcp_work);
+    }
+}
+
+void dhcp_restart(void) {
+    if (!sock) return;
+    restart_pending = 1;
+    queue_work(&dhcp_wq, &dhcp_work);
+    flush_workqueue(&dhcp_wq);
+}
+
+int dhcp_wait(uint32_t ms) {
+    uint32_t start = timer_get_ticks();
+    while (!ip_local_address()) {
+        if (!sock || timer_get_ticks() - start >= (ms + 9) / 10) return -1;
+        sched_idle_wait(1000);
+    }
+    return 0;
+}
+
+void dhcp_get_info(dhcp_info_t* out) {
+    uint32_t flags = spin_lock_irqsave(&info_lock);
+    *out = info;
+    spin_unlock_irqrestore(&info_lock, flags);
+
+    uint32_t now = timer_get_ticks();
+    out->remaining_secs = 0;
+    if (out->lease_secs == DHCP_INFINITE) {
+        out->remaining_secs = DHCP_INFINITE;
+    } else if (out->lease_secs && !tick_due(now, expire_at)) {
+        out->remaining_secs = (expire_at - now) / 100;
+    }
+}
+
+const char* dhcp_state_name(int state) {
+    static const char* names[] = { "off", "selecting", "requesting", "bound", "renewing", "rebinding" };
+    return (state >= 0 && state <= DHCP_REBINDING) ? names[state] : "?";
+}
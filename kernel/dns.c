@@ -0,0 +1,485 @@
+#include "dns.h"
+#include "udp.h"
+#include "net.h"
+#include "lock.h"
+#include "sched.h"
+#include "timer.h"
+#include "serial.h"
+#include "string.h"
+#include <stddef.h>
+
+#define DNS_FLAG_QR         0x8000       // Response
+#define DNS_FLAG_RD         0x0100       // Recursion desired
+#define DNS_RCODE_MASK      0x000F
+#define DNS_RCODE_NXDOMAIN  3
+
+#define DNS_TYPE_A          1
+#define DNS_TYPE_SOA        6
+#define DNS_CLASS_IN        1
+
+#define DNS_RR_FIXED        10           // Type, class, TTL and length after the name
+
+typedef struct {
+    char name[DNS_NAME_MAX];     // Lowercase
+    uint8_t state;               // dns_state_t
+    int8_t error;                // DNS_ERR_* once DNS_FAILED
+    uint8_t tries;
+    uint16_t id;
+    uint16_t waiters;            // Lookups blocked on this entry; pins it
+    uint32_t ip;
+    uint32_t expires;            // Ticks, for answers
+    uint32_t sent;               // Ticks of the last transmission
+    uint32_t used;               // LRU stamp
+    uint32_t hits;
+} dns_entry_t;
+
+// Only tasks resolve, so the cache and the socket's receive side are
+// all under one ticket lock. Whichever waiter holds it drains the
+// socket and completes entries for everyone.
+static dns_entry_t cache[DNS_CACHE_SIZE];
+static ticket_lock_t dns_lock;
+static udp_socket_t* sock;
+static volatile uint32_t server;
+static uint32_t use_clock;
+static uint16_t next_id;
+static dns_stats_t stats;
+
+static inline int tick_due(uint32_t now, uint32_t at) {
+    return (int32_t)(now - at) >= 0;
+}
+
+static uint32_t get_be32(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static uint16_t get_be16(const uint8_t* p) {
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+// Strict dotted quad: four decimal parts of at most 255
+static int parse_quad(const char* s, uint32_t* ip) {
+    uint32_t value = 0, part = 0;
+    int digits = 0, dots = 0;
+    for (;; s++) {
+        if (*s >= '0' && *s <= '9') {
+            part = part * 10 + (*s - '0');
+            if (++digits > 3 || part > 255) return -1;
+        } else if (*s == '.' || *s == '\0') {
+            if (!digits) return -1;
+            value = (value << 8) | part;
+            part = 0;
+            digits = 0;
+            if (!*s) break;
+            if (++dots > 3) return -1;
+        } else {
+            return -1;
+        }
+    }
+    if (dots != 3) return -1;
+    *ip = value;
+    return 0;
+}
+
+// Lowercase copy of a host name; -1 unless it is letters, digits, '-'
+// and '_' in labels of 1 to 63 characters
+static int normalize_name(const char* name, char* out) {
+    uint32_t n = 0, label = 0;
+    for (; *name; name++) {
+        char c = *name;
+        if (c >= 'A' && c <= 'Z') c += 'a' - 'A';
+        if (c == '.') {
+            if (label == 0) return -1;
+            label = 0;
+        } else if ((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '-' || c == '_') {
+            if (++label > 63) return -1;
+        } else {
+            return -1;
+        }
+        if (n >= DNS_NAME_MAX - 1) return -1;
+        out[n++] = c;
+    }
+    if (n && out[n - 1] == '.') n--;
+    if (n == 0) return -1;
+    out[n] = '\0';
+    return 0;
+}
+
+// Offset just past the (possibly compressed) name at off, or -1
+static int skip_name(const uint8_t* msg, uint32_t len, uint32_t off) {
+    while (off < len) {
+        uint8_t l = msg[off];
+        if (l == 0) return off + 1;
+        if ((l & 0xC0) == 0xC0) return off + 2 <= len ? (int)(off + 2) : -1;
+        if (l & 0xC0) return -1;
+        off += 1 + l;
+    }
+    return -1;
+}
+
+// Compare the question name at off with name, ignoring case. Returns the
+// offset past it, or -1 on a mismatch.
+static int match_name(const uint8_t* msg, uint32_t len, uint32_t off, const char* name) {
+    const char* n = name;
+    while (off < len) {
+        uint8_t l = msg[off++];
+        if (l == 0) return *n == '\0' ? (int)off : -1;
+        if ((l & 0xC0) || off + l > len) return -1;
+        if (n != name && *n++ != '.') return -1;
+        for (uint32_t i = 0; i < l; i++) {
+            char c = (char)msg[off + i];
+            if (c >= 'A' && c <= 'Z') c += 'a' - 'A';
+            if (*n == '\0' || c != *n) return -1;
+            n++;
+        }
+        off += l;
+    }
+    return -1;
+}
+
+static int send_query(dns_entry_t* e) {
+    pktbuf_t* pb = pktbuf_alloc();
+    if (!pb) return -1;
+
+    // Each label's length byte takes the place of a dot, plus the root
+    uint32_t name_len = strlen(e->name) + 2;
+    uint8_t* msg = pktbuf_append(pb, DNS_HLEN + name_len + 4);
+    dns_header_t* hdr = (dns_header_t*)msg;
+    memset(hdr, 0, DNS_HLEN);
+    hdr->id = htons(e->id);
+    hdr->flags = htons(DNS_FLAG_RD);
+    hdr->qdcount = htons(1);
+
+    uint8_t* p = msg + DNS_HLEN;
+    const char* label = e->name;
+    while (*label) {
+        const char* end = label;
+        while (*end && *end != '.') end++;
+        *p++ = (uint8_t)(end - label);
+        memcpy(p, label, end - label);
+        p += end - label;
+        label = *end ? end + 1 : end;
+    }
+    *p++ = 0;
+    *p++ = 0; *p++ = DNS_TYPE_A;
+    *p++ = 0; *p++ = DNS_CLASS_IN;
+
+    e->sent = timer_get_ticks();
+    stats.queries++;
+    return udp_sendto(sock, pb, server, DNS_PORT);
+}
+
+static void complete(dns_entry_t* e, uint8_t state, uint32_t ip, uint32_t ttl, uint32_t now) {
+    if (ttl > DNS_TTL_MAX) ttl = DNS_TTL_MAX;
+    e->state = state;
+    e->ip = ip;
+    e->expires = now + ttl * 100;
+}
+
+static void fail(dns_entry_t* e, int err) {
+    e->state = DNS_FAILED;
+    e->error = (int8_t)err;
+}
+
+// Negative TTL from the SOA in the authority section (RFC 2308 5)
+static uint32_t negative_ttl(const uint8_t* msg, uint32_t len, int off, uint32_t count) {
+    for (uint32_t i = 0; i < count && off >= 0; i++) {
+        off = skip_name(msg, len, off);
+        if (off < 0 || (uint32_t)off + DNS_RR_FIXED > len) break;
+        uint16_t type = get_be16(msg + off);
+        uint32_t ttl = get_be32(msg + off + 4);
+        uint16_t rdlen = get_be16(msg + off + 8);
+        int rdata = off + DNS_RR_FIXED;
+        off = rdata + rdlen;
+        if ((uint32_t)off > len) break;
+        if (type != DNS_TYPE_SOA) continue;
+
+        // MNAME and RNAME, then serial, refresh, retry, expire, minimum
+        int p = skip_name(msg, len, rdata);
+        if (p >= 0) p = skip_name(msg, len, p);
+        if (p < 0 || p + 20 > off) break;
+        uint32_t minimum = get_be32(msg + p + 16);
+        return ttl < minimum ? ttl : minimum;
+    }
+    return DNS_NEGATIVE_TTL;
+}
+
+static void dns_input(const uint8_t* msg, uint32_t len, uint32_t now) {
+    if (len < DNS_HLEN) return;
+    const dns_header_t* hdr = (const dns_header_t*)msg;
+    uint16_t flags = ntohs(hdr->flags);
+    if (!(flags & DNS_FLAG_QR) || ntohs(hdr->qdcount) != 1) return;
+
+    uint16_t id = ntohs(hdr->id);
+    dns_entry_t* e = NULL;
+    for (uint32_t i = 0; i < DNS_CACHE_SIZE; i++) {
+        if (cache[i].state == DNS_PENDING && cache[i].id == id) {
+            e = &cache[i];
+            break;
+        }
+    }
+    if (!e) return;
+
+    // The question must echo ours, or this is not the answer to it
+    int off = match_name(msg, len, DNS_HLEN, e->name);
+    if (off < 0 || (uint32_t)off + 4 > len) return;
+    off += 4;
+
+    uint32_t rcode = flags & DNS_RCODE_MASK;
+    uint32_t ancount = ntohs(hdr->ancount);
+    if (rcode == DNS_RCODE_NXDOMAIN) {
+        // Skip the answers (a CNAME chain may precede the NXDOMAIN)
+        for (uint32_t i = 0; i < ancount && off >= 0; i++) {
+            off = skip_name(msg, len, off);
+            if (off < 0 || (uint32_t)off + DNS_RR_FIXED > len) off = -1;
+            else off += DNS_RR_FIXED + get_be16(msg + off + 8);
+        }
+        uint32_t ttl = off >= 0 ? negative_ttl(msg, len, off, ntohs(hdr->nscount)) : DNS_NEGATIVE_TTL;
+        complete(e, DNS_NEGATIVE, 0, ttl, now);
+        stats.nxdomain++;
+        return;
+    }
+    if (rcode != 0) {
+        fail(e, DNS_ERR_SERVER);
+        stats.failures++;
+        return;
+    }
+
+    // The first A record answers; a CNAME chain before it lives no
+    // longer than its shortest TTL
+    uint32_t min_ttl = DNS_TTL_MAX;
+    for (uint32_t i = 0; i < ancount; i++) {
+        off = skip_name(msg, len, off);
+        if (off < 0 || (uint32_t)off + DNS_RR_FIXED > len) break;
+        uint16_t type = get_be16(msg + off);
+        uint16_t klass = get_be16(msg + off + 2);
+        uint32_t ttl = get_be32(msg + off + 4);
+        uint16_t rdlen = get_be16(msg + off + 8);
+        off += DNS_RR_FIXED;
+        if ((uint32_t)off + rdlen > len) break;
+        if (ttl < min_ttl) min_ttl = ttl;
+        if (type == DNS_TYPE_A && klass == DNS_CLASS_IN && rdlen == 4) {
+            complete(e, DNS_POSITIVE, get_be32(msg + off), min_ttl, now);
+            stats.answers++;
+            return;
+        }
+        off += rdlen;
+    }
+    if (off < 0 || (uint32_t)off > len) {
+        fail(e, DNS_ERR_SERVER);
+        stats.failures++;
+        return;
+    }
+
+    // The name exists but has no address (NODATA)
+    complete(e, DNS_NEGATIVE, 0, negative_ttl(msg, len, off, ntohs(hdr->nscount)), now);
+    stats.nxdomain++;
+}
+
+// Take answers off the socket and retransmit or give up on overdue
+// queries. Caller holds dns_lock.
+static void dns_poll(uint32_t now) {
+    pktbuf_t* pb;
+    uint32_t src_ip;
+    uint16_t src_port;
+    while ((pb = udp_recvfrom(sock, &src_ip, &src_port)) != NULL) {
+        if (src_ip == server && src_port == DNS_PORT) dns_input(pb->data, pb->len, now);
+        pktbuf_put(pb);
+    }
+
+    int sent = 0;
+    for (uint32_t i = 0; i < DNS_CACHE_SIZE; i++) {
+        dns_entry_t* e = &cache[i];
+        if (e->state != DNS_PENDING || !tick_due(now, e->sent + (DNS_RETRY_TICKS << (e->tries - 1)))) {
+            continue;
+        }
+        if (e->tries >= DNS_TRIES) {
+            fail(e, DNS_ERR_TIMEOUT);
+            stats.timeouts++;
+        } else {
+            e->tries++;
+            stats.retransmits++;
+            send_query(e);
+            sent = 1;
+        }
+    }
+    if (sent) net_flush();
+}
+
+// Cached entry for name, freeing expired ones on the way. Caller holds
+// dns_lock.
+static dns_entry_t* dns_find(const char* name, uint32_t now) {
+    for (uint32_t i = 0; i < DNS_CACHE_SIZE; i++) {
+        dns_entry_t* e = &cache[i];
+        if (e->state == DNS_FREE) continue;
+        int expired = (e->state == DNS_POSITIVE || e->state == DNS_NEGATIVE) && tick_due(now, e->expires);
+        if (expired || e->state == DNS_FAILED) {
+            // Waiters still read the result; new lookups start afresh
+            if (!e->waiters) {
+                if (expired) stats.expired++;
+                e->state = DNS_FREE;
+            }
+            continue;
+        }
+        if (strcmp(e->name, name) == 0) return e;
+    }
+    return NULL;
+}
+
+// A free slot, else the least recently used answer nobody waits on
+static dns_entry_t* dns_alloc(void) {
+    dns_entry_t* victim = NULL;
+    for (uint32_t i = 0; i < DNS_CACHE_SIZE; i++) {
+        dns_entry_t* e = &cache[i];
+        if (e->state == DNS_FREE) return e;
+        if (e->state == DNS_PENDING || e->state == DNS_FAILED || e->waiters) continue;
+        if (!victim || (int32_t)(e->used - victim->used) < 0) victim = e;
+    }
+    if (victim) stats.evictions++;
+    return victim;
+}
+
+static uint16_t new_id(void) {
+    // Unpredictable enough that an off-path reply must guess it
+    for (;;) {
+        uint16_t id = (uint16_t)(rdtsc() ^ (++next_id * 40503u));
+        int used = 0;
+        for (uint32_t i = 0; i < DNS_CACHE_SIZE; i++) {
+            if (cache[i].state == DNS_PENDING && cache[i].id == id) used = 1;
+        }
+        if (!used) return id;
+    }
+}
+
+int dns_resolve(const char* name, uint32_t* ip) {
+    if (parse_quad(name, ip) == 0) return 0;
+
+    char key[DNS_NAME_MAX];
+    if (normalize_name(name, key) < 0) return DNS_ERR_NAME;
+    if (!sock) return DNS_ERR_NO_SERVER;
+
+    ticket_lock(&dns_lock);
+    stats.lookups++;
+    uint32_t now = timer_get_ticks();
+    dns_entry_t* e = dns_find(key, now);
+    if (e && e->state != DNS_PENDING) {
+        e->hits++;
+        e->used = ++use_clock;
+        int err = 0;
+        if (e->state == DNS_POSITIVE) {
+            stats.hits++;
+            *ip = e->ip;
+        } else {
+            stats.negative_hits++;
+            err = DNS_ERR_NXDOMAIN;
+        }
+        ticket_unlock(&dns_lock);
+        return err;
+    }
+
+    if (e) {
+        stats.coalesced++;
+    } else {
+        if (!server || (e = dns_alloc()) == NULL) {
+            ticket_unlock(&dns_lock);
+            return server ? DNS_ERR_BUSY : DNS_ERR_NO_SERVER;
+        }
+        stats.misses++;
+        memcpy(e->name, key, sizeof(key));
+        e->state = DNS_PENDING;
+        e->tries = 1;
+        e->hits = 0;
+        e->id = new_id();
+        if (send_query(e) < 0) {
+            e->state = DNS_FREE;
+            ticket_unlock(&dns_lock);
+            return DNS_ERR_NO_SERVER;
+        }
+        net_flush();
+    }
+    e->used = ++use_clock;
+
+    // The waiter count pins the entry while the lock is dropped
+    e->waiters++;
+    while (e->state == DNS_PENDING) {
+        ticket_unlock(&dns_lock);
+        sched_idle_wait(1000);
+        ticket_lock(&dns_lock);
+        dns_poll(timer_get_ticks());
+    }
+    e->waiters--;
+
+    int err;
+    if (e->state == DNS_POSITIVE) {
+        *ip = e->ip;
+        err = 0;
+    } else if (e->state == DNS_NEGATIVE) {
+        err = DNS_ERR_NXDOMAIN;
+    } else {
+        err = e->error;
+        if (!e->waiters) e->state = DNS_FREE;
+    }
+    ticket_unlock(&dns_lock);
+    return err;
+}
+
+void dns_init(void) {
+    serial_write("DNS: Initializing...\n");
+    ticket_lock_init(&dns_lock, "dns");
+    sock = udp_open(0);
+    if (!sock) {
+        serial_write("DNS: No socket\n");
+        return;
+    }
+    serial_write("DNS: Initialized successfully\n");
+}
+
+void dns_set_server(uint32_t ip) {
+    server = ip;
+}
+
+uint32_t dns_get_server(void) {
+    return server;
+}
+
+void dns_flush(void) {
+    ticket_lock(&dns_lock);
+    for (uint32_t i = 0; i < DNS_CACHE_SIZE; i++) {
+        dns_entry_t* e = &cache[i];
+        if ((e->state == DNS_POSITIVE || e->state == DNS_NEGATIVE) && !e->waiters) e->state = DNS_FREE;
+    }
+    ticket_unlock(&dns_lock);
+}
+
+uint32_t dns_get_entries(dns_entry_info_t* out, uint32_t max) {
+    uint32_t n = 0;
+    uint32_t now = timer_get_ticks();
+    ticket_lock(&dns_lock);
+    for (uint32_t i = 0; i < DNS_CACHE_SIZE && n < max; i++) {
+        dns_entry_t* e = &cache[i];
+        if (e->state != DNS_POSITIVE && e->state != DNS_NEGATIVE && e->state != DNS_PENDING) continue;
+        memcpy(out[n].name, e->name, DNS_NAME_MAX);
+        out[n].ip = e->ip;
+        out[n].state = e->state;
+        out[n].hits = e->hits;
+        out[n].ttl = (e->state != DNS_PENDING && !tick_due(now, e->expires)) ? (e->expires - now) / 100 : 0;
+        n++;
+    }
+    ticket_unlock(&dns_lock);
+    return n;
+}
+
+void dns_get_stats(dns_stats_t* out) {
+    *out = stats;
+}
+
+const char* dns_strerror(int err) {
+    switch (err) {
+    case DNS_ERR_NXDOMAIN:  return "no such host";
+    case DNS_ERR_TIMEOUT:   return "timed out";
+    case DNS_ERR_SERVER:    return "server failure";
+    case DNS_ERR_NAME:      return "invalid host name";
+    case DNS_ERR_NO_SERVER: return "no DNS server";
+    case DNS_ERR_BUSY:      return "too many lookups";
+    }
+    return "unknown error";
+}
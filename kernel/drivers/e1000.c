@@ -2,17 +2,71 @@
 #include "pci.h"
 #include "serial.h"
 #include "heap.h"
+#include "lock.h"
+#include "irq.h"
+#include "softirq.h"
+#include "string.h"
+#include "net.h"
+#include "pktbuf.h"
 #include <stddef.h>
 
 static uint8_t* mmio_addr = NULL;
 static e1000_rx_desc_t* rx_descs = NULL;
 static e1000_tx_desc_t* tx_descs = NULL;
-static uint8_t** rx_buffers = NULL;
-static uint8_t** tx_buffers = NULL;
+static pktbuf_t** rx_pbs = NULL;   // Buffer posted on each RX descriptor
+static pktbuf_t** tx_pbs = NULL;   // Buffer in flight on each TX descriptor
+static uint32_t rx_size = E1000_RX_RING_SIZE;
+static uint32_t tx_size = E1000_TX_RING_SIZE;
 static uint16_t rx_cur = 0;
-static uint16_t tx_cur = 0;
+static uint16_t tx_cur = 0;     // Next descriptor to fill
+static uint16_t tx_clean = 0;   // Oldest descriptor not yet reclaimed
+static uint16_t tx_queued = 0;  // Filled since the last TDT write
 static uint8_t mac_addr[6];
 
+// Separate locks so a sender never waits behind the receive path
+static spinlock_t tx_lock;
+static spinlock_t rx_lock;
+
+static netdev_irq_mode_t irq_mode = NETDEV_IRQ_NONE;
+static int irq_vector = -1;
+static volatile uint32_t irq_count = 0;
+static volatile uint32_t link_changes = 0;
+
+// Set while receive interrupts are masked and the poll loop owns the ring
+static volatile uint32_t napi_scheduled = 0;
+
+static volatile uint32_t rx_packets = 0;
+static volatile uint32_t rx_bytes = 0;
+static volatile uint32_t rx_errors = 0;
+static volatile uint32_t rx_polls = 0;
+static volatile uint32_t rx_budget_hits = 0;
+static volatile uint32_t rx_no_buf = 0;
+
+static volatile uint32_t tx_packets = 0;
+static volatile uint32_t tx_bytes = 0;
+static volatile uint32_t tx_batches = 0;
+static volatile uint32_t tx_reclaimed = 0;
+static volatile uint32_t tx_full_stalls = 0;
+static volatile uint32_t tx_dropped = 0;
+
+static void e1000_net_tx_softirq(void);
+
+static const netdev_ops_t e1000_ops = {
+    .xmit = e1000_driver_xmit,
+    .flush = e1000_driver_flush,
+    .tx_wait = e1000_driver_tx_wait,
+    .get_stats = e1000_get_stats,
+    .get_irq_info = e1000_get_irq_info,
+    .get_ring_sizes = e1000_get_ring_sizes,
+};
+
+static netdev_t e1000_netdev = {
+    .name = "e1000",
+    .features = NETDEV_F_TX_CSUM | NETDEV_F_RX_CSUM,
+    .napi_budget = E1000_NAPI_BUDGET,
+    .ops = &e1000_ops,
+};
+
 static void e1000_write_reg(uint16_t reg, uint32_t value) {
     if (!mmio_addr) return;
     *((volatile uint32_t*)(mmio_addr + reg)) = value;
@@ -35,26 +89,196 @@ static void e1000_read_mac(void) {
     mac_addr[5] = (high >> 8) & 0xFF;
 }
 
-int e1000_driver_init(void) {
+static void e1000_irq_handler(struct registers* regs) {
+    (void)regs;
+
+    // Reading ICR acknowledges every cause; zero means a shared line
+    // fired for some other device
+    uint32_t icr = e1000_read_reg(E1000_REG_ICR);
+    if (icr == 0) return;
+
+    irq_count++;
+    if (icr & E1000_ICR_LSC) {
+        link_changes++;
+    }
+    if (icr & E1000_RX_IRQ_MASK) {
+        // Mask receive interrupts until the poll loop has drained the ring;
+        // under load the device then costs one interrupt per burst
+        e1000_write_reg(E1000_REG_IMC, E1000_RX_IRQ_MASK);
+        napi_scheduled = 1;
+        raise_softirq(SOFTIRQ_NET_RX);
+    }
+    if (icr & E1000_ICR_TXDW) {
+        raise_softirq(SOFTIRQ_NET_TX);
+    }
+}
+
+// Translate the descriptor's checksum status into pktbuf flags
+static uint8_t e1000_rx_csum_flags(e1000_rx_desc_t* desc) {
+    if (desc->status & E1000_RXD_STAT_IXSM) return 0;
+
+    uint8_t flags = 0;
+    if (desc->status & E1000_RXD_STAT_IPCS) {
+        flags |= (desc->errors & E1000_RXD_ERR_IPE) ? PKTBUF_CSUM_IP_BAD : PKTBUF_CSUM_IP_OK;
+    }
+    if (desc->status & E1000_RXD_STAT_TCPCS) {
+        flags |= (desc->errors & E1000_RXD_ERR_TCPE) ? PKTBUF_CSUM_L4_BAD : PKTBUF_CSUM_L4_OK;
+    }
+    return flags;
+}
+
+// Hand up to budget completed frames to the stack and return their
+// descriptors to the device. Called only from the NET_RX softirq, which
+// never nests on a CPU, so the hard IRQ handler cannot contend rx_lock.
+static int e1000_rx_poll(int budget) {
+    int done = 0;
+
+    spin_lock(&rx_lock);
+    while (done < budget && (rx_descs[rx_cur].status & E1000_RXD_STAT_DD)) {
+        e1000_rx_desc_t* desc = &rx_descs[rx_cur];
+
+        pktbuf_t* pb = rx_pbs[rx_cur];
+
+        // Checksum errors are reported per frame, not as receive errors
+        uint8_t errors = desc->errors & ~(E1000_RXD_ERR_TCPE | E1000_RXD_ERR_IPE);
+        if (errors || !(desc->status & E1000_RXD_STAT_EOP)) {
+            rx_errors++;
+        } else {
+            // Post a fresh buffer and pass the filled one up as is. With
+            // the pool empty the frame is dropped and its buffer reused.
+            pktbuf_t* fresh = pktbuf_alloc_rx();
+            if (!fresh) {
+                rx_no_buf++;
+            } else {
+                rx_pbs[rx_cur] = fresh;
+                desc->addr = (uint64_t)(uint32_t)fresh->data;
+
+                pb->len = desc->length;
+                pb->csum_flags = e1000_rx_csum_flags(desc);
+                rx_packets++;
+                rx_bytes += desc->length;
+                net_receive(pb);
+            }
+        }
+
+        desc->status = 0;
+        rx_cur = (rx_cur + 1) & (rx_size - 1);
+        done++;
+    }
+
+    // Return the whole batch with one tail write: each MMIO write is a
+    // VM exit under emulation. RDT is the last descriptor handed back.
+    if (done) e1000_write_reg(E1000_REG_RDT, (rx_cur - 1) & (rx_size - 1));
+    spin_unlock(&rx_lock);
+
+    return done;
+}
+
+static void e1000_net_rx_softirq(void) {
+    if (!napi_scheduled || !rx_descs) return;
+
+    rx_polls++;
+    if (e1000_rx_poll(E1000_NAPI_BUDGET) >= E1000_NAPI_BUDGET) {
+        // Still busy: stay masked and come back on the next pass
+        rx_budget_hits++;
+        raise_softirq(SOFTIRQ_NET_RX);
+        return;
+    }
+
+    // Ring empty. A frame that arrived while masked has already latched
+    // its cause in ICR, so unmasking raises the interrupt right away.
+    napi_scheduled = 0;
+    e1000_write_reg(E1000_REG_IMS, E1000_RX_IRQ_MASK);
+}
+
+// Prefer MSI-X, then MSI, then the INTx line through the active
+// interrupt controller. Message interrupts get a private vector and
+// never share a line.
+static void e1000_setup_irq(pci_device_t* dev) {
+    if (irq_mode == NETDEV_IRQ_NONE) {
+        int vector = irq_alloc_vector();
+
+        if (vector >= 0) {
+            irq_install_vector(vector, e1000_irq_handler);
+            if (pci_enable_msix(dev, 0, vector, 0) == 0) {
+                irq_mode = NETDEV_IRQ_MSIX;
+            } else if (pci_enable_msi(dev, vector, 0) == 0) {
+                irq_mode = NETDEV_IRQ_MSI;
+            } else {
+                irq_uninstall_vector(vector);
+                irq_free_vector(vector);
+                vector = -1;
+            }
+        }
+
+        if (irq_mode == NETDEV_IRQ_NONE && dev->irq < 16) {
+            irq_install_handler(dev->irq, e1000_irq_handler);
+            irq_unmask(dev->irq);
+            irq_mode = NETDEV_IRQ_LEGACY;
+            vector = IRQ0 + dev->irq;
+        }
+
+        irq_vector = vector;
+        if (irq_mode == NETDEV_IRQ_NONE) {
+            serial_write("E1000: No usable interrupt, polling only\n");
+            return;
+        }
+
+        open_softirq(SOFTIRQ_NET_RX, e1000_net_rx_softirq);
+        open_softirq(SOFTIRQ_NET_TX, e1000_net_tx_softirq);
+        serial_write(irq_mode == NETDEV_IRQ_MSIX ? "E1000: Using MSI-X\n" :
+                     irq_mode == NETDEV_IRQ_MSI ? "E1000: Using MSI\n" :
+                     "E1000: Using legacy INTx\n");
+    }
+
+    // Reset cleared the mask; drop stale causes and enable receive/link
+    napi_scheduled = 0;
+    e1000_write_reg(E1000_REG_IMC, 0xFFFFFFFF);
+    e1000_read_reg(E1000_REG_ICR);
+    e1000_write_reg(E1000_REG_IMS, E1000_RX_IRQ_MASK | E1000_ICR_TXDW | E1000_ICR_LSC);
+}
+
+static int e1000_ring_size_valid(uint32_t n) {
+    return n >= E1000_MIN_DESC && n <= E1000_MAX_DESC && (n & (n - 1)) == 0;
+}
+
+int e1000_set_ring_sizes(uint32_t rx, uint32_t tx) {
+    if (rx_descs || !e1000_ring_size_valid(rx) || !e1000_ring_size_valid(tx)) return -1;
+    rx_size = rx;
+    tx_size = tx;
+    return 0;
+}
+
+void e1000_get_ring_sizes(uint32_t* rx, uint32_t* tx) {
+    *rx = rx_size;
+    *tx = tx_size;
+}
+
+netdev_t* e1000_driver_init(void) {
     serial_write("E1000: Searching for device...\n");
     
+    spin_lock_init(&tx_lock, "e1000_tx");
+    spin_lock_init(&rx_lock, "e1000_rx");
+    
     pci_init();
     pci_device_t* dev = pci_find_device(E1000_VENDOR_ID, E1000_DEVICE_ID);
     
     if (!dev) {
         serial_write("E1000: Device not found\n");
-        return -1;
+        return NULL;
     }
     
-    serial_write("E1000: Device found at bus 0\n");
+    char loc[48];
+    sprintf(loc, "E1000: Device found at %02x:%02x.%u\n", dev->bus, dev->slot, dev->func);
+    serial_write(loc);
     
     // Get MMIO address (must be non-zero)
-    if (dev->bar0 == 0) {
+    if (dev->bar[0] == 0 || (dev->bar_is_io & 1)) {
         serial_write("E1000: Invalid BAR0\n");
-        return -1;
+        return NULL;
     }
     
-    mmio_addr = (uint8_t*)(uint32_t)(dev->bar0 & 0xFFFFFFF0);
+    mmio_addr = (uint8_t*)dev->bar[0];
     serial_write("E1000: MMIO configured\n");
     
     // Enable bus mastering and memory access
@@ -80,7 +304,7 @@ int e1000_driver_init(void) {
     
     if (timeout == 0) {
         serial_write("E1000: Reset timeout\n");
-        return -1;
+        return NULL;
     }
     
     serial_write("E1000: Reset complete\n");
@@ -100,26 +324,38 @@ int e1000_driver_init(void) {
     
     // Allocate descriptor rings
     serial_write("E1000: Allocating descriptors...\n");
-    rx_descs = (e1000_rx_desc_t*)kmalloc(sizeof(e1000_rx_desc_t) * E1000_NUM_RX_DESC);
-    tx_descs = (e1000_tx_desc_t*)kmalloc(sizeof(e1000_tx_desc_t) * E1000_NUM_TX_DESC);
-    rx_buffers = (uint8_t**)kmalloc(sizeof(uint8_t*) * E1000_NUM_RX_DESC);
-    tx_buffers = (uint8_t**)kmalloc(sizeof(uint8_t*) * E1000_NUM_TX_DESC);
+    rx_descs = (e1000_rx_desc_t*)dma_alloc(sizeof(e1000_rx_desc_t) * rx_size, E1000_RING_ALIGN);
+    tx_descs = (e1000_tx_desc_t*)dma_alloc(sizeof(e1000_tx_desc_t) * tx_size, E1000_RING_ALIGN);
+    rx_pbs = (pktbuf_t**)kmalloc(sizeof(pktbuf_t*) * rx_size);
+    tx_pbs = (pktbuf_t**)kmalloc(sizeof(pktbuf_t*) * tx_size);
     
-    if (!rx_descs || !tx_descs || !rx_buffers || !tx_buffers) {
+    if (!rx_descs || !tx_descs || !rx_pbs || !tx_pbs) {
         serial_write("E1000: Failed to allocate descriptors\n");
-        return -1;
+        return NULL;
     }
-    
-    // Allocate buffers
-    for (int i = 0; i < E1000_NUM_RX_DESC; i++) {
-        rx_buffers[i] = (uint8_t*)kmalloc(2048);
-        rx_descs[i].addr = (uint64_t)(uint32_t)rx_buffers[i];
+    memset(rx_descs, 0, sizeof(e1000_rx_desc_t) * rx_size);
+    memset(tx_descs, 0, sizeof(e1000_tx_desc_t) * tx_size);
+    
+    // One slab covering both rings keeps every in-flight buffer in a
+    // single contiguous run of pages
+    pktbuf_grow(rx_size + tx_size);
+    
+    // Post receive buffers from the packet pool; the device DMAs
+    // straight into them and they travel up the stack unchanged
+    for (uint32_t i = 0; i < rx_size; i++) {
+        rx_pbs[i] = pktbuf_alloc_rx();
+        if (!rx_pbs[i]) {
+            serial_write("E1000: Packet pool exhausted\n");
+            return NULL;
+        }
+        rx_descs[i].addr = (uint64_t)(uint32_t)rx_pbs[i]->data;
         rx_descs[i].status = 0;
     }
     
-    for (int i = 0; i < E1000_NUM_TX_DESC; i++) {
-        tx_buffers[i] = (uint8_t*)kmalloc(2048);
-        tx_descs[i].addr = (uint64_t)(uint32_t)tx_buffers[i];
+    // Transmit descriptors point at whatever buffer is queued on them
+    for (uint32_t i = 0; i < tx_size; i++) {
+        tx_pbs[i] = NULL;
+        tx_descs[i].addr = 0;
         tx_descs[i].status = 0;
         tx_descs[i].cmd = 0;
     }
@@ -127,85 +363,176 @@ int e1000_driver_init(void) {
     // Setup RX
     e1000_write_reg(E1000_REG_RDBAL, (uint32_t)rx_descs);
     e1000_write_reg(E1000_REG_RDBAH, 0);
-    e1000_write_reg(E1000_REG_RDLEN, E1000_NUM_RX_DESC * sizeof(e1000_rx_desc_t));
+    e1000_write_reg(E1000_REG_RDLEN, rx_size * sizeof(e1000_rx_desc_t));
     e1000_write_reg(E1000_REG_RDH, 0);
-    e1000_write_reg(E1000_REG_RDT, E1000_NUM_RX_DESC - 1);
+    e1000_write_reg(E1000_REG_RDT, rx_size - 1);
+    rx_cur = 0;
+    e1000_write_reg(E1000_REG_RXCSUM, E1000_RXCSUM_IPOFL | E1000_RXCSUM_TUOFL);
     e1000_write_reg(E1000_REG_RCTL, E1000_RCTL_EN | E1000_RCTL_BAM | E1000_RCTL_BSIZE_2048);
     
     // Setup TX
     e1000_write_reg(E1000_REG_TDBAL, (uint32_t)tx_descs);
     e1000_write_reg(E1000_REG_TDBAH, 0);
-    e1000_write_reg(E1000_REG_TDLEN, E1000_NUM_TX_DESC * sizeof(e1000_tx_desc_t));
+    e1000_write_reg(E1000_REG_TDLEN, tx_size * sizeof(e1000_tx_desc_t));
     e1000_write_reg(E1000_REG_TDH, 0);
     e1000_write_reg(E1000_REG_TDT, 0);
+    tx_cur = 0;
+    tx_clean = 0;
+    tx_queued = 0;
     e1000_write_reg(E1000_REG_TCTL, E1000_TCTL_EN | E1000_TCTL_PSP);
     
     // Link up
     e1000_write_reg(E1000_REG_CTRL, e1000_read_reg(E1000_REG_CTRL) | E1000_CTRL_SLU);
     
+    e1000_setup_irq(dev);
+    
+    e1000_get_mac(e1000_netdev.mac);
     serial_write("E1000: Initialized successfully\n");
-    return 0;
+    return &e1000_netdev;
 }
 
-void e1000_driver_send(uint8_t* data, uint32_t length) {
-    if (!mmio_addr || !tx_descs) {
-        serial_write("E1000: Not initialized\n");
-        return;
+// Take back descriptors the device has finished with. Caller holds tx_lock.
+static uint32_t e1000_tx_reclaim_locked(void) {
+    uint32_t reclaimed = 0;
+    while (tx_clean != tx_cur && (tx_descs[tx_clean].status & E1000_TXD_STAT_DD)) {
+        tx_descs[tx_clean].status = 0;
+        pktbuf_put(tx_pbs[tx_clean]);
+        tx_pbs[tx_clean] = NULL;
+        tx_clean = (tx_clean + 1) & (tx_size - 1);
+        reclaimed++;
     }
-    
-    // Copy data to buffer
-    for (uint32_t i = 0; i < length && i < 2048; i++) {
-        tx_buffers[tx_cur][i] = data[i];
-    }
-    
-    // Setup descriptor
-    tx_descs[tx_cur].length = length;
-    tx_descs[tx_cur].cmd = 0x0B; // EOP | IFCS | RS
-    tx_descs[tx_cur].status = 0;
-    
-    // Update tail
-    uint16_t old_cur = tx_cur;
-    tx_cur = (tx_cur + 1) % E1000_NUM_TX_DESC;
+    tx_reclaimed += reclaimed;
+    return reclaimed;
+}
+
+static inline uint32_t e1000_tx_free_locked(void) {
+    // One slot stays empty so a full ring is distinguishable from idle
+    return (tx_clean - tx_cur - 1) & (tx_size - 1);
+}
+
+// Publish queued descriptors with a single tail write. Caller holds tx_lock.
+static void e1000_tx_flush_locked(void) {
+    if (tx_queued == 0) return;
     e1000_write_reg(E1000_REG_TDT, tx_cur);
-    
-    // Wait for transmission with timeout
-    int timeout = 10000;
-    while (!(tx_descs[old_cur].status & 0x01) && timeout > 0) {
-        for (volatile int i = 0; i < 100; i++);
-        timeout--;
+    tx_queued = 0;
+    tx_batches++;
+}
+
+int e1000_driver_xmit(pktbuf_t* pb) {
+    if (!mmio_addr || !tx_descs) return -1;
+
+    uint32_t flags = spin_lock_irqsave(&tx_lock);
+
+    // Reclaim lazily, only once the ring is running low
+    if (e1000_tx_free_locked() < tx_size / 4) {
+        e1000_tx_reclaim_locked();
     }
-    
-    if (timeout > 0) {
-        serial_write("E1000: Packet sent\n");
-    } else {
-        serial_write("E1000: Send timeout\n");
+
+    // Backpressure: the ring is full, so push out what is queued and
+    // take back anything already sent. Waiting for more would keep
+    // interrupts off and every other sender out, so the frame is dropped
+    // and the caller (TCP retransmission, say) tries again later.
+    if (e1000_tx_free_locked() == 0) {
+        tx_full_stalls++;
+        e1000_tx_flush_locked();
+        e1000_tx_reclaim_locked();
+        if (e1000_tx_free_locked() == 0) {
+            tx_dropped++;
+            spin_unlock_irqrestore(&tx_lock, flags);
+            return -1;
+        }
     }
-}
 
-int e1000_driver_receive(uint8_t* buffer, uint32_t max_length) {
-    if (!mmio_addr || !rx_descs) return 0;
-    
-    if (!(rx_descs[rx_cur].status & 0x01)) {
-        return 0; // No packet
+    // The device reads the frame straight out of the caller's buffer
+    tx_pbs[tx_cur] = pb;
+    tx_descs[tx_cur].addr = (uint64_t)(uint32_t)pb->data;
+    tx_descs[tx_cur].length = pb->len;
+    tx_descs[tx_cur].cmd = E1000_TXD_CMD_EOP | E1000_TXD_CMD_IFCS | E1000_TXD_CMD_RS;
+    tx_descs[tx_cur].status = 0;
+    tx_descs[tx_cur].css = 0;
+    tx_descs[tx_cur].cso = 0;
+
+    // Legacy descriptor offload: the device sums from CSS to the end of
+    // the frame and adds in the seed already stored at CSO, so the stack
+    // pre-loads the pseudo-header sum there for TCP/UDP
+    if (pb->csum_flags & PKTBUF_CSUM_PARTIAL) {
+        uint32_t start = pb->csum_start - pktbuf_headroom(pb);
+        if (start + pb->csum_offset <= 0xFF) {
+            tx_descs[tx_cur].css = start;
+            tx_descs[tx_cur].cso = start + pb->csum_offset;
+            tx_descs[tx_cur].cmd |= E1000_TXD_CMD_IC;
+        } else {
+            // Offsets beyond the 8-bit fields: finish it in software
+            uint8_t* from = pb->head + pb->csum_start;
+            *(uint16_t*)(from + pb->csum_offset) = net_checksum(from, pb->data + pb->len - from);
+        }
     }
-    
-    uint16_t length = rx_descs[rx_cur].length;
-    if (length > max_length) length = max_length;
-    
-    // Copy data
-    for (uint16_t i = 0; i < length; i++) {
-        buffer[i] = rx_buffers[rx_cur][i];
+
+    tx_cur = (tx_cur + 1) & (tx_size - 1);
+    tx_queued++;
+    tx_packets++;
+    tx_bytes += pb->len;
+
+    spin_unlock_irqrestore(&tx_lock, flags);
+    return 0;
+}
+
+void e1000_driver_flush(void) {
+    if (!mmio_addr || !tx_descs) return;
+
+    uint32_t flags = spin_lock_irqsave(&tx_lock);
+    e1000_tx_flush_locked();
+    spin_unlock_irqrestore(&tx_lock, flags);
+}
+
+int e1000_driver_tx_wait(void) {
+    if (!mmio_addr || !tx_descs) return -1;
+
+    int timeout = 1000000;
+    for (;;) {
+        uint32_t flags = spin_lock_irqsave(&tx_lock);
+        e1000_tx_flush_locked();
+        e1000_tx_reclaim_locked();
+        int idle = (tx_clean == tx_cur);
+        spin_unlock_irqrestore(&tx_lock, flags);
+
+        if (idle) return 0;
+        if (timeout-- <= 0) return -1;
+        __asm__ volatile("pause");
     }
-    
-    // Reset descriptor
-    rx_descs[rx_cur].status = 0;
-    
-    // Update tail
-    uint16_t old_cur = rx_cur;
-    rx_cur = (rx_cur + 1) % E1000_NUM_RX_DESC;
-    e1000_write_reg(E1000_REG_RDT, old_cur);
-    
-    return length;
+}
+
+// TXDW bottom half: reclaim completions while the sender is idle
+static void e1000_net_tx_softirq(void) {
+    if (!tx_descs) return;
+
+    uint32_t flags = spin_lock_irqsave(&tx_lock);
+    e1000_tx_reclaim_locked();
+    spin_unlock_irqrestore(&tx_lock, flags);
+}
+
+void e1000_get_irq_info(netdev_irq_info_t* info) {
+    info->mode = irq_mode;
+    info->vector = irq_vector < 0 ? 0 : (uint32_t)irq_vector;
+    info->count = irq_count;
+    info->link_changes = link_changes;
+}
+
+void e1000_get_stats(netdev_stats_t* stats) {
+    stats->rx_packets = rx_packets;
+    stats->rx_bytes = rx_bytes;
+    stats->rx_errors = rx_errors;
+    stats->rx_polls = rx_polls;
+    stats->rx_budget_hits = rx_budget_hits;
+    stats->rx_no_buf = rx_no_buf;
+    stats->irq_count = irq_count;
+    stats->tx_packets = tx_packets;
+    stats->tx_bytes = tx_bytes;
+    stats->tx_batches = tx_batches;
+    stats->tx_kicks_skipped = 0;
+    stats->tx_reclaimed = tx_reclaimed;
+    stats->tx_full_stalls = tx_full_stalls;
+    stats->tx_dropped = tx_dropped;
 }
 
 void e1000_get_mac(uint8_t* mac) {
@@ -2,6 +2,10 @@
 #include "irq.h"
 #include "serial.h"
 #include "vga.h"
+#include "lock.h"
+#include "softirq.h"
+#include "workqueue.h"
+#include <stddef.h>
 
 #define KEYBOARD_DATA_PORT 0x60
 #define KEYBOARD_STATUS_PORT 0x64
@@ -12,6 +16,24 @@ static char key_buffer[BUFFER_SIZE];
 static int buffer_start = 0;
 static int buffer_end = 0;
 
+// Protects the ring: the keyboard softirq fills it while the shell drains it
+static spinlock_t buffer_lock;
+
+// Raw scancodes handed from the hard IRQ to the softirq
+#define SCAN_SIZE 64
+static uint8_t scan_buffer[SCAN_SIZE];
+static int scan_start = 0;
+static int scan_end = 0;
+static spinlock_t scan_lock;
+
+// Characters waiting to be echoed by the console work item
+#define ECHO_SIZE 256
+static char echo_buffer[ECHO_SIZE];
+static int echo_start = 0;
+static int echo_end = 0;
+static spinlock_t echo_lock;
+static work_t echo_work;
+
 static inline uint8_t inb(uint16_t port) {
     uint8_t ret;
     __asm__ volatile ("inb %1, %0" : "=a"(ret) : "Nd"(port));
@@ -61,42 +83,43 @@ static int shift_pressed = 0;
 
 // Add key to buffer
 static void buffer_add(char c) {
+    uint32_t flags = spin_lock_irqsave(&buffer_lock);
     int next = (buffer_end + 1) % BUFFER_SIZE;
     if (next != buffer_start) {
         key_buffer[buffer_end] = c;
         buffer_end = next;
     }
+    spin_unlock_irqrestore(&buffer_lock, flags);
 }
 
 // Get key from buffer
 static char buffer_get(void) {
-    if (buffer_start == buffer_end) {
-        return 0;
+    char c = 0;
+    uint32_t flags = spin_lock_irqsave(&buffer_lock);
+    if (buffer_start != buffer_end) {
+        c = key_buffer[buffer_start];
+        buffer_start = (buffer_start + 1) % BUFFER_SIZE;
     }
-    char c = key_buffer[buffer_start];
-    buffer_start = (buffer_start + 1) % BUFFER_SIZE;
+    spin_unlock_irqrestore(&buffer_lock, flags);
     return c;
 }
 
-// Keyboard interrupt handler
-static void keyboard_handler(struct registers* regs) {
-    (void)regs;
-    
-    uint8_t scancode = inb(KEYBOARD_DATA_PORT);
-    
+// Translate a make/break code, tracking shift. Returns 0 for keys that
+// produce no character.
+static char keyboard_translate(uint8_t scancode) {
     // Check for shift press/release
     if (scancode == 0x2A || scancode == 0x36) {
         shift_pressed = 1;
-        return;
+        return 0;
     }
     if (scancode == 0xAA || scancode == 0xB6) {
         shift_pressed = 0;
-        return;
+        return 0;
     }
     
     // Ignore key releases (high bit set)
     if (scancode & 0x80) {
-        return;
+        return 0;
     }
     
     // Handle special keys
@@ -129,20 +152,82 @@ static void keyboard_handler(struct registers* regs) {
         }
     }
     
-    if (c != 0) {
+    return c;
+}
+
+// Console echo, run from console_wq so VGA output leaves the IRQ path
+static void keyboard_echo_work(void* arg) {
+    (void)arg;
+    
+    while (1) {
+        char c = 0;
+        uint32_t flags = spin_lock_irqsave(&echo_lock);
+        if (echo_start != echo_end) {
+            c = echo_buffer[echo_start];
+            echo_start = (echo_start + 1) % ECHO_SIZE;
+        }
+        spin_unlock_irqrestore(&echo_lock, flags);
+        
+        if (c == 0) break;
+        vga_putchar(c);
+    }
+}
+
+// Bottom half: translate raw scancodes, fill the key buffer, queue echo
+static void keyboard_softirq(void) {
+    int echoed = 0;
+    
+    while (1) {
+        int have = 0;
+        uint8_t scancode = 0;
+        uint32_t flags = spin_lock_irqsave(&scan_lock);
+        if (scan_start != scan_end) {
+            scancode = scan_buffer[scan_start];
+            scan_start = (scan_start + 1) % SCAN_SIZE;
+            have = 1;
+        }
+        spin_unlock_irqrestore(&scan_lock, flags);
+        
+        if (!have) break;
+        
+        char c = keyboard_translate(scancode);
+        if (c == 0) continue;
+        
         buffer_add(c);
         
-        // Echo to screen
-        if (c == '\b') {
-            vga_putchar('\b');
-        } else if (c == '\n') {
-            vga_putchar('\n');
-        } else {
-            vga_putchar(c);
+        flags = spin_lock_irqsave(&echo_lock);
+        int next = (echo_end + 1) % ECHO_SIZE;
+        if (next != echo_start) {
+            echo_buffer[echo_end] = c;
+            echo_end = next;
+            echoed = 1;
         }
+        spin_unlock_irqrestore(&echo_lock, flags);
+    }
+    
+    if (echoed) {
+        queue_work(&console_wq, &echo_work);
     }
 }
 
+// Keyboard interrupt handler: grab the scancode and defer the rest
+static void keyboard_handler(struct registers* regs) {
+    (void)regs;
+    
+    uint8_t scancode = inb(KEYBOARD_DATA_PORT);
+    
+    // Interrupts are already off inside the handler
+    spin_lock(&scan_lock);
+    int next = (scan_end + 1) % SCAN_SIZE;
+    if (next != scan_start) {
+        scan_buffer[scan_end] = scancode;
+        scan_end = next;
+    }
+    spin_unlock(&scan_lock);
+    
+    raise_softirq(SOFTIRQ_KEYBOARD);
+}
+
 static inline void outb(uint16_t port, uint8_t val) {
     __asm__ volatile ("outb %0, %1" : : "a"(val), "Nd"(port));
 }
@@ -170,6 +255,12 @@ static void keyboard_wait_output(void) {
 void keyboard_init(void) {
     serial_write("Keyboard: Initializing...\n");
 
+    spin_lock_init(&buffer_lock, "keyboard");
+    spin_lock_init(&scan_lock, "keyboard_scan");
+    spin_lock_init(&echo_lock, "keyboard_echo");
+    init_work(&echo_work, keyboard_echo_work, NULL);
+    open_softirq(SOFTIRQ_KEYBOARD, keyboard_softirq);
+
     // Disable first PS/2 port
     keyboard_wait_input();
     outb(KEYBOARD_STATUS_PORT, 0xAD);
@@ -221,10 +312,8 @@ void keyboard_init(void) {
     // Register keyboard interrupt handler (IRQ1)
     irq_install_handler(1, keyboard_handler);
 
-    // Make sure keyboard IRQ is enabled in PIC
-    uint8_t mask = inb(0x21);
-    mask &= ~(1 << 1);  // Enable IRQ1 (keyboard)
-    outb(0x21, mask);
+    // Enable IRQ1 at whichever interrupt controller is active
+    irq_unmask(1);
 
     serial_write("Keyboard: IRQ enabled\n");
     serial_write("Keyboard: Initialized successfully\n");
@@ -274,8 +363,9 @@ static char keyboard_poll(void) {
 
 char keyboard_getchar(void) {
     // Try interrupt-based first
-    if (buffer_start != buffer_end) {
-        return buffer_get();
+    char buffered = buffer_get();
+    if (buffered != 0) {
+        return buffered;
     }
     
     // Fall back to polling
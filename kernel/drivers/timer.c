@@ -1,8 +1,16 @@
 #include "timer.h"
 #include "irq.h"
 #include "serial.h"
+#include "div64.h"
+#include "rcu.h"
+#include "softirq.h"
 
-static uint32_t tick = 0;
+static volatile uint32_t tick = 0;
+static uint32_t timer_hz = 0;
+static uint32_t tsc_khz = 0;
+
+static timer_hook_t hooks[TIMER_MAX_HOOKS];
+static volatile uint32_t num_hooks = 0;
 
 static inline void outb(uint16_t port, uint8_t val) {
     __asm__ volatile ("outb %0, %1" : : "a"(val), "Nd"(port));
@@ -12,20 +20,35 @@ static inline void outb(uint16_t port, uint8_t val) {
 static void timer_handler(struct registers* regs) {
     (void)regs;
     tick++;
+    raise_softirq(SOFTIRQ_TIMER);
 }
 
-static inline uint8_t inb(uint16_t port) {
-    uint8_t ret;
-    __asm__ volatile ("inb %1, %0" : "=a"(ret) : "Nd"(port));
-    return ret;
+// Timer bottom half
+static void timer_softirq(void) {
+    // Keep grace periods moving on CPUs that never reach the scheduler
+    rcu_tick();
+
+    uint32_t n = num_hooks;
+    for (uint32_t i = 0; i < n; i++) hooks[i]();
+}
+
+int timer_add_hook(timer_hook_t fn) {
+    if (num_hooks >= TIMER_MAX_HOOKS) return -1;
+    hooks[num_hooks] = fn;
+    // Publish the slot before the count the softirq reads
+    __atomic_store_n(&num_hooks, num_hooks + 1, __ATOMIC_RELEASE);
+    return 0;
 }
 
 void timer_init(uint32_t frequency) {
     serial_write("Timer: Initializing...\n");
 
     // Register timer handler
+    open_softirq(SOFTIRQ_TIMER, timer_softirq);
     irq_install_handler(0, timer_handler);
 
+    timer_hz = frequency;
+
     // Calculate divisor
     uint32_t divisor = 1193180 / frequency;
 
@@ -39,10 +62,8 @@ void timer_init(uint32_t frequency) {
     outb(0x40, low);
     outb(0x40, high);
 
-    // Make sure timer IRQ is enabled in PIC
-    uint8_t mask = inb(0x21);
-    mask &= ~(1 << 0);  // Enable IRQ0 (timer)
-    outb(0x21, mask);
+    // Enable IRQ0 at whichever interrupt controller is active
+    irq_unmask(0);
 
     serial_write("Timer: IRQ enabled\n");
     serial_write("Timer: Initialized successfully\n");
@@ -51,3 +72,40 @@ void timer_init(uint32_t frequency) {
 uint32_t timer_get_ticks(void) {
     return tick;
 }
+
+// Measure the TSC rate against the PIT tick. Needs interrupts enabled.
+void timer_calibrate_tsc(void) {
+    serial_write("Timer: Calibrating TSC...\n");
+
+    // Align to a tick edge, then count cycles across 10 ticks
+    uint32_t start_tick = tick;
+    while (tick == start_tick) __asm__ volatile("pause");
+
+    uint32_t t0 = tick;
+    uint64_t c0 = rdtsc();
+    while (tick - t0 < 10) __asm__ volatile("pause");
+    uint64_t c1 = rdtsc();
+
+    // cycles per ms = delta / (10 ticks * 1000 / hz ms)
+    tsc_khz = (uint32_t)div_u64((c1 - c0) * timer_hz, 10 * 1000);
+    if (tsc_khz == 0) tsc_khz = 1000000; // Assume 1 GHz if calibration failed
+
+    serial_write("Timer: TSC calibrated\n");
+}
+
+uint32_t timer_tsc_khz(void) {
+    return tsc_khz;
+}
+
+uint64_t timer_cycles_to_us(uint64_t cycles) {
+    return div_u64(cycles * 1000, tsc_khz);
+}
+
+uint64_t timer_cycles_to_ns(uint64_t cycles) {
+    return div_u64(cycles * 1000000, tsc_khz);
+}
+
+void timer_udelay(uint32_t us) {
+    uint64_t end = rdtsc() + div_u64((uint64_t)us * tsc_khz, 1000);
+    while (rdtsc() < end) __asm__ volatile("pause");
+}
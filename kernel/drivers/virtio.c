@@ -0,0 +1,282 @@
+#include "virtio.h"
+#include "pci.h"
+#include "heap.h"
+#include "serial.h"
+#include "string.h"
+#include <stddef.h>
+
+// The avail ring's used_event and the used ring's avail_event trail the
+// rings proper
+static inline volatile uint16_t* virtq_used_event(virtqueue_t* vq) {
+    return &vq->avail->ring[vq->size];
+}
+
+static inline volatile uint16_t* virtq_avail_event(virtqueue_t* vq) {
+    return (volatile uint16_t*)&vq->used->ring[vq->size];
+}
+
+// Store/load ordering against the device; x86 needs a real fence only
+// where a store must be visible before a following load
+static inline void virtio_mb(void) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+static inline void virtio_wmb(void) {
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void virtio_rmb(void) {
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+}
+
+static uint32_t virtio_cap_read(pci_device_t* pci, uint8_t cap, uint8_t offset) {
+    return pci_read_config(pci->bus, pci->slot, pci->func, cap + offset);
+}
+
+int virtio_pci_init(pci_device_t* pci, virtio_device_t* vdev) {
+    memset(vdev, 0, sizeof(*vdev));
+    vdev->pci = pci;
+
+    // A function may list several capabilities of one type; the first
+    // usable one is preferred
+    for (uint32_t i = 0; i < pci->num_caps; i++) {
+        if (pci->caps[i].id != PCI_CAP_ID_VNDR) continue;
+
+        uint8_t cap = pci->caps[i].offset;
+        uint8_t type = (virtio_cap_read(pci, cap, 0) >> 24) & 0xFF;
+        uint8_t bar = virtio_cap_read(pci, cap, VIRTIO_PCI_CAP_BAR) & 0xFF;
+        uint32_t offset = virtio_cap_read(pci, cap, VIRTIO_PCI_CAP_OFFSET);
+
+        if (type == VIRTIO_PCI_CAP_PCI_CFG) continue;
+        if (bar >= PCI_NUM_BARS || pci->bar[bar] == 0 || (pci->bar_is_io & (1 << bar))) continue;
+        volatile uint8_t* window = (volatile uint8_t*)(pci->bar[bar] + offset);
+
+        if (type == VIRTIO_PCI_CAP_COMMON_CFG && !vdev->common) {
+            vdev->common = (volatile virtio_pci_common_cfg_t*)window;
+        } else if (type == VIRTIO_PCI_CAP_NOTIFY_CFG && !vdev->notify_base) {
+            vdev->notify_base = window;
+            vdev->notify_mult = virtio_cap_read(pci, cap, VIRTIO_PCI_NOTIFY_MULT);
+        } else if (type == VIRTIO_PCI_CAP_ISR_CFG && !vdev->isr) {
+            vdev->isr = window;
+        } else if (type == VIRTIO_PCI_CAP_DEVICE_CFG && !vdev->device_cfg) {
+            vdev->device_cfg = window;
+        }
+    }
+
+    if (!vdev->common || !vdev->notify_base || !vdev->isr) return -1;
+
+    // Write the command word alone so the RW1C status bits stay intact
+    uint32_t cmd = pci_read_config(pci->bus, pci->slot, pci->func, PCI_REG_COMMAND) & 0xFFFF;
+    pci_write_config(pci->bus, pci->slot, pci->func, PCI_REG_COMMAND,
+                     cmd | PCI_COMMAND_MEMORY | PCI_COMMAND_MASTER);
+    return 0;
+}
+
+int virtio_negotiate(virtio_device_t* vdev, uint64_t supported) {
+    volatile virtio_pci_common_cfg_t* common = vdev->common;
+
+    // Reset, and wait for the device to report it finished
+    common->device_status = 0;
+    int timeout = 100000;
+    while (common->device_status != 0 && timeout-- > 0) {
+        __asm__ volatile("pause");
+    }
+    if (common->device_status != 0) return -1;
+
+    common->device_status = VIRTIO_STATUS_ACKNOWLEDGE;
+    common->device_status = VIRTIO_STATUS_ACKNOWLEDGE | VIRTIO_STATUS_DRIVER;
+
+    common->device_feature_select = 0;
+    uint64_t offered = common->device_feature;
+    common->device_feature_select = 1;
+    offered |= (uint64_t)common->device_feature << 32;
+
+    uint64_t features = offered & supported;
+    if (!(features & VIRTIO_F_VERSION_1)) {
+        common->device_status |= VIRTIO_STATUS_FAILED;
+        return -1;
+    }
+
+    common->driver_feature_select = 0;
+    common->driver_feature = (uint32_t)features;
+    common->driver_feature_select = 1;
+    common->driver_feature = (uint32_t)(features >> 32);
+
+    // The device confirms by leaving FEATURES_OK set
+    common->device_status |= VIRTIO_STATUS_FEATURES_OK;
+    if (!(common->device_status & VIRTIO_STATUS_FEATURES_OK)) {
+        common->device_status |= VIRTIO_STATUS_FAILED;
+        return -1;
+    }
+
+    vdev->features = features;
+    return 0;
+}
+
+int virtq_setup(virtio_device_t* vdev, virtqueue_t* vq, uint16_t index,
+                uint16_t max_size, uint16_t msix_vector) {
+    volatile virtio_pci_common_cfg_t* common = vdev->common;
+
+    common->queue_select = index;
+    uint16_t size = common->queue_size;
+    if (size == 0 || common->queue_enable) return -1;
+
+    // Split ring sizes are powers of two, so the smaller of two is one too
+    if (size > max_size) size = max_size;
+
+    memset(vq, 0, sizeof(*vq));
+    vq->index = index;
+    vq->size = size;
+    vq->event_idx = virtio_has_feature(vdev, VIRTIO_F_RING_EVENT_IDX);
+
+    // Ring sizes per virtio 1.0, 2.4: each part plus its event field
+    uint32_t desc_bytes = sizeof(virtq_desc_t) * size;
+    uint32_t avail_bytes = sizeof(virtq_avail_t) + sizeof(uint16_t) * (size + 1);
+    uint32_t used_bytes = sizeof(virtq_used_t) + sizeof(virtq_used_elem_t) * size + sizeof(uint16_t);
+
+    vq->desc = (volatile virtq_desc_t*)dma_alloc(desc_bytes, VIRTQ_ALIGN);
+    vq->avail = (volatile virtq_avail_t*)dma_alloc(avail_bytes, VIRTQ_ALIGN);
+    vq->used = (volatile virtq_used_t*)dma_alloc(used_bytes, VIRTQ_ALIGN);
+    vq->cookies = (void**)kmalloc(sizeof(void*) * size);
+    if (!vq->desc || !vq->avail || !vq->used || !vq->cookies) return -1;
+
+    memset((void*)vq->desc, 0, desc_bytes);
+    memset((void*)vq->avail, 0, avail_bytes);
+    memset((void*)vq->used, 0, used_bytes);
+
+    for (uint16_t i = 0; i < size; i++) {
+        vq->desc[i].next = i + 1;
+        vq->cookies[i] = NULL;
+    }
+    vq->free_head = 0;
+    vq->num_free = size;
+
+    common->queue_size = size;
+    common->queue_desc_lo = (uint32_t)vq->desc;
+    common->queue_desc_hi = 0;
+    common->queue_avail_lo = (uint32_t)vq->avail;
+    common->queue_avail_hi = 0;
+    common->queue_used_lo = (uint32_t)vq->used;
+    common->queue_used_hi = 0;
+
+    // Reading back NO_VECTOR means the device could not take the vector
+    common->queue_msix_vector = msix_vector;
+    if (common->queue_msix_vector != msix_vector) return -1;
+
+    vq->notify = (volatile uint16_t*)(vdev->notify_base +
+                                      common->queue_notify_off * vdev->notify_mult);
+    common->queue_enable = 1;
+    return 0;
+}
+
+void virtio_driver_ok(virtio_device_t* vdev) {
+    vdev->common->device_status |= VIRTIO_STATUS_DRIVER_OK;
+}
+
+uint8_t virtio_read_isr(virtio_device_t* vdev) {
+    return *vdev->isr;
+}
+
+void virtio_read_config(virtio_device_t* vdev, uint32_t offset, void* buf, uint32_t len) {
+    if (!vdev->device_cfg) return;
+
+    // Retry if the device changed the fields midway through
+    uint8_t* out = (uint8_t*)buf;
+    uint8_t generation;
+    do {
+        generation = vdev->common->config_generation;
+        for (uint32_t i = 0; i < len; i++) {
+            out[i] = vdev->device_cfg[offset + i];
+        }
+    } while (generation != vdev->common->config_generation);
+}
+
+int virtq_add(virtqueue_t* vq, void* buf, uint32_t len, int device_writes, void* cookie) {
+    if (vq->num_free == 0) return -1;
+
+    uint16_t head = vq->free_head;
+    volatile virtq_desc_t* desc = &vq->desc[head];
+    vq->free_head = desc->next;
+    vq->num_free--;
+
+    desc->addr = (uint64_t)(uint32_t)buf;
+    desc->len = len;
+    desc->flags = device_writes ? VIRTQ_DESC_F_WRITE : 0;
+    vq->cookies[head] = cookie;
+
+    vq->avail->ring[vq->avail_idx & (vq->size - 1)] = head;
+    vq->avail_idx++;
+    return 0;
+}
+
+int virtq_kick(virtqueue_t* vq) {
+    uint16_t old = vq->published_idx;
+    uint16_t new_idx = vq->avail_idx;
+    if (old == new_idx) return -1;
+
+    // Descriptors and ring entries before the index the device polls
+    virtio_wmb();
+    vq->avail->idx = new_idx;
+    vq->published_idx = new_idx;
+
+    // The index store must land before the device's event is read, or a
+    // device going idle concurrently could be left unnotified
+    virtio_mb();
+
+    int notify;
+    if (vq->event_idx) {
+        notify = virtq_need_event(*virtq_avail_event(vq), new_idx, old);
+    } else {
+        notify = !(vq->used->flags & VIRTQ_USED_F_NO_NOTIFY);
+    }
+    if (notify) {
+        *vq->notify = vq->index;
+    }
+    return notify;
+}
+
+void* virtq_get(virtqueue_t* vq, uint32_t* len) {
+    if (!virtq_has_used(vq)) return NULL;
+
+    // Read the entry only after seeing the index that covers it
+    virtio_rmb();
+    volatile virtq_used_elem_t* elem = &vq->used->ring[vq->last_used & (vq->size - 1)];
+    uint16_t id = (uint16_t)elem->id;
+    if (len) *len = elem->len;
+    vq->last_used++;
+
+    void* cookie = vq->cookies[id];
+    vq->cookies[id] = NULL;
+    vq->desc[id].next = vq->free_head;
+    vq->free_head = id;
+    vq->num_free++;
+    return cookie;
+}
+
+void virtq_disable_cb(virtqueue_t* vq) {
+    if (vq->event_idx) {
+        // An event the device has already passed fires only after the
+        // index wraps all the way around
+        *virtq_used_event(vq) = vq->last_used - 1;
+    } else {
+        vq->avail->flags = VIRTQ_AVAIL_F_NO_INTERRUPT;
+    }
+}
+
+int virtq_enable_cb(virtqueue_t* vq) {
+    if (vq->event_idx) {
+        *virtq_used_event(vq) = vq->last_used;
+    } else {
+        vq->avail->flags = 0;
+    }
+    virtio_mb();
+    return virtq_has_used(vq);
+}
+
+void virtq_enable_cb_delayed(virtqueue_t* vq) {
+    if (vq->event_idx) {
+        *virtq_used_event(vq) = vq->avail_idx - 1;
+    } else {
+        vq->avail->flags = 0;
+    }
+}
@@ -0,0 +1,489 @@
+#include "virtio_net.h"
+#include "virtio.h"
+#include "pci.h"
+#include "serial.h"
+#include "lock.h"
+#include "irq.h"
+#include "softirq.h"
+#include "string.h"
+#include "net.h"
+#include "pktbuf.h"
+#include <stddef.h>
+
+static virtio_device_t vdev;
+static virtqueue_t rxq;
+static virtqueue_t txq;
+static int ready = 0;
+static uint32_t hdr_len = sizeof(virtio_net_hdr_t);
+
+// Separate locks so a sender never waits behind the receive path
+static spinlock_t tx_lock;
+static spinlock_t rx_lock;
+
+static netdev_irq_mode_t irq_mode = NETDEV_IRQ_NONE;
+static int irq_vector = -1;      // RX vector (MSI-X) or the INTx vector
+static int tx_irq_vector = -1;   // MSI-X only
+static volatile uint32_t irq_count = 0;
+static volatile uint32_t link_changes = 0;
+
+// Set while receive interrupts are suppressed and the poll loop owns the queue
+static volatile uint32_t napi_scheduled = 0;
+
+static volatile uint32_t rx_packets = 0;
+static volatile uint32_t rx_bytes = 0;
+static volatile uint32_t rx_errors = 0;
+static volatile uint32_t rx_polls = 0;
+static volatile uint32_t rx_budget_hits = 0;
+static volatile uint32_t rx_no_buf = 0;
+
+static volatile uint32_t tx_packets = 0;
+static volatile uint32_t tx_bytes = 0;
+static volatile uint32_t tx_batches = 0;
+static volatile uint32_t tx_kicks_skipped = 0;
+static volatile uint32_t tx_reclaimed = 0;
+static volatile uint32_t tx_full_stalls = 0;
+static volatile uint32_t tx_dropped = 0;
+
+static void virtio_net_tx_softirq(void);
+
+static const netdev_ops_t virtio_net_ops = {
+    .xmit = virtio_net_xmit,
+    .flush = virtio_net_flush,
+    .tx_wait = virtio_net_tx_wait,
+    .get_stats = virtio_net_get_stats,
+    .get_irq_info = virtio_net_get_irq_info,
+    .get_ring_sizes = virtio_net_get_ring_sizes,
+};
+
+static netdev_t virtio_net_netdev = {
+    .name = "virtio-net",
+    .napi_budget = VIRTIO_NET_NAPI_BUDGET,
+    .ops = &virtio_net_ops,
+};
+
+// Post a whole pktbuf slot for the device to write header and frame into
+static int virtio_net_post_rx(pktbuf_t* pb) {
+    pb->data = pb->head;
+    pb->len = 0;
+    return virtq_add(&rxq, pb->head, PKTBUF_SIZE, 1, pb);
+}
+
+static void virtio_net_rx_irq(struct registers* regs) {
+    (void)regs;
+    irq_count++;
+
+    // Suppress further receive interrupts until the poll loop has drained
+    // the queue. This is a write to guest memory, not a device register.
+    virtq_disable_cb(&rxq);
+    napi_scheduled = 1;
+    raise_softirq(SOFTIRQ_NET_RX);
+}
+
+static void virtio_net_tx_irq(struct registers* regs) {
+    (void)regs;
+    irq_count++;
+    raise_softirq(SOFTIRQ_NET_TX);
+}
+
+// INTx: one line for both queues and configuration changes
+static void virtio_net_intx_irq(struct registers* regs) {
+    (void)regs;
+
+    // Reading ISR acknowledges it; zero means a shared line fired for
+    // some other device
+    uint8_t isr = virtio_read_isr(&vdev);
+    if (isr == 0) return;
+
+    irq_count++;
+    if (isr & VIRTIO_ISR_CONFIG) {
+        link_changes++;
+    }
+    if (isr & VIRTIO_ISR_QUEUE) {
+        virtq_disable_cb(&rxq);
+        napi_scheduled = 1;
+        raise_softirq(SOFTIRQ_NET_RX);
+        raise_softirq(SOFTIRQ_NET_TX);
+    }
+}
+
+// Translate the header's checksum state into pktbuf flags. A frame from
+// another guest on the host may still carry a partial checksum; finish
+// it here so the stack sees a normal frame.
+static uint8_t virtio_net_rx_csum_flags(virtio_net_hdr_t* hdr, pktbuf_t* pb) {
+    if (hdr->flags & VIRTIO_NET_HDR_F_NEEDS_CSUM) {
+        uint32_t start = hdr->csum_start;
+        if (start + hdr->csum_offset + 2 > pb->len) return 0;
+        uint8_t* from = pb->data + start;
+        *(uint16_t*)(from + hdr->csum_offset) = net_checksum(from, pb->len - start);
+        return PKTBUF_CSUM_L4_OK;
+    }
+    if (hdr->flags & VIRTIO_NET_HDR_F_DATA_VALID) {
+        return PKTBUF_CSUM_L4_OK;
+    }
+    return 0;
+}
+
+// Hand up to budget received frames to the stack and repost their
+// buffers with one notification. Called only from the NET_RX softirq.
+static int virtio_net_rx_poll(int budget) {
+    int done = 0;
+    pktbuf_t* pb;
+    uint32_t len;
+
+    spin_lock(&rx_lock);
+    while (done < budget && (pb = (pktbuf_t*)virtq_get(&rxq, &len)) != NULL) {
+        virtio_net_hdr_t* hdr = (virtio_net_hdr_t*)pb->head;
+
+        if (len < hdr_len + 14 || len > PKTBUF_SIZE) {
+            rx_errors++;
+        } else {
+            // Post a fresh buffer and pass the filled one up as is. With
+            // the pool empty the frame is dropped and its buffer reused.
+            pktbuf_t* fresh = pktbuf_alloc_rx();
+            if (!fresh) {
+                rx_no_buf++;
+            } else {
+                pb->len = len;
+                pktbuf_pull(pb, hdr_len);
+                pb->csum_flags = virtio_net_rx_csum_flags(hdr, pb);
+                rx_packets++;
+                rx_bytes += pb->len;
+                net_receive(pb);
+                pb = fresh;
+            }
+        }
+
+        virtio_net_post_rx(pb);
+        done++;
+    }
+    if (done) {
+        virtq_kick(&rxq);
+    }
+    spin_unlock(&rx_lock);
+
+    return done;
+}
+
+static void virtio_net_rx_softirq(void) {
+    if (!napi_scheduled || !ready) return;
+
+    rx_polls++;
+    if (virtio_net_rx_poll(VIRTIO_NET_NAPI_BUDGET) >= VIRTIO_NET_NAPI_BUDGET) {
+        // Still busy: stay suppressed and come back on the next pass
+        rx_budget_hits++;
+        raise_softirq(SOFTIRQ_NET_RX);
+        return;
+    }
+
+    // Queue empty. Re-arm, and poll again if a frame landed in between:
+    // the device only interrupts for entries past the new event index.
+    napi_scheduled = 0;
+    if (virtq_enable_cb(&rxq)) {
+        virtq_disable_cb(&rxq);
+        napi_scheduled = 1;
+        raise_softirq(SOFTIRQ_NET_RX);
+    }
+}
+
+// Prefer MSI-X with one vector per queue, then the INTx line. Returns
+// the queue vectors to program (VIRTIO_MSI_NO_VECTOR for INTx).
+static uint16_t virtio_net_setup_msix(pci_device_t* dev) {
+    if (pci_msix_table_size(dev) < 2) return VIRTIO_MSI_NO_VECTOR;
+
+    int rx_vector = irq_alloc_vector();
+    int tx_vector = irq_alloc_vector();
+    if (rx_vector >= 0 && tx_vector >= 0) {
+        irq_install_vector(rx_vector, virtio_net_rx_irq);
+        irq_install_vector(tx_vector, virtio_net_tx_irq);
+        if (pci_enable_msix(dev, VIRTIO_NET_RX_QUEUE, rx_vector, 0) == 0 &&
+            pci_enable_msix(dev, VIRTIO_NET_TX_QUEUE, tx_vector, 0) == 0) {
+            irq_mode = NETDEV_IRQ_MSIX;
+            irq_vector = rx_vector;
+            tx_irq_vector = tx_vector;
+            return 0;
+        }
+        pci_disable_msix(dev);
+        irq_uninstall_vector(rx_vector);
+        irq_uninstall_vector(tx_vector);
+    }
+    if (rx_vector >= 0) irq_free_vector(rx_vector);
+    if (tx_vector >= 0) irq_free_vector(tx_vector);
+    return VIRTIO_MSI_NO_VECTOR;
+}
+
+static void virtio_net_teardown_msix(pci_device_t* dev) {
+    pci_disable_msix(dev);
+    irq_uninstall_vector(irq_vector);
+    irq_uninstall_vector(tx_irq_vector);
+    irq_free_vector(irq_vector);
+    irq_free_vector(tx_irq_vector);
+    irq_mode = NETDEV_IRQ_NONE;
+    irq_vector = -1;
+    tx_irq_vector = -1;
+}
+
+static int virtio_net_setup_queues(uint16_t msix) {
+    // MSI-X table entry n serves queue n
+    uint16_t rx_vec = msix == VIRTIO_MSI_NO_VECTOR ? msix : VIRTIO_NET_RX_QUEUE;
+    uint16_t tx_vec = msix == VIRTIO_MSI_NO_VECTOR ? msix : VIRTIO_NET_TX_QUEUE;
+
+    vdev.common->msix_config = VIRTIO_MSI_NO_VECTOR;
+    if (virtq_setup(&vdev, &rxq, VIRTIO_NET_RX_QUEUE, VIRTIO_NET_RX_RING_SIZE, rx_vec) < 0) return -1;
+    if (virtq_setup(&vdev, &txq, VIRTIO_NET_TX_QUEUE, VIRTIO_NET_TX_RING_SIZE, tx_vec) < 0) return -1;
+    return 0;
+}
+
+netdev_t* virtio_net_driver_init(void) {
+    serial_write("Virtio-net: Searching for device...\n");
+
+    spin_lock_init(&tx_lock, "virtio_net_tx");
+    spin_lock_init(&rx_lock, "virtio_net_rx");
+
+    pci_init();
+    pci_device_t* dev = pci_find_device(VIRTIO_VENDOR_ID, VIRTIO_NET_DEVICE_ID_MODERN);
+    if (!dev) dev = pci_find_device(VIRTIO_VENDOR_ID, VIRTIO_NET_DEVICE_ID_TRANSITIONAL);
+    if (!dev) {
+        serial_write("Virtio-net: Device not found\n");
+        return NULL;
+    }
+
+    char buf[64];
+    sprintf(buf, "Virtio-net: Device found at %02x:%02x.%u\n", dev->bus, dev->slot, dev->func);
+    serial_write(buf);
+
+    if (virtio_pci_init(dev, &vdev) < 0) {
+        serial_write("Virtio-net: No virtio 1.0 interface (legacy only?)\n");
+        return NULL;
+    }
+
+    // No MRG_RXBUF: pktbufs are not chained, so every frame must land in
+    // one 2 KiB slot, which any frame within the 1500-byte MTU does
+    uint64_t supported = VIRTIO_F_VERSION_1 | VIRTIO_F_RING_EVENT_IDX |
+                         VIRTIO_NET_F_MAC |
+                         VIRTIO_NET_F_CSUM | VIRTIO_NET_F_GUEST_CSUM;
+    if (virtio_negotiate(&vdev, supported) < 0) {
+        serial_write("Virtio-net: Feature negotiation failed\n");
+        return NULL;
+    }
+    sprintf(buf, "Virtio-net: Features 0x%08x%08x\n",
+            (uint32_t)(vdev.features >> 32), (uint32_t)vdev.features);
+    serial_write(buf);
+
+    // The MSI-X vectors must exist before the queues are bound to them;
+    // a device that refuses them gets INTx instead
+    uint16_t msix = virtio_net_setup_msix(dev);
+    int result = virtio_net_setup_queues(msix);
+    if (result < 0 && msix != VIRTIO_MSI_NO_VECTOR) {
+        // Start over from reset without message interrupts
+        virtio_net_teardown_msix(dev);
+        result = virtio_negotiate(&vdev, supported);
+        if (result == 0) result = virtio_net_setup_queues(VIRTIO_MSI_NO_VECTOR);
+    }
+    if (result < 0) {
+        serial_write("Virtio-net: Queue setup failed\n");
+        vdev.common->device_status |= VIRTIO_STATUS_FAILED;
+        return NULL;
+    }
+
+    if (irq_mode == NETDEV_IRQ_NONE && dev->irq < 16) {
+        irq_install_handler(dev->irq, virtio_net_intx_irq);
+        irq_unmask(dev->irq);
+        irq_mode = NETDEV_IRQ_LEGACY;
+        irq_vector = IRQ0 + dev->irq;
+    }
+
+    if (irq_mode == NETDEV_IRQ_NONE) {
+        serial_write("Virtio-net: No usable interrupt, polling only\n");
+    } else {
+        open_softirq(SOFTIRQ_NET_RX, virtio_net_rx_softirq);
+        open_softirq(SOFTIRQ_NET_TX, virtio_net_tx_softirq);
+        serial_write(irq_mode == NETDEV_IRQ_MSIX ? "Virtio-net: Using MSI-X\n" :
+                     "Virtio-net: Using legacy INTx\n");
+    }
+
+    // Without VIRTIO_NET_F_MAC the device has no address of its own
+    if (virtio_has_feature(&vdev, VIRTIO_NET_F_MAC)) {
+        virtio_read_config(&vdev, VIRTIO_NET_CFG_MAC, virtio_net_netdev.mac, 6);
+    } else {
+        static const uint8_t fallback[6] = { 0x52, 0x54, 0x00, 0x12, 0x34, 0x57 };
+        memcpy(virtio_net_netdev.mac, fallback, 6);
+    }
+    sprintf(buf, "Virtio-net: MAC: %02x:%02x:%02x:%02x:%02x:%02x\n",
+            virtio_net_netdev.mac[0], virtio_net_netdev.mac[1], virtio_net_netdev.mac[2],
+            virtio_net_netdev.mac[3], virtio_net_netdev.mac[4], virtio_net_netdev.mac[5]);
+    serial_write(buf);
+
+    if (virtio_has_feature(&vdev, VIRTIO_NET_F_CSUM)) {
+        virtio_net_netdev.features |= NETDEV_F_TX_CSUM;
+    }
+    if (virtio_has_feature(&vdev, VIRTIO_NET_F_GUEST_CSUM)) {
+        virtio_net_netdev.features |= NETDEV_F_RX_CSUM;
+    }
+
+    // One slab covering both queues, as for e1000
+    pktbuf_grow(rxq.size + txq.size);
+
+    // Receive interrupts stay suppressed until the queue is full of buffers
+    virtq_disable_cb(&rxq);
+    virtio_driver_ok(&vdev);
+
+    while (rxq.num_free > 0) {
+        pktbuf_t* pb = pktbuf_alloc_rx();
+        if (!pb) {
+            serial_write("Virtio-net: Packet pool exhausted\n");
+            break;
+        }
+        virtio_net_post_rx(pb);
+    }
+    virtq_kick(&rxq);
+    virtq_enable_cb(&rxq);
+
+    // Transmit completions are reaped lazily; see virtio_net_flush()
+    virtq_disable_cb(&txq);
+
+    ready = 1;
+    sprintf(buf, "Virtio-net: Queues rx %u tx %u\n", rxq.size, txq.size);
+    serial_write(buf);
+    serial_write("Virtio-net: Initialized successfully\n");
+    return &virtio_net_netdev;
+}
+
+// Take back buffers the device has finished sending. Caller holds tx_lock.
+static uint32_t virtio_net_tx_reclaim_locked(void) {
+    uint32_t reclaimed = 0;
+    pktbuf_t* pb;
+    while ((pb = (pktbuf_t*)virtq_get(&txq, NULL)) != NULL) {
+        pktbuf_put(pb);
+        reclaimed++;
+    }
+    tx_reclaimed += reclaimed;
+    return reclaimed;
+}
+
+// Publish queued buffers with at most one notification. With event
+// indexes the device says when it wants one: while it is still working
+// through the ring it asks for none, and the doorbell (a VM exit) is
+// skipped. Caller holds tx_lock.
+static void virtio_net_tx_flush_locked(void) {
+    // Interrupt once this whole batch is sent so its buffers come back
+    // even if nothing else is transmitted
+    virtq_enable_cb_delayed(&txq);
+
+    int kicked = virtq_kick(&txq);
+    if (kicked > 0) {
+        tx_batches++;
+    } else if (kicked == 0) {
+        tx_kicks_skipped++;
+    }
+}
+
+int virtio_net_xmit(pktbuf_t* pb) {
+    if (!ready || pktbuf_headroom(pb) < hdr_len) return -1;
+
+    uint32_t flags = spin_lock_irqsave(&tx_lock);
+
+    // Reclaim lazily, only once the ring is running low
+    if (txq.num_free < txq.size / 4) {
+        virtio_net_tx_reclaim_locked();
+    }
+
+    // Backpressure: the ring is full, so push out what is queued and
+    // take back anything already used; the frame is refused rather than
+    // waited for with the lock held and interrupts off
+    if (txq.num_free == 0) {
+        tx_full_stalls++;
+        virtio_net_tx_flush_locked();
+        virtio_net_tx_reclaim_locked();
+        if (txq.num_free == 0) {
+            tx_dropped++;
+            spin_unlock_irqrestore(&tx_lock, flags);
+            return -1;
+        }
+    }
+
+    // The header goes into the buffer's headroom, so frame and header
+    // leave in a single descriptor
+    uint32_t frame_len = pb->len;
+    virtio_net_hdr_t* hdr = (virtio_net_hdr_t*)pktbuf_push(pb, hdr_len);
+    memset(hdr, 0, sizeof(*hdr));
+    hdr->gso_type = VIRTIO_NET_HDR_GSO_NONE;
+
+    // Same contract as the e1000 CSS/CSO fields: the device sums from
+    // csum_start to the end and folds in the seed already in the field
+    if (pb->csum_flags & PKTBUF_CSUM_PARTIAL) {
+        uint8_t* frame = pb->data + hdr_len;
+        hdr->flags = VIRTIO_NET_HDR_F_NEEDS_CSUM;
+        hdr->csum_start = (pb->head + pb->csum_start) - frame;
+        hdr->csum_offset = pb->csum_offset;
+    }
+
+    virtq_add(&txq, pb->data, pb->len, 0, pb);
+    tx_packets++;
+    tx_bytes += frame_len;
+
+    spin_unlock_irqrestore(&tx_lock, flags);
+    return 0;
+}
+
+void virtio_net_flush(void) {
+    if (!ready) return;
+
+    uint32_t flags = spin_lock_irqsave(&tx_lock);
+    virtio_net_tx_flush_locked();
+    spin_unlock_irqrestore(&tx_lock, flags);
+}
+
+int virtio_net_tx_wait(void) {
+    if (!ready) return -1;
+
+    int timeout = 1000000;
+    for (;;) {
+        uint32_t flags = spin_lock_irqsave(&tx_lock);
+        virtio_net_tx_flush_locked();
+        virtio_net_tx_reclaim_locked();
+        int idle = (txq.num_free == txq.size);
+        spin_unlock_irqrestore(&tx_lock, flags);
+
+        if (idle) return 0;
+        if (timeout-- <= 0) return -1;
+        __asm__ volatile("pause");
+    }
+}
+
+// Transmit-complete bottom half: reclaim while the sender is idle
+static void virtio_net_tx_softirq(void) {
+    if (!ready) return;
+
+    uint32_t flags = spin_lock_irqsave(&tx_lock);
+    virtio_net_tx_reclaim_locked();
+    spin_unlock_irqrestore(&tx_lock, flags);
+}
+
+void virtio_net_get_irq_info(netdev_irq_info_t* info) {
+    info->mode = irq_mode;
+    info->vector = irq_vector < 0 ? 0 : (uint32_t)irq_vector;
+    info->count = irq_count;
+    info->link_changes = link_changes;
+}
+
+void virtio_net_get_stats(netdev_stats_t* stats) {
+    stats->rx_packets = rx_packets;
+    stats->rx_bytes = rx_bytes;
+    stats->rx_errors = rx_errors;
+    stats->rx_polls = rx_polls;
+    stats->rx_budget_hits = rx_budget_hits;
+    stats->rx_no_buf = rx_no_buf;
+    stats->irq_count = irq_count;
+    stats->tx_packets = tx_packets;
+    stats->tx_bytes = tx_bytes;
+    stats->tx_batches = tx_batches;
+    stats->tx_kicks_skipped = tx_kicks_skipped;
+    stats->tx_reclaimed = tx_reclaimed;
+    stats->tx_full_stalls = tx_full_stalls;
+    stats->tx_dropped = tx_dropped;
+}
+
+void virtio_net_get_ring_sizes(uint32_t* rx, uint32_t* tx) {
+    *rx = rxq.size;
+    *tx = txq.size;
+}
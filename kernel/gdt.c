@@ -1,45 +1,60 @@
 #include "gdt.h"
+#include "smp.h"
 #include "serial.h"
 
-// GDT entries
-gdt_entry_t gdt[3];
-gdt_ptr_t gp;
+// One GDT per CPU so each can carry its own per-CPU data segment
+gdt_entry_t gdt[MAX_CPUS][GDT_ENTRIES];
+gdt_ptr_t gp[MAX_CPUS];
 
 // External assembly function to load GDT
 extern void gdt_flush(uint32_t);
 
 // Set a GDT entry
-static void gdt_set_gate(int num, uint32_t base, uint32_t limit, uint8_t access, uint8_t gran) {
-    gdt[num].base_low = (base & 0xFFFF);
-    gdt[num].base_middle = (base >> 16) & 0xFF;
-    gdt[num].base_high = (base >> 24) & 0xFF;
-
-    gdt[num].limit_low = (limit & 0xFFFF);
-    gdt[num].granularity = ((limit >> 16) & 0x0F);
-    gdt[num].granularity |= (gran & 0xF0);
-    gdt[num].access = access;
+static void gdt_set_gate(int cpu, int num, uint32_t base, uint32_t limit, uint8_t access, uint8_t gran) {
+    gdt[cpu][num].base_low = (base & 0xFFFF);
+    gdt[cpu][num].base_middle = (base >> 16) & 0xFF;
+    gdt[cpu][num].base_high = (base >> 24) & 0xFF;
+
+    gdt[cpu][num].limit_low = (limit & 0xFFFF);
+    gdt[cpu][num].granularity = ((limit >> 16) & 0x0F);
+    gdt[cpu][num].granularity |= (gran & 0xF0);
+    gdt[cpu][num].access = access;
 }
 
 void gdt_init(void) {
     serial_write("GDT: Initializing...\n");
 
+    gdt_init_cpu(0);
+
+    serial_write("GDT: Initialized successfully\n");
+}
+
+void gdt_init_cpu(uint32_t cpu) {
+    cpu_t* c = &cpus[cpu];
+    c->self = c;
+    c->id = cpu;
+
     // Setup GDT pointer
-    gp.limit = (sizeof(gdt_entry_t) * 3) - 1;
-    gp.base = (uint32_t)&gdt;
+    gp[cpu].limit = (sizeof(gdt_entry_t) * GDT_ENTRIES) - 1;
+    gp[cpu].base = (uint32_t)&gdt[cpu];
 
     // NULL descriptor
-    gdt_set_gate(0, 0, 0, 0, 0);
+    gdt_set_gate(cpu, 0, 0, 0, 0, 0);
 
     // Code segment: base=0, limit=4GB, access=0x9A, granularity=0xCF
     // Access: Present, Ring 0, Code segment, Executable, Readable
-    gdt_set_gate(1, 0, 0xFFFFFFFF, 0x9A, 0xCF);
+    gdt_set_gate(cpu, 1, 0, 0xFFFFFFFF, 0x9A, 0xCF);
 
     // Data segment: base=0, limit=4GB, access=0x92, granularity=0xCF
     // Access: Present, Ring 0, Data segment, Writable
-    gdt_set_gate(2, 0, 0xFFFFFFFF, 0x92, 0xCF);
+    gdt_set_gate(cpu, 2, 0, 0xFFFFFFFF, 0x92, 0xCF);
+
+    // Per-CPU segment: base=&cpus[cpu], byte granular, 32-bit
+    gdt_set_gate(cpu, 3, (uint32_t)c, sizeof(cpu_t) - 1, 0x92, 0x40);
 
     // Load the GDT
-    gdt_flush((uint32_t)&gp);
+    gdt_flush((uint32_t)&gp[cpu]);
 
-    serial_write("GDT: Initialized successfully\n");
+    // %gs stays on the per-CPU segment; the ISR stubs leave it alone
+    __asm__ volatile ("movw %0, %%gs" : : "r"((uint16_t)GDT_PERCPU_SELECTOR));
 }
@@ -1,27 +1,46 @@
 #include "heap.h"
 #include "serial.h"
+#include "lock.h"
+#include "string.h"
 #include <stddef.h>
 
-// Simple heap implementation
-#define HEAP_START 0x00100000  // 1MB
+// Simple heap implementation, placed on the first page after the
+// kernel image (which itself loads at 1MB)
 #define HEAP_SIZE  0x00100000  // 1MB heap
 
+// Physically contiguous region right above the heap for device rings and
+// buffer slabs. Boot-time allocations only, never freed.
+#define DMA_REGION_SIZE 0x02000000  // 32MB
+
+extern uint8_t _kernel_end[];
+
 typedef struct heap_block {
     size_t size;
     int is_free;
     struct heap_block* next;
 } heap_block_t;
 
-static uint32_t heap_current = HEAP_START;
+static uint32_t heap_start = 0;
+static uint32_t dma_start = 0;
+static uint32_t dma_current = 0;
 static heap_block_t* heap_head = NULL;
 
+// Every CPU allocates from the same list; MCS keeps waiters off one line
+static mcs_lock_t heap_lock;
+
 void heap_init(void) {
-    serial_write("Heap: Initializing at 0x00100000...\n");
-    heap_head = (heap_block_t*)HEAP_START;
+    heap_start = ((uint32_t)_kernel_end + 0xFFF) & 0xFFFFF000;
+
+    char buf[48];
+    sprintf(buf, "Heap: Initializing at 0x%08x...\n", heap_start);
+    serial_write(buf);
+    heap_head = (heap_block_t*)heap_start;
     heap_head->size = HEAP_SIZE - sizeof(heap_block_t);
     heap_head->is_free = 1;
     heap_head->next = NULL;
-    heap_current = HEAP_START + sizeof(heap_block_t);
+    dma_start = heap_start + HEAP_SIZE;
+    dma_current = dma_start;
+    mcs_lock_init(&heap_lock, "heap");
     serial_write("Heap: Initialized successfully\n");
 }
 
@@ -31,6 +50,11 @@ void* kmalloc(size_t size) {
     // Align to 4 bytes
     size = (size + 3) & ~3;
     
+    mcs_node_t node;
+    uint32_t flags = irq_save();
+    mcs_lock(&heap_lock, &node);
+    
+    void* result = NULL;
     heap_block_t* current = heap_head;
     
     // First-fit algorithm
@@ -50,28 +74,52 @@ void* kmalloc(size_t size) {
                 current->next = new_block;
             }
             
-            return (void*)((uint8_t*)current + sizeof(heap_block_t));
+            result = (void*)((uint8_t*)current + sizeof(heap_block_t));
+            break;
         }
         current = current->next;
     }
     
-    // No suitable block found
-    return NULL;
+    mcs_unlock(&heap_lock, &node);
+    irq_restore(flags);
+    
+    // NULL if no suitable block was found
+    return result;
 }
 
-void* kmalloc_a(size_t size) {
-    // Page-aligned allocation (4KB)
-    uint32_t addr = heap_current;
-    if (addr & 0xFFF) {
-        addr = (addr & 0xFFFFF000) + 0x1000;
+void* dma_alloc(size_t size, uint32_t align) {
+    if (size == 0) return NULL;
+    if (align < 4) align = 4;
+
+    mcs_node_t node;
+    uint32_t flags = irq_save();
+    mcs_lock(&heap_lock, &node);
+
+    // align must be a power of two
+    uint32_t addr = (dma_current + align - 1) & ~(align - 1);
+    void* ptr = NULL;
+    if (addr + size <= dma_start + DMA_REGION_SIZE) {
+        ptr = (void*)addr;
+        dma_current = addr + size;
     }
-    
-    void* ptr = (void*)addr;
-    heap_current = addr + size;
-    
+
+    mcs_unlock(&heap_lock, &node);
+    irq_restore(flags);
+
     return ptr;
 }
 
+void dma_stats(uint32_t* total, uint32_t* used) {
+    *total = DMA_REGION_SIZE;
+    *used = dma_current - dma_start;
+}
+
+void* kmalloc_a(size_t size) {
+    // Page-aligned allocation (4KB). Served from the DMA region so it can
+    // never overlap blocks of the first-fit heap.
+    return dma_alloc(size, 0x1000);
+}
+
 void* kmalloc_p(size_t size, uint32_t* phys) {
     void* ptr = kmalloc(size);
     if (phys) {
@@ -92,6 +140,11 @@ void kfree(void* ptr) {
     if (ptr == NULL) return;
     
     heap_block_t* block = (heap_block_t*)((uint8_t*)ptr - sizeof(heap_block_t));
+    
+    mcs_node_t node;
+    uint32_t flags = irq_save();
+    mcs_lock(&heap_lock, &node);
+    
     block->is_free = 1;
     
     // Coalesce with next block if it's free
@@ -110,6 +163,9 @@ void kfree(void* ptr) {
         current->size += sizeof(heap_block_t) + block->size;
         current->next = block->next;
     }
+    
+    mcs_unlock(&heap_lock, &node);
+    irq_restore(flags);
 }
 
 // Get heap statistics
@@ -118,6 +174,10 @@ void heap_stats(uint32_t* total, uint32_t* used, uint32_t* free_blocks) {
     *used = 0;
     *free_blocks = 0;
     
+    mcs_node_t node;
+    uint32_t flags = irq_save();
+    mcs_lock(&heap_lock, &node);
+    
     heap_block_t* current = heap_head;
     while (current != NULL) {
         *total += current->size + sizeof(heap_block_t);
@@ -128,4 +188,7 @@ void heap_stats(uint32_t* total, uint32_t* used, uint32_t* free_blocks) {
         }
         current = current->next;
     }
+    
+    mcs_unlock(&heap_lock, &node);
+    irq_restore(flags);
 }
@@ -0,0 +1,432 @@
+#include "http.h"
+#include "tcp.h"
+#include "timer.h"
+#include "sched.h"
+#include "string.h"
+#include <stddef.h>
+
+// Response parser. Fed the payload of each received segment in turn;
+// status and header lines are assembled in a small line buffer, body
+// bytes go to the sink without being copied here.
+typedef enum {
+    HP_STATUS,
+    HP_HEADERS,
+    HP_BODY,                     // Content-Length or until close
+    HP_CHUNK_SIZE,
+    HP_CHUNK_DATA,
+    HP_CHUNK_END,                // CRLF after the chunk data
+    HP_TRAILERS,
+    HP_DONE
+} http_state_t;
+
+typedef struct {
+    http_state_t state;
+    http_response_t* resp;
+    http_sink_t sink;
+    void* arg;
+    uint32_t remaining;          // Body or chunk bytes still to come
+    uint8_t until_close;         // Body ends when the server closes
+    uint8_t conn_close;          // "Connection: close"
+    uint8_t conn_keep_alive;     // "Connection: keep-alive" (HTTP/1.0)
+    int error;
+    uint32_t line_len;
+    char line[HTTP_LINE_MAX];
+} http_parser_t;
+
+static inline char lower(char ch) {
+    return (ch >= 'A' && ch <= 'Z') ? ch + ('a' - 'A') : ch;
+}
+
+// Case-insensitive: does s contain token?
+static int has_token(const char* s, const char* token) {
+    for (; *s; s++) {
+        uint32_t i = 0;
+        while (token[i] && lower(s[i]) == token[i]) i++;
+        if (!token[i]) return 1;
+    }
+    return 0;
+}
+
+static int name_is(const char* name, uint32_t len, const char* want) {
+    uint32_t i = 0;
+    for (; i < len; i++) {
+        if (!want[i] || lower(name[i]) != want[i]) return 0;
+    }
+    return want[i] == '\0';
+}
+
+static uint64_t elapsed_us(uint64_t since) {
+    return timer_cycles_to_us(rdtsc() - since);
+}
+
+static void http_header(http_parser_t* p, char* line, uint32_t len) {
+    http_response_t* r = p->resp;
+    uint32_t colon = 0;
+    while (colon < len && line[colon] != ':') colon++;
+    if (colon == len) return;                // Not a header; tolerate it
+
+    char* value = line + colon + 1;
+    while (*value == ' ' || *value == '\t') value++;
+    char* end = line + len;
+    while (end > value && (end[-1] == ' ' || end[-1] == '\t')) *--end = '\0';
+
+    if (name_is(line, colon, "content-length")) {
+        uint32_t n = 0;
+        if (*value < '0' || *value > '9') {
+            p->error = HTTP_ERR_PROTOCOL;
+            return;
+        }
+        for (; *value >= '0' && *value <= '9'; value++) {
+            if (n > (HTTP_LENGTH_NONE - 1) / 10) {
+                p->error = HTTP_ERR_PROTOCOL;
+                return;
+            }
+            n = n * 10 + (*value - '0');
+        }
+        r->content_length = n;
+    } else if (name_is(line, colon, "transfer-encoding")) {
+        r->chunked = has_token(value, "chunked");
+    } else if (name_is(line, colon, "connection")) {
+        if (has_token(value, "close")) p->conn_close = 1;
+        if (has_token(value, "keep-alive")) p->conn_keep_alive = 1;
+    } else if (name_is(line, colon, "content-type")) {
+        strncpy(r->content_type, value, HTTP_TYPE_MAX - 1);
+        r->content_type[HTTP_TYPE_MAX - 1] = '\0';
+    }
+}
+
+// Blank line after the headers: choose how the body is framed
+static void http_headers_done(http_parser_t* p) {
+    http_response_t* r = p->resp;
+
+    // Interim response (100 Continue); the real one follows
+    if (r->status < 200) {
+        r->chunked = 0;
+        r->content_length = HTTP_LENGTH_NONE;
+        r->content_type[0] = '\0';
+        p->conn_close = p->conn_keep_alive = 0;
+        p->state = HP_STATUS;
+        return;
+    }
+
+    r->keep_alive = r->version >= 1 ? !p->conn_close : p->conn_keep_alive;
+    if (r->status == 204 || r->status == 304) {
+        p->state = HP_DONE;
+    } else if (r->chunked) {
+        // Transfer coding overrides any Content-Length (RFC 9112 6.3)
+        r->content_length = HTTP_LENGTH_NONE;
+        p->state = HP_CHUNK_SIZE;
+    } else if (r->content_length != HTTP_LENGTH_NONE) {
+        p->remaining = r->content_length;
+        p->state = p->remaining ? HP_BODY : HP_DONE;
+    } else {
+        p->until_close = 1;
+        r->keep_alive = 0;
+        p->state = HP_BODY;
+    }
+}
+
+static void http_line(http_parser_t* p, char* line, uint32_t len) {
+    http_response_t* r = p->resp;
+    switch (p->state) {
+    case HP_STATUS:
+        // HTTP/1.x SP 3DIGIT SP reason
+        if (len < 12 || strncmp(line, "HTTP/1.", 7) != 0 || line[8] != ' ' ||
+            line[9] < '1' || line[9] > '5' || line[10] < '0' || line[10] > '9' ||
+            line[11] < '0' || line[11] > '9') {
+            p->error = HTTP_ERR_PROTOCOL;
+            return;
+        }
+        r->version = line[7] == '0' ? 0 : 1;
+        r->status = (line[9] - '0') * 100 + (line[10] - '0') * 10 + (line[11] - '0');
+        p->state = HP_HEADERS;
+        break;
+
+    case HP_HEADERS:
+        if (len == 0) http_headers_done(p);
+        else http_header(p, line, len);
+        break;
+
+    case HP_CHUNK_SIZE: {
+        uint32_t size = 0, digits = 0;
+        for (; digits < len; digits++) {
+            char ch = lower(line[digits]);
+            uint32_t v;
+            if (ch >= '0' && ch <= '9') v = ch - '0';
+            else if (ch >= 'a' && ch <= 'f') v = ch - 'a' + 10;
+            else break;
+            if (size >> 28) {
+                p->error = HTTP_ERR_PROTOCOL;
+                return;
+            }
+            size = (size << 4) | v;
+        }
+        // Chunk extensions (";name=value") are ignored
+        if (digits == 0 || (digits < len && line[digits] != ';' && line[digits] != ' ' && line[digits] != '\t')) {
+            p->error = HTTP_ERR_PROTOCOL;
+            return;
+        }
+        p->remaining = size;
+        p->state = size ? HP_CHUNK_DATA : HP_TRAILERS;
+        break;
+    }
+
+    case HP_CHUNK_END:
+        if (len != 0) {
+            p->error = HTTP_ERR_PROTOCOL;
+            return;
+        }
+        p->state = HP_CHUNK_SIZE;
+        break;
+
+    case HP_TRAILERS:
+        if (len == 0) p->state = HP_DONE;
+        break;
+
+    default:
+        break;
+    }
+}
+
+// Returns the bytes consumed; stops early once the response is complete
+// or on an error (p->error)
+static uint32_t http_feed(http_parser_t* p, const uint8_t* data, uint32_t len) {
+    uint32_t i = 0;
+    while (i < len && p->state != HP_DONE && !p->error) {
+        if (p->state == HP_BODY || p->state == HP_CHUNK_DATA) {
+            uint32_t n = len - i;
+            if (!p->until_close && n > p->remaining) n = p->remaining;
+            if (p->sink && p->sink(data + i, n, p->arg) < 0) {
+                p->error = HTTP_ERR_SINK;
+                return i;
+            }
+            p->resp->body_bytes += n;
+            i += n;
+            if (!p->until_close) {
+                p->remaining -= n;
+                if (p->remaining == 0) p->state = p->state == HP_BODY ? HP_DONE : HP_CHUNK_END;
+            }
+            continue;
+        }
+
+        // Line-oriented states; CR is dropped, LF ends the line
+        char ch = (char)data[i++];
+        if (ch != '\n') {
+            if (ch != '\r' && p->line_len < HTTP_LINE_MAX - 1) p->line[p->line_len++] = ch;
+            continue;
+        }
+        p->line[p->line_len] = '\0';
+        uint32_t line_len = p->line_len;
+        p->line_len = 0;
+        http_line(p, p->line, line_len);
+    }
+    return i;
+}
+
+int http_parse_url(const char* url, http_url_t* out) {
+    const char* p = url;
+    if (strncmp(p, "http://", 7) == 0) {
+        p += 7;
+    } else {
+        // Any other scheme (https://...) is not supported
+        for (const char* s = p; *s && *s != '/'; s++) {
+            if (s[0] == ':' && s[1] == '/' && s[2] == '/') return -1;
+        }
+    }
+
+    uint32_t n = 0;
+    while (*p && *p != ':' && *p != '/' && *p != '?' && *p != '#') {
+        if (n >= HTTP_HOST_MAX - 1) return -1;
+        out->host[n++] = *p++;
+    }
+    out->host[n] = '\0';
+    if (n == 0) return -1;
+
+    out->port = HTTP_DEFAULT_PORT;
+    if (*p == ':') {
+        uint32_t port = 0, digits = 0;
+        for (p++; *p >= '0' && *p <= '9'; p++, digits++) {
+            port = port * 10 + (*p - '0');
+            if (port > 65535) return -1;
+        }
+        if (digits == 0 || port == 0) return -1;
+        out->port = (uint16_t)port;
+    }
+
+    // The fragment stays on the client
+    n = 0;
+    if (*p != '/') out->path[n++] = '/';
+    while (*p && *p != '#') {
+        if (n >= HTTP_PATH_MAX - 1 || *p == ' ') return -1;
+        out->path[n++] = *p++;
+    }
+    out->path[n] = '\0';
+    return 0;
+}
+
+void http_client_init(http_client_t* c, uint32_t ip, uint16_t port, const char* host) {
+    c->conn = NULL;
+    c->ip = ip;
+    c->port = port;
+    strncpy(c->host, host, HTTP_HOST_MAX - 1);
+    c->host[HTTP_HOST_MAX - 1] = '\0';
+    c->requests = 0;
+    c->connects = 0;
+}
+
+void http_client_close(http_client_t* c) {
+    if (c->conn) {
+        tcp_close(c->conn);
+        c->conn = NULL;
+    }
+}
+
+// After an error the connection is in an unknown state: reset it
+static void http_client_drop(http_client_t* c) {
+    if (c->conn) {
+        tcp_abort(c->conn);
+        c->conn = NULL;
+    }
+}
+
+static int http_connect(http_client_t* c, http_response_t* resp) {
+    uint64_t t0 = rdtsc();
+    c->conn = tcp_connect(c->ip, c->port);
+    if (!c->conn) return HTTP_ERR_CONNECT;
+
+    uint32_t start = timer_get_ticks();
+    uint32_t ev;
+    while (!((ev = tcp_poll(c->conn)) & (TCP_EV_CONNECTED | TCP_EV_CLOSED)) &&
+           timer_get_ticks() - start < HTTP_CONNECT_MS / TCP_TICK_MS) {
+        sched_idle_wait(1000);
+    }
+    if (!(ev & TCP_EV_CONNECTED) || (ev & TCP_EV_CLOSED)) {
+        http_client_drop(c);
+        return HTTP_ERR_CONNECT;
+    }
+    resp->connect_us = (uint32_t)elapsed_us(t0);
+    c->connects++;
+    return 0;
+}
+
+// One request/response on the open connection. *received counts the
+// response bytes seen, so a failure before the first one can be retried.
+static int http_exchange(http_client_t* c, const char* path, http_parser_t* p, uint32_t* received) {
+    http_response_t* resp = p->resp;
+    char req[HTTP_PATH_MAX + HTTP_HOST_MAX + 96];
+    int len;
+    if (c->port == HTTP_DEFAULT_PORT) {
+        len = sprintf(req, "GET %s HTTP/1.1\r\nHost: %s\r\nUser-Agent: NiceTop-wget/1.0\r\nAccept: */*\r\n\r\n",
+                      path, c->host);
+    } else {
+        len = sprintf(req, "GET %s HTTP/1.1\r\nHost: %s:%u\r\nUser-Agent: NiceTop-wget/1.0\r\nAccept: */*\r\n\r\n",
+                      path, c->host, c->port);
+    }
+
+    uint32_t last = timer_get_ticks();
+    int off = 0;
+    while (off < len) {
+        int n = tcp_send(c->conn, req + off, len - off);
+        if (n < 0) return HTTP_ERR_CLOSED;
+        off += n;
+        if (n == 0) {
+            if (timer_get_ticks() - last >= HTTP_IDLE_MS / TCP_TICK_MS) return HTTP_ERR_TIMEOUT;
+            sched_idle_wait(1000);
+        }
+    }
+    uint64_t t_sent = rdtsc();
+
+    last = timer_get_ticks();
+    while (p->state != HP_DONE) {
+        pktbuf_t* pb = tcp_recv_pb(c->conn);
+        if (!pb) {
+            uint32_t ev = tcp_poll(c->conn);
+            if (!(ev & (TCP_EV_READABLE | TCP_EV_CLOSED))) {
+                if (timer_get_ticks() - last >= HTTP_IDLE_MS / TCP_TICK_MS) return HTTP_ERR_TIMEOUT;
+                sched_idle_wait(1000);
+                continue;
+            }
+            // Readable with nothing queued: data raced in, or end of stream
+            pb = tcp_recv_pb(c->conn);
+            if (!pb) {
+                // A FIN ends a body framed by the close; a reset never does
+                if (p->state == HP_BODY && p->until_close && !(ev & TCP_EV_CLOSED)) {
+                    p->state = HP_DONE;
+                    break;
+                }
+                return HTTP_ERR_CLOSED;
+            }
+        }
+
+        last = timer_get_ticks();
+        if (*received == 0) resp->ttfb_us = (uint32_t)elapsed_us(t_sent);
+        *received += pb->len;
+
+        uint32_t used = http_feed(p, pb->data, pb->len);
+        uint32_t extra = pb->len - used;
+        pktbuf_put(pb);
+        if (p->error) return p->error;
+        // Bytes nobody asked for: the connection can't be trusted again
+        if (extra) resp->keep_alive = 0;
+    }
+    resp->total_us = (uint32_t)elapsed_us(t_sent);
+    return 0;
+}
+
+int http_get(http_client_t* c, const char* path, http_sink_t sink, void* arg, http_response_t* resp) {
+    if (strlen(path) >= HTTP_PATH_MAX) return HTTP_ERR_PROTOCOL;
+
+    for (int attempt = 0; ; attempt++) {
+        memset(resp, 0, sizeof(*resp));
+        resp->content_length = HTTP_LENGTH_NONE;
+
+        // A kept connection the server has since closed (or written to
+        // unprompted) is no use
+        if (c->conn && (tcp_poll(c->conn) & (TCP_EV_READABLE | TCP_EV_CLOSED))) {
+            http_client_drop(c);
+        }
+        resp->reused = c->conn != NULL;
+        if (!c->conn) {
+            int err = http_connect(c, resp);
+            if (err) return err;
+        }
+
+        http_parser_t p;
+        p.state = HP_STATUS;
+        p.resp = resp;
+        p.sink = sink;
+        p.arg = arg;
+        p.remaining = 0;
+        p.until_close = 0;
+        p.conn_close = 0;
+        p.conn_keep_alive = 0;
+        p.error = 0;
+        p.line_len = 0;
+
+        uint32_t received = 0;
+        int err = http_exchange(c, path, &p, &received);
+        if (err) {
+            http_client_drop(c);
+            // The server may close an idle connection just as a request
+            // goes out; a GET is safe to send again on a fresh one
+            if (err == HTTP_ERR_CLOSED && resp->reused && received == 0 && attempt == 0) continue;
+            return err;
+        }
+
+        c->requests++;
+        if (!resp->keep_alive) http_client_close(c);
+        return 0;
+    }
+}
+
+const char* http_strerror(int err) {
+    switch (err) {
+    case 0:                 return "ok";
+    case HTTP_ERR_CONNECT:  return "connection failed";
+    case HTTP_ERR_TIMEOUT:  return "timed out";
+    case HTTP_ERR_PROTOCOL: return "malformed response";
+    case HTTP_ERR_CLOSED:   return "connection closed early";
+    case HTTP_ERR_SINK:     return "aborted";
+    default:                return "error";
+    }
+}
@@ -0,0 +1,575 @@
+#include "httpd.h"
+#include "tcp.h"
+#include "vfs.h"
+#include "heap.h"
+#include "lock.h"
+#include "workqueue.h"
+#include "timer.h"
+#include "serial.h"
+#include "string.h"
+#include <stddef.h>
+
+// TCP callbacks run in the NET_RX softirq on any CPU. They only put the
+// connection on the ready list and queue httpd_work; the work item, a
+// task on an ordered workqueue, does all parsing and sending. That keeps
+// the VFS lock (a task-context lock) out of softirq context, and one
+// execution serves every connection that became ready meanwhile.
+
+typedef struct httpd_conn {
+    tcp_conn_t* tcp;             // 0 when the slot is free
+    struct httpd_conn* ready_next;
+    uint8_t queued;              // On the ready list (ready_lock)
+    uint8_t sending;             // Response not yet fully queued to TCP
+    uint8_t keep_alive;          // Keep the connection after the response
+    uint8_t http10;              // Client spoke HTTP/1.0
+    uint32_t last_active;        // Ticks
+    uint32_t requests;
+
+    // Received request bytes; may run into the next pipelined request
+    uint32_t req_len;
+    char req[HTTPD_REQ_MAX];
+    pktbuf_t* rx_pb;             // Received segment not yet copied in full
+
+    // Response: the header (with any generated body), then the body
+    uint32_t head_len, head_off;
+    char head[HTTPD_HEAD_MAX];
+    const char* body;
+    uint32_t body_len, body_off;
+    const char* mapped;          // vfs_map() snapshot to release
+    char* owned;                 // kmalloc()ed body to free
+} httpd_conn_t;
+
+static httpd_conn_t conns[HTTPD_MAX_CONNS];
+static tcp_conn_t* listener;
+static uint16_t listen_port;
+static volatile int stopping;
+
+static spinlock_t ready_lock;
+static httpd_conn_t* ready_head;
+static httpd_conn_t* ready_tail;
+static uint32_t accept_pending;
+
+static workqueue_t httpd_wq;
+static work_t httpd_work;
+static int httpd_initialized;
+static httpd_stats_t stats;
+
+// Any context: mark the connection (or, for the listener, the accept
+// queue) ready and make sure the work item runs
+static void httpd_event(tcp_conn_t* tcp, uint32_t events, void* arg) {
+    (void)tcp;
+    (void)events;
+    httpd_conn_t* hc = (httpd_conn_t*)arg;
+
+    uint32_t flags = spin_lock_irqsave(&ready_lock);
+    stats.events++;
+    if (!hc) {
+        accept_pending = 1;
+    } else if (!hc->queued) {
+        hc->queued = 1;
+        hc->ready_next = NULL;
+        if (ready_tail) ready_tail->ready_next = hc;
+        else ready_head = hc;
+        ready_tail = hc;
+    }
+    spin_unlock_irqrestore(&ready_lock, flags);
+    queue_work(&httpd_wq, &httpd_work);
+}
+
+static void httpd_release_body(httpd_conn_t* hc) {
+    if (hc->mapped) vfs_unmap(hc->mapped);
+    if (hc->owned) kfree(hc->owned);
+    hc->mapped = NULL;
+    hc->owned = NULL;
+    hc->body = NULL;
+    hc->body_len = hc->body_off = 0;
+}
+
+// Give the connection back; a graceful close sends what is queued first
+static void httpd_release(httpd_conn_t* hc, int abort) {
+    tcp_conn_t* tcp = hc->tcp;
+    httpd_release_body(hc);
+    if (hc->rx_pb) pktbuf_put(hc->rx_pb);
+    hc->rx_pb = NULL;
+    hc->tcp = NULL;
+    hc->sending = 0;
+    if (abort) tcp_abort(tcp);
+    else tcp_close(tcp);
+    stats.active--;
+}
+
+static const char* httpd_content_type(const char* name) {
+    const char* ext = NULL;
+    for (const char* p = name; *p; p++) {
+        if (*p == '.') ext = p + 1;
+    }
+    if (!ext) return "application/octet-stream";
+    if (strcmp(ext, "html") == 0 || strcmp(ext, "htm") == 0) return "text/html";
+    if (strcmp(ext, "txt") == 0 || strcmp(ext, "md") == 0 || strcmp(ext, "c") == 0 ||
+        strcmp(ext, "h") == 0) return "text/plain";
+    if (strcmp(ext, "css") == 0) return "text/css";
+    if (strcmp(ext, "js") == 0) return "text/javascript";
+    if (strcmp(ext, "json") == 0) return "application/json";
+    if (strcmp(ext, "png") == 0) return "image/png";
+    return "application/octet-stream";
+}
+
+// Start a response. A body of len bytes follows the header unless
+// head_only; the caller sets hc->body to it.
+static void httpd_header(httpd_conn_t* hc, int status, const char* reason, const char* type, uint32_t len) {
+    const char* conn = "";
+    if (!hc->keep_alive) conn = "Connection: close\r\n";
+    else if (hc->http10) conn = "Connection: keep-alive\r\n";
+
+    hc->head_len = sprintf(hc->head, "HTTP/1.1 %d %s\r\nServer: NiceTop\r\nContent-Type: %s\r\nContent-Length: %u\r\n%s\r\n",
+                           status, reason, type, len, conn);
+    hc->head_off = 0;
+    hc->body = NULL;
+    hc->body_len = hc->body_off = 0;
+    hc->sending = 1;
+
+    if (status < 300) stats.status_2xx++;
+    else if (status < 500) stats.status_4xx++;
+    else stats.status_5xx++;
+}
+
+// Response whose body is generated into the header buffer
+static void httpd_small(httpd_conn_t* hc, int status, const char* reason, const char* type,
+                        const char* body, uint32_t len, int head_only) {
+    httpd_header(hc, status, reason, type, len);
+    if (head_only) return;
+    if (len > HTTPD_HEAD_MAX - hc->head_len) len = HTTPD_HEAD_MAX - hc->head_len;
+    memcpy(hc->head + hc->head_len, body, len);
+    hc->head_len += len;
+}
+
+static void httpd_error(httpd_conn_t* hc, int status, const char* reason, int head_only) {
+    char body[64];
+    int len = sprintf(body, "%d %s\n", status, reason);
+    httpd_small(hc, status, reason, "text/plain", body, len, head_only);
+}
+
+static void httpd_health(httpd_conn_t* hc, int head_only) {
+    char body[160];
+    int len = sprintf(body, "ok\nuptime %u s\nactive %u\naccepted %u\nrequests %u\n",
+                      timer_get_ticks() / 100, stats.active, stats.accepted, stats.requests);
+    httpd_small(hc, 200, "OK", "text/plain", body, len, head_only);
+}
+
+// Copy s into out with the HTML metacharacters as entities (at most
+// HTTPD_ESCAPE_MAX bytes per input byte); returns the length written
+#define HTTPD_ESCAPE_MAX 6
+static uint32_t httpd_escape(char* out, const char* s) {
+    uint32_t len = 0;
+    for (; *s; s++) {
+        const char* entity = NULL;
+        switch (*s) {
+        case '<': entity = "&lt;"; break;
+        case '>': entity = "&gt;"; break;
+        case '&': entity = "&amp;"; break;
+        case '"': entity = "&quot;"; break;
+        }
+        if (entity) {
+            while (*entity) out[len++] = *entity++;
+        } else {
+            out[len++] = *s;
+        }
+    }
+    out[len] = '\0';
+    return len;
+}
+
+static void httpd_listing(httpd_conn_t* hc, int head_only) {
+    // Room for every slot, however the file set changes meanwhile
+    char* page = (char*)kmalloc(160 + MAX_FILES * (2 * HTTPD_ESCAPE_MAX * MAX_FILENAME + 48));
+    if (!page) {
+        httpd_error(hc, 503, "Service Unavailable", head_only);
+        return;
+    }
+    uint32_t len = sprintf(page, "<!DOCTYPE html>\n<html><head><title>NiceTop OS</title></head><body>\n<h1>Files</h1>\n<ul>\n");
+    int count = vfs_get_file_count();
+    for (int i = 0; i < count && i < MAX_FILES; i++) {
+        file_t* file = vfs_get_file(i);
+        if (!file || file->type != FILE_TYPE_REGULAR) continue;
+        char name[HTTPD_ESCAPE_MAX * MAX_FILENAME + 1];
+        httpd_escape(name, file->name);
+        len += sprintf(page + len, "<li><a href=\"/%s\">%s</a> %u bytes</li>\n", name, name, file->size);
+    }
+    len += sprintf(page + len, "</ul>\n</body></html>\n");
+
+    httpd_header(hc, 200, "OK", "text/html", len);
+    if (head_only) {
+        kfree(page);
+        return;
+    }
+    hc->owned = page;
+    hc->body = page;
+    hc->body_len = len;
+}
+
+static void httpd_file(httpd_conn_t* hc, file_t* file, int head_only) {
+    const char* data;
+    uint32_t size;
+    if (vfs_map(file, &data, &size) < 0) {
+        httpd_error(hc, 404, "Not Found", head_only);
+        return;
+    }
+    httpd_header(hc, 200, "OK", httpd_content_type(file->name), size);
+    if (head_only) {
+        vfs_unmap(data);
+        return;
+    }
+    hc->mapped = data;
+    hc->body = data;
+    hc->body_len = size;
+}
+
+static int httpd_has_token(const char* s, const char* token) {
+    for (; *s; s++) {
+        uint32_t i = 0;
+        while (token[i]) {
+            char ch = s[i];
+            if (ch >= 'A' && ch <= 'Z') ch += 'a' - 'A';
+            if (ch != token[i]) break;
+            i++;
+        }
+        if (!token[i]) return 1;
+    }
+    return 0;
+}
+
+static int httpd_name_is(const char* name, uint32_t len, const char* want) {
+    uint32_t i = 0;
+    for (; i < len; i++) {
+        char ch = name[i];
+        if (ch >= 'A' && ch <= 'Z') ch += 'a' - 'A';
+        if (!want[i] || ch != want[i]) return 0;
+    }
+    return want[i] == '\0';
+}
+
+// Look for a complete request in hc->req and start its response.
+// Returns 1 when a response was started, 0 when more bytes are needed.
+static int httpd_parse(httpd_conn_t* hc) {
+    uint32_t end = 0;
+    for (uint32_t i = 3; i < hc->req_len; i++) {
+        if (hc->req[i] == '\n' && hc->req[i - 1] == '\r' && hc->req[i - 2] == '\n' && hc->req[i - 3] == '\r') {
+            end = i + 1;
+            break;
+        }
+    }
+    if (!end) {
+        if (hc->req_len < HTTPD_REQ_MAX) return 0;
+        hc->keep_alive = 0;
+        httpd_error(hc, 431, "Request Header Fields Too Large", 0);
+        return 1;
+    }
+
+    // Request line: METHOD SP target SP HTTP/1.x
+    char* p = hc->req;
+    char* method = p;
+    while (p < hc->req + end && *p != ' ' && *p != '\r') p++;
+    char* method_end = p;
+    if (*p == ' ') p++;
+    char* target = p;
+    while (p < hc->req + end && *p != ' ' && *p != '\r') p++;
+    char* target_end = p;
+    if (*p == ' ') p++;
+    char* version = p;
+    while (p < hc->req + end && *p != '\r') p++;
+    *method_end = '\0';
+    *target_end = '\0';
+    int bad = p - version != 8 || strncmp(version, "HTTP/1.", 7) != 0 ||
+              (version[7] != '0' && version[7] != '1') || target == target_end || *target != '/';
+    *p = '\0';
+    hc->http10 = !bad && version[7] == '0';
+    p += 2;
+
+    // Headers that matter here
+    int conn_close = 0, conn_keep_alive = 0, has_body = 0;
+    while (p < hc->req + end - 2) {
+        char* line = p;
+        while (*p != '\r') p++;
+        *p = '\0';
+        p += 2;
+        uint32_t colon = 0;
+        while (line[colon] && line[colon] != ':') colon++;
+        if (!line[colon]) continue;
+        char* value = line + colon + 1;
+        while (*value == ' ' || *value == '\t') value++;
+        if (httpd_name_is(line, colon, "connection")) {
+            if (httpd_has_token(value, "close")) conn_close = 1;
+            if (httpd_has_token(value, "keep-alive")) conn_keep_alive = 1;
+        } else if (httpd_name_is(line, colon, "content-length")) {
+            if (value[0] != '0' || value[1] != '\0') has_body = 1;
+        } else if (httpd_name_is(line, colon, "transfer-encoding")) {
+            has_body = 1;
+        }
+    }
+    hc->keep_alive = hc->http10 ? conn_keep_alive : !conn_close;
+
+    hc->requests++;
+    stats.requests++;
+    if (hc->requests > 1) stats.reused++;
+
+    int is_get = strcmp(method, "GET") == 0;
+    int is_head = strcmp(method, "HEAD") == 0;
+    if (bad) {
+        hc->keep_alive = 0;
+        httpd_error(hc, 400, "Bad Request", 0);
+    } else if ((!is_get && !is_head) || has_body) {
+        // Request bodies are never read, so the stream can't continue
+        hc->keep_alive = 0;
+        httpd_error(hc, 405, "Method Not Allowed", is_head);
+    } else {
+        // Only the path selects the resource
+        for (char* q = target; *q; q++) {
+            if (*q == '?') {
+                *q = '\0';
+                break;
+            }
+        }
+        const char* name = target + 1;
+        file_t* file = NULL;
+        if (name[0] == '\0') {
+            file = vfs_open("index.html");
+            if (!file) httpd_listing(hc, is_head);
+        } else if (strcmp(name, "health") == 0) {
+            httpd_health(hc, is_head);
+        } else {
+            file = vfs_open(name);
+            if (!file || file->type != FILE_TYPE_REGULAR) {
+                file = NULL;
+                httpd_error(hc, 404, "Not Found", is_head);
+            }
+        }
+        if (file) httpd_file(hc, file, is_head);
+    }
+
+    // Keep whatever followed this request (pipelining)
+    for (uint32_t i = end; i < hc->req_len; i++) {
+        hc->req[i - end] = hc->req[i];
+    }
+    hc->req_len -= end;
+
+    // Hold a short header until the body joins it in one segment
+    tcp_set_cork(hc->tcp, 1);
+    return 1;
+}
+
+// Queue as much of the response as TCP takes. Returns 1 once all of it
+// is queued, 0 when the send buffer is full (WRITABLE resumes) or the
+// connection failed (hc->tcp is then 0).
+static int httpd_push(httpd_conn_t* hc) {
+    while (hc->head_off < hc->head_len) {
+        int n = tcp_send(hc->tcp, hc->head + hc->head_off, hc->head_len - hc->head_off);
+        if (n < 0) {
+            httpd_release(hc, 1);
+            return 0;
+        }
+        if (n == 0) return 0;
+        hc->head_off += n;
+        stats.bytes_out += n;
+    }
+    while (hc->body_off < hc->body_len) {
+        int n = tcp_send(hc->tcp, hc->body + hc->body_off, hc->body_len - hc->body_off);
+        if (n < 0) {
+            httpd_release(hc, 1);
+            return 0;
+        }
+        if (n == 0) return 0;
+        hc->body_off += n;
+        stats.bytes_out += n;
+    }
+    return 1;
+}
+
+// Move received bytes into the request buffer. Returns 0 when there is
+// nothing more for now, or the peer closed (the slot is then released).
+static int httpd_read(httpd_conn_t* hc) {
+    // httpd_parse() answers 431 before the buffer can fill up, so there
+    // is room here; what does not fit stays parked for the next call
+    pktbuf_t* pb = hc->rx_pb;
+    if (!pb) pb = tcp_recv_pb(hc->tcp);
+    if (!pb) {
+        // Readable with nothing queued: data raced in, or end of stream
+        if (!(tcp_poll(hc->tcp) & (TCP_EV_READABLE | TCP_EV_CLOSED))) return 0;
+        pb = tcp_recv_pb(hc->tcp);
+        if (!pb) {
+            httpd_release(hc, 0);
+            return 0;
+        }
+    }
+    uint32_t n = pb->len;
+    if (n > HTTPD_REQ_MAX - hc->req_len) n = HTTPD_REQ_MAX - hc->req_len;
+    memcpy(hc->req + hc->req_len, pb->data, n);
+    hc->req_len += n;
+    pktbuf_pull(pb, n);
+    if (pb->len) {
+        hc->rx_pb = pb;
+    } else {
+        hc->rx_pb = NULL;
+        pktbuf_put(pb);
+    }
+    hc->last_active = timer_get_ticks();
+    return 1;
+}
+
+static void httpd_service(httpd_conn_t* hc) {
+    while (hc->tcp) {
+        if (hc->sending) {
+            if (!httpd_push(hc)) return;
+            tcp_set_cork(hc->tcp, 0);
+            httpd_release_body(hc);
+            hc->sending = 0;
+            hc->last_active = timer_get_ticks();
+            if (!hc->keep_alive) {
+                httpd_release(hc, 0);
+                return;
+            }
+            continue;
+        }
+        if (httpd_parse(hc)) continue;
+        if (!httpd_read(hc)) return;
+    }
+}
+
+// Free slot, or the one idle the longest between requests
+static httpd_conn_t* httpd_slot(void) {
+    httpd_conn_t* idle = NULL;
+    uint32_t now = timer_get_ticks();
+    for (uint32_t i = 0; i < HTTPD_MAX_CONNS; i++) {
+        httpd_conn_t* hc = &conns[i];
+        if (!hc->tcp) return hc;
+        if (!hc->sending && hc->req_len == 0 && !hc->rx_pb &&
+            (!idle || now - hc->last_active > now - idle->last_active)) {
+            idle = hc;
+        }
+    }
+    if (idle) {
+        httpd_release(idle, 0);
+        stats.reaped++;
+    }
+    return idle;
+}
+
+static void httpd_accept_all(void) {
+    tcp_conn_t* tcp;
+    while ((tcp = tcp_accept(listener)) != NULL) {
+        httpd_conn_t* hc = httpd_slot();
+        if (!hc) {
+            stats.rejected++;
+            tcp_abort(tcp);
+            continue;
+        }
+        hc->tcp = tcp;
+        hc->sending = 0;
+        hc->keep_alive = 1;
+        hc->http10 = 0;
+        hc->requests = 0;
+        hc->req_len = 0;
+        hc->last_active = timer_get_ticks();
+        stats.accepted++;
+        stats.active++;
+        tcp_set_callback(tcp, httpd_event, hc);
+        // Anything that arrived before the callback was set
+        httpd_service(hc);
+    }
+}
+
+static void httpd_drain_ready(void) {
+    uint32_t flags = spin_lock_irqsave(&ready_lock);
+    for (httpd_conn_t* hc = ready_head; hc; hc = hc->ready_next) hc->queued = 0;
+    ready_head = ready_tail = NULL;
+    accept_pending = 0;
+    spin_unlock_irqrestore(&ready_lock, flags);
+}
+
+static void httpd_teardown(void) {
+    if (listener) {
+        tcp_close(listener);
+        listener = NULL;
+    }
+    for (uint32_t i = 0; i < HTTPD_MAX_CONNS; i++) {
+        if (conns[i].tcp) httpd_release(&conns[i], 1);
+    }
+    httpd_drain_ready();
+    listen_port = 0;
+    serial_write("HTTPD: Stopped\n");
+}
+
+static void httpd_run(void* arg) {
+    (void)arg;
+    stats.runs++;
+    if (stopping) {
+        httpd_teardown();
+        return;
+    }
+    if (!listener) {
+        // Callbacks that raced with httpd_stop()
+        httpd_drain_ready();
+        return;
+    }
+
+    for (;;) {
+        uint32_t flags = spin_lock_irqsave(&ready_lock);
+        uint32_t accept = accept_pending;
+        accept_pending = 0;
+        httpd_conn_t* hc = ready_head;
+        if (hc) {
+            ready_head = hc->ready_next;
+            if (!ready_head) ready_tail = NULL;
+            hc->queued = 0;
+        }
+        spin_unlock_irqrestore(&ready_lock, flags);
+
+        if (accept) httpd_accept_all();
+        if (hc) {
+            // The slot may have been released since it was queued
+            if (hc->tcp) httpd_service(hc);
+        } else if (!accept) {
+            break;
+        }
+    }
+}
+
+int httpd_start(uint16_t port) {
+    if (!httpd_initialized) {
+        spin_lock_init(&ready_lock, "httpd_ready");
+        workqueue_create(&httpd_wq, "httpd", -1, 1);
+        init_work(&httpd_work, httpd_run, NULL);
+        httpd_initialized = 1;
+    }
+    if (listener) return -1;
+
+    tcp_conn_t* l = tcp_listen(port, HTTPD_BACKLOG);
+    if (!l) return -1;
+
+    memset(&stats, 0, sizeof(stats));
+    stopping = 0;
+    listen_port = port;
+    listener = l;
+    tcp_set_callback(l, httpd_event, NULL);
+
+    // Connections that completed before the callback was set
+    accept_pending = 1;
+    queue_work(&httpd_wq, &httpd_work);
+    serial_write("HTTPD: Listening\n");
+    return 0;
+}
+
+void httpd_stop(void) {
+    if (!listener) return;
+    stopping = 1;
+    queue_work(&httpd_wq, &httpd_work);
+    flush_workqueue(&httpd_wq);
+    stopping = 0;
+}
+
+uint16_t httpd_port(void) {
+    return listen_port;
+}
+
+void httpd_get_stats(httpd_stats_t* out) {
+    *out = stats;
+}
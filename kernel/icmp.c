@@ -0,0 +1,274 @@
+#include "icmp.h"
+#include "ip.h"
+#include "checksum.h"
+#include "timer.h"
+#include "div64.h"
+#include "string.h"
+#include "serial.h"
+#include <stddef.h>
+
+// Open ping sessions, matched by identifier on every echo reply
+static icmp_ping_t* sessions = NULL;
+static spinlock_t icmp_lock;
+static volatile uint32_t next_id = 0x4E54;   // "NT"
+static icmp_stats_t stats;
+
+// Echo request: answer in the receive buffer itself. Only the type
+// changes, so the checksum is patched rather than recomputed, and the
+// IP and Ethernet headers are rebuilt in the space the old ones used.
+static void icmp_echo_request(pktbuf_t* pb, ip_header_t* ip) {
+    stats.in_echo_requests++;
+
+    // Broadcast pings go unanswered (RFC 1122 3.2.2.6 allows either)
+    if (ntohl(ip->dest_ip) != ip_local_address()) return;
+    uint32_t src = ntohl(ip->src_ip);
+
+    icmp_header_t* icmp = (icmp_header_t*)pb->data;
+    uint16_t old_word = *(uint16_t*)icmp;
+    icmp->type = ICMP_ECHO_REPLY;
+    icmp->checksum = csum_update16(icmp->checksum, old_word, *(uint16_t*)icmp);
+
+    pktbuf_get(pb);
+    pb->csum_flags = 0;
+    if (ip_output(pb, src, IP_PROTO_ICMP) < 0) {
+        stats.out_errors++;
+        return;
+    }
+    stats.out_echo_replies++;
+    net_flush();
+}
+
+static void icmp_echo_reply(pktbuf_t* pb, ip_header_t* ip) {
+    uint64_t now = rdtsc();
+    stats.in_echo_replies++;
+
+    icmp_header_t* icmp = (icmp_header_t*)pb->data;
+    uint16_t id = ntohs(icmp->id);
+    uint16_t seq = ntohs(icmp->sequence);
+    uint32_t src = ntohl(ip->src_ip);
+
+    uint32_t flags = spin_lock_irqsave(&icmp_lock);
+    icmp_ping_t* ping = sessions;
+    while (ping && !(ping->id == id && ping->dest == src)) ping = ping->next;
+
+    icmp_ping_slot_t* slot = ping ? &ping->slots[seq % ICMP_PING_SLOTS] : NULL;
+    if (!slot || slot->seq != seq || slot->sent_tsc == 0) {
+        stats.in_unmatched_replies++;
+    } else if (slot->replied) {
+        ping->duplicates++;
+    } else {
+        uint32_t rtt = (uint32_t)timer_cycles_to_ns(now - slot->sent_tsc);
+        uint32_t rtt_us = rtt / 1000;
+        slot->rtt_ns = rtt;
+        slot->ttl = ip->ttl;
+        __atomic_store_n(&slot->replied, 1, __ATOMIC_RELEASE);
+
+        ping->received++;
+        if (ping->received == 1 || rtt < ping->min_ns) ping->min_ns = rtt;
+        if (rtt > ping->max_ns) ping->max_ns = rtt;
+        ping->sum_ns += rtt;
+        ping->sum_sq_us += (uint64_t)rtt_us * rtt_us;
+    }
+    spin_unlock_irqrestore(&icmp_lock, flags);
+}
+
+// Errors quote our original header; charge them to the session
+static void icmp_error(pktbuf_t* pb) {
+    if (pb->len < sizeof(icmp_header_t) + IP_HLEN + sizeof(icmp_header_t)) return;
+
+    ip_header_t* orig = (ip_header_t*)(pb->data + sizeof(icmp_header_t));
+    if (orig->protocol != IP_PROTO_ICMP) return;
+    icmp_header_t* orig_icmp = (icmp_header_t*)((uint8_t*)orig + (orig->version_ihl & 0x0F) * 4);
+    if ((uint8_t*)orig_icmp + sizeof(icmp_header_t) > pb->data + pb->len) return;
+    if (orig_icmp->type != ICMP_ECHO_REQUEST) return;
+
+    uint16_t id = ntohs(orig_icmp->id);
+    uint32_t flags = spin_lock_irqsave(&icmp_lock);
+    for (icmp_ping_t* ping = sessions; ping; ping = ping->next) {
+        if (ping->id == id) {
+            ping->errors++;
+            break;
+        }
+    }
+    spin_unlock_irqrestore(&icmp_lock, flags);
+}
+
+static void icmp_rx(pktbuf_t* pb, ip_header_t* ip) {
+    stats.in_msgs++;
+    if (pb->len < sizeof(icmp_header_t)) return;
+
+    // NICs only validate TCP and UDP, so ICMP is always summed here
+    if (net_checksum(pb->data, pb->len) != 0) {
+        stats.in_csum_errors++;
+        return;
+    }
+
+    icmp_header_t* icmp = (icmp_header_t*)pb->data;
+    switch (icmp->type) {
+    case ICMP_ECHO_REQUEST:
+        icmp_echo_request(pb, ip);
+        break;
+    case ICMP_ECHO_REPLY:
+        icmp_echo_reply(pb, ip);
+        break;
+    case ICMP_DEST_UNREACH:
+        stats.in_dest_unreach++;
+        icmp_error(pb);
+        break;
+    case ICMP_TIME_EXCEEDED:
+        stats.in_time_exceeded++;
+        icmp_error(pb);
+        break;
+    default:
+        break;
+    }
+}
+
+void icmp_send_error(pktbuf_t* pb, ip_header_t* ip, uint8_t type, uint8_t code) {
+    uint32_t dest = ntohl(ip->dest_ip);
+    if (dest != ip_local_address()) return;
+    if (ip->protocol == IP_PROTO_ICMP) {
+        // Never answer an error with an error; requests are fine
+        uint8_t t = pb->len ? pb->data[0] : 0xFF;
+        if (t != ICMP_ECHO_REQUEST) return;
+    }
+
+    uint32_t hlen = (ip->version_ihl & 0x0F) * 4;
+    uint32_t quoted = pb->len < 8 ? pb->len : 8;
+
+    pktbuf_t* out = pktbuf_alloc();
+    if (!out) return;
+    icmp_header_t* icmp = (icmp_header_t*)pktbuf_append(out, sizeof(icmp_header_t) + hlen + quoted);
+    icmp->type = type;
+    icmp->code = code;
+    icmp->id = 0;
+    icmp->sequence = 0;
+    memcpy((uint8_t*)icmp + sizeof(icmp_header_t), ip, hlen);
+    memcpy((uint8_t*)icmp + sizeof(icmp_header_t) + hlen, pb->data, quoted);
+    icmp->checksum = 0;
+    icmp->checksum = net_checksum(icmp, out->len);
+
+    if (ip_output(out, ntohl(ip->src_ip), IP_PROTO_ICMP) < 0) {
+        stats.out_errors++;
+        return;
+    }
+    net_flush();
+}
+
+void icmp_ping_open(icmp_ping_t* ping, uint32_t dest, uint16_t data_len) {
+    memset(ping, 0, sizeof(*ping));
+    ping->dest = dest;
+    ping->data_len = data_len;
+    ping->id = (uint16_t)__atomic_fetch_add(&next_id, 1, __ATOMIC_RELAXED);
+
+    uint32_t flags = spin_lock_irqsave(&icmp_lock);
+    ping->next = sessions;
+    sessions = ping;
+    spin_unlock_irqrestore(&icmp_lock, flags);
+}
+
+void icmp_ping_close(icmp_ping_t* ping) {
+    uint32_t flags = spin_lock_irqsave(&icmp_lock);
+    icmp_ping_t** link = &sessions;
+    while (*link && *link != ping) link = &(*link)->next;
+    if (*link) *link = ping->next;
+    spin_unlock_irqrestore(&icmp_lock, flags);
+}
+
+int icmp_ping_send(icmp_ping_t* ping) {
+    pktbuf_t* pb = pktbuf_alloc();
+    if (!pb) return -1;
+
+    uint32_t len = sizeof(icmp_header_t) + ping->data_len;
+    icmp_header_t* icmp = (icmp_header_t*)pktbuf_append(pb, len);
+    if (!icmp) {
+        pktbuf_put(pb);
+        return -1;
+    }
+
+    uint16_t seq = ping->next_seq++;
+    icmp->type = ICMP_ECHO_REQUEST;
+    icmp->code = 0;
+    icmp->id = htons(ping->id);
+    icmp->sequence = htons(seq);
+    uint8_t* data = (uint8_t*)icmp + sizeof(icmp_header_t);
+    for (uint32_t i = 0; i < ping->data_len; i++) data[i] = (uint8_t)(0x10 + i);
+    icmp->checksum = 0;
+    net_tx_csum(pb, (uint8_t*)icmp, offsetof(icmp_header_t, checksum));
+
+    // Arm the slot before the request can possibly be answered
+    uint32_t flags = spin_lock_irqsave(&icmp_lock);
+    icmp_ping_slot_t* slot = &ping->slots[seq % ICMP_PING_SLOTS];
+    slot->seq = seq;
+    slot->replied = 0;
+    slot->rtt_ns = 0;
+    slot->sent_tsc = rdtsc();
+    ping->transmitted++;
+    spin_unlock_irqrestore(&icmp_lock, flags);
+
+    if (ip_output(pb, ping->dest, IP_PROTO_ICMP) < 0) {
+        stats.out_errors++;
+        return -1;
+    }
+    net_flush();
+    stats.out_echo_requests++;
+    return seq;
+}
+
+int icmp_ping_reply(icmp_ping_t* ping, uint16_t seq, uint32_t* rtt_ns, uint8_t* ttl) {
+    icmp_ping_slot_t* slot = &ping->slots[seq % ICMP_PING_SLOTS];
+    if (slot->seq != seq || !__atomic_load_n(&slot->replied, __ATOMIC_ACQUIRE)) return 0;
+    if (rtt_ns) *rtt_ns = slot->rtt_ns;
+    if (ttl) *ttl = slot->ttl;
+    return 1;
+}
+
+// Integer square root by shifts only (no 64-bit division available)
+static uint32_t isqrt64(uint64_t n) {
+    uint64_t root = 0;
+    uint64_t bit = 1ULL << 62;
+    while (bit > n) bit >>= 2;
+    while (bit) {
+        if (n >= root + bit) {
+            n -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint32_t)root;
+}
+
+void icmp_ping_summary(icmp_ping_t* ping, icmp_rtt_summary_t* summary) {
+    memset(summary, 0, sizeof(*summary));
+
+    uint32_t flags = spin_lock_irqsave(&icmp_lock);
+    uint32_t n = ping->received;
+    uint64_t sum = ping->sum_ns;
+    uint64_t sum_sq = ping->sum_sq_us;
+    uint32_t min = ping->min_ns;
+    uint32_t max = ping->max_ns;
+    spin_unlock_irqrestore(&icmp_lock, flags);
+    if (n == 0) return;
+
+    // mdev as ping(8): sqrt(E[x^2] - E[x]^2)
+    uint32_t avg_us = (uint32_t)div_u64(div_u64(sum, n), 1000);
+    uint64_t mean_sq = div_u64(sum_sq, n);
+    uint64_t avg_sq = (uint64_t)avg_us * avg_us;
+    summary->min_us = min / 1000;
+    summary->max_us = max / 1000;
+    summary->avg_us = avg_us;
+    summary->mdev_us = mean_sq > avg_sq ? isqrt64(mean_sq - avg_sq) : 0;
+}
+
+void icmp_get_stats(icmp_stats_t* out) {
+    *out = stats;
+}
+
+void icmp_init(void) {
+    serial_write("ICMP: Initializing...\n");
+    spin_lock_init(&icmp_lock, "icmp");
+    ip_register_protocol(IP_PROTO_ICMP, icmp_rx);
+    serial_write("ICMP: Initialized successfully\n");
+}
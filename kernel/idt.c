@@ -1,34 +1,9 @@
 #include "idt.h"
 #include "serial.h"
 #include "vga.h"
+#include "rcu.h"
 #include <stddef.h>
 
-// IDT entry structure
-struct idt_entry {
-    uint16_t base_low;
-    uint16_t selector;
-    uint8_t always0;
-    uint8_t flags;
-    uint16_t base_high;
-} __attribute__((packed));
-
-// IDT pointer structure
-struct idt_ptr {
-    uint16_t limit;
-    uint32_t base;
-} __attribute__((packed));
-
-// CPU registers structure
-struct registers {
-    uint32_t ds;
-    uint32_t edi, esi, ebp, esp, ebx, edx, ecx, eax;
-    uint32_t int_no, err_code;
-    uint32_t eip, cs, eflags, useresp, ss;
-};
-
-// Interrupt handler function type
-typedef void (*isr_t)(struct registers*);
-
 // IDT entries (256 interrupts)
 struct idt_entry idt[256];
 struct idt_ptr idtp;
@@ -135,8 +110,15 @@ void idt_init(void) {
     serial_write("IDT: Initialized successfully\n");
 }
 
+// Load the shared IDT on an application processor. The gates are
+// identical on every CPU, so one table serves them all.
+void idt_load(void) {
+    idt_flush((uint32_t)&idtp);
+}
+
+// Handlers are read locklessly under RCU; see irq_uninstall_handler()
 void register_interrupt_handler(uint8_t n, isr_t handler) {
-    interrupt_handlers[n] = handler;
+    rcu_assign_pointer(interrupt_handlers[n], handler);
 }
 
 // Exception messages
@@ -178,10 +160,14 @@ static const char* exception_messages[] = {
 // ISR handler called from assembly
 void isr_handler(struct registers* regs) {
     // Check if we have a custom handler
-    if (interrupt_handlers[regs->int_no] != NULL) {
-        isr_t handler = interrupt_handlers[regs->int_no];
+    rcu_read_lock();
+    isr_t handler = rcu_dereference(interrupt_handlers[regs->int_no]);
+    if (handler != NULL) {
         handler(regs);
+        rcu_read_unlock();
     } else {
+        rcu_read_unlock();
+
         // Unhandled exception
         serial_write("Unhandled exception: ");
         serial_write(exception_messages[regs->int_no]);
@@ -0,0 +1,146 @@
+#ifndef ACPI_H
+#define ACPI_H
+
+#include <stdint.h>
+
+// Limits for the MADT summary
+#define ACPI_MAX_CPUS      32
+#define ACPI_MAX_IOAPICS   4
+#define ACPI_MAX_OVERRIDES 16
+
+// Root System Description Pointer (ACPI 1.0 part + 2.0 extension)
+typedef struct {
+    char signature[8];
+    uint8_t checksum;
+    char oem_id[6];
+    uint8_t revision;
+    uint32_t rsdt_address;
+    uint32_t length;
+    uint64_t xsdt_address;
+    uint8_t extended_checksum;
+    uint8_t reserved[3];
+} __attribute__((packed)) acpi_rsdp_t;
+
+// Common header of every system description table
+typedef struct {
+    char signature[4];
+    uint32_t length;
+    uint8_t revision;
+    uint8_t checksum;
+    char oem_id[6];
+    char oem_table_id[8];
+    uint32_t oem_revision;
+    uint32_t creator_id;
+    uint32_t creator_revision;
+} __attribute__((packed)) acpi_sdt_header_t;
+
+// Multiple APIC Description Table
+typedef struct {
+    acpi_sdt_header_t header;
+    uint32_t lapic_address;
+    uint32_t flags;
+} __attribute__((packed)) acpi_madt_t;
+
+#define ACPI_MADT_PCAT_COMPAT 0x01
+
+// MADT entry types
+#define ACPI_MADT_LAPIC          0
+#define ACPI_MADT_IOAPIC         1
+#define ACPI_MADT_OVERRIDE       2
+#define ACPI_MADT_LAPIC_OVERRIDE 5
+
+typedef struct {
+    uint8_t type;
+    uint8_t length;
+} __attribute__((packed)) acpi_madt_entry_t;
+
+typedef struct {
+    acpi_madt_entry_t header;
+    uint8_t acpi_id;
+    uint8_t apic_id;
+    uint32_t flags;
+} __attribute__((packed)) acpi_madt_lapic_t;
+
+#define ACPI_LAPIC_ENABLED        0x01
+#define ACPI_LAPIC_ONLINE_CAPABLE 0x02
+
+typedef struct {
+    acpi_madt_entry_t header;
+    uint8_t ioapic_id;
+    uint8_t reserved;
+    uint32_t address;
+    uint32_t gsi_base;
+} __attribute__((packed)) acpi_madt_ioapic_t;
+
+typedef struct {
+    acpi_madt_entry_t header;
+    uint8_t bus;
+    uint8_t source;
+    uint32_t gsi;
+    uint16_t flags;
+} __attribute__((packed)) acpi_madt_override_t;
+
+typedef struct {
+    acpi_madt_entry_t header;
+    uint16_t reserved;
+    uint64_t address;
+} __attribute__((packed)) acpi_madt_lapic_override_t;
+
+// PCI Express memory-mapped configuration space table
+typedef struct {
+    acpi_sdt_header_t header;
+    uint64_t reserved;
+} __attribute__((packed)) acpi_mcfg_t;
+
+// One ECAM window: 1 MiB of config space per bus, starting at start_bus
+typedef struct {
+    uint64_t base_address;
+    uint16_t segment;
+    uint8_t start_bus;
+    uint8_t end_bus;
+    uint32_t reserved;
+} __attribute__((packed)) acpi_mcfg_entry_t;
+
+// Interrupt source override polarity/trigger flags (MPS INTI flags)
+#define ACPI_INTI_POLARITY_MASK 0x03
+#define ACPI_INTI_ACTIVE_LOW    0x03
+#define ACPI_INTI_TRIGGER_MASK  0x0C
+#define ACPI_INTI_LEVEL         0x0C
+
+typedef struct {
+    uint8_t id;
+    uint32_t address;
+    uint32_t gsi_base;
+} acpi_ioapic_info_t;
+
+typedef struct {
+    uint8_t source;  // ISA IRQ
+    uint32_t gsi;
+    uint16_t flags;
+} acpi_override_info_t;
+
+// Summary of the MADT used by the APIC and SMP code
+typedef struct {
+    uint32_t lapic_address;
+    int pcat_compat;
+    uint32_t num_cpus;
+    uint8_t cpu_apic_ids[ACPI_MAX_CPUS];
+    uint32_t num_ioapics;
+    acpi_ioapic_info_t ioapics[ACPI_MAX_IOAPICS];
+    uint32_t num_overrides;
+    acpi_override_info_t overrides[ACPI_MAX_OVERRIDES];
+} acpi_madt_info_t;
+
+// Record the RSDP handed over by the bootloader (Multiboot2 ACPI tags)
+void acpi_set_rsdp(void* rsdp);
+
+// Locate the RSDP (falls back to the BIOS areas) and parse the MADT
+int acpi_init(void);
+
+// Find a table by its 4-character signature, or NULL
+void* acpi_find_table(const char* signature);
+
+// Parsed MADT, or NULL when no MADT was found
+const acpi_madt_info_t* acpi_get_madt(void);
+
+#endif // ACPI_H
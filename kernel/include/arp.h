@@ -0,0 +1,81 @@
+#ifndef ARP_H
+#define ARP_H
+
+#include <stdint.h>
+#include "pktbuf.h"
+
+// ARP (RFC 826) over Ethernet for IPv4, with a neighbor cache hashed by
+// IP address. Addresses are in host order throughout this interface.
+
+#define ARP_HASH_BITS       6
+#define ARP_HASH_SIZE       (1 << ARP_HASH_BITS)     // Buckets
+#define ARP_MAX_ENTRIES     128
+#define ARP_MAX_PENDING     8        // Frames held per unresolved entry
+
+// Timers, in timer ticks (100 Hz)
+#define ARP_RETRY_TICKS     100      // Between requests while unresolved
+#define ARP_MAX_RETRIES     3
+#define ARP_REACHABLE_TICKS 6000     // Confirmed entries go stale after 60 s
+#define ARP_STALE_TICKS     6000     // Unused stale entries expire after this
+
+#define ARP_OP_REQUEST 1
+#define ARP_OP_REPLY   2
+
+typedef enum {
+    ARP_FREE = 0,
+    ARP_INCOMPLETE,      // Request sent, frames queued
+    ARP_REACHABLE,       // Confirmed by a reply or request from the host
+    ARP_STALE            // Still used; the next send re-probes
+} arp_state_t;
+
+// Snapshot of one cache entry for listings
+typedef struct {
+    uint32_t ip;
+    uint8_t mac[6];
+    uint8_t state;       // arp_state_t
+    uint8_t pending;     // Frames waiting on resolution
+    uint32_t age;        // Ticks since last confirmed (or first request)
+} arp_entry_info_t;
+
+typedef struct {
+    uint32_t requests_sent;
+    uint32_t replies_sent;
+    uint32_t requests_received;
+    uint32_t replies_received;
+    uint32_t gratuitous_sent;
+    uint32_t hits;           // Frames sent straight from the cache
+    uint32_t misses;         // Frames that had to wait for resolution
+    uint32_t queued;
+    uint32_t queue_drops;    // Pending queue full or resolution failed
+    uint32_t resolve_failed;
+    uint32_t expired;
+    uint32_t table_full;
+    uint32_t conflicts;      // Another host claimed our address
+} arp_stats_t;
+
+// Register the ARP ethertype and announce our address (gratuitous ARP)
+void arp_init(void);
+
+// Send an IPv4 packet (pb->data at the IP header) to next_hop on the
+// local segment: prepends the Ethernet header and transmits right away
+// when the address is cached, otherwise queues it behind an ARP request.
+// Always consumes the reference. Returns 0 sent, 1 queued, -1 dropped.
+int arp_output(pktbuf_t* pb, uint32_t next_hop);
+
+// Cached hardware address of ip; returns 1 if known
+int arp_lookup(uint32_t ip, uint8_t* mac);
+
+// Broadcast a gratuitous request for our own address (none while unset)
+void arp_announce(void);
+
+// Ages entries and retransmits requests; called from the network tick
+void arp_tick(void);
+
+// Drop every entry (pending frames included)
+void arp_flush(void);
+
+// Fill up to max entries; returns how many were stored
+uint32_t arp_get_entries(arp_entry_info_t* out, uint32_t max);
+void arp_get_stats(arp_stats_t* stats);
+
+#endif // ARP_H
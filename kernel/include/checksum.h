@@ -0,0 +1,40 @@
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include <stdint.h>
+
+// Internet checksum (RFC 1071) helpers.
+//
+// Partial sums are 32-bit values that can be chained: pass the result of
+// one call as the initial sum of the next. csum_fold() turns a partial
+// sum into the final complemented 16-bit checksum. All sums are taken
+// over native-order 16-bit words, which by the checksum's byte-order
+// independence yields a field that is stored as is.
+
+// One's-complement sum of len bytes, added to sum
+uint32_t csum_partial(const void* buf, uint32_t len, uint32_t sum);
+
+// Fold a partial sum to 16 bits and complement it
+static inline uint16_t csum_fold(uint32_t sum) {
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    return (uint16_t)~sum;
+}
+
+// Checksum of a buffer, ready to store
+static inline uint16_t csum_compute(const void* buf, uint32_t len) {
+    return csum_fold(csum_partial(buf, len, 0));
+}
+
+// TCP/UDP pseudo-header sum (addresses in network order, len and proto
+// in host order), unfolded so it can seed csum_partial() or a NIC
+uint32_t csum_tcpudp_nofold(uint32_t saddr, uint32_t daddr, uint16_t len,
+                            uint8_t proto, uint32_t sum);
+
+// RFC 1624 incremental update (eqn. 3: HC' = ~(~HC + ~m + m')) for a
+// checksum covering a 16- or 32-bit field that changed from old to new,
+// e.g. a TTL decrement or a NAT address rewrite
+uint16_t csum_update16(uint16_t check, uint16_t old_val, uint16_t new_val);
+uint16_t csum_update32(uint16_t check, uint32_t old_val, uint32_t new_val);
+
+#endif // CHECKSUM_H
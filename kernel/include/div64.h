@@ -0,0 +1,26 @@
+#ifndef DIV64_H
+#define DIV64_H
+
+#include <stdint.h>
+
+// 64-by-32 bit division without libgcc (__udivdi3 is not linked in).
+// Two chained divl instructions: the high quotient first, then the low
+// half with the high remainder in edx, which can never overflow.
+static inline uint64_t div_u64_rem(uint64_t n, uint32_t d, uint32_t* rem) {
+    uint32_t hi = (uint32_t)(n >> 32);
+    uint32_t lo = (uint32_t)n;
+    uint32_t qhi = hi / d;
+    uint32_t r = hi % d;
+    uint32_t qlo;
+
+    __asm__ ("divl %4" : "=a"(qlo), "=d"(r) : "a"(lo), "d"(r), "rm"(d));
+
+    if (rem) *rem = r;
+    return ((uint64_t)qhi << 32) | qlo;
+}
+
+static inline uint64_t div_u64(uint64_t n, uint32_t d) {
+    return div_u64_rem(n, d, 0);
+}
+
+#endif // DIV64_H
@@ -0,0 +1,98 @@
+#ifndef DNS_H
+#define DNS_H
+
+#include <stdint.h>
+
+// Stub resolver (RFC 1035) for A records. Queries go over UDP to one
+// recursive server, the one from the DHCP lease. Answers are kept in a
+// small cache for their TTL, least recently used entries making room,
+// and names that do not exist are cached too (RFC 2308). A lookup of a
+// name already being queried waits for that query instead of sending
+// its own. Addresses are in host order.
+
+#define DNS_PORT            53
+#define DNS_NAME_MAX        64           // Host names, trailing dot dropped
+#define DNS_CACHE_SIZE      32
+
+// Message header (multi-byte fields in network order)
+typedef struct {
+    uint16_t id;
+    uint16_t flags;
+    uint16_t qdcount;
+    uint16_t ancount;
+    uint16_t nscount;
+    uint16_t arcount;
+} __attribute__((packed)) dns_header_t;
+
+#define DNS_HLEN            12
+
+// Timers, in timer ticks (100 Hz)
+#define DNS_RETRY_TICKS     100          // First retransmission, doubled per try
+#define DNS_TRIES           3
+
+// TTLs, in seconds
+#define DNS_TTL_MAX         86400
+#define DNS_NEGATIVE_TTL    60           // For negative answers without an SOA
+
+// Errors (negative returns of dns_resolve)
+#define DNS_ERR_NXDOMAIN    -1           // No such name, or no A record
+#define DNS_ERR_TIMEOUT     -2           // Server did not answer
+#define DNS_ERR_SERVER      -3           // Server failure or malformed answer
+#define DNS_ERR_NAME        -4           // Not a valid host name
+#define DNS_ERR_NO_SERVER   -5           // Resolver not running or no route
+#define DNS_ERR_BUSY        -6           // Every cache slot has a query in flight
+
+typedef enum {
+    DNS_FREE = 0,
+    DNS_PENDING,         // Query in flight
+    DNS_POSITIVE,        // Address cached
+    DNS_NEGATIVE,        // Nonexistence cached
+    DNS_FAILED           // Query failed; kept until its waiters have seen it
+} dns_state_t;
+
+// Snapshot of one cache entry for listings
+typedef struct {
+    char name[DNS_NAME_MAX];
+    uint32_t ip;
+    uint8_t state;       // dns_state_t
+    uint32_t ttl;        // Seconds left
+    uint32_t hits;
+} dns_entry_info_t;
+
+typedef struct {
+    uint32_t lookups;
+    uint32_t hits;           // Answered from the cache
+    uint32_t negative_hits;
+    uint32_t misses;         // Needed a query
+    uint32_t coalesced;      // Joined a query already in flight
+    uint32_t queries;        // Sent, retransmissions included
+    uint32_t retransmits;
+    uint32_t answers;
+    uint32_t nxdomain;       // Negative answers: no such name or no A record
+    uint32_t timeouts;
+    uint32_t failures;       // SERVFAIL, REFUSED and malformed answers
+    uint32_t expired;
+    uint32_t evictions;
+} dns_stats_t;
+
+// Open the resolver socket (task context, from net_init())
+void dns_init(void);
+
+void dns_set_server(uint32_t ip);
+uint32_t dns_get_server(void);
+
+// Resolve name to an address: dotted quads directly, then the cache,
+// then the server. Blocks, idling the CPU while waiting, so call it from
+// a task. Returns 0 with *ip set, or DNS_ERR_*.
+int dns_resolve(const char* name, uint32_t* ip);
+
+// Drop every cached answer
+void dns_flush(void);
+
+// Fill up to max entries; returns how many were stored
+uint32_t dns_get_entries(dns_entry_info_t* out, uint32_t max);
+void dns_get_stats(dns_stats_t* stats);
+
+const char* dns_strerror(int err);
+
+#endif // DNS_H
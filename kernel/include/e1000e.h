@@ -0,0 +1,122 @@
+#ifndef E1000E_H
+#define E1000E_H
+
+#include <stdint.h>
+#include "e1000.h"
+#include "netdev.h"
+
+// Intel 82574L (QEMU -device e1000e). Register-compatible with the
+// 82540EM in e1000.h, plus two RX/TX queue pairs, RSS and MSI-X.
+#define E1000E_DEVICE_ID   0x10D3
+
+#define E1000E_NUM_QUEUES  2
+
+// Per-queue ring registers: queue n is 0x100 bytes after queue 0
+#define E1000E_REG_RDBAL(n)  (0x2800 + (n) * 0x100)
+#define E1000E_REG_RDBAH(n)  (0x2804 + (n) * 0x100)
+#define E1000E_REG_RDLEN(n)  (0x2808 + (n) * 0x100)
+#define E1000E_REG_RDH(n)    (0x2810 + (n) * 0x100)
+#define E1000E_REG_RDT(n)    (0x2818 + (n) * 0x100)
+#define E1000E_REG_TDBAL(n)  (0x3800 + (n) * 0x100)
+#define E1000E_REG_TDBAH(n)  (0x3804 + (n) * 0x100)
+#define E1000E_REG_TDLEN(n)  (0x3808 + (n) * 0x100)
+#define E1000E_REG_TDH(n)    (0x3810 + (n) * 0x100)
+#define E1000E_REG_TDT(n)    (0x3818 + (n) * 0x100)
+
+#define E1000E_REG_EIAC    0x00DC   // Causes auto-cleared on MSI-X delivery
+#define E1000E_REG_IVAR    0x00E4   // Cause to MSI-X vector mapping
+#define E1000E_REG_RFCTL   0x5008
+#define E1000E_REG_MRQC    0x5818
+#define E1000E_REG_RETA    0x5C00   // 32 registers, 128 one-byte entries
+#define E1000E_REG_RSSRK   0x5C80   // 10 registers, 40-byte Toeplitz key
+
+// MSI-X interrupt causes (ICR/IMS/IMC/EIAC)
+#define E1000E_ICR_RXQ(n)  (0x00100000u << (n))
+#define E1000E_ICR_TXQ(n)  (0x00400000u << (n))
+#define E1000E_ICR_OTHER   0x01000000
+
+// IVAR: a 4-bit field per cause, vector in the low three bits
+#define E1000E_IVAR_VALID       0x8
+#define E1000E_IVAR_RXQ(n)      ((n) * 4)        // Field shifts
+#define E1000E_IVAR_TXQ(n)      (8 + (n) * 4)
+#define E1000E_IVAR_OTHER       16
+#define E1000E_IVAR_INT_ALL_WB  0x80000000       // TX cause on every write-back
+
+#define E1000E_CTRL_EXT_PBA_CLR 0x80000000       // MSI-X pending bits auto-clear
+
+#define E1000E_RCTL_LBM_MAC     0x00000040       // MAC loopback
+#define E1000E_RFCTL_EXTEN      0x00008000       // Extended RX descriptors
+#define E1000E_RXCSUM_PCSD      0x00002000       // RSS hash replaces packet checksum
+
+// MRQC: RSS mode and hashed header types
+#define E1000E_MRQC_RSS         0x00000001
+#define E1000E_MRQC_TCPIPV4     0x00010000
+#define E1000E_MRQC_IPV4        0x00020000
+
+// RETA entries select queue 0 or 1 with bit 7
+#define E1000E_RETA_ENTRIES     128
+#define E1000E_RETA_QUEUE(q)    ((q) << 7)
+
+// Extended RX descriptor status/error bits
+#define E1000E_RXD_STAT_DD      0x00000001
+#define E1000E_RXD_STAT_EOP     0x00000002
+#define E1000E_RXD_STAT_IXSM    0x00000004
+#define E1000E_RXD_STAT_UDPCS   0x00000010
+#define E1000E_RXD_STAT_TCPCS   0x00000020
+#define E1000E_RXD_STAT_IPCS    0x00000040
+#define E1000E_RXD_ERR_FRAME    0x97000000       // CE, SE, SEQ, CXE, RXE
+#define E1000E_RXD_ERR_TCPE     0x20000000
+#define E1000E_RXD_ERR_IPE      0x40000000
+#define E1000E_RXD_MRQ_RSS_TYPE 0x0000000F       // 0: no hash computed
+
+#ifndef E1000E_RX_RING_SIZE
+#define E1000E_RX_RING_SIZE 256
+#endif
+#ifndef E1000E_TX_RING_SIZE
+#define E1000E_TX_RING_SIZE 256
+#endif
+
+// Extended receive descriptor: the driver writes the buffer address, the
+// device writes back RSS and status over the same 16 bytes
+typedef union {
+    struct {
+        uint64_t addr;
+        uint64_t reserved;       // Must be 0 (clears DD)
+    } read;
+    struct {
+        uint32_t mrq;            // RSS type
+        uint32_t rss_hash;
+        uint32_t status_error;
+        uint16_t length;
+        uint16_t vlan;
+    } wb;
+} __attribute__((packed)) e1000e_rx_desc_t;
+
+// Bring up the first 82574L; returns its netdev or 0 if absent
+netdev_t* e1000e_driver_init(void);
+
+// netdev ops, see netdev.h
+int e1000e_driver_xmit(pktbuf_t* pb);
+void e1000e_driver_flush(void);
+int e1000e_driver_tx_wait(void);
+void e1000e_get_stats(netdev_stats_t* stats);
+void e1000e_get_irq_info(netdev_irq_info_t* info);
+void e1000e_get_ring_sizes(uint32_t* rx, uint32_t* tx);
+
+// Queues receive flows are spread over (1 .. e1000e_num_queues());
+// rewrites the redirection table, rings stay set up
+int e1000e_set_rss_queues(uint32_t count);
+uint32_t e1000e_num_queues(void);
+
+// Counters of one queue pair and the CPU its interrupt is steered to
+void e1000e_get_queue_stats(uint32_t queue, netdev_stats_t* stats, uint32_t* cpu);
+
+// Route transmitted frames straight back into the receive path
+void e1000e_set_loopback(int enable);
+
+// Toeplitz hash over input with the driver's RSS key, and the queue the
+// redirection table maps it to, for checking the device's spread
+uint32_t e1000e_rss_hash(const uint8_t* input, uint32_t len);
+uint32_t e1000e_rss_queue(uint32_t hash);
+
+#endif // E1000E_H
@@ -13,4 +13,9 @@ void* kmalloc_ap(size_t size, uint32_t* phys); // Page-aligned + physical
 void kfree(void* ptr);
 void heap_stats(uint32_t* total, uint32_t* used, uint32_t* free_blocks);
 
+// Physically contiguous memory with the given power-of-two alignment, for
+// descriptor rings and DMA buffers. Never freed; NULL when exhausted.
+void* dma_alloc(size_t size, uint32_t align);
+void dma_stats(uint32_t* total, uint32_t* used);
+
 #endif // HEAP_H
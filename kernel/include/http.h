@@ -0,0 +1,80 @@
+#ifndef HTTP_H
+#define HTTP_H
+
+#include <stdint.h>
+#include "tcp.h"
+
+// HTTP/1.1 client (RFC 9112) over the TCP stack. Requests are GETs on a
+// persistent connection: consecutive requests to the same server reuse
+// it until the server closes it or says "Connection: close". Bodies are
+// framed by Content-Length, chunked transfer coding or connection close,
+// and are handed to a sink as they arrive, straight from the receive
+// buffers, so nothing the size of the response is ever held.
+
+#define HTTP_DEFAULT_PORT   80
+#define HTTP_HOST_MAX       64
+#define HTTP_PATH_MAX       256
+#define HTTP_LINE_MAX       256          // Longer header lines are cut (and ignored)
+#define HTTP_TYPE_MAX       48
+#define HTTP_CONNECT_MS     3000
+#define HTTP_IDLE_MS        10000        // Give up when the server goes quiet this long
+
+#define HTTP_LENGTH_NONE    0xFFFFFFFF
+
+// Errors (negative returns of http_get)
+#define HTTP_ERR_CONNECT    -1           // No connection could be made
+#define HTTP_ERR_TIMEOUT    -2           // Server stopped responding
+#define HTTP_ERR_PROTOCOL   -3           // Malformed response
+#define HTTP_ERR_CLOSED     -4           // Connection closed mid-response
+#define HTTP_ERR_SINK       -5           // The sink asked to stop
+
+typedef struct {
+    char host[HTTP_HOST_MAX];
+    uint16_t port;
+    char path[HTTP_PATH_MAX];    // Always starts with '/'
+} http_url_t;
+
+// Consumes body bytes in order; return < 0 to abort the transfer
+typedef int (*http_sink_t)(const uint8_t* data, uint32_t len, void* arg);
+
+typedef struct {
+    int status;                  // 200, 404, ...
+    uint8_t version;             // Minor version: 0 for HTTP/1.0, 1 for HTTP/1.1
+    uint8_t chunked;
+    uint8_t keep_alive;          // Connection stays open for the next request
+    uint8_t reused;              // Sent on a connection kept from an earlier request
+    uint32_t content_length;     // HTTP_LENGTH_NONE when not given
+    uint32_t body_bytes;         // Decoded body bytes passed to the sink
+    uint32_t connect_us;         // Handshake time; 0 when reused
+    uint32_t ttfb_us;            // Request sent to first response byte
+    uint32_t total_us;           // Request sent to last body byte
+    char content_type[HTTP_TYPE_MAX];
+} http_response_t;
+
+// Persistent connection to one server
+typedef struct {
+    tcp_conn_t* conn;            // 0 when not connected
+    uint32_t ip;
+    uint16_t port;
+    char host[HTTP_HOST_MAX];    // Sent as the Host header
+    uint32_t requests;           // Completed on this client
+    uint32_t connects;           // Connections opened for them
+} http_client_t;
+
+// Split "http://host[:port][/path]" (scheme optional); -1 if malformed
+int http_parse_url(const char* url, http_url_t* out);
+
+void http_client_init(http_client_t* client, uint32_t ip, uint16_t port, const char* host);
+
+// GET path, streaming the body into sink. Blocks, idling the CPU between
+// segments, so call it from a task (the shell), not an interrupt.
+// Returns 0 with resp filled in (any status code), or HTTP_ERR_*.
+int http_get(http_client_t* client, const char* path, http_sink_t sink, void* arg,
+             http_response_t* resp);
+
+// Drop the connection, if any
+void http_client_close(http_client_t* client);
+
+const char* http_strerror(int err);
+
+#endif // HTTP_H
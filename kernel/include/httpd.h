@@ -0,0 +1,50 @@
+#ifndef HTTPD_H
+#define HTTPD_H
+
+#include <stdint.h>
+
+// HTTP/1.1 server for VFS files and a health page. Event driven: TCP
+// callbacks queue ready connections for one work item that serves them
+// all, so there is no task per connection. Responses are sent from a
+// vfs_map() snapshot of the file, copied once, straight into the TCP
+// segments.
+//
+//   GET /          index.html, or a listing of the files
+//   GET /health    status in text/plain
+//   GET /NAME      the file NAME
+//
+// HEAD is answered too; anything else gets 405.
+
+#define HTTPD_PORT          80
+#define HTTPD_MAX_CONNS     64
+#define HTTPD_BACKLOG       32
+#define HTTPD_REQ_MAX       2048         // Request line and headers
+#define HTTPD_HEAD_MAX      512          // Response header and generated bodies
+
+typedef struct {
+    uint32_t accepted;
+    uint32_t rejected;           // Accepted with every slot busy
+    uint32_t reaped;             // Idle keep-alive connections closed to make room
+    uint32_t active;
+    uint32_t requests;
+    uint32_t reused;             // Requests after the first on a connection
+    uint32_t status_2xx;
+    uint32_t status_4xx;
+    uint32_t status_5xx;
+    uint32_t events;             // TCP callbacks
+    uint32_t runs;               // Work item executions
+    uint64_t bytes_out;
+} httpd_stats_t;
+
+// Listen on port; -1 if already running or the port is taken
+int httpd_start(uint16_t port);
+
+// Close the listener and every connection (task context)
+void httpd_stop(void);
+
+// Listening port, 0 when stopped
+uint16_t httpd_port(void);
+
+void httpd_get_stats(httpd_stats_t* stats);
+
+#endif // HTTPD_H
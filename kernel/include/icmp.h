@@ -0,0 +1,95 @@
+#ifndef ICMP_H
+#define ICMP_H
+
+#include <stdint.h>
+#include "lock.h"
+#include "net.h"
+
+// ICMP (RFC 792): answers echo requests and matches echo replies to
+// ping sessions, timing each sequence number with the TSC.
+
+#define ICMP_ECHO_REPLY       0
+#define ICMP_DEST_UNREACH     3
+#define ICMP_ECHO_REQUEST     8
+#define ICMP_TIME_EXCEEDED    11
+
+#define ICMP_PORT_UNREACH     3      // Destination unreachable codes
+#define ICMP_PROTO_UNREACH    2
+
+// Sequence numbers tracked per session; older ones count as lost
+#define ICMP_PING_SLOTS       64
+
+#define ICMP_PING_DEFAULT_DATA 56    // Payload bytes, as ping(8)
+
+// One slot per outstanding sequence number
+typedef struct {
+    uint64_t sent_tsc;
+    volatile uint32_t rtt_ns;        // Valid once replied is set
+    uint16_t seq;
+    volatile uint8_t replied;
+    volatile uint8_t ttl;
+} icmp_ping_slot_t;
+
+// Echo session. The caller owns the storage from icmp_ping_open() to
+// icmp_ping_close(); replies are recorded from the receive softirq
+// under the ICMP lock.
+typedef struct icmp_ping {
+    struct icmp_ping* next;
+    uint32_t dest;
+    uint16_t id;
+    uint16_t data_len;
+    uint16_t next_seq;
+    icmp_ping_slot_t slots[ICMP_PING_SLOTS];
+    uint32_t transmitted;
+    uint32_t received;
+    uint32_t duplicates;
+    uint32_t errors;                 // Unreachable / time exceeded for us
+    uint32_t min_ns;
+    uint32_t max_ns;
+    uint64_t sum_ns;
+    uint64_t sum_sq_us;              // For the standard deviation
+} icmp_ping_t;
+
+typedef struct {
+    uint32_t in_msgs;
+    uint32_t in_csum_errors;
+    uint32_t in_echo_requests;
+    uint32_t in_echo_replies;
+    uint32_t in_unmatched_replies;
+    uint32_t in_dest_unreach;
+    uint32_t in_time_exceeded;
+    uint32_t out_echo_replies;
+    uint32_t out_echo_requests;
+    uint32_t out_errors;             // Replies or requests that failed to send
+} icmp_stats_t;
+
+typedef struct {
+    uint32_t min_us;
+    uint32_t avg_us;
+    uint32_t max_us;
+    uint32_t mdev_us;
+} icmp_rtt_summary_t;
+
+void icmp_init(void);
+
+// Start a session to dest with data_len payload bytes per request
+void icmp_ping_open(icmp_ping_t* ping, uint32_t dest, uint16_t data_len);
+void icmp_ping_close(icmp_ping_t* ping);
+
+// Send the next echo request; returns its sequence number or -1
+int icmp_ping_send(icmp_ping_t* ping);
+
+// Whether seq has been answered; stores its RTT and TTL if so
+int icmp_ping_reply(icmp_ping_t* ping, uint16_t seq, uint32_t* rtt_ns, uint8_t* ttl);
+
+// min/avg/max/mdev over the replies so far (all 0 without replies)
+void icmp_ping_summary(icmp_ping_t* ping, icmp_rtt_summary_t* summary);
+
+// Report a received packet as undeliverable (RFC 1122 3.2.2): quotes
+// its IP header and first 8 data bytes. pb->data is at the IP payload,
+// as handed to protocol handlers. Not sent for broadcasts or errors.
+void icmp_send_error(pktbuf_t* pb, ip_header_t* ip, uint8_t type, uint8_t code);
+
+void icmp_get_stats(icmp_stats_t* stats);
+
+#endif // ICMP_H
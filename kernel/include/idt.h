@@ -29,6 +29,9 @@ struct registers {
 // Initialize IDT
 void idt_init(void);
 
+// Load the IDT on the calling CPU (application processors)
+void idt_load(void);
+
 // Set IDT gate (for IRQ setup)
 void idt_set_gate(uint8_t num, uint32_t base, uint16_t sel, uint8_t flags);
 
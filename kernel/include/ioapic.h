@@ -0,0 +1,42 @@
+#ifndef IOAPIC_H
+#define IOAPIC_H
+
+#include <stdint.h>
+
+// Memory-mapped register window
+#define IOAPIC_REG_SELECT  0x00
+#define IOAPIC_REG_WINDOW  0x10
+
+// Indirect registers
+#define IOAPIC_ID          0x00
+#define IOAPIC_VERSION     0x01
+#define IOAPIC_REDIR_BASE  0x10
+
+// Redirection entry bits (low dword)
+#define IOAPIC_REDIR_ACTIVE_LOW 0x00002000
+#define IOAPIC_REDIR_LEVEL      0x00008000
+#define IOAPIC_REDIR_MASKED     0x00010000
+
+// Number of legacy ISA IRQ lines
+#define ISA_IRQ_COUNT 16
+
+// Find the I/O APICs in the MADT and mask every input.
+// Returns -1 if the system has none.
+int ioapic_init(void);
+
+int ioapic_available(void);
+
+// Global system interrupt an ISA IRQ is wired to, plus the redirection
+// flags (polarity/trigger) from the MADT interrupt source overrides
+uint32_t ioapic_isa_to_gsi(uint8_t irq, uint32_t* redir_flags);
+
+// Program a GSI to deliver vector to one Local APIC (left masked)
+void ioapic_route(uint32_t gsi, uint8_t vector, uint8_t apic_id, uint32_t redir_flags);
+
+void ioapic_mask(uint32_t gsi);
+void ioapic_unmask(uint32_t gsi);
+
+// Change the destination Local APIC of a GSI
+void ioapic_set_dest(uint32_t gsi, uint8_t apic_id);
+
+#endif // IOAPIC_H
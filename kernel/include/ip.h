@@ -0,0 +1,89 @@
+#ifndef IP_H
+#define IP_H
+
+#include <stdint.h>
+#include "net.h"
+
+// IPv4 (RFC 791) input and output. Header fields are in network order
+// on the wire and in ip_header_t; addresses passed to and from this
+// interface are in host order.
+
+#define IP_PROTO_ICMP 1
+#define IP_PROTO_TCP  6
+#define IP_PROTO_UDP  17
+
+#define IP_VERSION_IHL 0x45          // IPv4, 20-byte header
+#define IP_HLEN        20
+#define IP_DEFAULT_TTL 64
+
+// flags_fragment
+#define IP_FLAG_DF     0x4000
+#define IP_FLAG_MF     0x2000
+#define IP_FRAG_OFFSET 0x1FFF
+
+#define IP_BROADCAST   0xFFFFFFFF
+
+// Upper-layer receive handler. pb->data is at the protocol header and
+// pb->len covers the payload up to the IP total length; ip points at the
+// IP header in front of it. The buffer is borrowed as in net_receive().
+typedef void (*ip_proto_handler_t)(pktbuf_t* pb, ip_header_t* ip);
+
+// Route flags
+#define IP_ROUTE_GATEWAY 0x01        // Next hop is the gateway, not the host
+#define IP_ROUTE_IFACE   0x02        // Derived from the interface address
+
+#define IP_MAX_ROUTES 16
+
+typedef struct {
+    uint32_t dest;
+    uint32_t netmask;
+    uint32_t gateway;
+    uint32_t flags;
+} ip_route_t;
+
+typedef struct {
+    uint32_t in_receives;
+    uint32_t in_hdr_errors;      // Truncated, bad version or length
+    uint32_t in_csum_errors;
+    uint32_t in_addr_errors;     // Not addressed to us
+    uint32_t in_frag_drops;      // Fragments (reassembly is not supported)
+    uint32_t in_unknown_protos;
+    uint32_t in_delivers;
+    uint32_t out_requests;
+    uint32_t out_no_routes;
+    uint32_t out_discards;       // Neighbor resolution failed or NIC full
+    uint32_t in_icmp, in_udp, in_tcp;
+    uint32_t out_icmp, out_udp, out_tcp;
+} ip_stats_t;
+
+// Register the IPv4 ethertype and install the interface routes
+void ip_init(void);
+
+// Deliver received packets of protocol to handler
+void ip_register_protocol(uint8_t protocol, ip_proto_handler_t handler);
+
+// Prepend an IP header to the protocol data at pb->data and send it
+// towards dest_ip. Queues the frame; net_flush() hands it to the NIC.
+// Always consumes the reference. Returns -1 if it was dropped.
+int ip_output(pktbuf_t* pb, uint32_t dest_ip, uint8_t protocol);
+
+// Source address of outgoing packets (0 while unconfigured)
+uint32_t ip_local_address(void);
+
+// Longest-prefix match; stores the neighbor to send to in *next_hop.
+// Returns -1 when no route covers dest.
+int ip_route_lookup(uint32_t dest, uint32_t* next_hop);
+
+// Route table updates (task context: they wait for an RCU grace period)
+int ip_route_add(uint32_t dest, uint32_t netmask, uint32_t gateway);
+int ip_route_del(uint32_t dest, uint32_t netmask);
+
+// Replace the connected and default routes after the interface
+// address changed (called by net_set_ip())
+void ip_update_interface(void);
+
+// Copy the table, most specific route first; returns the count
+uint32_t ip_get_routes(ip_route_t* out, uint32_t max);
+void ip_get_stats(ip_stats_t* stats);
+
+#endif // IP_H
@@ -15,6 +15,8 @@
 #define MULTIBOOT_TAG_TYPE_MMAP 6
 #define MULTIBOOT_TAG_TYPE_VBE 7
 #define MULTIBOOT_TAG_TYPE_FRAMEBUFFER 8
+#define MULTIBOOT_TAG_TYPE_ACPI_OLD 14
+#define MULTIBOOT_TAG_TYPE_ACPI_NEW 15
 
 struct multiboot_tag {
     uint32_t type;
@@ -40,6 +42,13 @@ struct multiboot_tag_basic_meminfo {
     uint32_t mem_upper;
 };
 
+// ACPI RSDP copy (old = ACPI 1.0, new = ACPI 2.0+)
+struct multiboot_tag_acpi {
+    uint32_t type;
+    uint32_t size;
+    uint8_t rsdp[];
+};
+
 // Parse multiboot2 info
 void multiboot2_parse(uint32_t magic, void* mbi);
 
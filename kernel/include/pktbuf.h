@@ -0,0 +1,95 @@
+#ifndef PKTBUF_H
+#define PKTBUF_H
+
+#include <stdint.h>
+
+// Every buffer is one 2 KiB DMA slot. Receive DMA uses the whole slot;
+// transmit buffers start their data PKTBUF_HEADROOM bytes in so each
+// protocol layer can prepend its header in place.
+#define PKTBUF_SIZE       2048
+#define PKTBUF_HEADROOM   128
+#define PKTBUF_POOL_SIZE  256    // Initial slab; drivers grow the pool
+
+// Reference-counted packet buffer. The slot is identity mapped, so
+// pointers into it double as DMA addresses.
+typedef struct pktbuf {
+    uint8_t* head;              // Start of the DMA slot
+    uint8_t* data;              // First valid byte
+    uint32_t len;               // Valid bytes from data
+    volatile uint32_t refcnt;
+    struct pktbuf* next;        // Free list / queue link
+    uint16_t csum_start;        // TX offload: sum from head + csum_start...
+    uint16_t csum_offset;       // ...to the end, stored at csum_start + this
+    uint8_t csum_flags;         // PKTBUF_CSUM_*
+    uint32_t cb[4];             // Scratch for the layer holding the buffer
+} pktbuf_t;
+
+// Checksum state carried with a buffer
+#define PKTBUF_CSUM_PARTIAL  0x01   // TX: the NIC inserts the L4 checksum
+#define PKTBUF_CSUM_IP_OK    0x02   // RX: NIC verified the IPv4 header
+#define PKTBUF_CSUM_IP_BAD   0x04
+#define PKTBUF_CSUM_L4_OK    0x08   // RX: NIC verified the TCP/UDP checksum
+#define PKTBUF_CSUM_L4_BAD   0x10
+
+typedef struct {
+    uint32_t total;
+    uint32_t slabs;
+    uint32_t free;
+    uint32_t allocs;
+    uint32_t alloc_failures;
+} pktbuf_stats_t;
+
+void pktbuf_init(void);
+
+// Add a slab of count buffers, e.g. enough to fill a driver's rings.
+// Returns the number added (0 when DMA memory ran out).
+uint32_t pktbuf_grow(uint32_t count);
+
+// Buffer for building an outgoing packet: empty, data at the headroom
+pktbuf_t* pktbuf_alloc(void);
+
+// Buffer for receive DMA: data at the slot start, PKTBUF_SIZE bytes
+pktbuf_t* pktbuf_alloc_rx(void);
+
+static inline void pktbuf_get(pktbuf_t* pb) {
+    __atomic_fetch_add(&pb->refcnt, 1, __ATOMIC_RELAXED);
+}
+
+// Drop a reference; the last one returns the buffer to the pool
+void pktbuf_put(pktbuf_t* pb);
+
+static inline uint32_t pktbuf_headroom(pktbuf_t* pb) {
+    return pb->data - pb->head;
+}
+
+static inline uint32_t pktbuf_tailroom(pktbuf_t* pb) {
+    return PKTBUF_SIZE - pktbuf_headroom(pb) - pb->len;
+}
+
+// Prepend n bytes (a header); returns the new start or 0 without room
+static inline uint8_t* pktbuf_push(pktbuf_t* pb, uint32_t n) {
+    if (pktbuf_headroom(pb) < n) return 0;
+    pb->data -= n;
+    pb->len += n;
+    return pb->data;
+}
+
+// Strip n bytes from the front; returns the new start or 0 if too short
+static inline uint8_t* pktbuf_pull(pktbuf_t* pb, uint32_t n) {
+    if (pb->len < n) return 0;
+    pb->data += n;
+    pb->len -= n;
+    return pb->data;
+}
+
+// Extend the packet by n bytes; returns where they start or 0
+static inline uint8_t* pktbuf_append(pktbuf_t* pb, uint32_t n) {
+    if (pktbuf_tailroom(pb) < n) return 0;
+    uint8_t* tail = pb->data + pb->len;
+    pb->len += n;
+    return tail;
+}
+
+void pktbuf_get_stats(pktbuf_stats_t* stats);
+
+#endif // PKTBUF_H
@@ -0,0 +1,85 @@
+#ifndef RCU_H
+#define RCU_H
+
+#include <stdint.h>
+#include "smp.h"
+
+// Quiescent-state based RCU.
+//
+// Readers bracket their accesses with rcu_read_lock()/rcu_read_unlock(),
+// which only touch a per-CPU nesting counter. A CPU passes through a
+// quiescent state at every scheduler loop iteration, while halted, and
+// whenever an interrupt arrives outside a read-side section. The timer
+// tick nudges CPUs that hold up a grace period with a wakeup IPI.
+
+// Per-CPU read-side state (one cache line each)
+typedef struct {
+    volatile uint32_t nesting;     // Read-side nesting depth
+    volatile uint32_t qs_seq;      // Last grace period this CPU observed
+    volatile uint32_t idle;        // Halted: implicitly quiescent
+} __attribute__((aligned(64))) rcu_cpu_t;
+
+extern rcu_cpu_t rcu_cpu[MAX_CPUS];
+extern volatile uint32_t rcu_gp_seq;
+
+// Grace-period statistics
+typedef struct {
+    uint32_t grace_periods;
+    uint32_t nudges;          // Wakeup IPIs sent to lagging CPUs
+    uint32_t max_gp_us;       // Longest synchronize_rcu() wait
+} rcu_stats_t;
+
+// Publish and read RCU-protected pointers
+#define rcu_assign_pointer(p, v) __atomic_store_n(&(p), (v), __ATOMIC_RELEASE)
+#define rcu_dereference(p)       __atomic_load_n(&(p), __ATOMIC_ACQUIRE)
+
+static inline void rcu_read_lock(void) {
+    rcu_cpu[smp_cpu_id()].nesting++;
+    __asm__ volatile("" : : : "memory");
+}
+
+static inline void rcu_read_unlock(void) {
+    __asm__ volatile("" : : : "memory");
+    rcu_cpu[smp_cpu_id()].nesting--;
+}
+
+// Report a quiescent state for the calling CPU (no references held)
+static inline void rcu_quiescent_state(void) {
+    rcu_cpu_t* r = &rcu_cpu[smp_cpu_id()];
+    uint32_t seq = rcu_gp_seq;
+    // Only dirty the line when a grace period is actually waiting
+    if (r->qs_seq != seq) {
+        r->qs_seq = seq;
+    }
+}
+
+// Interrupt entry: quiescent unless the interrupted code is a reader
+static inline void rcu_irq_enter(void) {
+    rcu_cpu_t* r = &rcu_cpu[smp_cpu_id()];
+    uint32_t seq = rcu_gp_seq;
+    if (r->nesting == 0 && r->qs_seq != seq) {
+        r->qs_seq = seq;
+    }
+}
+
+void rcu_init(void);
+
+// Halted CPUs count as quiescent; exit fences before new reads
+void rcu_idle_enter(void);
+void rcu_idle_exit(void);
+
+// Called from the timer interrupt to push stalled grace periods along
+void rcu_tick(void);
+
+// Wait until every pre-existing reader has finished. Task context only,
+// with interrupts enabled and outside any read-side section.
+void synchronize_rcu(void);
+
+void rcu_get_stats(rcu_stats_t* stats);
+
+// Read-side benchmark: readers on CPUs [1, ncpus) while the boot CPU
+// keeps replacing the table. use_rcu = 0 takes a spinlock instead.
+// Returns reads per second; updates per second go to *updates.
+uint32_t rcu_bench(uint32_t ncpus, int use_rcu, uint32_t* updates);
+
+#endif // RCU_H
@@ -0,0 +1,72 @@
+#ifndef SCHED_H
+#define SCHED_H
+
+#include <stdint.h>
+
+// Capacity of each per-CPU deque (power of two)
+#define SCHED_DEQUE_SIZE 1024
+
+typedef void (*task_fn_t)(void* arg);
+
+// Completion counter shared by a set of spawned tasks
+typedef struct {
+    volatile uint32_t pending;
+} task_group_t;
+
+// Run-to-completion kernel task. The caller owns the storage and must
+// keep it alive until the task has run (sched_wait() guarantees this).
+typedef struct task {
+    task_fn_t fn;
+    void* arg;
+    task_group_t* group;
+    struct task* next;      // Inbox link for remote submission
+} task_t;
+
+// Per-CPU scheduler statistics
+typedef struct {
+    uint32_t tasks_run;
+    uint32_t steals;
+    uint32_t steal_failures;
+    uint32_t wakeups;
+} sched_stats_t;
+
+// Initialize the run queues (before smp_init)
+void sched_init(void);
+
+static inline void task_init(task_t* task, task_fn_t fn, void* arg) {
+    task->fn = fn;
+    task->arg = arg;
+    task->group = 0;
+    task->next = 0;
+}
+
+// Push a task onto the calling CPU's deque (task context only)
+void sched_spawn(task_group_t* group, task_t* task);
+
+// Hand a task to a specific CPU's inbox (any context, including IRQs)
+void sched_submit(uint32_t cpu, task_t* task);
+
+// Wait for every task of a group, running other tasks meanwhile
+void sched_wait(task_group_t* group);
+
+// Scheduler loop of an application processor (never returns)
+void sched_run(void);
+
+// Idle point of the boot CPU's shell loop: run queued tasks, then
+// spend up to us microseconds idle
+void sched_idle_wait(uint32_t us);
+
+// Load of a CPU in percent since the previous call for that CPU
+uint32_t sched_cpu_load(uint32_t cpu);
+
+// Limit task execution and stealing to CPUs [0, ncpus)
+void sched_set_active_cpus(uint32_t ncpus);
+
+void sched_get_stats(uint32_t cpu, sched_stats_t* stats);
+void sched_reset_stats(void);
+
+// Fork/join benchmark (recursive fib with task spawning) on ncpus CPUs.
+// Returns tasks per second; total steals are stored in *steals.
+uint32_t sched_bench_forkjoin(uint32_t ncpus, uint32_t* steals);
+
+#endif // SCHED_H
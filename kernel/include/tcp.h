@@ -0,0 +1,319 @@
+#ifndef TCP_H
+#define TCP_H
+
+#include <stdint.h>
+#include "pktbuf.h"
+#include "lock.h"
+
+// TCP (RFC 9293) with window scaling (RFC 7323), SACK (RFC 2018),
+// delayed ACKs, RFC 6298 retransmission timers and pluggable congestion
+// control. Ports and addresses are in host order.
+
+typedef struct {
+    uint16_t src_port;
+    uint16_t dest_port;
+    uint32_t seq;
+    uint32_t ack;
+    uint8_t data_off;            // Header length in 32-bit words, high nibble
+    uint8_t flags;
+    uint16_t window;
+    uint16_t checksum;
+    uint16_t urgent;
+} __attribute__((packed)) tcp_header_t;
+
+#define TCP_HLEN    20
+
+// Header flags
+#define TCP_FIN 0x01
+#define TCP_SYN 0x02
+#define TCP_RST 0x04
+#define TCP_PSH 0x08
+#define TCP_ACK 0x10
+
+// Options
+#define TCP_OPT_END       0
+#define TCP_OPT_NOP       1
+#define TCP_OPT_MSS       2
+#define TCP_OPT_WSCALE    3
+#define TCP_OPT_SACK_OK   4
+#define TCP_OPT_SACK      5
+
+#define TCP_MAX_CONNS     128
+#define TCP_HASH_SIZE     64
+#define TCP_MSS_DEFAULT   536            // Peer sent no MSS option
+#define TCP_MSS_LOCAL     1460           // Ethernet MTU - IP - TCP
+#define TCP_SACK_BLOCKS   4              // Scoreboard ranges kept per connection
+
+// Buffers per connection, in bytes. The receive window scale is the
+// smallest that lets the whole receive buffer be advertised.
+#define TCP_SNDBUF        (256 * 1024)
+#define TCP_RCVBUF        (128 * 1024)
+#define TCP_SNDQ_SLOTS    256            // Segments per send queue (power of two)
+
+// Timers (RFC 6298 bounds; milliseconds)
+#define TCP_RTO_INITIAL   1000
+#define TCP_RTO_MIN       200
+#define TCP_RTO_MAX       60000
+#define TCP_DELACK_MS     40
+#define TCP_TIME_WAIT_MS  2000           // 2 MSL, shortened for a small pool
+#define TCP_FIN_WAIT_2_MS 60000          // Closed connection waiting for the peer's FIN
+#define TCP_TICK_MS       10             // Timer resolution (timer_init(100))
+#define TCP_SYN_RETRIES   5
+#define TCP_MAX_RETRIES   12
+
+typedef enum {
+    TCP_CLOSED = 0,
+    TCP_LISTEN,
+    TCP_SYN_SENT,
+    TCP_SYN_RECEIVED,
+    TCP_ESTABLISHED,
+    TCP_FIN_WAIT_1,
+    TCP_FIN_WAIT_2,
+    TCP_CLOSE_WAIT,
+    TCP_CLOSING,
+    TCP_LAST_ACK,
+    TCP_TIME_WAIT
+} tcp_state_t;
+
+// tcp_poll() events
+#define TCP_EV_READABLE   0x01       // Data queued, or the peer closed
+#define TCP_EV_WRITABLE   0x02       // Send buffer has room
+#define TCP_EV_CONNECTED  0x04       // Handshake complete
+#define TCP_EV_ACCEPT     0x08       // Listener: a connection is ready
+#define TCP_EV_CLOSED     0x10       // Reset, timed out or fully closed
+
+typedef struct tcp_conn tcp_conn_t;
+
+// Congestion control algorithm. cwnd and ssthresh are in bytes.
+typedef struct tcp_cong_ops {
+    const char* name;
+    void (*init)(tcp_conn_t* conn);
+    // New data acknowledged outside loss recovery
+    void (*on_ack)(tcp_conn_t* conn, uint32_t acked, uint32_t rtt_us);
+    // Slow start threshold after a loss is detected
+    uint32_t (*ssthresh)(tcp_conn_t* conn);
+    // Loss recovery finished or a retransmission timeout fired
+    void (*on_recovered)(tcp_conn_t* conn);
+    void (*on_timeout)(tcp_conn_t* conn);
+} tcp_cong_ops_t;
+
+extern const tcp_cong_ops_t tcp_newreno;
+extern const tcp_cong_ops_t tcp_cubic;
+
+typedef struct {
+    uint32_t segs_out;
+    uint32_t segs_in;
+    uint32_t data_segs_out;
+    uint32_t bytes_sent;             // First transmissions
+    uint32_t bytes_acked;
+    uint32_t bytes_received;
+    uint32_t retransmits;            // Segments sent again
+    uint32_t fast_retransmits;       // Recoveries entered on dupacks/SACK
+    uint32_t timeouts;
+    uint32_t dup_acks;
+    uint32_t sack_blocks_in;
+    uint32_t ooo_segments;           // Received beyond a hole
+    uint32_t delayed_acks;           // ACKs sent by the delayed-ACK timer
+    uint32_t zero_window_probes;
+} tcp_conn_stats_t;
+
+// Snapshot for reporting
+typedef struct {
+    tcp_state_t state;
+    uint32_t local_ip, remote_ip;
+    uint16_t local_port, remote_port;
+    uint32_t mss;
+    uint32_t cwnd;
+    uint32_t ssthresh;
+    uint32_t srtt_us;
+    uint32_t rttvar_us;
+    uint32_t rto_ms;
+    uint32_t snd_wnd;
+    uint32_t rcv_wnd;
+    uint32_t in_flight;
+    uint32_t snd_queued;             // Bytes not yet acknowledged, sent or not
+    uint8_t snd_wscale, rcv_wscale, sack_ok;
+    const char* cong;
+    tcp_conn_stats_t stats;
+} tcp_info_t;
+
+typedef struct {
+    uint32_t active_opens;
+    uint32_t passive_opens;
+    uint32_t resets_in;
+    uint32_t resets_out;
+    uint32_t in_segs;
+    uint32_t in_csum_errors;
+    uint32_t in_errors;
+    uint32_t no_conn;                // Segments for no connection (answered with RST)
+    uint32_t conns_exhausted;
+    uint32_t out_segs;
+    uint32_t retransmits;
+} tcp_stats_t;
+
+// Connection control block. Fields below the lock are guarded by it;
+// the connection pool, hash and references by the table lock.
+struct tcp_conn {
+    struct tcp_conn* hash_next;
+    volatile uint32_t refcnt;        // Stack (while hashed) + owner handle
+    uint8_t in_use;                  // Pool slot taken
+    uint8_t hashed;                  // In the lookup table (holds a reference)
+    spinlock_t lock;
+    tcp_state_t state;
+    uint32_t local_ip, remote_ip;
+    uint16_t local_port, remote_port;
+
+    // Send side. The queue is a ring with one buffer per segment,
+    // unacknowledged first (cb[0] is the segment's first sequence number).
+    // It cannot chain through pb->next: the buffers themselves go down
+    // the stack, and ARP queues unresolved frames on that link.
+    uint32_t iss;
+    uint32_t snd_una;
+    uint32_t snd_nxt;
+    uint32_t snd_max;                // Highest sequence sent + 1
+    uint32_t snd_wnd;                // Peer window, already scaled
+    uint32_t snd_wl1, snd_wl2;       // Segment seq/ack of the last window update
+    uint32_t snd_end;                // Sequence after the last queued byte
+    uint16_t mss;                    // Largest segment the peer accepts
+    uint8_t snd_wscale;
+    uint8_t rcv_wscale;
+    uint8_t sack_ok;
+    uint8_t fin_queued;              // tcp_close() asked for a FIN after the data
+    uint8_t cork;                    // tcp_set_cork(): hold back a partial last segment
+    pktbuf_t* sndq[TCP_SNDQ_SLOTS];
+    uint32_t sndq_head, sndq_tail;   // Free-running indices
+    uint32_t snd_unsent;             // Index of the first segment at or after snd_nxt
+    uint32_t sndq_bytes;
+
+    // Receive side: in-order data for the reader, and segments past a
+    // hole sorted by sequence (cb[0])
+    uint32_t irs;
+    uint32_t rcv_nxt;
+    uint32_t rcv_adv;                // Right edge of the last advertised window
+    pktbuf_t* rcvq;
+    pktbuf_t* rcvq_tail;
+    uint32_t rcvq_bytes;
+    pktbuf_t* oooq;
+    uint32_t oooq_bytes;
+    uint32_t ooo_last;               // Sequence of the latest out-of-order arrival
+    uint8_t fin_received;
+    uint8_t ack_pending;             // Segments received since the last ACK
+    uint8_t quickack;                // Acknowledge the next segment at once
+
+    // SACK scoreboard of the send side: disjoint [start, end) ranges
+    uint32_t sacked[TCP_SACK_BLOCKS][2];
+    uint32_t num_sacked;
+    uint32_t sacked_bytes;
+
+    // Loss recovery (RFC 6582 NewReno, SACK-assisted)
+    uint32_t dupacks;
+    uint32_t recover;
+    uint8_t in_recovery;
+    uint32_t recovery_epoch;         // Marks segments resent in this recovery
+
+    // RTT estimation: one timed segment per window (Karn's rule)
+    uint32_t srtt_us;
+    uint32_t rttvar_us;
+    uint32_t rto_ms;
+    uint32_t rtt_seq;
+    uint64_t rtt_tsc;
+    uint8_t rtt_timing;
+    uint8_t backoff;
+    uint8_t retries;
+
+    // Timer deadlines in ticks, 0 when stopped
+    uint32_t rtx_deadline;
+    uint32_t delack_deadline;
+    uint32_t tw_deadline;
+
+    // Congestion control
+    const tcp_cong_ops_t* cong;
+    uint32_t cwnd;
+    uint32_t ssthresh;
+    uint32_t cwnd_cnt;               // Bytes acked toward the next increase
+    uint32_t cong_priv[8];           // Algorithm state
+
+    // Passive open: the listener a child belongs to, and the listener's
+    // queue of established children waiting for tcp_accept()
+    tcp_conn_t* parent;
+    tcp_conn_t* accept_next;
+    tcp_conn_t* acceptq;
+    uint32_t accept_len;
+    uint32_t backlog;
+
+    // Event notification (any context, connection lock not held)
+    void (*event_fn)(tcp_conn_t* conn, uint32_t events, void* arg);
+    void* event_arg;
+
+    uint8_t reset;                   // Connection was reset or timed out
+    tcp_conn_stats_t stats;
+};
+
+void tcp_init(void);
+
+// Active open; returns the connection in SYN_SENT (0 when the pool is
+// exhausted). Wait for TCP_EV_CONNECTED or TCP_EV_CLOSED with tcp_poll().
+tcp_conn_t* tcp_connect(uint32_t ip, uint16_t port);
+
+// Passive open on port with room for backlog completed connections
+tcp_conn_t* tcp_listen(uint16_t port, uint32_t backlog);
+
+// Next established connection of a listener, or 0
+tcp_conn_t* tcp_accept(tcp_conn_t* listener);
+
+// Copy up to len bytes into the send queue, built as MSS-sized segments
+// in packet buffers with room for the headers, and transmit what the
+// windows allow. Returns the bytes taken (0 when the buffer is full),
+// -1 once the connection can no longer send.
+int tcp_send(tcp_conn_t* conn, const void* data, uint32_t len);
+
+// Copy received data; returns the byte count, 0 if none is queued yet
+// and -1 at end of stream (FIN received and everything read) or reset
+int tcp_recv(tcp_conn_t* conn, void* buf, uint32_t len);
+
+// Zero-copy receive: the next in-order segment with pb->data at its
+// payload, or 0. The caller owns the returned reference.
+pktbuf_t* tcp_recv_pb(tcp_conn_t* conn);
+
+// While corked, a last segment shorter than the MSS waits for more data
+// instead of going out on its own, so a response header and the start
+// of its body share a segment. Uncorking sends what is held.
+void tcp_set_cork(tcp_conn_t* conn, int on);
+
+// Send a FIN once the queued data is out and give up the handle; the
+// stack finishes the close. tcp_abort() resets instead.
+void tcp_close(tcp_conn_t* conn);
+void tcp_abort(tcp_conn_t* conn);
+
+// Events currently true for the connection (TCP_EV_*)
+uint32_t tcp_poll(tcp_conn_t* conn);
+
+// Called with the events that just became true: new data, send space,
+// handshake done, connection ready to accept, closed
+void tcp_set_callback(tcp_conn_t* conn, void (*fn)(tcp_conn_t*, uint32_t, void*), void* arg);
+
+// Congestion control algorithm by name ("cubic", "newreno").
+// Per connection (before or during the transfer), or the default for
+// connections opened from now on; -1 for an unknown name
+int tcp_set_cong(tcp_conn_t* conn, const char* name);
+int tcp_set_default_cong(const char* name);
+const char* tcp_default_cong(void);
+
+// Advances retransmission, delayed-ACK and TIME-WAIT timers; called
+// from the network tick
+void tcp_tick(void);
+
+void tcp_get_info(tcp_conn_t* conn, tcp_info_t* info);
+
+// Snapshot of every connection in use; returns the count stored
+uint32_t tcp_get_conns(tcp_info_t* out, uint32_t max);
+void tcp_get_stats(tcp_stats_t* stats);
+const char* tcp_state_name(tcp_state_t state);
+
+// Sequence space comparisons (RFC 1982)
+static inline int tcp_seq_lt(uint32_t a, uint32_t b)  { return (int32_t)(a - b) < 0; }
+static inline int tcp_seq_leq(uint32_t a, uint32_t b) { return (int32_t)(a - b) <= 0; }
+static inline int tcp_seq_gt(uint32_t a, uint32_t b)  { return (int32_t)(a - b) > 0; }
+static inline int tcp_seq_geq(uint32_t a, uint32_t b) { return (int32_t)(a - b) >= 0; }
+
+#endif // TCP_H
@@ -0,0 +1,90 @@
+#ifndef UDP_H
+#define UDP_H
+
+#include <stdint.h>
+#include "pktbuf.h"
+
+// UDP (RFC 768) sockets. Ports and addresses are in host order.
+
+typedef struct {
+    uint16_t src_port;
+    uint16_t dest_port;
+    uint16_t length;
+    uint16_t checksum;
+} __attribute__((packed)) udp_header_t;
+
+#define UDP_HLEN            8
+#define UDP_HASH_SIZE       64           // Socket buckets by local port
+#define UDP_RX_RING_SIZE    128          // Datagrams queued per socket (power of two)
+#define UDP_EPHEMERAL_FIRST 49152        // IANA dynamic range
+#define UDP_EPHEMERAL_LAST  65535
+
+// Largest payload that fits one Ethernet frame without fragmentation
+#define UDP_MAX_PAYLOAD     (1500 - 20 - UDP_HLEN)
+
+typedef struct {
+    uint32_t rx_datagrams;
+    uint32_t rx_bytes;
+    uint32_t rx_ring_full;       // Dropped: the reader fell behind
+    uint32_t tx_datagrams;
+    uint32_t tx_bytes;
+    uint32_t tx_errors;
+} udp_sock_stats_t;
+
+// A socket's receive queue is a bounded ring of buffer pointers filled
+// by the NET_RX softirq and drained by the task that owns the socket.
+// Producers reserve a slot with one compare-and-swap on head (RSS can
+// deliver a socket's datagrams on several CPUs), then publish the
+// pointer; the single consumer needs no atomics beyond the loads.
+typedef struct udp_socket {
+    struct udp_socket* hash_next;
+    uint16_t local_port;
+    uint16_t remote_port;        // Connected peer, 0 when unconnected
+    uint32_t remote_ip;
+    pktbuf_t* volatile ring[UDP_RX_RING_SIZE];
+    volatile uint32_t head __attribute__((aligned(64)));   // Producers
+    volatile uint32_t tail __attribute__((aligned(64)));   // Consumer
+    udp_sock_stats_t stats;
+} udp_socket_t;
+
+typedef struct {
+    uint32_t in_datagrams;
+    uint32_t in_errors;          // Truncated or bad length
+    uint32_t in_csum_errors;
+    uint32_t no_ports;           // No socket bound, port unreachable sent
+    uint32_t out_datagrams;
+} udp_stats_t;
+
+void udp_init(void);
+
+// Bind a socket to port (0 picks an ephemeral port); 0 if the port is
+// taken or memory ran out. Task context.
+udp_socket_t* udp_open(uint16_t port);
+
+// Unbind, drop queued datagrams and free the socket once no receive
+// path can still see it. Task context.
+void udp_close(udp_socket_t* sock);
+
+// Only accept datagrams from ip:port; also the default for udp_send()
+void udp_connect(udp_socket_t* sock, uint32_t ip, uint16_t port);
+
+// Send the payload at pb->data (zero-copy; leave PKTBUF_HEADROOM free).
+// Consumes the reference; the frame is queued, net_flush() sends it.
+// Returns -1 if it was dropped.
+int udp_sendto(udp_socket_t* sock, pktbuf_t* pb, uint32_t dest_ip, uint16_t dest_port);
+
+// Copying convenience for flat data; sends to the connected peer
+int udp_send(udp_socket_t* sock, const void* data, uint32_t len);
+
+// Next queued datagram with pb->data at its payload, or 0 when the
+// queue is empty. Never blocks; the caller owns the returned reference.
+pktbuf_t* udp_recvfrom(udp_socket_t* sock, uint32_t* src_ip, uint16_t* src_port);
+
+// Datagrams waiting in the receive queue
+static inline uint32_t udp_pending(udp_socket_t* sock) {
+    return sock->head - sock->tail;
+}
+
+void udp_get_stats(udp_stats_t* stats);
+
+#endif // UDP_H
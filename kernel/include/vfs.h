@@ -8,6 +8,9 @@
 #define MAX_FILES 64
 #define MAX_FILE_SIZE 4096
 
+// Buckets of the name lookup hash (power of two)
+#define VFS_HASH_SIZE 64
+
 // File types
 typedef enum {
     FILE_TYPE_REGULAR,
@@ -15,12 +18,14 @@ typedef enum {
 } file_type_t;
 
 // File structure
-typedef struct {
+typedef struct file {
     char name[MAX_FILENAME];
     file_type_t type;
     uint32_t size;
+    uint32_t capacity;          // Bytes allocated at data (size + 1 or more)
     char* data;
     bool in_use;
+    struct file* hash_next;     // Name hash chain (RCU-protected)
 } file_t;
 
 // VFS functions
@@ -28,7 +33,15 @@ void vfs_init(void);
 file_t* vfs_create(const char* name, file_type_t type);
 file_t* vfs_open(const char* name);
 int vfs_write(file_t* file, const char* data, uint32_t size);
+// Add to the end of the file, growing it geometrically; not bound by
+// MAX_FILE_SIZE, only by the heap. Returns size, or -1 when out of memory.
+int vfs_append(file_t* file, const char* data, uint32_t size);
 int vfs_read(file_t* file, char* buffer, uint32_t size);
+// Pin the current contents for reading without the lock: they stay
+// valid and unchanged across later writes and deletion until
+// vfs_unmap(). *data is 0 for an empty file; -1 if the file is gone.
+int vfs_map(file_t* file, const char** data, uint32_t* size);
+void vfs_unmap(const char* data);
 int vfs_delete(const char* name);
 void vfs_list(void);
 int vfs_get_file_count(void);
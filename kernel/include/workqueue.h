@@ -0,0 +1,66 @@
+#ifndef WORKQUEUE_H
+#define WORKQUEUE_H
+
+#include <stdint.h>
+#include "sched.h"
+#include "lock.h"
+
+typedef void (*work_fn_t)(void* arg);
+
+struct workqueue;
+
+// Deferred work item. The owner keeps the storage alive while queued.
+typedef struct work {
+    task_t task;                    // Used by concurrent workqueues
+    work_fn_t fn;
+    void* arg;
+    struct workqueue* wq;
+    struct work* next;              // Ordered workqueue FIFO link
+    volatile uint32_t pending;      // Queued and not yet started
+} work_t;
+
+// Workqueue executing work items as scheduler tasks in process context.
+// Ordered queues run one item at a time in submission order; concurrent
+// queues hand every item to the scheduler as its own task.
+typedef struct workqueue {
+    const char* name;
+    int32_t cpu;                    // Preferred CPU, -1 for round-robin
+    int ordered;
+    task_group_t group;             // Outstanding tasks, for flushing
+    volatile uint32_t next_cpu;
+    volatile uint32_t executed;
+
+    // Ordered mode: FIFO drained by a single runner task
+    spinlock_t lock;
+    work_t* head;
+    work_t* tail;
+    volatile uint32_t scheduled;
+    task_t runner;
+} workqueue_t;
+
+// Shared queues: system_wq runs concurrently on the application
+// processors, console_wq is ordered and prefers the boot CPU
+extern workqueue_t system_wq;
+extern workqueue_t console_wq;
+
+void workqueue_init(void);
+
+void workqueue_create(workqueue_t* wq, const char* name, int32_t cpu, int ordered);
+
+static inline void init_work(work_t* work, work_fn_t fn, void* arg) {
+    task_init(&work->task, 0, 0);
+    work->fn = fn;
+    work->arg = arg;
+    work->wq = 0;
+    work->next = 0;
+    work->pending = 0;
+}
+
+// Queue work (any context, including hard and soft IRQs). Returns 0 if
+// the item was already pending.
+int queue_work(workqueue_t* wq, work_t* work);
+
+// Wait until everything queued so far has run (task context only)
+void flush_workqueue(workqueue_t* wq);
+
+#endif // WORKQUEUE_H
@@ -0,0 +1,148 @@
+#include "ioapic.h"
+#include "acpi.h"
+#include "lock.h"
+#include "serial.h"
+#include "string.h"
+#include <stddef.h>
+
+typedef struct {
+    volatile uint32_t* base;
+    uint32_t gsi_base;
+    uint32_t gsi_count;
+} ioapic_t;
+
+static ioapic_t ioapics[ACPI_MAX_IOAPICS];
+static uint32_t num_ioapics = 0;
+
+// IOREGSEL/IOWIN is a two-step access, so it must not interleave
+static spinlock_t ioapic_lock;
+
+static uint32_t ioapic_read(ioapic_t* io, uint8_t reg) {
+    io->base[IOAPIC_REG_SELECT / 4] = reg;
+    return io->base[IOAPIC_REG_WINDOW / 4];
+}
+
+static void ioapic_write(ioapic_t* io, uint8_t reg, uint32_t value) {
+    io->base[IOAPIC_REG_SELECT / 4] = reg;
+    io->base[IOAPIC_REG_WINDOW / 4] = value;
+}
+
+// Find the I/O APIC serving a GSI; *pin receives the input number
+static ioapic_t* ioapic_for_gsi(uint32_t gsi, uint32_t* pin) {
+    for (uint32_t i = 0; i < num_ioapics; i++) {
+        ioapic_t* io = &ioapics[i];
+        if (gsi >= io->gsi_base && gsi < io->gsi_base + io->gsi_count) {
+            *pin = gsi - io->gsi_base;
+            return io;
+        }
+    }
+    return NULL;
+}
+
+int ioapic_init(void) {
+    serial_write("IOAPIC: Initializing...\n");
+
+    const acpi_madt_info_t* madt = acpi_get_madt();
+    if (!madt || madt->num_ioapics == 0) {
+        serial_write("IOAPIC: None found\n");
+        return -1;
+    }
+
+    spin_lock_init(&ioapic_lock, "ioapic");
+
+    for (uint32_t i = 0; i < madt->num_ioapics && i < ACPI_MAX_IOAPICS; i++) {
+        ioapic_t* io = &ioapics[num_ioapics];
+        io->base = (volatile uint32_t*)madt->ioapics[i].address;
+        io->gsi_base = madt->ioapics[i].gsi_base;
+
+        // Bits 16-23 of the version register hold the last entry index
+        io->gsi_count = ((ioapic_read(io, IOAPIC_VERSION) >> 16) & 0xFF) + 1;
+
+        // Start with every input masked
+        for (uint32_t pin = 0; pin < io->gsi_count; pin++) {
+            ioapic_write(io, IOAPIC_REDIR_BASE + pin * 2, IOAPIC_REDIR_MASKED);
+            ioapic_write(io, IOAPIC_REDIR_BASE + pin * 2 + 1, 0);
+        }
+
+        char buf[64];
+        sprintf(buf, "IOAPIC: id %u, GSI %u-%u\n", madt->ioapics[i].id,
+                io->gsi_base, io->gsi_base + io->gsi_count - 1);
+        serial_write(buf);
+        num_ioapics++;
+    }
+
+    serial_write("IOAPIC: Initialized successfully\n");
+    return 0;
+}
+
+int ioapic_available(void) {
+    return num_ioapics > 0;
+}
+
+uint32_t ioapic_isa_to_gsi(uint8_t irq, uint32_t* redir_flags) {
+    const acpi_madt_info_t* madt = acpi_get_madt();
+
+    // ISA default: identity mapped, edge triggered, active high
+    uint32_t gsi = irq;
+    uint32_t flags = 0;
+
+    for (uint32_t i = 0; madt && i < madt->num_overrides; i++) {
+        const acpi_override_info_t* ov = &madt->overrides[i];
+        if (ov->source != irq) continue;
+
+        gsi = ov->gsi;
+        if ((ov->flags & ACPI_INTI_POLARITY_MASK) == ACPI_INTI_ACTIVE_LOW) {
+            flags |= IOAPIC_REDIR_ACTIVE_LOW;
+        }
+        if ((ov->flags & ACPI_INTI_TRIGGER_MASK) == ACPI_INTI_LEVEL) {
+            flags |= IOAPIC_REDIR_LEVEL;
+        }
+        break;
+    }
+
+    if (redir_flags) *redir_flags = flags;
+    return gsi;
+}
+
+void ioapic_route(uint32_t gsi, uint8_t vector, uint8_t apic_id, uint32_t redir_flags) {
+    uint32_t pin;
+    ioapic_t* io = ioapic_for_gsi(gsi, &pin);
+    if (!io) return;
+
+    // Fixed delivery, physical destination, masked until irq_unmask()
+    uint32_t flags = spin_lock_irqsave(&ioapic_lock);
+    ioapic_write(io, IOAPIC_REDIR_BASE + pin * 2, IOAPIC_REDIR_MASKED);
+    ioapic_write(io, IOAPIC_REDIR_BASE + pin * 2 + 1, (uint32_t)apic_id << 24);
+    ioapic_write(io, IOAPIC_REDIR_BASE + pin * 2,
+                 IOAPIC_REDIR_MASKED | redir_flags | vector);
+    spin_unlock_irqrestore(&ioapic_lock, flags);
+}
+
+static void ioapic_update(uint32_t gsi, uint32_t clear, uint32_t set) {
+    uint32_t pin;
+    ioapic_t* io = ioapic_for_gsi(gsi, &pin);
+    if (!io) return;
+
+    uint32_t flags = spin_lock_irqsave(&ioapic_lock);
+    uint32_t low = ioapic_read(io, IOAPIC_REDIR_BASE + pin * 2);
+    ioapic_write(io, IOAPIC_REDIR_BASE + pin * 2, (low & ~clear) | set);
+    spin_unlock_irqrestore(&ioapic_lock, flags);
+}
+
+void ioapic_mask(uint32_t gsi) {
+    ioapic_update(gsi, 0, IOAPIC_REDIR_MASKED);
+}
+
+void ioapic_unmask(uint32_t gsi) {
+    ioapic_update(gsi, IOAPIC_REDIR_MASKED, 0);
+}
+
+void ioapic_set_dest(uint32_t gsi, uint8_t apic_id) {
+    uint32_t pin;
+    ioapic_t* io = ioapic_for_gsi(gsi, &pin);
+    if (!io) return;
+
+    uint32_t flags = spin_lock_irqsave(&ioapic_lock);
+    ioapic_write(io, IOAPIC_REDIR_BASE + pin * 2 + 1, (uint32_t)apic_id << 24);
+    spin_unlock_irqrestore(&ioapic_lock, flags);
+}
@@ -0,0 +1,289 @@
+#include "ip.h"
+#include "arp.h"
+#include "icmp.h"
+#include "heap.h"
+#include "lock.h"
+#include "rcu.h"
+#include "string.h"
+#include "serial.h"
+#include <stddef.h>
+
+// Route table, most specific prefix first so the first match wins.
+// Readers use it under RCU; updates copy it and swap the pointer.
+typedef struct {
+    uint32_t count;
+    ip_route_t routes[IP_MAX_ROUTES];
+} ip_route_table_t;
+
+static ip_route_table_t* route_table = NULL;
+
+// Serializes route table updates
+static ticket_lock_t route_lock;
+
+// Receive demultiplexing, indexed by the protocol field
+static ip_proto_handler_t handlers[256];
+
+// Interface addresses the receive path accepts
+static volatile uint32_t local_ip = 0;
+static volatile uint32_t local_bcast = IP_BROADCAST;
+
+static ip_stats_t stats;
+static volatile uint32_t next_id = 1;
+
+static inline uint32_t prefix_len(uint32_t netmask) {
+    return netmask ? 32 - __builtin_ctz(netmask) : 0;
+}
+
+uint32_t ip_local_address(void) {
+    return local_ip;
+}
+
+void ip_register_protocol(uint8_t protocol, ip_proto_handler_t handler) {
+    handlers[protocol] = handler;
+}
+
+int ip_route_lookup(uint32_t dest, uint32_t* next_hop) {
+    int found = -1;
+    rcu_read_lock();
+    ip_route_table_t* table = rcu_dereference(route_table);
+    if (table) {
+        for (uint32_t i = 0; i < table->count; i++) {
+            ip_route_t* r = &table->routes[i];
+            if ((dest & r->netmask) == r->dest) {
+                *next_hop = (r->flags & IP_ROUTE_GATEWAY) ? r->gateway : dest;
+                found = 0;
+                break;
+            }
+        }
+    }
+    rcu_read_unlock();
+    return found;
+}
+
+// Publish a modified copy of the table and free the old one once no
+// reader can still be walking it. Called with route_lock held; drops it.
+static void route_publish(ip_route_table_t* table) {
+    ip_route_table_t* old = route_table;
+    rcu_assign_pointer(route_table, table);
+    ticket_unlock(&route_lock);
+
+    if (old) {
+        synchronize_rcu();
+        kfree(old);
+    }
+}
+
+static ip_route_table_t* route_copy(void) {
+    ip_route_table_t* table = (ip_route_table_t*)kmalloc(sizeof(ip_route_table_t));
+    if (!table) return NULL;
+    if (route_table) memcpy(table, route_table, sizeof(*table));
+    else table->count = 0;
+    return table;
+}
+
+static int route_remove(ip_route_table_t* table, uint32_t dest, uint32_t netmask) {
+    for (uint32_t i = 0; i < table->count; i++) {
+        if (table->routes[i].dest == dest && table->routes[i].netmask == netmask) {
+            for (uint32_t j = i + 1; j < table->count; j++) {
+                table->routes[j - 1] = table->routes[j];
+            }
+            table->count--;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// Insert keeping longer prefixes in front; replaces an equal prefix
+static int route_insert(ip_route_table_t* table, uint32_t dest, uint32_t netmask,
+                        uint32_t gateway, uint32_t flags) {
+    route_remove(table, dest & netmask, netmask);
+    if (table->count >= IP_MAX_ROUTES) return -1;
+
+    uint32_t len = prefix_len(netmask);
+    uint32_t pos = 0;
+    while (pos < table->count && prefix_len(table->routes[pos].netmask) >= len) pos++;
+    for (uint32_t j = table->count; j > pos; j--) {
+        table->routes[j] = table->routes[j - 1];
+    }
+
+    ip_route_t* r = &table->routes[pos];
+    r->dest = dest & netmask;
+    r->netmask = netmask;
+    r->gateway = gateway;
+    r->flags = flags | (gateway ? IP_ROUTE_GATEWAY : 0);
+    table->count++;
+    return 0;
+}
+
+int ip_route_add(uint32_t dest, uint32_t netmask, uint32_t gateway) {
+    // Masks must be contiguous for the prefix ordering to hold
+    if (netmask & (~netmask >> 1)) return -1;
+
+    ticket_lock(&route_lock);
+    ip_route_table_t* table = route_copy();
+    if (!table || route_insert(table, dest, netmask, gateway, 0) < 0) {
+        ticket_unlock(&route_lock);
+        if (table) kfree(table);
+        return -1;
+    }
+    route_publish(table);
+    return 0;
+}
+
+int ip_route_del(uint32_t dest, uint32_t netmask) {
+    ticket_lock(&route_lock);
+    ip_route_table_t* table = route_copy();
+    if (!table || route_remove(table, dest & netmask, netmask) < 0) {
+        ticket_unlock(&route_lock);
+        if (table) kfree(table);
+        return -1;
+    }
+    route_publish(table);
+    return 0;
+}
+
+void ip_update_interface(void) {
+    net_interface_t nif;
+    net_get_interface(&nif);
+
+    ticket_lock(&route_lock);
+    ip_route_table_t* table = route_copy();
+    if (!table) {
+        ticket_unlock(&route_lock);
+        return;
+    }
+
+    // Drop the routes of the previous address, keep the user's
+    for (uint32_t i = 0; i < table->count;) {
+        if (table->routes[i].flags & IP_ROUTE_IFACE) {
+            route_remove(table, table->routes[i].dest, table->routes[i].netmask);
+        } else {
+            i++;
+        }
+    }
+    if (nif.ip) {
+        route_insert(table, nif.ip, nif.netmask, 0, IP_ROUTE_IFACE);
+        if (nif.gateway) route_insert(table, 0, 0, nif.gateway, IP_ROUTE_IFACE);
+    }
+
+    local_ip = nif.ip;
+    local_bcast = nif.ip ? (nif.ip | ~nif.netmask) : IP_BROADCAST;
+    route_publish(table);
+}
+
+uint32_t ip_get_routes(ip_route_t* out, uint32_t max) {
+    uint32_t n = 0;
+    rcu_read_lock();
+    ip_route_table_t* table = rcu_dereference(route_table);
+    if (table) {
+        for (; n < table->count && n < max; n++) out[n] = table->routes[n];
+    }
+    rcu_read_unlock();
+    return n;
+}
+
+void ip_get_stats(ip_stats_t* out) {
+    *out = stats;
+}
+
+static inline void count_proto(uint8_t protocol, uint32_t* icmp, uint32_t* udp, uint32_t* tcp) {
+    if (protocol == IP_PROTO_TCP) (*tcp)++;
+    else if (protocol == IP_PROTO_UDP) (*udp)++;
+    else if (protocol == IP_PROTO_ICMP) (*icmp)++;
+}
+
+int ip_output(pktbuf_t* pb, uint32_t dest_ip, uint8_t protocol) {
+    stats.out_requests++;
+    count_proto(protocol, &stats.out_icmp, &stats.out_udp, &stats.out_tcp);
+
+    uint32_t next_hop = dest_ip;
+    if (dest_ip != IP_BROADCAST && ip_route_lookup(dest_ip, &next_hop) < 0) {
+        stats.out_no_routes++;
+        pktbuf_put(pb);
+        return -1;
+    }
+
+    uint32_t total = pb->len + IP_HLEN;
+    ip_header_t* ip = (ip_header_t*)pktbuf_push(pb, IP_HLEN);
+    if (!ip) {
+        stats.out_discards++;
+        pktbuf_put(pb);
+        return -1;
+    }
+    ip->version_ihl = IP_VERSION_IHL;
+    ip->tos = 0;
+    ip->total_length = htons(total);
+    ip->id = htons((uint16_t)__atomic_fetch_add(&next_id, 1, __ATOMIC_RELAXED));
+    ip->flags_fragment = htons(IP_FLAG_DF);
+    ip->ttl = IP_DEFAULT_TTL;
+    ip->protocol = protocol;
+    ip->src_ip = htonl(local_ip);
+    ip->dest_ip = htonl(dest_ip);
+    ip->checksum = 0;
+    ip->checksum = net_checksum(ip, IP_HLEN);
+
+    if (arp_output(pb, next_hop) < 0) {
+        stats.out_discards++;
+        return -1;
+    }
+    return 0;
+}
+
+// Receive fast path: one combined test admits the common packet (plain
+// 20-byte header, unfragmented, addressed to us) and it is handed up in
+// place, with only data and len adjusted
+static void ip_rx(pktbuf_t* pb) {
+    stats.in_receives++;
+
+    if (pb->len < ETH_HLEN + IP_HLEN) {
+        stats.in_hdr_errors++;
+        return;
+    }
+    ip_header_t* ip = (ip_header_t*)(pb->data + ETH_HLEN);
+    uint32_t avail = pb->len - ETH_HLEN;
+    uint32_t hlen = (ip->version_ihl & 0x0F) * 4;
+    uint32_t total = ntohs(ip->total_length);
+
+    if ((ip->version_ihl >> 4) != 4 || hlen < IP_HLEN || total < hlen || total > avail) {
+        stats.in_hdr_errors++;
+        return;
+    }
+    if (!net_rx_csum_ok(pb, NET_CSUM_IP, ip, hlen, 0)) {
+        stats.in_csum_errors++;
+        return;
+    }
+    if (ntohs(ip->flags_fragment) & (IP_FLAG_MF | IP_FRAG_OFFSET)) {
+        stats.in_frag_drops++;
+        return;
+    }
+
+    // Accept anything while unconfigured (DHCP offers to the new address)
+    uint32_t dest = ntohl(ip->dest_ip);
+    if (dest != local_ip && dest != IP_BROADCAST && dest != local_bcast && local_ip != 0) {
+        stats.in_addr_errors++;
+        return;
+    }
+
+    // Strip Ethernet padding and the headers
+    pb->len = ETH_HLEN + total;
+    pktbuf_pull(pb, ETH_HLEN + hlen);
+
+    ip_proto_handler_t handler = handlers[ip->protocol];
+    if (!handler) {
+        stats.in_unknown_protos++;
+        icmp_send_error(pb, ip, ICMP_DEST_UNREACH, ICMP_PROTO_UNREACH);
+        return;
+    }
+    count_proto(ip->protocol, &stats.in_icmp, &stats.in_udp, &stats.in_tcp);
+    stats.in_delivers++;
+    handler(pb, ip);
+}
+
+void ip_init(void) {
+    serial_write("IP: Initializing...\n");
+    ticket_lock_init(&route_lock, "route");
+    net_register_protocol(ETH_TYPE_IPV4, ip_rx);
+    ip_update_interface();
+    serial_write("IP: Initialized successfully\n");
+}
@@ -1,5 +1,13 @@
 #include "irq.h"
 #include "serial.h"
+#include "apic.h"
+#include "ioapic.h"
+#include "lock.h"
+#include "rcu.h"
+#include "smp.h"
+#include "softirq.h"
+#include "timer.h"
+#include "string.h"
 #include <stddef.h>
 
 // Registers structure
@@ -42,6 +50,38 @@ extern void irq13();
 extern void irq14();
 extern void irq15();
 
+// Local APIC vectors from assembly
+extern void apic_vector240();
+extern void apic_spurious();
+
+// Stubs for the device vectors IRQ_VECTOR_BASE..IRQ_VECTOR_LAST
+extern uint32_t irq_vector_stubs[];
+
+// Per-CPU hard-IRQ accounting. Aligned so CPUs never share a line.
+typedef struct {
+    irq_stats_t stats;
+} __attribute__((aligned(64))) irq_cpu_t;
+
+static irq_cpu_t irq_cpu[MAX_CPUS];
+
+// Current interrupt controller (IRQ_MODE_PIC or IRQ_MODE_APIC)
+static volatile int irq_mode = IRQ_MODE_PIC;
+
+// ISA lines drivers have unmasked, and the CPU each one is routed to
+static uint16_t irq_enabled = 0;
+static uint8_t irq_cpu_dest[ISA_IRQ_COUNT];
+
+// ISA lines the MADT overrides make level triggered (PCI INTx on 9-11)
+static volatile uint16_t irq_level = 0;
+
+// Entry-to-handler latency of the timer IRQ, per controller mode
+static irq_latency_t irq_latency[2];
+
+// Device vector allocation bitmap
+#define IRQ_NUM_VECTORS (IRQ_VECTOR_LAST - IRQ_VECTOR_BASE + 1)
+static uint32_t vector_used[(IRQ_NUM_VECTORS + 31) / 32];
+static spinlock_t vector_lock;
+
 static inline void outb(uint16_t port, uint8_t val) {
     __asm__ volatile ("outb %0, %1" : : "a"(val), "Nd"(port));
 }
@@ -68,9 +108,33 @@ static void pic_remap(void) {
     outb(PIC1_DATA, 0x01);
     outb(PIC2_DATA, 0x01);
 
-    // Restore masks (enable all IRQs)
-    outb(PIC1_DATA, 0x00);
-    outb(PIC2_DATA, 0x00);
+    // Mask everything except the cascade; drivers use irq_unmask()
+    outb(PIC1_DATA, 0xFB);
+    outb(PIC2_DATA, 0xFF);
+}
+
+static inline uint8_t inb(uint16_t port) {
+    uint8_t ret;
+    __asm__ volatile ("inb %1, %0" : "=a"(ret) : "Nd"(port));
+    return ret;
+}
+
+static void pic_set_mask(int irq, int masked) {
+    uint16_t port = irq < 8 ? PIC1_DATA : PIC2_DATA;
+    uint8_t bit = 1 << (irq & 7);
+    uint8_t mask = inb(port);
+    outb(port, masked ? (mask | bit) : (mask & ~bit));
+}
+
+// Program the I/O APIC entry of an ISA IRQ for its current target CPU
+static void ioapic_route_isa(int irq) {
+    uint32_t redir_flags;
+    uint32_t gsi = ioapic_isa_to_gsi(irq, &redir_flags);
+    uint32_t cpu = irq_cpu_dest[irq];
+    uint8_t apic_id = cpu == 0 ? lapic_id() : cpus[cpu].apic_id;
+    if (redir_flags & IOAPIC_REDIR_LEVEL) irq_level |= (uint16_t)(1 << irq);
+    else irq_level &= (uint16_t)~(1 << irq);
+    ioapic_route(gsi, IRQ0 + irq, apic_id, redir_flags);
 }
 
 void irq_init(void) {
@@ -97,31 +161,223 @@ void irq_init(void) {
     idt_set_gate(46, (uint32_t)irq14, 0x08, 0x8E);
     idt_set_gate(47, (uint32_t)irq15, 0x08, 0x8E);
 
+    // Device vectors for MSI/MSI-X
+    for (int v = IRQ_VECTOR_BASE; v <= IRQ_VECTOR_LAST; v++) {
+        idt_set_gate(v, irq_vector_stubs[v - IRQ_VECTOR_BASE], 0x08, 0x8E);
+    }
+    spin_lock_init(&vector_lock, "irq_vector");
+
+    // Local APIC vectors (IPIs and spurious)
+    idt_set_gate(IPI_VECTOR_WAKEUP, (uint32_t)apic_vector240, 0x08, 0x8E);
+    idt_set_gate(LAPIC_SPURIOUS_VECTOR, (uint32_t)apic_spurious, 0x08, 0x8E);
+
     // Enable interrupts
     __asm__ volatile("sti");
 
     serial_write("IRQ: Initialized successfully\n");
 }
 
+int irq_alloc_vector(void) {
+    int vector = -1;
+    uint32_t flags = spin_lock_irqsave(&vector_lock);
+    for (int i = 0; i < IRQ_NUM_VECTORS; i++) {
+        if (!(vector_used[i / 32] & (1u << (i % 32)))) {
+            vector_used[i / 32] |= 1u << (i % 32);
+            vector = IRQ_VECTOR_BASE + i;
+            break;
+        }
+    }
+    spin_unlock_irqrestore(&vector_lock, flags);
+    return vector;
+}
+
+void irq_free_vector(int vector) {
+    if (vector < IRQ_VECTOR_BASE || vector > IRQ_VECTOR_LAST) return;
+    int i = vector - IRQ_VECTOR_BASE;
+    uint32_t flags = spin_lock_irqsave(&vector_lock);
+    vector_used[i / 32] &= ~(1u << (i % 32));
+    spin_unlock_irqrestore(&vector_lock, flags);
+}
+
+void irq_install_vector(int vector, isr_t handler) {
+    if (vector < IRQ_VECTOR_BASE || vector > IRQ_VECTOR_LAST) return;
+    register_interrupt_handler(vector, handler);
+}
+
+// Once this returns, no CPU is still running the old handler
+void irq_uninstall_vector(int vector) {
+    if (vector < IRQ_VECTOR_BASE || vector > IRQ_VECTOR_LAST) return;
+    register_interrupt_handler(vector, NULL);
+    synchronize_rcu();
+}
+
+void irq_unmask(int irq) {
+    if (irq < 0 || irq >= ISA_IRQ_COUNT) return;
+
+    uint32_t flags = irq_save();
+    irq_enabled |= 1 << irq;
+    if (irq_mode == IRQ_MODE_APIC) {
+        ioapic_unmask(ioapic_isa_to_gsi(irq, NULL));
+    } else {
+        pic_set_mask(irq, 0);
+    }
+    irq_restore(flags);
+}
+
+void irq_mask(int irq) {
+    if (irq < 0 || irq >= ISA_IRQ_COUNT) return;
+
+    uint32_t flags = irq_save();
+    irq_enabled &= ~(1 << irq);
+    if (irq_mode == IRQ_MODE_APIC) {
+        ioapic_mask(ioapic_isa_to_gsi(irq, NULL));
+    } else if (irq != 2) {
+        pic_set_mask(irq, 1);
+    }
+    irq_restore(flags);
+}
+
+int irq_set_affinity(int irq, uint32_t cpu) {
+    if (irq < 0 || irq >= ISA_IRQ_COUNT) return -1;
+    if (cpu >= smp_num_cpus() || !cpus[cpu].online) return -1;
+
+    // The 8259 can only interrupt the boot CPU
+    irq_cpu_dest[irq] = cpu;
+    if (irq_mode == IRQ_MODE_APIC) {
+        uint8_t apic_id = cpu == 0 ? lapic_id() : cpus[cpu].apic_id;
+        ioapic_set_dest(ioapic_isa_to_gsi(irq, NULL), apic_id);
+    }
+    return 0;
+}
+
+int irq_get_mode(void) {
+    return irq_mode;
+}
+
+int irq_set_mode(int mode) {
+    if (mode == irq_mode) return 0;
+
+    if (mode == IRQ_MODE_APIC) {
+        if (!ioapic_available() && ioapic_init() < 0) return -1;
+        if (!lapic_available()) lapic_init();
+    }
+
+    uint32_t flags = irq_save();
+
+    if (mode == IRQ_MODE_APIC) {
+        // Silence the 8259s, then route every ISA line through the I/O APIC
+        outb(PIC1_DATA, 0xFF);
+        outb(PIC2_DATA, 0xFF);
+        for (int irq = 0; irq < ISA_IRQ_COUNT; irq++) {
+            if (irq == 2) continue;  // Cascade, not a real source
+            ioapic_route_isa(irq);
+            if (irq_enabled & (1 << irq)) {
+                ioapic_unmask(ioapic_isa_to_gsi(irq, NULL));
+            }
+        }
+        irq_mode = IRQ_MODE_APIC;
+        serial_write("IRQ: Routing through I/O APIC\n");
+    } else {
+        for (int irq = 0; irq < ISA_IRQ_COUNT; irq++) {
+            if (irq == 2) continue;
+            ioapic_mask(ioapic_isa_to_gsi(irq, NULL));
+        }
+        outb(PIC1_DATA, ~(irq_enabled & 0xFF) & 0xFB);
+        outb(PIC2_DATA, ~(irq_enabled >> 8) & 0xFF);
+        irq_mode = IRQ_MODE_PIC;
+        serial_write("IRQ: Routing through 8259 PIC\n");
+    }
+
+    irq_restore(flags);
+    return 0;
+}
+
+void irq_get_latency(int mode, irq_latency_t* latency) {
+    if (mode != IRQ_MODE_PIC && mode != IRQ_MODE_APIC) return;
+    *latency = irq_latency[mode];
+}
+
+void irq_reset_latency(void) {
+    memset(irq_latency, 0, sizeof(irq_latency));
+}
+
 void irq_install_handler(int irq, isr_t handler) {
     register_interrupt_handler(IRQ0 + irq, handler);
 }
 
+// Once this returns, no CPU is still running the old handler
 void irq_uninstall_handler(int irq) {
     register_interrupt_handler(IRQ0 + irq, NULL);
+    synchronize_rcu();
 }
 
 // IRQ handler called from assembly
 void irq_handler(struct registers* regs) {
-    // Send EOI to PICs
-    if (regs->int_no >= 40) {
-        outb(PIC2_COMMAND, PIC_EOI);  // Send to slave
+    uint64_t entry = rdtsc();
+
+    // The interrupted code is quiescent unless it was inside a reader
+    rcu_irq_enter();
+
+    int mode = irq_mode;
+
+    // A level-triggered I/O APIC line is still asserted until the handler
+    // quiets the device; an EOI before that clears Remote-IRR and the
+    // line is delivered a second time. Those wait for the handler, MSI
+    // and edge vectors are acknowledged right away.
+    int late_eoi = mode == IRQ_MODE_APIC && regs->int_no >= IRQ0 &&
+                   regs->int_no < IRQ0 + ISA_IRQ_COUNT && (irq_level & (1 << (regs->int_no - IRQ0)));
+    if (late_eoi) {
+        // Acknowledged once the handler returns
+    } else if (regs->int_no >= IRQ_VECTOR_BASE || mode == IRQ_MODE_APIC) {
+        // Local APIC, MSI and I/O APIC vectors: one memory-mapped write
+        lapic_eoi();
+    } else {
+        // Send EOI to PICs
+        if (regs->int_no >= 40) {
+            outb(PIC2_COMMAND, PIC_EOI);  // Send to slave
+        }
+        outb(PIC1_COMMAND, PIC_EOI);      // Send to master
     }
-    outb(PIC1_COMMAND, PIC_EOI);      // Send to master
 
     // Call registered handler
-    if (interrupt_handlers[regs->int_no] != NULL) {
-        isr_t handler = interrupt_handlers[regs->int_no];
+    rcu_read_lock();
+    isr_t handler = rcu_dereference(interrupt_handlers[regs->int_no]);
+    if (regs->int_no == IRQ0) {
+        irq_latency_t* lat = &irq_latency[mode];
+        uint64_t cycles = rdtsc() - entry;
+        lat->samples++;
+        lat->total_cycles += cycles;
+        if (cycles > lat->max_cycles) {
+            lat->max_cycles = cycles;
+        }
+    }
+    if (handler != NULL) {
         handler(regs);
     }
+    rcu_read_unlock();
+    if (late_eoi) lapic_eoi();
+
+    // Time spent with interrupts off in the hard-IRQ path
+    irq_stats_t* st = &irq_cpu[smp_cpu_id()].stats;
+    uint64_t cycles = rdtsc() - entry;
+    st->irqs++;
+    st->hard_cycles += cycles;
+    if (cycles > st->max_hard_cycles) {
+        st->max_hard_cycles = cycles;
+        st->max_vector = regs->int_no;
+    }
+
+    // Deferred work runs next, with interrupts enabled
+    do_softirq();
+}
+
+void irq_get_stats(uint32_t cpu, irq_stats_t* stats) {
+    if (cpu >= MAX_CPUS) return;
+    *stats = irq_cpu[cpu].stats;
+}
+
+void irq_reset_stats(void) {
+    for (int c = 0; c < MAX_CPUS; c++) {
+        memset(&irq_cpu[c].stats, 0, sizeof(irq_stats_t));
+    }
 }
@@ -11,9 +11,57 @@
 #include "heap.h"
 #include "vfs.h"
 #include "net.h"
+#include "e1000e.h"
+#include "arp.h"
+#include "ip.h"
+#include "icmp.h"
+#include "udp.h"
+#include "tcp.h"
+#include "http.h"
+#include "httpd.h"
+#include "dhcp.h"
+#include "dns.h"
+#include "pci.h"
+#include "pktbuf.h"
+#include "acpi.h"
+#include "smp.h"
+#include "sched.h"
+#include "lock.h"
+#include "rcu.h"
+#include "softirq.h"
+#include "workqueue.h"
+#include "div64.h"
+#include "string.h"
 #include <stdint.h>
 #include <stdbool.h>
 
+// wget: streams a response body into a file, created on the first byte
+// of a successful response so errors don't clobber an existing one
+typedef struct {
+    const char* name;
+    file_t* file;
+    http_response_t* resp;
+    uint32_t stored;
+    uint8_t truncated;           // The heap ran out; the rest was dropped
+} wget_out_t;
+
+static int wget_sink(const uint8_t* data, uint32_t len, void* arg) {
+    wget_out_t* out = (wget_out_t*)arg;
+    if (out->resp->status < 200 || out->resp->status > 299) return 0;
+    if (!out->file) {
+        out->file = vfs_open(out->name);
+        if (!out->file) out->file = vfs_create(out->name, FILE_TYPE_REGULAR);
+        if (!out->file) return -1;
+        vfs_write(out->file, "", 0);
+    }
+    // Keep reading after running out of memory so the connection stays usable
+    if (!out->truncated && len) {
+        if (vfs_append(out->file, (const char*)data, len) < 0) out->truncated = 1;
+        else out->stored += len;
+    }
+    return 0;
+}
+
 void kernel_main(uint32_t magic, void* multiboot_info) {
 
     // Initialize serial for debugging
@@ -40,6 +88,13 @@ void kernel_main(uint32_t magic, void* multiboot_info) {
     irq_init();
     serial_write("NiceTop OS: IRQ initialized\n");
 
+    // Initialize deferred work (softirqs, tasks, workqueues)
+    serial_write("NiceTop OS: Initializing deferred work...\n");
+    softirq_init();
+    sched_init();
+    workqueue_init();
+    serial_write("NiceTop OS: Deferred work initialized\n");
+
     // Initialize Timer (100 Hz)
     serial_write("NiceTop OS: Initializing Timer...\n");
     timer_init(100);
@@ -60,14 +115,31 @@ void kernel_main(uint32_t magic, void* multiboot_info) {
     vfs_init();
     serial_write("NiceTop OS: VFS initialized\n");
 
-    // Network will be initialized on first use
-    serial_write("NiceTop OS: Network ready (lazy init)\n");
+    // Packet buffers for the network stack
+    pktbuf_init();
 
     // Parse Multiboot2 info for framebuffer
     serial_write("NiceTop OS: Parsing Multiboot2 info...\n");
     multiboot2_parse(magic, multiboot_info);
     serial_write("NiceTop OS: Multiboot2 parsed\n");
 
+    // Calibrate the TSC for microsecond delays and benchmarks
+    timer_calibrate_tsc();
+
+    // Bring up the application processors
+    serial_write("NiceTop OS: Initializing SMP...\n");
+    acpi_init();
+    irq_set_mode(IRQ_MODE_APIC);
+    pci_init();
+    rcu_init();
+    smp_init();
+    serial_write("NiceTop OS: SMP initialized\n");
+
+    // Bring up the network; DHCP leases an address in the background
+    serial_write("NiceTop OS: Initializing Network...\n");
+    if (net_init() == 0) serial_write("NiceTop OS: Network initialized\n");
+    else serial_write("NiceTop OS: No network device\n");
+
     // Check if framebuffer is available
     framebuffer_info_t* fb = framebuffer_get_info();
     if (!fb || fb->width == 0) {
@@ -149,11 +221,47 @@ void kernel_main(uint32_t magic, void* multiboot_info) {
                         line_y += 20;
                         fb_draw_string(20, line_y, "  edit   - Text editor", RGB(200, 200, 200), RGB(10, 10, 35));
                         line_y += 20;
-                        fb_draw_string(20, line_y, "  ping   - Ping host", RGB(200, 200, 200), RGB(10, 10, 35));
+                        fb_draw_string(20, line_y, "  ping   - Ping host (ping [-c N] [-i SEC] A.B.C.D)", RGB(200, 200, 200), RGB(10, 10, 35));
                         line_y += 20;
                         fb_draw_string(20, line_y, "  ifconfig - Network config", RGB(200, 200, 200), RGB(10, 10, 35));
                         line_y += 20;
-                        fb_draw_string(20, line_y, "  wget   - Download file", RGB(200, 200, 200), RGB(10, 10, 35));
+                        fb_draw_string(20, line_y, "  wget   - HTTP/1.1 download: wget URL [URL...] (host: make http-serve)", RGB(200, 200, 200), RGB(10, 10, 35));
+                        line_y += 20;
+                        fb_draw_string(20, line_y, "  smp    - List CPUs (smpbench: scaling test)", RGB(200, 200, 200), RGB(10, 10, 35));
+                        line_y += 20;
+                        fb_draw_string(20, line_y, "  schedbench - Fork/join work-stealing test", RGB(200, 200, 200), RGB(10, 10, 35));
+                        line_y += 20;
+                        fb_draw_string(20, line_y, "  lockstat - Lock contention statistics", RGB(200, 200, 200), RGB(10, 10, 35));
+                        line_y += 20;
+                        fb_draw_string(20, line_y, "  rcubench - RCU vs spinlock read throughput", RGB(200, 200, 200), RGB(10, 10, 35));
+                        line_y += 20;
+                        fb_draw_string(20, line_y, "  irqstat - Interrupt-off and softirq times", RGB(200, 200, 200), RGB(10, 10, 35));
+                        line_y += 20;
+                        fb_draw_string(20, line_y, "  irqlat - Timer IRQ latency, PIC vs I/O APIC", RGB(200, 200, 200), RGB(10, 10, 35));
+                        line_y += 20;
+                        fb_draw_string(20, line_y, "  lspci - List PCI devices", RGB(200, 200, 200), RGB(10, 10, 35));
+                        line_y += 20;
+                        fb_draw_string(20, line_y, "  pcibench - Config scan time, port I/O vs ECAM", RGB(200, 200, 200), RGB(10, 10, 35));
+                        line_y += 20;
+                        fb_draw_string(20, line_y, "  netstat - NIC packet and interrupt rates", RGB(200, 200, 200), RGB(10, 10, 35));
+                        line_y += 20;
+                        fb_draw_string(20, line_y, "  txbench - Small-frame TX, synchronous vs batched", RGB(200, 200, 200), RGB(10, 10, 35));
+                        line_y += 20;
+                        fb_draw_string(20, line_y, "  rssbench - e1000e multi-flow RX, 1 vs 2 queues", RGB(200, 200, 200), RGB(10, 10, 35));
+                        line_y += 20;
+                        fb_draw_string(20, line_y, "  arp    - Neighbor cache and ARP counters", RGB(200, 200, 200), RGB(10, 10, 35));
+                        line_y += 20;
+                        fb_draw_string(20, line_y, "  route  - IPv4 routes (route add|del NET/LEN [GW])", RGB(200, 200, 200), RGB(10, 10, 35));
+                        line_y += 20;
+                        fb_draw_string(20, line_y, "  udpbench - UDP echo RTT and throughput (host: make udp-echo)", RGB(200, 200, 200), RGB(10, 10, 35));
+                        line_y += 20;
+                        fb_draw_string(20, line_y, "  tcpbench - TCP bulk send [IP[:PORT]] [cubic|newreno] [MB] (host: make tcp-sink)", RGB(200, 200, 200), RGB(10, 10, 35));
+                        line_y += 20;
+                        fb_draw_string(20, line_y, "  httpd  - HTTP server for files [start [PORT]|stop] (host: make httpd-bench)", RGB(200, 200, 200), RGB(10, 10, 35));
+                        line_y += 20;
+                        fb_draw_string(20, line_y, "  dhcp   - Lease status and counters (dhcp renew: start over)", RGB(200, 200, 200), RGB(10, 10, 35));
+                        line_y += 20;
+                        fb_draw_string(20, line_y, "  nslookup - Resolve names [NAME ...], list the cache, or -flush it", RGB(200, 200, 200), RGB(10, 10, 35));
                     }
                     // clear
                     else if (cmd_pos == 5 && command_buffer[0] == 'c' && command_buffer[1] == 'l' && 
@@ -397,23 +505,38 @@ void kernel_main(uint32_t magic, void* multiboot_info) {
                         fb_draw_string(84, line_y, buf, RGB(100, 200, 255), RGB(10, 10, 35));
                         line_y += 40;
                         
-                        // CPU bar
+                        // Per-CPU load bars, refreshed every 500 ms until a key is pressed
                         fb_draw_string(20, line_y, "CPU Usage:", RGB(200, 200, 200), RGB(10, 10, 35));
                         line_y += 20;
-                        fb_draw_string(20, line_y, "[", RGB(150, 150, 150), RGB(10, 10, 35));
-                        for (int b = 0; b < 30; b++) {
-                            if (b < 10) {
-                                fb_draw_string(28 + b * 8, line_y, "#", RGB(0, 255, 100), RGB(10, 10, 35));
-                            } else {
-                                fb_draw_string(28 + b * 8, line_y, "-", RGB(50, 50, 50), RGB(10, 10, 35));
-                            }
+                        uint32_t ncpus = smp_num_cpus();
+                        for (uint32_t c = 0; c < ncpus; c++) {
+                            sched_cpu_load(c);  // Open the sampling window
                         }
-                        fb_draw_string(28 + 30 * 8, line_y, "]", RGB(150, 150, 150), RGB(10, 10, 35));
-                        fb_draw_string(28 + 31 * 8, line_y, " 33%", RGB(200, 200, 200), RGB(10, 10, 35));
-                        
-                        // Wait for key
+                        uint32_t last_sample = timer_get_ticks();
+
                         while (!keyboard_available()) {
-                            for (volatile int d = 0; d < 100000; d++);
+                            if (timer_get_ticks() - last_sample >= 50) {
+                                last_sample = timer_get_ticks();
+                                for (uint32_t c = 0; c < ncpus; c++) {
+                                    int bar_y = line_y + c * 20;
+                                    uint32_t load = sched_cpu_load(c);
+                                    uint32_t filled = load * 30 / 100;
+                                    char label[16];
+                                    sprintf(label, "cpu%-2u [", c);
+                                    fb_draw_string(20, bar_y, label, RGB(150, 150, 150), RGB(10, 10, 35));
+                                    for (uint32_t b = 0; b < 30; b++) {
+                                        if (b < filled) {
+                                            fb_draw_string(84 + b * 8, bar_y, "#", RGB(0, 255, 100), RGB(10, 10, 35));
+                                        } else {
+                                            fb_draw_string(84 + b * 8, bar_y, "-", RGB(50, 50, 50), RGB(10, 10, 35));
+                                        }
+                                    }
+                                    char pct[8];
+                                    sprintf(pct, "] %3u%%", load);
+                                    fb_draw_string(84 + 30 * 8, bar_y, pct, RGB(200, 200, 200), RGB(10, 10, 35));
+                                }
+                            }
+                            sched_idle_wait(1000);
                         }
                         keyboard_getchar();
                         
@@ -445,70 +568,157 @@ void kernel_main(uint32_t magic, void* multiboot_info) {
                             fb_draw_string(20, line_y, "rm: file not found", RGB(255, 100, 100), RGB(10, 10, 35));
                         }
                     }
-                    // ping - Network ping
+                    // ping - ICMP echo with RTT: ping [-c count] [-i seconds] host
                     else if (cmd_pos > 5 && command_buffer[0] == 'p' && command_buffer[1] == 'i' && 
                              command_buffer[2] == 'n' && command_buffer[3] == 'g' && command_buffer[4] == ' ') {
                         command_buffer[cmd_pos] = '\0';
-                        char* ip_str = command_buffer + 5;
-                        
-                        // Initialize network on first use
-                        static bool net_initialized = false;
-                        if (!net_initialized) {
+                        char buf[96];
+
+                        // Options, then the host
+                        uint32_t count = 4;
+                        uint32_t interval_ms = 1000;
+                        char* arg = command_buffer + 5;
+                        while (arg[0] == '-' && (arg[1] == 'c' || arg[1] == 'i') && arg[2] == ' ') {
+                            char opt = arg[1];
+                            arg += 3;
+                            uint32_t whole = 0, frac = 0, frac_div = 1;
+                            while (*arg >= '0' && *arg <= '9') whole = whole * 10 + (*arg++ - '0');
+                            if (*arg == '.') {
+                                arg++;
+                                while (*arg >= '0' && *arg <= '9') {
+                                    if (frac_div < 1000) {
+                                        frac = frac * 10 + (*arg - '0');
+                                        frac_div *= 10;
+                                    }
+                                    arg++;
+                                }
+                            }
+                            while (*arg == ' ') arg++;
+                            if (opt == 'c') count = whole;
+                            else interval_ms = whole * 1000 + frac * 1000 / frac_div;
+                        }
+                        char* ip_str = arg;
+                        if (count == 0) count = 1;
+                        if (interval_ms < 10) interval_ms = 10;   // One timer tick
+
+                        if (net_init() != 0) {
                             line_y += 20;
-                            fb_draw_string(20, line_y, "Initializing network...", RGB(200, 200, 200), RGB(10, 10, 35));
-                            if (net_init() == 0) {
-                                net_initialized = true;
-                                line_y += 20;
-                                fb_draw_string(20, line_y, "Network ready", RGB(0, 255, 100), RGB(10, 10, 35));
-                            } else {
+                            fb_draw_string(20, line_y, "Network init failed", RGB(255, 100, 100), RGB(10, 10, 35));
+                        } else {
+                            uint32_t dest_ip = ip_from_string(ip_str);
+                            char dest_str[16];
+                            ip_to_string(dest_ip, dest_str);
+                            line_y += 20;
+                            sprintf(buf, "PING %s: %u data bytes", dest_str, ICMP_PING_DEFAULT_DATA);
+                            fb_draw_string(20, line_y, buf, RGB(0, 255, 255), RGB(10, 10, 35));
+
+                            static icmp_ping_t ping;
+                            icmp_ping_open(&ping, dest_ip, ICMP_PING_DEFAULT_DATA);
+
+                            for (uint32_t i = 0; i < count; i++) {
+                                uint32_t t0 = timer_get_ticks();
+                                int seq = icmp_ping_send(&ping);
+
+                                // Wait out the interval (at least a second for the
+                                // last one), stopping early once the reply is in
+                                uint32_t wait_ms = (i + 1 < count || interval_ms > 1000) ? interval_ms : 1000;
+                                uint32_t rtt_ns = 0;
+                                uint8_t ttl = 0;
+                                int replied = 0;
+                                while (timer_get_ticks() - t0 < wait_ms / 10) {
+                                    if (seq >= 0 && !replied) {
+                                        replied = icmp_ping_reply(&ping, (uint16_t)seq, &rtt_ns, &ttl);
+                                        if (replied) {
+                                            uint32_t us = rtt_ns / 1000;
+                                            line_y += 20;
+                                            sprintf(buf, "%u bytes from %s: icmp_seq=%u ttl=%u time=%u.%03u ms",
+                                                    ICMP_PING_DEFAULT_DATA + 8, dest_str, seq, ttl,
+                                                    us / 1000, us % 1000);
+                                            fb_draw_string(20, line_y, buf, RGB(200, 200, 200), RGB(10, 10, 35));
+                                            if (i + 1 == count) break;
+                                        }
+                                    }
+                                    sched_idle_wait(1000);
+                                }
+                                if (!replied) {
+                                    line_y += 20;
+                                    sprintf(buf, seq < 0 ? "icmp_seq=%u: send failed" : "Request timeout for icmp_seq %u",
+                                            (uint32_t)(uint16_t)(ping.next_seq - 1));
+                                    fb_draw_string(20, line_y, buf, RGB(255, 100, 100), RGB(10, 10, 35));
+                                }
+                            }
+                            icmp_ping_close(&ping);
+
+                            icmp_rtt_summary_t rtt;
+                            icmp_ping_summary(&ping, &rtt);
+                            uint32_t loss = ping.transmitted ?
+                                (ping.transmitted - ping.received) * 100 / ping.transmitted : 0;
+                            line_y += 20;
+                            sprintf(buf, "--- %s ping statistics ---", dest_str);
+                            fb_draw_string(20, line_y, buf, RGB(0, 255, 255), RGB(10, 10, 35));
+                            line_y += 20;
+                            sprintf(buf, "%u packets transmitted, %u received, %u%% packet loss",
+                                    ping.transmitted, ping.received, loss);
+                            if (ping.duplicates || ping.errors) {
+                                char extra[40];
+                                sprintf(extra, ", +%u dups, +%u errors", ping.duplicates, ping.errors);
+                                strcpy(buf + strlen(buf), extra);
+                            }
+                            fb_draw_string(20, line_y, buf, RGB(200, 200, 200), RGB(10, 10, 35));
+                            if (ping.received) {
                                 line_y += 20;
-                                fb_draw_string(20, line_y, "Network init failed", RGB(255, 100, 100), RGB(10, 10, 35));
+                                sprintf(buf, "rtt min/avg/max/mdev = %u.%03u/%u.%03u/%u.%03u/%u.%03u ms",
+                                        rtt.min_us / 1000, rtt.min_us % 1000, rtt.avg_us / 1000, rtt.avg_us % 1000,
+                                        rtt.max_us / 1000, rtt.max_us % 1000, rtt.mdev_us / 1000, rtt.mdev_us % 1000);
+                                fb_draw_string(20, line_y, buf, RGB(200, 200, 200), RGB(10, 10, 35));
                             }
                         }
-                        
-                        line_y += 20;
-                        uint32_t dest_ip = ip_from_string(ip_str);
-                        fb_draw_string(20, line_y, "PING ", RGB(0, 255, 255), RGB(10, 10, 35));
-                        fb_draw_string(60, line_y, ip_str, RGB(255, 255, 255), RGB(10, 10, 35));
-                        line_y += 20;
-                        
-                        net_ping(dest_ip);
-                        
-                        fb_draw_string(20, line_y, "64 bytes from ", RGB(200, 200, 200), RGB(10, 10, 35));
-                        fb_draw_string(132, line_y, ip_str, RGB(255, 255, 255), RGB(10, 10, 35));
-                        line_y += 20;
-                        fb_draw_string(20, line_y, "icmp_seq=1 ttl=64 time=<1ms", RGB(200, 200, 200), RGB(10, 10, 35));
                     }
                     // ifconfig - Network configuration
                     else if (cmd_pos == 8 && command_buffer[0] == 'i' && command_buffer[1] == 'f' && 
                              command_buffer[2] == 'c' && command_buffer[3] == 'o' && command_buffer[4] == 'n' &&
                              command_buffer[5] == 'f' && command_buffer[6] == 'i' && command_buffer[7] == 'g') {
-                        // Initialize network on first use
-                        static bool net_initialized = false;
-                        if (!net_initialized) {
+                        if (net_init() != 0) {
                             line_y += 20;
-                            fb_draw_string(20, line_y, "Initializing network...", RGB(200, 200, 200), RGB(10, 10, 35));
-                            if (net_init() == 0) {
-                                net_initialized = true;
-                                line_y += 20;
-                                fb_draw_string(20, line_y, "Network ready", RGB(0, 255, 100), RGB(10, 10, 35));
-                            } else {
-                                line_y += 20;
-                                fb_draw_string(20, line_y, "Network init failed", RGB(255, 100, 100), RGB(10, 10, 35));
-                            }
+                            fb_draw_string(20, line_y, "Network init failed", RGB(255, 100, 100), RGB(10, 10, 35));
                         }
-                        
+
+                        net_interface_t nif;
+                        net_get_interface(&nif);
+                        dhcp_info_t dhcp;
+                        dhcp_get_info(&dhcp);
+
                         line_y += 20;
                         fb_draw_string(20, line_y, "eth0: flags=UP,RUNNING", RGB(0, 255, 255), RGB(10, 10, 35));
                         line_y += 20;
                         
-                        char ip_str[16];
-                        ip_to_string((10 << 24) | (0 << 16) | (2 << 8) | 15, ip_str);
+                        char ip_str[16], mask_str[16], gw_str[16];
+                        char line[96];
+                        ip_to_string(nif.ip, ip_str);
                         fb_draw_string(20, line_y, "  inet ", RGB(200, 200, 200), RGB(10, 10, 35));
-                        fb_draw_string(68, line_y, ip_str, RGB(0, 255, 100), RGB(10, 10, 35));
+                        fb_draw_string(68, line_y, nif.ip ? ip_str : "(none)", RGB(0, 255, 100), RGB(10, 10, 35));
                         line_y += 20;
                         
-                        fb_draw_string(20, line_y, "  netmask 255.255.255.0", RGB(200, 200, 200), RGB(10, 10, 35));
+                        ip_to_string(nif.netmask, mask_str);
+                        ip_to_string(nif.gateway, gw_str);
+                        sprintf(line, "  netmask %s  gateway %s", mask_str, gw_str);
+                        fb_draw_string(20, line_y, line, RGB(200, 200, 200), RGB(10, 10, 35));
+                        line_y += 20;
+
+                        // Where the address came from
+                        if (dhcp.lease_secs) {
+                            ip_to_string(dhcp.server, ip_str);
+                            sprintf(line, "  dhcp %s from %s, %u s left", dhcp_state_name(dhcp.state),
+                                    ip_str, dhcp.remaining_secs);
+                        } else {
+                            sprintf(line, "  dhcp %s%s", dhcp_state_name(dhcp.state),
+                                    dhcp.fallback ? " (static defaults in use)" : "");
+                        }
+                        fb_draw_string(20, line_y, line, RGB(200, 200, 200), RGB(10, 10, 35));
+                        line_y += 20;
+                        ip_to_string(dns_get_server(), ip_str);
+                        sprintf(line, "  nameserver %s", dns_get_server() ? ip_str : "(none)");
+                        fb_draw_string(20, line_y, line, RGB(200, 200, 200), RGB(10, 10, 35));
                         line_y += 20;
                         
                         // Display actual MAC from hardware
@@ -528,98 +738,144 @@ void kernel_main(uint32_t magic, void* multiboot_info) {
                         mac_str[pos] = '\0';
                         
                         fb_draw_string(76, line_y, mac_str, RGB(0, 255, 100), RGB(10, 10, 35));
+                        line_y += 20;
+                        
+                        // Driver and interrupt delivery
+                        netdev_t* dev = net_get_device();
+                        if (dev) {
+                            netdev_irq_info_t irq_info;
+                            dev->ops->get_irq_info(&irq_info);
+                            static const char* irq_modes[] = {"none", "INTx", "MSI", "MSI-X"};
+                            char irq_line[96];
+                            sprintf(irq_line, "  %s interrupt %s vector %u (%u irqs, %u link changes)",
+                                    dev->name, irq_modes[irq_info.mode], irq_info.vector,
+                                    irq_info.count, irq_info.link_changes);
+                            fb_draw_string(20, line_y, irq_line, RGB(200, 200, 200), RGB(10, 10, 35));
+                        }
                     }
-                    // wget - Download file
+                    // wget - HTTP/1.1 download into files: wget URL [URL ...]
                     else if (cmd_pos > 5 && command_buffer[0] == 'w' && command_buffer[1] == 'g' && 
                              command_buffer[2] == 'e' && command_buffer[3] == 't' && command_buffer[4] == ' ') {
-                        // Initialize network on first use
-                        static bool net_initialized = false;
-                        if (!net_initialized) {
+                        command_buffer[cmd_pos] = '\0';
+                        char buf[128];
+
+                        if (net_init() != 0) {
                             line_y += 20;
-                            fb_draw_string(20, line_y, "Initializing network...", RGB(200, 200, 200), RGB(10, 10, 35));
-                            if (net_init() == 0) {
-                                net_initialized = true;
+                            fb_draw_string(20, line_y, "Network init failed", RGB(255, 100, 100), RGB(10, 10, 35));
+                        } else if (dhcp_wait(DHCP_WAIT_MS) < 0) {
+                            line_y += 20;
+                            fb_draw_string(20, line_y, "No IPv4 address yet (see ifconfig)", RGB(255, 100, 100), RGB(10, 10, 35));
+                        } else {
+                            // Consecutive URLs on one server share a kept-alive connection
+                            http_client_t client;
+                            int have_client = 0;
+
+                            char* p = command_buffer + 5;
+                            while (*p && line_y < (int)fb->height - 100) {
+                                while (*p == ' ') p++;
+                                if (!*p) break;
+                                char* tok = p;
+                                while (*p && *p != ' ') p++;
+                                if (*p) *p++ = '\0';
+
+                                http_url_t url;
+                                if (http_parse_url(tok, &url) < 0) {
+                                    line_y += 20;
+                                    fb_draw_string(20, line_y, "Bad URL (http://host[:port]/path)", RGB(255, 100, 100), RGB(10, 10, 35));
+                                    continue;
+                                }
+
+                                uint32_t ip;
+                                int rerr = dns_resolve(url.host, &ip);
+                                if (rerr < 0) {
+                                    line_y += 20;
+                                    sprintf(buf, "Cannot resolve %s: %s", url.host, dns_strerror(rerr));
+                                    fb_draw_string(20, line_y, buf, RGB(255, 100, 100), RGB(10, 10, 35));
+                                    continue;
+                                }
+
+                                // Same server, port and Host header: reuse the connection
+                                if (!have_client || client.ip != ip || client.port != url.port ||
+                                    strcmp(client.host, url.host) != 0) {
+                                    if (have_client) http_client_close(&client);
+                                    http_client_init(&client, ip, url.port, url.host);
+                                    have_client = 1;
+                                }
+
+                                // File name: last path segment without the query
+                                char filename[MAX_FILENAME] = "index.html";
+                                int start = 0, end = 0;
+                                while (url.path[end] && url.path[end] != '?') {
+                                    if (url.path[end] == '/') start = end + 1;
+                                    end++;
+                                }
+                                if (end > start) {
+                                    int n = end - start < MAX_FILENAME - 1 ? end - start : MAX_FILENAME - 1;
+                                    memcpy(filename, url.path + start, n);
+                                    filename[n] = '\0';
+                                }
+
                                 line_y += 20;
-                                fb_draw_string(20, line_y, "Network ready", RGB(0, 255, 100), RGB(10, 10, 35));
-                            } else {
+                                sprintf(buf, "GET http://%s:%u", url.host, url.port);
+                                fb_draw_string(20, line_y, buf, RGB(0, 255, 255), RGB(10, 10, 35));
+                                fb_draw_string(20 + strlen(buf) * 8, line_y, url.path, RGB(0, 255, 255), RGB(10, 10, 35));
+
+                                // The body is appended to the file segment by segment
+                                wget_out_t out;
+                                out.name = filename;
+                                http_response_t resp;
+                                out.file = NULL;
+                                out.resp = &resp;
+                                out.stored = 0;
+                                out.truncated = 0;
+                                int err = http_get(&client, url.path, wget_sink, &out, &resp);
+
                                 line_y += 20;
-                                fb_draw_string(20, line_y, "Network init failed", RGB(255, 100, 100), RGB(10, 10, 35));
-                            }
-                        }
-                        
-                        command_buffer[cmd_pos] = '\0';
-                        char* url = command_buffer + 5;
-                        
-                        // Extract filename from URL (everything after last '/')
-                        char filename[64] = "index.html";
-                        int url_len = 0;
-                        while (url[url_len]) url_len++;
-                        
-                        // Find last '/' in URL
-                        int last_slash = -1;
-                        for (int i = url_len - 1; i >= 0; i--) {
-                            if (url[i] == '/') {
-                                last_slash = i;
-                                break;
-                            }
-                        }
-                        
-                        // Extract filename after last slash
-                        if (last_slash >= 0 && last_slash < url_len - 1) {
-                            int fn_idx = 0;
-                            for (int i = last_slash + 1; i < url_len && fn_idx < 63; i++) {
-                                // Stop at query string or fragment
-                                if (url[i] == '?' || url[i] == '#') break;
-                                filename[fn_idx++] = url[i];
-                            }
-                            filename[fn_idx] = '\0';
-                        }
-                        
-                        // If filename is empty or just domain, use index.html
-                        if (filename[0] == '\0') {
-                            filename[0] = 'i'; filename[1] = 'n'; filename[2] = 'd';
-                            filename[3] = 'e'; filename[4] = 'x'; filename[5] = '.';
-                            filename[6] = 'h'; filename[7] = 't'; filename[8] = 'm';
-                            filename[9] = 'l'; filename[10] = '\0';
-                        }
-                        
-                        line_y += 20;
-                        fb_draw_string(20, line_y, "Resolving ", RGB(200, 200, 200), RGB(10, 10, 35));
-                        fb_draw_string(100, line_y, url, RGB(0, 255, 255), RGB(10, 10, 35));
-                        line_y += 20;
-                        fb_draw_string(20, line_y, "Downloading...", RGB(200, 200, 200), RGB(10, 10, 35));
-                        line_y += 20;
-                        
-                        char response[2048];
-                        int size = net_http_get(url, response, sizeof(response));
-                        
-                        if (size > 0) {
-                            // Display size
-                            char buf[16];
-                            int i = 0;
-                            char temp[16]; int j = 0;
-                            int display_size = size;
-                            if (display_size == 0) buf[i++] = '0';
-                            else {
-                                while (display_size > 0) { temp[j++] = '0' + (display_size % 10); display_size /= 10; }
-                                while (j > 0) buf[i++] = temp[--j];
-                            }
-                            buf[i] = '\0';
-                            
-                            fb_draw_string(20, line_y, "Saved: ", RGB(0, 255, 100), RGB(10, 10, 35));
-                            fb_draw_string(76, line_y, filename, RGB(255, 255, 255), RGB(10, 10, 35));
-                            line_y += 20;
-                            fb_draw_string(20, line_y, "Size: ", RGB(200, 200, 200), RGB(10, 10, 35));
-                            fb_draw_string(68, line_y, buf, RGB(0, 255, 100), RGB(10, 10, 35));
-                            fb_draw_string(68 + i * 8, line_y, " bytes", RGB(0, 255, 100), RGB(10, 10, 35));
-                            
-                            // Save to file with extracted filename
-                            file_t* file = vfs_create(filename, FILE_TYPE_REGULAR);
-                            if (file) {
-                                vfs_write(file, response, size);
+                                if (err == HTTP_ERR_SINK) {
+                                    fb_draw_string(20, line_y, "  failed: no free file slot", RGB(255, 100, 100), RGB(10, 10, 35));
+                                    continue;
+                                }
+                                if (err < 0) {
+                                    sprintf(buf, "  failed: %s", http_strerror(err));
+                                    fb_draw_string(20, line_y, buf, RGB(255, 100, 100), RGB(10, 10, 35));
+                                    continue;
+                                }
+                                if (resp.status < 200 || resp.status > 299) {
+                                    sprintf(buf, "  HTTP %d, %u bytes, not saved", resp.status, resp.body_bytes);
+                                    fb_draw_string(20, line_y, buf, RGB(255, 100, 100), RGB(10, 10, 35));
+                                } else {
+                                    // An empty body still leaves an (empty) file
+                                    if (!out.file) wget_sink((const uint8_t*)"", 0, &out);
+                                    if (!out.file) {
+                                        sprintf(buf, "  HTTP %d, %u bytes, no free file slot", resp.status, resp.body_bytes);
+                                        fb_draw_string(20, line_y, buf, RGB(255, 100, 100), RGB(10, 10, 35));
+                                    } else if (out.truncated) {
+                                        sprintf(buf, "  HTTP %d, %u bytes, out of memory: kept %u in %s",
+                                                resp.status, resp.body_bytes, out.stored, filename);
+                                        fb_draw_string(20, line_y, buf, RGB(255, 100, 100), RGB(10, 10, 35));
+                                    } else {
+                                        sprintf(buf, "  HTTP %d, saved %u bytes to %s%s", resp.status, out.stored,
+                                                filename, resp.chunked ? " (chunked)" : "");
+                                        fb_draw_string(20, line_y, buf, RGB(0, 255, 100), RGB(10, 10, 35));
+                                    }
+                                }
+
+                                uint32_t kbps = resp.total_us ?
+                                    (uint32_t)div_u64((uint64_t)resp.body_bytes * 1000000 / 1024, resp.total_us) : 0;
+                                line_y += 20;
+                                if (resp.reused) {
+                                    sprintf(buf, "  TTFB %u.%03u ms  total %u.%03u ms  %u KB/s  reused connection",
+                                            resp.ttfb_us / 1000, resp.ttfb_us % 1000,
+                                            resp.total_us / 1000, resp.total_us % 1000, kbps);
+                                } else {
+                                    sprintf(buf, "  TTFB %u.%03u ms  total %u.%03u ms  %u KB/s  connect %u.%03u ms",
+                                            resp.ttfb_us / 1000, resp.ttfb_us % 1000,
+                                            resp.total_us / 1000, resp.total_us % 1000, kbps,
+                                            resp.connect_us / 1000, resp.connect_us % 1000);
+                                }
+                                fb_draw_string(20, line_y, buf, RGB(150, 150, 150), RGB(10, 10, 35));
                             }
-                        } else {
-                            fb_draw_string(20, line_y, "Error: Failed to download", RGB(255, 100, 100), RGB(10, 10, 35));
+                            if (have_client) http_client_close(&client);
                         }
                     }
                     // edit - Simple nano-style editor (inspired by Linux nano)
@@ -643,8 +899,9 @@ void kernel_main(uint32_t magic, void* multiboot_info) {
                         int edit_pos = 0;
                         file_t* file = vfs_open(filename);
                         if (file) {
-                            vfs_read(file, edit_buffer, MAX_FILE_SIZE - 1);
-                            edit_pos = file->size;
+                            // Downloads can be larger than the buffer; edit the head
+                            int bytes = vfs_read(file, edit_buffer, MAX_FILE_SIZE - 1);
+                            edit_pos = bytes > 0 ? bytes : 0;
                         } else {
                             edit_buffer[0] = '\0';
                         }
@@ -881,13 +1138,1128 @@ void kernel_main(uint32_t magic, void* multiboot_info) {
                                     }
                                 }
                             }
-                            for (volatile int d = 0; d < 10000; d++);
+                            sched_idle_wait(20);
                         }
                         
                         // Redraw screen
                         fb_clear(RGB(10, 10, 35));
                         line_y = 20;
                     }
+                    // smp - List CPUs
+                    else if (cmd_pos == 3 && command_buffer[0] == 's' && command_buffer[1] == 'm' && command_buffer[2] == 'p') {
+                        char buf[64];
+                        uint32_t ncpus = smp_num_cpus();
+                        line_y += 20;
+                        sprintf(buf, "%u CPU(s) online, TSC %u MHz", ncpus, timer_tsc_khz() / 1000);
+                        fb_draw_string(20, line_y, buf, RGB(0, 255, 255), RGB(10, 10, 35));
+                        for (uint32_t c = 0; c < ncpus; c++) {
+                            line_y += 20;
+                            sprintf(buf, "  cpu%u  apic %u%s", c, cpus[c].apic_id, c == 0 ? "  (BSP)" : "");
+                            fb_draw_string(20, line_y, buf, RGB(200, 200, 200), RGB(10, 10, 35));
+                        }
+                    }
+                    // smpbench - Parallel framebuffer fill, 1..N CPUs
+                    else if (cmd_pos == 8 && command_buffer[0] == 's' && command_buffer[1] == 'm' &&
+                             command_buffer[2] == 'p' && command_buffer[3] == 'b' && command_buffer[4] == 'e' &&
+                             command_buffer[5] == 'n' && command_buffer[6] == 'c' && command_buffer[7] == 'h') {
+                        uint32_t ncpus = smp_num_cpus();
+                        uint32_t results[MAX_CPUS];
+                        for (uint32_t n = 1; n <= ncpus; n++) {
+                            results[n - 1] = smp_bench_fill(n, 32);
+                        }
+
+                        fb_clear(RGB(10, 10, 35));
+                        line_y = 20;
+                        fb_draw_string(20, line_y, "Parallel framebuffer fill (32 frames)", RGB(0, 255, 255), RGB(10, 10, 35));
+                        for (uint32_t n = 1; n <= ncpus; n++) {
+                            char buf[64];
+                            uint32_t base = results[0] ? results[0] : 1;
+                            uint32_t speedup = results[n - 1] * 100 / base;
+                            sprintf(buf, "  %2u CPU(s): %6u MB/s  %u.%02ux", n, results[n - 1], speedup / 100, speedup % 100);
+                            line_y += 20;
+                            fb_draw_string(20, line_y, buf, RGB(200, 200, 200), RGB(10, 10, 35));
+                        }
+                    }
+                    // schedbench - Fork/join throughput and steals at 1, 2, 4, 8 CPUs
+                    else if (cmd_pos == 10 && command_buffer[0] == 's' && command_buffer[1] == 'c' &&
+                             command_buffer[2] == 'h' && command_buffer[3] == 'e' && command_buffer[4] == 'd' &&
+                             command_buffer[5] == 'b' && command_buffer[6] == 'e' && command_buffer[7] == 'n' &&
+                             command_buffer[8] == 'c' && command_buffer[9] == 'h') {
+                        line_y += 20;
+                        fb_draw_string(20, line_y, "Fork/join fib(27), cutoff 12", RGB(0, 255, 255), RGB(10, 10, 35));
+                        for (uint32_t n = 1; n <= 8; n *= 2) {
+                            char buf[80];
+                            line_y += 20;
+                            if (n > smp_num_cpus()) {
+                                sprintf(buf, "  %u vCPU(s): not available", n);
+                                fb_draw_string(20, line_y, buf, RGB(150, 150, 150), RGB(10, 10, 35));
+                                continue;
+                            }
+                            uint32_t steals = 0;
+                            uint32_t rate = sched_bench_forkjoin(n, &steals);
+                            sprintf(buf, "  %u vCPU(s): %8u tasks/s  %6u steals", n, rate, steals);
+                            fb_draw_string(20, line_y, buf, RGB(200, 200, 200), RGB(10, 10, 35));
+                        }
+                    }
+                    // lockstat - Per-class lock contention (LOCK_STATS builds only)
+                    else if (cmd_pos == 8 && command_buffer[0] == 'l' && command_buffer[1] == 'o' &&
+                             command_buffer[2] == 'c' && command_buffer[3] == 'k' && command_buffer[4] == 's' &&
+                             command_buffer[5] == 't' && command_buffer[6] == 'a' && command_buffer[7] == 't') {
+                        line_y += 20;
+                        if (!lock_stats_enabled()) {
+                            fb_draw_string(20, line_y, "Lock statistics disabled (build with LOCK_STATS=1)", RGB(255, 100, 100), RGB(10, 10, 35));
+                        } else {
+                            fb_draw_string(20, line_y, "Lock          Acquires  Contended  Avg spin  Avg hold  Max hold", RGB(0, 255, 255), RGB(10, 10, 35));
+                            for (uint32_t i = 0; i < lock_class_count(); i++) {
+                                lock_stats_t st;
+                                const char* name = lock_class_get(i, &st);
+                                if (!name) continue;
+
+                                // Averages in TSC cycles; contended acquires only for spin
+                                uint32_t acquires = st.acquires > 0xFFFFFFFF ? 0xFFFFFFFF : (uint32_t)st.acquires;
+                                uint32_t contended = st.contended > 0xFFFFFFFF ? 0xFFFFFFFF : (uint32_t)st.contended;
+                                uint32_t avg_spin = contended ? (uint32_t)div_u64(st.spin_cycles, contended) : 0;
+                                uint32_t avg_hold = acquires ? (uint32_t)div_u64(st.hold_cycles, acquires) : 0;
+                                uint32_t max_hold = st.max_hold > 0xFFFFFFFF ? 0xFFFFFFFF : (uint32_t)st.max_hold;
+
+                                char buf[96];
+                                sprintf(buf, "%-12s %9u  %9u  %8u  %8u  %8u", name, acquires, contended, avg_spin, avg_hold, max_hold);
+                                line_y += 20;
+                                fb_draw_string(20, line_y, buf, RGB(200, 200, 200), RGB(10, 10, 35));
+                            }
+                            line_y += 20;
+                            fb_draw_string(20, line_y, "(times in TSC cycles)", RGB(150, 150, 150), RGB(10, 10, 35));
+                        }
+                    }
+                    // rcubench - Read-side throughput with a concurrent updater
+                    else if (cmd_pos == 8 && command_buffer[0] == 'r' && command_buffer[1] == 'c' &&
+                             command_buffer[2] == 'u' && command_buffer[3] == 'b' && command_buffer[4] == 'e' &&
+                             command_buffer[5] == 'n' && command_buffer[6] == 'c' && command_buffer[7] == 'h') {
+                        uint32_t ncpus = smp_num_cpus();
+                        line_y += 20;
+                        if (ncpus < 2) {
+                            fb_draw_string(20, line_y, "rcubench needs at least 2 CPUs", RGB(255, 100, 100), RGB(10, 10, 35));
+                        } else {
+                            char buf[80];
+                            sprintf(buf, "%u reader(s), 1 updater, 200 ms per run", ncpus - 1);
+                            fb_draw_string(20, line_y, buf, RGB(0, 255, 255), RGB(10, 10, 35));
+
+                            uint32_t updates = 0;
+                            uint32_t reads = rcu_bench(ncpus, 0, &updates);
+                            sprintf(buf, "  spinlock: %10u reads/s  %7u updates/s", reads, updates);
+                            line_y += 20;
+                            fb_draw_string(20, line_y, buf, RGB(200, 200, 200), RGB(10, 10, 35));
+
+                            reads = rcu_bench(ncpus, 1, &updates);
+                            sprintf(buf, "  rcu:      %10u reads/s  %7u updates/s", reads, updates);
+                            line_y += 20;
+                            fb_draw_string(20, line_y, buf, RGB(200, 200, 200), RGB(10, 10, 35));
+
+                            rcu_stats_t rs;
+                            rcu_get_stats(&rs);
+                            sprintf(buf, "  grace periods: %u  nudges: %u  max wait: %u us", rs.grace_periods, rs.nudges, rs.max_gp_us);
+                            line_y += 20;
+                            fb_draw_string(20, line_y, buf, RGB(150, 150, 150), RGB(10, 10, 35));
+                        }
+                    }
+                    // irqstat - Worst-case hard-IRQ (interrupts off) time and softirq load
+                    else if (cmd_pos == 7 && command_buffer[0] == 'i' && command_buffer[1] == 'r' &&
+                             command_buffer[2] == 'q' && command_buffer[3] == 's' && command_buffer[4] == 't' &&
+                             command_buffer[5] == 'a' && command_buffer[6] == 't') {
+                        line_y += 20;
+                        fb_draw_string(20, line_y, "CPU   IRQs  Avg hard  Max hard (vec)  Max softirq", RGB(0, 255, 255), RGB(10, 10, 35));
+                        for (uint32_t c = 0; c < smp_num_cpus(); c++) {
+                            irq_stats_t is;
+                            softirq_stats_t ss;
+                            irq_get_stats(c, &is);
+                            softirq_get_stats(c, &ss);
+
+                            // Nanoseconds: cycles * 1000 converted as microseconds
+                            uint32_t avg_ns = is.irqs ? (uint32_t)timer_cycles_to_us(div_u64(is.hard_cycles, is.irqs) * 1000) : 0;
+                            uint32_t max_ns = (uint32_t)timer_cycles_to_us(is.max_hard_cycles * 1000);
+                            uint32_t soft_ns = (uint32_t)timer_cycles_to_us(ss.max_cycles * 1000);
+
+                            char buf[96];
+                            sprintf(buf, "cpu%-2u %6u %7u ns %8u ns (%3u) %8u ns", c, is.irqs, avg_ns, max_ns, is.max_vector, soft_ns);
+                            line_y += 20;
+                            fb_draw_string(20, line_y, buf, RGB(200, 200, 200), RGB(10, 10, 35));
+                        }
+
+                        uint32_t runs[NR_SOFTIRQS] = { 0 };
+                        for (uint32_t c = 0; c < smp_num_cpus(); c++) {
+                            softirq_stats_t ss;
+                            softirq_get_stats(c, &ss);
+                            for (int i = 0; i < NR_SOFTIRQS; i++) {
+                                runs[i] += ss.runs[i];
+                            }
+                        }
+                        char buf[96];
+                        sprintf(buf, "softirq runs: timer %u  net_rx %u  net_tx %u  keyboard %u",
+                                runs[SOFTIRQ_TIMER], runs[SOFTIRQ_NET_RX], runs[SOFTIRQ_NET_TX], runs[SOFTIRQ_KEYBOARD]);
+                        line_y += 20;
+                        fb_draw_string(20, line_y, buf, RGB(150, 150, 150), RGB(10, 10, 35));
+                    }
+                    // irqlat - Timer IRQ entry-to-handler latency under each controller
+                    else if (cmd_pos == 6 && command_buffer[0] == 'i' && command_buffer[1] == 'r' &&
+                             command_buffer[2] == 'q' && command_buffer[3] == 'l' && command_buffer[4] == 'a' &&
+                             command_buffer[5] == 't') {
+                        line_y += 20;
+                        fb_draw_string(20, line_y, "Timer IRQ entry-to-handler latency (50 ticks each)", RGB(0, 255, 255), RGB(10, 10, 35));
+
+                        int prev_mode = irq_get_mode();
+                        const char* mode_names[2] = { "8259 PIC", "I/O APIC" };
+                        irq_reset_latency();
+                        for (int mode = IRQ_MODE_PIC; mode <= IRQ_MODE_APIC; mode++) {
+                            char buf[80];
+                            line_y += 20;
+                            if (irq_set_mode(mode) < 0) {
+                                sprintf(buf, "  %s: not available", mode_names[mode]);
+                                fb_draw_string(20, line_y, buf, RGB(150, 150, 150), RGB(10, 10, 35));
+                                continue;
+                            }
+
+                            uint32_t t0 = timer_get_ticks();
+                            while (timer_get_ticks() - t0 < 50) {
+                                sched_idle_wait(1000);
+                            }
+
+                            irq_latency_t lat;
+                            irq_get_latency(mode, &lat);
+                            uint32_t avg_ns = lat.samples ? (uint32_t)timer_cycles_to_us(div_u64(lat.total_cycles, lat.samples) * 1000) : 0;
+                            uint32_t max_ns = (uint32_t)timer_cycles_to_us(lat.max_cycles * 1000);
+                            sprintf(buf, "  %s: avg %6u ns  max %6u ns  (%u samples)", mode_names[mode], avg_ns, max_ns, lat.samples);
+                            fb_draw_string(20, line_y, buf, RGB(200, 200, 200), RGB(10, 10, 35));
+                        }
+                        irq_set_mode(prev_mode);
+                    }
+                    // lspci - List enumerated PCI functions
+                    else if (cmd_pos == 5 && command_buffer[0] == 'l' && command_buffer[1] == 's' &&
+                             command_buffer[2] == 'p' && command_buffer[3] == 'c' && command_buffer[4] == 'i') {
+                        uint32_t count = pci_device_count();
+                        char buf[96];
+                        line_y += 20;
+                        sprintf(buf, "%u PCI functions", count);
+                        fb_draw_string(20, line_y, buf, RGB(0, 255, 255), RGB(10, 10, 35));
+
+                        for (uint32_t i = 0; i < count; i++) {
+                            pci_device_t* dev = pci_get_device(i);
+                            line_y += 20;
+                            sprintf(buf, "%02x:%02x.%u %-20s %04x:%04x rev %02x irq %u%s%s",
+                                    dev->bus, dev->slot, dev->func,
+                                    pci_class_name(dev->class_code, dev->subclass),
+                                    dev->vendor_id, dev->device_id, dev->revision, dev->irq,
+                                    dev->msi_cap ? " MSI" : "", dev->msix_cap ? " MSI-X" : "");
+                            fb_draw_string(20, line_y, buf, RGB(200, 200, 200), RGB(10, 10, 35));
+
+                            // One line per implemented BAR
+                            for (int b = 0; b < PCI_NUM_BARS; b++) {
+                                if (dev->bar_size[b] == 0) continue;
+                                line_y += 20;
+                                sprintf(buf, "    BAR%d %s at %08x size %u", b,
+                                        (dev->bar_is_io & (1 << b)) ? "I/O" : "mem",
+                                        dev->bar[b], dev->bar_size[b]);
+                                fb_draw_string(20, line_y, buf, RGB(150, 150, 150), RGB(10, 10, 35));
+                            }
+                        }
+                    }
+                    // pcibench - Full config-space scan under each access mechanism
+                    else if (cmd_pos == 8 && command_buffer[0] == 'p' && command_buffer[1] == 'c' &&
+                             command_buffer[2] == 'i' && command_buffer[3] == 'b' && command_buffer[4] == 'e' &&
+                             command_buffer[5] == 'n' && command_buffer[6] == 'c' && command_buffer[7] == 'h') {
+                        line_y += 20;
+                        fb_draw_string(20, line_y, "PCI config scan, 256 buses + 64-byte headers", RGB(0, 255, 255), RGB(10, 10, 35));
+
+                        const char* mode_names[2] = { "port I/O", "ECAM" };
+                        for (int mode = PCI_CONFIG_PORTIO; mode <= PCI_CONFIG_ECAM; mode++) {
+                            char buf[96];
+                            pci_scan_result_t res;
+                            line_y += 20;
+                            if (pci_bench_scan(mode, &res) < 0) {
+                                sprintf(buf, "  %-8s: not available (no MCFG; try QEMU_MACHINE=q35)", mode_names[mode]);
+                                fb_draw_string(20, line_y, buf, RGB(150, 150, 150), RGB(10, 10, 35));
+                                continue;
+                            }
+
+                            uint32_t us = (uint32_t)timer_cycles_to_us(res.cycles);
+                            uint32_t ns_per_read = res.reads ? (uint32_t)div_u64(timer_cycles_to_us(res.cycles * 1000), res.reads) : 0;
+                            sprintf(buf, "  %-8s: %7u us  %5u reads  %4u ns/read  (%u functions)",
+                                    mode_names[mode], us, res.reads, ns_per_read, res.functions);
+                            fb_draw_string(20, line_y, buf, RGB(200, 200, 200), RGB(10, 10, 35));
+                        }
+                    }
+                    // netstat - Receive packet and interrupt rates over one second
+                    else if (cmd_pos == 7 && command_buffer[0] == 'n' && command_buffer[1] == 'e' &&
+                             command_buffer[2] == 't' && command_buffer[3] == 's' && command_buffer[4] == 't' &&
+                             command_buffer[5] == 'a' && command_buffer[6] == 't') {
+                        char buf[128];
+                        if (net_init() != 0) {
+                            line_y += 20;
+                            fb_draw_string(20, line_y, "Network init failed", RGB(255, 100, 100), RGB(10, 10, 35));
+                        } else {
+                            netdev_t* dev = net_get_device();
+                            line_y += 20;
+                            sprintf(buf, "eth0 (%s) receive, sampled over 1 s", dev->name);
+                            fb_draw_string(20, line_y, buf, RGB(0, 255, 255), RGB(10, 10, 35));
+
+                            netdev_stats_t s0, s1;
+                            dev->ops->get_stats(&s0);
+                            uint32_t t0 = timer_get_ticks();
+                            while (timer_get_ticks() - t0 < 100) {
+                                sched_idle_wait(1000);
+                            }
+                            dev->ops->get_stats(&s1);
+
+                            line_y += 20;
+                            sprintf(buf, "  %u pkts/s  %u bytes/s  %u irqs/s  %u polls/s",
+                                    s1.rx_packets - s0.rx_packets, s1.rx_bytes - s0.rx_bytes,
+                                    s1.irq_count - s0.irq_count, s1.rx_polls - s0.rx_polls);
+                            fb_draw_string(20, line_y, buf, RGB(200, 200, 200), RGB(10, 10, 35));
+
+                            line_y += 20;
+                            sprintf(buf, "  total: %u pkts  %u errors  %u irqs  %u budget hits (budget %u)",
+                                    s1.rx_packets, s1.rx_errors, s1.irq_count, s1.rx_budget_hits, dev->napi_budget);
+                            fb_draw_string(20, line_y, buf, RGB(150, 150, 150), RGB(10, 10, 35));
+
+                            net_stats_t ns;
+                            net_get_stats(&ns);
+                            line_y += 20;
+                            sprintf(buf, "  stack: %u delivered  %u runts  %u unhandled ethertype",
+                                    ns.rx_packets, ns.rx_dropped, ns.rx_unhandled);
+                            fb_draw_string(20, line_y, buf, RGB(150, 150, 150), RGB(10, 10, 35));
+
+                            pktbuf_stats_t ps;
+                            pktbuf_get_stats(&ps);
+                            line_y += 20;
+                            sprintf(buf, "  pktbuf: %u/%u free  %u allocs  %u failures  %u rx drops (no buffer)",
+                                    ps.free, ps.total, ps.allocs, ps.alloc_failures, s1.rx_no_buf);
+                            fb_draw_string(20, line_y, buf, RGB(150, 150, 150), RGB(10, 10, 35));
+
+                            line_y += 20;
+                            sprintf(buf, "  csum: tx %u offloaded / %u sw  rx %u hw ok / %u hw bad / %u sw",
+                                    ns.tx_csum_offload, ns.tx_csum_sw, ns.rx_csum_hw, ns.rx_csum_hw_bad, ns.rx_csum_sw);
+                            fb_draw_string(20, line_y, buf, RGB(150, 150, 150), RGB(10, 10, 35));
+
+                            ip_stats_t is;
+                            ip_get_stats(&is);
+                            line_y += 20;
+                            sprintf(buf, "  ip: in %u  delivered %u  hdr err %u  csum err %u  not ours %u  frags %u  no proto %u",
+                                    is.in_receives, is.in_delivers, is.in_hdr_errors, is.in_csum_errors,
+                                    is.in_addr_errors, is.in_frag_drops, is.in_unknown_protos);
+                            fb_draw_string(20, line_y, buf, RGB(150, 150, 150), RGB(10, 10, 35));
+                            line_y += 20;
+                            sprintf(buf, "  ip: out %u  no route %u  discards %u  icmp %u/%u  udp %u/%u  tcp %u/%u (in/out)",
+                                    is.out_requests, is.out_no_routes, is.out_discards, is.in_icmp, is.out_icmp,
+                                    is.in_udp, is.out_udp, is.in_tcp, is.out_tcp);
+                            fb_draw_string(20, line_y, buf, RGB(150, 150, 150), RGB(10, 10, 35));
+
+                            icmp_stats_t ics;
+                            icmp_get_stats(&ics);
+                            line_y += 20;
+                            sprintf(buf, "  icmp: echo %u in / %u replied  replies %u in (%u unmatched)  unreach %u  csum err %u",
+                                    ics.in_echo_requests, ics.out_echo_replies, ics.in_echo_replies,
+                                    ics.in_unmatched_replies, ics.in_dest_unreach, ics.in_csum_errors);
+                            fb_draw_string(20, line_y, buf, RGB(150, 150, 150), RGB(10, 10, 35));
+
+                            udp_stats_t us;
+                            udp_get_stats(&us);
+                            line_y += 20;
+                            sprintf(buf, "  udp: in %u  out %u  errors %u  csum err %u  no port %u",
+                                    us.in_datagrams, us.out_datagrams, us.in_errors, us.in_csum_errors, us.no_ports);
+                            fb_draw_string(20, line_y, buf, RGB(150, 150, 150), RGB(10, 10, 35));
+
+                            tcp_stats_t ts;
+                            tcp_get_stats(&ts);
+                            line_y += 20;
+                            sprintf(buf, "  tcp: opens %u/%u (act/pas)  in %u  out %u  rexmit %u  rst %u/%u  csum err %u  no conn %u",
+                                    ts.active_opens, ts.passive_opens, ts.in_segs, ts.out_segs, ts.retransmits,
+                                    ts.resets_in, ts.resets_out, ts.in_csum_errors, ts.no_conn);
+                            fb_draw_string(20, line_y, buf, RGB(150, 150, 150), RGB(10, 10, 35));
+
+                            static tcp_info_t conns[8];
+                            uint32_t nconns = tcp_get_conns(conns, 8);
+                            for (uint32_t i = 0; i < nconns; i++) {
+                                char remote[16];
+                                ip_to_string(conns[i].remote_ip, remote);
+                                line_y += 20;
+                                sprintf(buf, "    %-11s :%u -> %s:%u  cwnd %u KB  srtt %u us  %s",
+                                        tcp_state_name(conns[i].state), conns[i].local_port, remote,
+                                        conns[i].remote_port, conns[i].cwnd / 1024, conns[i].srtt_us, conns[i].cong);
+                                fb_draw_string(20, line_y, buf, RGB(150, 150, 150), RGB(10, 10, 35));
+                            }
+
+                            uint32_t rx_ring, tx_ring, dma_total, dma_used;
+                            dev->ops->get_ring_sizes(&rx_ring, &tx_ring);
+                            dma_stats(&dma_total, &dma_used);
+                            line_y += 20;
+                            sprintf(buf, "  rings: rx %u  tx %u  (%u slabs, DMA region %u/%u KB used)",
+                                    rx_ring, tx_ring, ps.slabs, dma_used / 1024, dma_total / 1024);
+                            fb_draw_string(20, line_y, buf, RGB(150, 150, 150), RGB(10, 10, 35));
+                        }
+                    }
+                    // txbench - 60-byte frame transmit rate, one-at-a-time vs batched
+                    else if (cmd_pos == 7 && command_buffer[0] == 't' && command_buffer[1] == 'x' &&
+                             command_buffer[2] == 'b' && command_buffer[3] == 'e' && command_buffer[4] == 'n' &&
+                             command_buffer[5] == 'c' && command_buffer[6] == 'h') {
+                        char buf[128];
+                        if (net_init() != 0) {
+                            line_y += 20;
+                            fb_draw_string(20, line_y, "Network init failed", RGB(255, 100, 100), RGB(10, 10, 35));
+                        } else {
+                            netdev_t* dev = net_get_device();
+                            line_y += 20;
+                            sprintf(buf, "TX 5000 x 60-byte frames on %s", dev->name);
+                            fb_draw_string(20, line_y, buf, RGB(0, 255, 255), RGB(10, 10, 35));
+
+                            // Broadcast frames with the local experimental ethertype
+                            uint8_t frame[60];
+                            memset(frame, 0, sizeof(frame));
+                            memset(frame, 0xFF, 6);
+                            net_get_mac(frame + 6);
+                            frame[12] = 0x88;
+                            frame[13] = 0xB5;
+
+                            const int count = 5000;
+                            const char* names[2] = { "sync (per-frame wait)", "batched (16/flush)" };
+                            for (int mode = 0; mode < 2; mode++) {
+                                netdev_stats_t s0, s1;
+                                dev->ops->get_stats(&s0);
+                                uint64_t start = rdtsc();
+                                for (int i = 0; i < count; i++) {
+                                    if (mode == 0) {
+                                        // The old path: one doorbell and a completion wait per frame
+                                        net_send_packet(frame, sizeof(frame));
+                                        net_tx_wait();
+                                    } else {
+                                        // A full ring refuses the frame: wait for
+                                        // completions outside the driver lock and retry
+                                        if (net_queue_packet(frame, sizeof(frame)) < 0) {
+                                            net_tx_wait();
+                                            net_queue_packet(frame, sizeof(frame));
+                                        }
+                                        if ((i & 15) == 15) net_flush();
+                                    }
+                                }
+                                net_tx_wait();
+                                uint64_t cycles = rdtsc() - start;
+                                dev->ops->get_stats(&s1);
+
+                                uint32_t us = (uint32_t)timer_cycles_to_us(cycles);
+                                uint32_t pps = us ? (uint32_t)div_u64((uint64_t)count * 1000000, us) : 0;
+                                uint32_t kbps = us ? (uint32_t)div_u64((uint64_t)(s1.tx_bytes - s0.tx_bytes) * 8000, us) : 0;
+                                line_y += 20;
+                                sprintf(buf, "  %-22s %7u pkts/s %6u kbit/s %6u us  %u doorbells (%u skipped)  %u stalls",
+                                        names[mode], pps, kbps, us, s1.tx_batches - s0.tx_batches,
+                                        s1.tx_kicks_skipped - s0.tx_kicks_skipped,
+                                        s1.tx_full_stalls - s0.tx_full_stalls);
+                                fb_draw_string(20, line_y, buf, RGB(200, 200, 200), RGB(10, 10, 35));
+                            }
+                        }
+                    }
+                    // rssbench - Multi-flow receive through MAC loopback, 1 vs 2 RSS queues
+                    else if (cmd_pos == 8 && command_buffer[0] == 'r' && command_buffer[1] == 's' &&
+                             command_buffer[2] == 's' && command_buffer[3] == 'b' && command_buffer[4] == 'e' &&
+                             command_buffer[5] == 'n' && command_buffer[6] == 'c' && command_buffer[7] == 'h') {
+                        char buf[112];
+                        // Bound for the run so the frames are delivered, not
+                        // answered with port unreachables
+                        const uint16_t dst_port = 9;
+                        udp_socket_t* sock = NULL;
+                        if (net_init() != 0 || e1000e_num_queues() == 0) {
+                            line_y += 20;
+                            fb_draw_string(20, line_y, "Needs an e1000e NIC (make run NIC=e1000e)", RGB(255, 100, 100), RGB(10, 10, 35));
+                        } else if ((sock = udp_open(dst_port)) == NULL) {
+                            line_y += 20;
+                            fb_draw_string(20, line_y, "UDP port 9 is in use", RGB(255, 100, 100), RGB(10, 10, 35));
+                        } else {
+                            uint32_t nq_max = e1000e_num_queues();
+                            line_y += 20;
+                            sprintf(buf, "RX 20000 frames, 64 UDP flows, MAC loopback (%u queues, %u CPUs)",
+                                    nq_max, smp_num_cpus());
+                            fb_draw_string(20, line_y, buf, RGB(0, 255, 255), RGB(10, 10, 35));
+
+                            // UDP/IPv4 to ourselves; flows differ in source address
+                            // and port, so the IPv4 2-tuple hash spreads them
+                            static uint8_t frame[1514];
+                            const uint32_t flows = 64;
+                            const uint32_t count = 20000;
+                            const uint32_t dst_ip = (10 << 24) | (0 << 16) | (2 << 8) | 15;
+                            const uint32_t src_base = (10 << 24) | (1 << 16);   // 10.1.0.f
+                            memset(frame, 0, sizeof(frame));
+                            net_get_mac(frame);
+                            net_get_mac(frame + 6);
+                            frame[12] = 0x08;
+                            frame[13] = 0x00;
+                            frame[14] = 0x45;
+                            frame[22] = 64;
+                            frame[23] = 17;
+                            for (int b = 0; b < 4; b++) frame[30 + b] = (dst_ip >> (24 - b * 8)) & 0xFF;
+                            frame[36] = dst_port >> 8;
+                            frame[37] = dst_port & 0xFF;
+
+                            // Where the device should put each flow with two queues
+                            uint32_t predicted[2] = { 0, 0 };
+                            for (uint32_t f = 0; f < flows; f++) {
+                                uint8_t tuple[8];
+                                uint32_t src_ip = src_base | f;
+                                for (int b = 0; b < 4; b++) {
+                                    tuple[b] = (src_ip >> (24 - b * 8)) & 0xFF;
+                                    tuple[4 + b] = (dst_ip >> (24 - b * 8)) & 0xFF;
+                                }
+                                predicted[e1000e_rss_hash(tuple, 8) & 1]++;
+                            }
+
+                            static const uint32_t sizes[2] = { 60, 1514 };
+                            for (uint32_t si = 0; si < 2; si++) {
+                                uint32_t len = sizes[si];
+                                uint32_t ip_len = len - 14;
+                                frame[16] = ip_len >> 8;
+                                frame[17] = ip_len & 0xFF;
+                                frame[38] = (ip_len - 20) >> 8;
+                                frame[39] = (ip_len - 20) & 0xFF;
+
+                                for (uint32_t nq = 1; nq <= nq_max; nq++) {
+                                    e1000e_set_rss_queues(nq);
+                                    e1000e_set_loopback(1);
+
+                                    netdev_stats_t q0[2], q1[2];
+                                    for (uint32_t q = 0; q < nq_max; q++) e1000e_get_queue_stats(q, &q0[q], NULL);
+
+                                    uint64_t start = rdtsc();
+                                    for (uint32_t i = 0; i < count; i++) {
+                                        uint32_t f = i & (flows - 1);
+                                        uint32_t src_ip = src_base | f;
+                                        for (int b = 0; b < 4; b++) frame[26 + b] = (src_ip >> (24 - b * 8)) & 0xFF;
+                                        frame[34] = 0x04;
+                                        frame[35] = f;
+                                        frame[24] = frame[25] = 0;
+                                        uint16_t check = net_checksum(frame + 14, 20);
+                                        memcpy(frame + 24, &check, 2);
+                                        if (net_queue_packet(frame, len) < 0) {
+                                            net_tx_wait();
+                                            net_queue_packet(frame, len);
+                                        }
+                                        if ((i & 15) == 15) net_flush();
+                                    }
+                                    net_flush();
+
+                                    // Done when every frame came back or after 2 s
+                                    uint32_t t0 = timer_get_ticks();
+                                    uint32_t received = 0;
+                                    while (timer_get_ticks() - t0 < 200) {
+                                        received = 0;
+                                        for (uint32_t q = 0; q < nq_max; q++) {
+                                            e1000e_get_queue_stats(q, &q1[q], NULL);
+                                            received += q1[q].rx_packets - q0[q].rx_packets;
+                                        }
+                                        pktbuf_t* pb;
+                                        while ((pb = udp_recvfrom(sock, NULL, NULL)) != NULL) pktbuf_put(pb);
+                                        if (received >= count) break;
+                                        __asm__ volatile("pause");
+                                    }
+                                    uint64_t cycles = rdtsc() - start;
+                                    net_tx_wait();
+                                    e1000e_set_loopback(0);
+
+                                    uint32_t us = (uint32_t)timer_cycles_to_us(cycles);
+                                    uint32_t pps = us ? (uint32_t)div_u64((uint64_t)received * 1000000, us) : 0;
+                                    uint32_t mbps = us ? (uint32_t)div_u64((uint64_t)received * len * 8, us) : 0;
+                                    line_y += 20;
+                                    sprintf(buf, "  %4u B  %u queue%s  %7u pkts/s  %5u Mbit/s  q0 %u  q1 %u  (%u/%u rx)",
+                                            len, nq, nq > 1 ? "s" : " ", pps, mbps,
+                                            q1[0].rx_packets - q0[0].rx_packets,
+                                            nq_max > 1 ? q1[1].rx_packets - q0[1].rx_packets : 0,
+                                            received, count);
+                                    fb_draw_string(20, line_y, buf, RGB(200, 200, 200), RGB(10, 10, 35));
+                                }
+                            }
+                            e1000e_set_rss_queues(nq_max);
+                            udp_close(sock);
+
+                            line_y += 20;
+                            sprintf(buf, "  Toeplitz prediction for 2 queues: %u flows -> q0, %u flows -> q1",
+                                    predicted[0], predicted[1]);
+                            fb_draw_string(20, line_y, buf, RGB(150, 150, 150), RGB(10, 10, 35));
+                        }
+                    }
+                    // arp - Neighbor cache
+                    else if (cmd_pos == 3 && command_buffer[0] == 'a' && command_buffer[1] == 'r' &&
+                             command_buffer[2] == 'p') {
+                        char buf[96];
+                        if (net_init() != 0) {
+                            line_y += 20;
+                            fb_draw_string(20, line_y, "No network device", RGB(255, 100, 100), RGB(10, 10, 35));
+                        } else {
+                            static const char* states[] = {"free", "incomplete", "reachable", "stale"};
+                            arp_entry_info_t ents[8];
+                            uint32_t n = arp_get_entries(ents, 8);
+                            line_y += 20;
+                            fb_draw_string(20, line_y, "Address          HWaddress          State       Age  Queued", RGB(0, 255, 255), RGB(10, 10, 35));
+                            for (uint32_t i = 0; i < n; i++) {
+                                char ip_str[16];
+                                ip_to_string(ents[i].ip, ip_str);
+                                line_y += 20;
+                                sprintf(buf, "%-16s %02x:%02x:%02x:%02x:%02x:%02x  %-10s %4us  %u",
+                                        ip_str, ents[i].mac[0], ents[i].mac[1], ents[i].mac[2],
+                                        ents[i].mac[3], ents[i].mac[4], ents[i].mac[5],
+                                        states[ents[i].state], ents[i].age / 100, ents[i].pending);
+                                fb_draw_string(20, line_y, buf, RGB(200, 200, 200), RGB(10, 10, 35));
+                            }
+
+                            arp_stats_t as;
+                            arp_get_stats(&as);
+                            line_y += 20;
+                            sprintf(buf, "requests %u sent / %u recv, replies %u sent / %u recv, gratuitous %u",
+                                    as.requests_sent, as.requests_received, as.replies_sent,
+                                    as.replies_received, as.gratuitous_sent);
+                            fb_draw_string(20, line_y, buf, RGB(150, 150, 150), RGB(10, 10, 35));
+                            line_y += 20;
+                            sprintf(buf, "hits %u, misses %u, queued %u, dropped %u, failed %u, expired %u",
+                                    as.hits, as.misses, as.queued, as.queue_drops,
+                                    as.resolve_failed, as.expired);
+                            fb_draw_string(20, line_y, buf, RGB(150, 150, 150), RGB(10, 10, 35));
+                        }
+                    }
+                    // route - Show or edit the IPv4 route table
+                    else if (cmd_pos >= 5 && command_buffer[0] == 'r' && command_buffer[1] == 'o' &&
+                             command_buffer[2] == 'u' && command_buffer[3] == 't' && command_buffer[4] == 'e' &&
+                             (cmd_pos == 5 || command_buffer[5] == ' ')) {
+                        command_buffer[cmd_pos] = '\0';
+                        char buf[96];
+                        if (net_init() != 0) {
+                            line_y += 20;
+                            fb_draw_string(20, line_y, "No network device", RGB(255, 100, 100), RGB(10, 10, 35));
+                        } else if (cmd_pos > 6) {
+                            // route add|del A.B.C.D/LEN [GATEWAY]
+                            char* arg = command_buffer + 6;
+                            int add = strncmp(arg, "add ", 4) == 0;
+                            int del = strncmp(arg, "del ", 4) == 0;
+                            char* net = arg + 4;
+                            char* slash = net;
+                            while (*slash && *slash != '/') slash++;
+                            int result = -1;
+                            if ((add || del) && *slash == '/') {
+                                *slash = '\0';
+                                char* len_str = slash + 1;
+                                uint32_t len = 0;
+                                while (*len_str >= '0' && *len_str <= '9') len = len * 10 + (*len_str++ - '0');
+                                uint32_t gateway = 0;
+                                while (*len_str == ' ') len_str++;
+                                if (*len_str) gateway = ip_from_string(len_str);
+                                uint32_t mask = len >= 32 ? 0xFFFFFFFF : (len ? ~(0xFFFFFFFFu >> len) : 0);
+                                uint32_t dest = ip_from_string(net);
+                                result = add ? ip_route_add(dest, mask, gateway) : ip_route_del(dest, mask);
+                            }
+                            line_y += 20;
+                            if (result == 0) {
+                                fb_draw_string(20, line_y, add ? "Route added" : "Route deleted", RGB(0, 255, 100), RGB(10, 10, 35));
+                            } else {
+                                fb_draw_string(20, line_y, "usage: route [add|del A.B.C.D/LEN [GATEWAY]]", RGB(255, 100, 100), RGB(10, 10, 35));
+                            }
+                        } else {
+                            ip_route_t routes[IP_MAX_ROUTES];
+                            uint32_t n = ip_get_routes(routes, IP_MAX_ROUTES);
+                            line_y += 20;
+                            fb_draw_string(20, line_y, "Destination        Gateway          Flags", RGB(0, 255, 255), RGB(10, 10, 35));
+                            for (uint32_t i = 0; i < n; i++) {
+                                char dest_str[16], gw_str[16], net_str[20];
+                                ip_to_string(routes[i].dest, dest_str);
+                                ip_to_string(routes[i].gateway, gw_str);
+                                uint32_t len = routes[i].netmask ? 32 - __builtin_ctz(routes[i].netmask) : 0;
+                                sprintf(net_str, "%s/%u", dest_str, len);
+                                line_y += 20;
+                                sprintf(buf, "%-18s %-16s %s%s", net_str,
+                                        (routes[i].flags & IP_ROUTE_GATEWAY) ? gw_str : "*",
+                                        (routes[i].flags & IP_ROUTE_GATEWAY) ? "UG" : "U",
+                                        (routes[i].flags & IP_ROUTE_IFACE) ? "" : " (static)");
+                                fb_draw_string(20, line_y, buf, RGB(200, 200, 200), RGB(10, 10, 35));
+                            }
+                        }
+                    }
+                    // udpbench - Echo round trips and windowed throughput: udpbench [A.B.C.D[:PORT]]
+                    else if (cmd_pos >= 8 && command_buffer[0] == 'u' && command_buffer[1] == 'd' &&
+                             command_buffer[2] == 'p' && command_buffer[3] == 'b' && command_buffer[4] == 'e' &&
+                             command_buffer[5] == 'n' && command_buffer[6] == 'c' && command_buffer[7] == 'h' &&
+                             (cmd_pos == 8 || command_buffer[8] == ' ')) {
+                        command_buffer[cmd_pos] = '\0';
+                        char buf[112];
+
+                        // Default: the host's loopback through QEMU user networking
+                        uint32_t dest_ip = (10 << 24) | (0 << 16) | (2 << 8) | 2;
+                        uint16_t dest_port = 7777;
+                        if (cmd_pos > 9) {
+                            char* arg = command_buffer + 9;
+                            char* colon = arg;
+                            while (*colon && *colon != ':') colon++;
+                            if (*colon == ':') {
+                                *colon = '\0';
+                                uint32_t port = 0;
+                                for (char* p = colon + 1; *p >= '0' && *p <= '9'; p++) port = port * 10 + (*p - '0');
+                                dest_port = (uint16_t)port;
+                            }
+                            dest_ip = ip_from_string(arg);
+                        }
+
+                        udp_socket_t* sock = NULL;
+                        if (net_init() != 0 || (sock = udp_open(0)) == NULL) {
+                            line_y += 20;
+                            fb_draw_string(20, line_y, "Network init failed", RGB(255, 100, 100), RGB(10, 10, 35));
+                        } else {
+                            char dest_str[16];
+                            ip_to_string(dest_ip, dest_str);
+                            udp_connect(sock, dest_ip, dest_port);
+                            line_y += 20;
+                            sprintf(buf, "UDP echo with %s:%u from port %u", dest_str, dest_port, sock->local_port);
+                            fb_draw_string(20, line_y, buf, RGB(0, 255, 255), RGB(10, 10, 35));
+
+                            // Datagrams carry their sequence number first
+                            static uint8_t payload[UDP_MAX_PAYLOAD];
+                            memset(payload, 0x5A, sizeof(payload));
+
+                            // 1. Ping-pong: one 64-byte datagram in flight
+                            const uint32_t rounds = 200;
+                            uint32_t replies = 0, min_us = 0xFFFFFFFF, max_us = 0;
+                            uint64_t sum_us = 0;
+                            for (uint32_t i = 0; i < rounds; i++) {
+                                memcpy(payload, &i, 4);
+                                uint64_t t0 = rdtsc();
+                                if (udp_send(sock, payload, 64) < 0) continue;
+                                net_flush();
+                                uint32_t start = timer_get_ticks();
+                                while (timer_get_ticks() - start < 20) {
+                                    uint32_t seq = 0;
+                                    pktbuf_t* pb = udp_recvfrom(sock, NULL, NULL);
+                                    if (pb) {
+                                        if (pb->len >= 4) memcpy(&seq, pb->data, 4);
+                                        pktbuf_put(pb);
+                                        if (seq == i) {
+                                            uint32_t us = (uint32_t)timer_cycles_to_us(rdtsc() - t0);
+                                            if (us < min_us) min_us = us;
+                                            if (us > max_us) max_us = us;
+                                            sum_us += us;
+                                            replies++;
+                                            break;
+                                        }
+                                    }
+                                    __asm__ volatile("pause");
+                                }
+                            }
+                            line_y += 20;
+                            if (replies == 0) {
+                                fb_draw_string(20, line_y, "  no echoes received (is the echo server running?)", RGB(255, 100, 100), RGB(10, 10, 35));
+                            } else {
+                                sprintf(buf, "  ping-pong 64 B: %u/%u replies  rtt min %u us  avg %u us  max %u us",
+                                        replies, rounds, min_us, (uint32_t)div_u64(sum_us, replies), max_us);
+                                fb_draw_string(20, line_y, buf, RGB(200, 200, 200), RGB(10, 10, 35));
+
+                                // 2. Streaming: keep a window of datagrams in flight
+                                static const uint32_t sizes[2] = { 64, 1024 };
+                                for (uint32_t si = 0; si < 2; si++) {
+                                    const uint32_t total = 20000;
+                                    const uint32_t window = 64;
+                                    uint32_t sent = 0, received = 0, lost = 0;
+                                    uint64_t t0 = rdtsc();
+                                    uint32_t last_rx = timer_get_ticks();
+                                    while (received + lost < total && timer_get_ticks() - last_rx < 50) {
+                                        uint32_t burst = 0;
+                                        while (sent < total && sent - received - lost < window && burst < 16) {
+                                            memcpy(payload, &sent, 4);
+                                            if (udp_send(sock, payload, sizes[si]) < 0) break;
+                                            sent++;
+                                            burst++;
+                                        }
+                                        if (burst) net_flush();
+
+                                        pktbuf_t* pb;
+                                        while ((pb = udp_recvfrom(sock, NULL, NULL)) != NULL) {
+                                            pktbuf_put(pb);
+                                            received++;
+                                            last_rx = timer_get_ticks();
+                                        }
+                                        // A full window with nothing back for 100 ms:
+                                        // write the datagrams in flight off as lost
+                                        if (sent - received - lost == window && timer_get_ticks() - last_rx > 10) {
+                                            lost += window;
+                                            last_rx = timer_get_ticks();
+                                        }
+                                    }
+                                    uint32_t us = (uint32_t)timer_cycles_to_us(rdtsc() - t0);
+                                    uint32_t pps = us ? (uint32_t)div_u64((uint64_t)received * 1000000, us) : 0;
+                                    uint32_t kbps = us ? (uint32_t)div_u64((uint64_t)received * sizes[si] * 8 * 1000, us) : 0;
+                                    line_y += 20;
+                                    sprintf(buf, "  stream %4u B x %u (window %u): %u echoes/s  %u kbit/s each way  %u lost",
+                                            sizes[si], sent, window, pps, kbps, sent - received);
+                                    fb_draw_string(20, line_y, buf, RGB(200, 200, 200), RGB(10, 10, 35));
+                                }
+                                line_y += 20;
+                                sprintf(buf, "  socket: %u rx  %u tx  %u ring-full drops  %u tx errors",
+                                        sock->stats.rx_datagrams, sock->stats.tx_datagrams,
+                                        sock->stats.rx_ring_full, sock->stats.tx_errors);
+                                fb_draw_string(20, line_y, buf, RGB(150, 150, 150), RGB(10, 10, 35));
+                            }
+                            udp_close(sock);
+                        }
+                    }
+                    // tcpbench - Bulk transfer to a discard server: tcpbench [A.B.C.D[:PORT]] [cubic|newreno] [MB]
+                    else if (cmd_pos >= 8 && command_buffer[0] == 't' && command_buffer[1] == 'c' &&
+                             command_buffer[2] == 'p' && command_buffer[3] == 'b' && command_buffer[4] == 'e' &&
+                             command_buffer[5] == 'n' && command_buffer[6] == 'c' && command_buffer[7] == 'h' &&
+                             (cmd_pos == 8 || command_buffer[8] == ' ')) {
+                        command_buffer[cmd_pos] = '\0';
+                        char buf[128];
+
+                        // Default: the host's loopback through QEMU user networking
+                        uint32_t dest_ip = (10 << 24) | (0 << 16) | (2 << 8) | 2;
+                        uint16_t dest_port = 5001;
+                        const char* cong = tcp_default_cong();
+                        uint32_t mbytes = 32;
+
+                        // Arguments in any order: an address, an algorithm or a size
+                        char* p = command_buffer + 8;
+                        while (*p) {
+                            while (*p == ' ') p++;
+                            if (!*p) break;
+                            char* tok = p;
+                            while (*p && *p != ' ') p++;
+                            if (*p) *p++ = '\0';
+
+                            int dots = 0;
+                            for (char* q = tok; *q; q++) dots += (*q == '.');
+                            if (dots == 3) {
+                                char* colon = tok;
+                                while (*colon && *colon != ':') colon++;
+                                if (*colon == ':') {
+                                    *colon = '\0';
+                                    uint32_t port = 0;
+                                    for (char* d = colon + 1; *d >= '0' && *d <= '9'; d++) port = port * 10 + (*d - '0');
+                                    dest_port = (uint16_t)port;
+                                }
+                                dest_ip = ip_from_string(tok);
+                            } else if (tok[0] >= '0' && tok[0] <= '9') {
+                                mbytes = 0;
+                                for (char* d = tok; *d >= '0' && *d <= '9'; d++) mbytes = mbytes * 10 + (*d - '0');
+                                if (mbytes == 0) mbytes = 1;
+                                if (mbytes > 4000) mbytes = 4000;
+                            } else {
+                                cong = tok;
+                            }
+                        }
+
+                        tcp_conn_t* conn = NULL;
+                        if (net_init() != 0) {
+                            line_y += 20;
+                            fb_draw_string(20, line_y, "Network init failed", RGB(255, 100, 100), RGB(10, 10, 35));
+                        } else if ((conn = tcp_connect(dest_ip, dest_port)) == NULL) {
+                            line_y += 20;
+                            fb_draw_string(20, line_y, "No free TCP connection", RGB(255, 100, 100), RGB(10, 10, 35));
+                        } else if (tcp_set_cong(conn, cong) < 0) {
+                            line_y += 20;
+                            sprintf(buf, "Unknown congestion control '%s' (cubic, newreno)", cong);
+                            fb_draw_string(20, line_y, buf, RGB(255, 100, 100), RGB(10, 10, 35));
+                            tcp_abort(conn);
+                        } else {
+                            char dest_str[16];
+                            ip_to_string(dest_ip, dest_str);
+                            line_y += 20;
+                            sprintf(buf, "TCP bulk send to %s:%u, %u MB, %s", dest_str, dest_port, mbytes, cong);
+                            fb_draw_string(20, line_y, buf, RGB(0, 255, 255), RGB(10, 10, 35));
+
+                            uint32_t start = timer_get_ticks();
+                            uint32_t ev = 0;
+                            while (!((ev = tcp_poll(conn)) & (TCP_EV_CONNECTED | TCP_EV_CLOSED)) &&
+                                   timer_get_ticks() - start < 300) {
+                                sched_idle_wait(1000);
+                            }
+                            if (!(ev & TCP_EV_CONNECTED) || (ev & TCP_EV_CLOSED)) {
+                                line_y += 20;
+                                fb_draw_string(20, line_y, "  connect failed (is the sink running? make tcp-sink)", RGB(255, 100, 100), RGB(10, 10, 35));
+                                tcp_abort(conn);
+                            } else {
+                                static uint8_t chunk[16384];
+                                for (uint32_t i = 0; i < sizeof(chunk); i++) chunk[i] = (uint8_t)i;
+
+                                const uint32_t total = mbytes * 1024 * 1024;
+                                uint32_t sent = 0, interval_bytes = 0, lines = 0;
+                                int failed = 0;
+                                tcp_info_t info;
+                                uint64_t t0 = rdtsc(), t_last = t0;
+                                while (sent < total) {
+                                    uint32_t n = total - sent < sizeof(chunk) ? total - sent : sizeof(chunk);
+                                    int r = tcp_send(conn, chunk, n);
+                                    if (r < 0) {
+                                        failed = 1;
+                                        break;
+                                    }
+                                    sent += r;
+                                    interval_bytes += r;
+                                    // Send buffer full: ACKs free it from the receive softirq
+                                    if (r == 0) sched_idle_wait(100);
+
+                                    // Progress once a second
+                                    uint64_t now = rdtsc();
+                                    uint32_t us = (uint32_t)timer_cycles_to_us(now - t_last);
+                                    if (us >= 1000000 && lines < 10) {
+                                        tcp_get_info(conn, &info);
+                                        uint32_t kbps = (uint32_t)div_u64((uint64_t)interval_bytes * 8000, us);
+                                        line_y += 20;
+                                        sprintf(buf, "  %3u MB  %u.%u Mbit/s  cwnd %u KB  srtt %u us  rexmit %u",
+                                                sent >> 20, kbps / 1000, (kbps % 1000) / 100, info.cwnd / 1024,
+                                                info.srtt_us, info.stats.retransmits);
+                                        fb_draw_string(20, line_y, buf, RGB(200, 200, 200), RGB(10, 10, 35));
+                                        interval_bytes = 0;
+                                        t_last = now;
+                                        lines++;
+                                    }
+                                }
+
+                                // Until the sink has acknowledged everything
+                                start = timer_get_ticks();
+                                do {
+                                    tcp_get_info(conn, &info);
+                                    if (info.snd_queued == 0 || info.state == TCP_CLOSED) break;
+                                    sched_idle_wait(1000);
+                                } while (timer_get_ticks() - start < 1000);
+                                uint32_t us = (uint32_t)timer_cycles_to_us(rdtsc() - t0);
+
+                                line_y += 20;
+                                if (failed || info.state == TCP_CLOSED) {
+                                    sprintf(buf, "  connection lost after %u bytes", sent);
+                                    fb_draw_string(20, line_y, buf, RGB(255, 100, 100), RGB(10, 10, 35));
+                                } else {
+                                    uint32_t kbps = us ? (uint32_t)div_u64((uint64_t)sent * 8000, us) : 0;
+                                    sprintf(buf, "  %u MB in %u.%03u s: %u.%u Mbit/s", mbytes, us / 1000000,
+                                            (us / 1000) % 1000, kbps / 1000, (kbps % 1000) / 100);
+                                    fb_draw_string(20, line_y, buf, RGB(0, 255, 100), RGB(10, 10, 35));
+                                }
+                                line_y += 20;
+                                if (info.ssthresh >= 0x7FFFFFFF) {
+                                    sprintf(buf, "  cwnd %u KB  ssthresh -  srtt %u us  rttvar %u us  rto %u ms",
+                                            info.cwnd / 1024, info.srtt_us, info.rttvar_us, info.rto_ms);
+                                } else {
+                                    sprintf(buf, "  cwnd %u KB  ssthresh %u KB  srtt %u us  rttvar %u us  rto %u ms",
+                                            info.cwnd / 1024, info.ssthresh / 1024, info.srtt_us, info.rttvar_us, info.rto_ms);
+                                }
+                                fb_draw_string(20, line_y, buf, RGB(200, 200, 200), RGB(10, 10, 35));
+                                line_y += 20;
+                                sprintf(buf, "  segs %u  rexmit %u  recoveries %u  timeouts %u  dupacks %u  sack blocks %u",
+                                        info.stats.segs_out, info.stats.retransmits, info.stats.fast_retransmits,
+                                        info.stats.timeouts, info.stats.dup_acks, info.stats.sack_blocks_in);
+                                fb_draw_string(20, line_y, buf, RGB(150, 150, 150), RGB(10, 10, 35));
+                                line_y += 20;
+                                sprintf(buf, "  mss %u  wscale %u/%u  sack %s  peer window %u KB",
+                                        info.mss, info.snd_wscale, info.rcv_wscale, info.sack_ok ? "on" : "off",
+                                        info.snd_wnd / 1024);
+                                fb_draw_string(20, line_y, buf, RGB(150, 150, 150), RGB(10, 10, 35));
+                                tcp_close(conn);
+                            }
+                        }
+                    }
+                    // httpd - HTTP server for VFS files: httpd [start [PORT]|stop]
+                    else if (cmd_pos >= 5 && command_buffer[0] == 'h' && command_buffer[1] == 't' &&
+                             command_buffer[2] == 't' && command_buffer[3] == 'p' && command_buffer[4] == 'd' &&
+                             (cmd_pos == 5 || command_buffer[5] == ' ')) {
+                        command_buffer[cmd_pos] = '\0';
+                        char buf[128];
+                        char* arg = command_buffer + 5;
+                        while (*arg == ' ') arg++;
+
+                        if (strncmp(arg, "start", 5) == 0) {
+                            uint32_t port = 0;
+                            for (char* d = arg + 5; *d; d++) {
+                                if (*d >= '0' && *d <= '9') port = port * 10 + (*d - '0');
+                            }
+                            if (port == 0 || port > 65535) port = HTTPD_PORT;
+
+                            line_y += 20;
+                            if (net_init() != 0) {
+                                fb_draw_string(20, line_y, "Network init failed", RGB(255, 100, 100), RGB(10, 10, 35));
+                            } else if (httpd_start((uint16_t)port) < 0) {
+                                fb_draw_string(20, line_y, "HTTP server already running or port in use", RGB(255, 100, 100), RGB(10, 10, 35));
+                            } else {
+                                if (port == HTTPD_PORT) sprintf(buf, "HTTP server on port %u (make run forwards host port 8080 here)", port);
+                                else sprintf(buf, "HTTP server on port %u", port);
+                                fb_draw_string(20, line_y, buf, RGB(0, 255, 100), RGB(10, 10, 35));
+                            }
+                        } else if (strncmp(arg, "stop", 4) == 0) {
+                            httpd_stop();
+                            line_y += 20;
+                            fb_draw_string(20, line_y, "HTTP server stopped", RGB(0, 255, 100), RGB(10, 10, 35));
+                        } else if (*arg) {
+                            line_y += 20;
+                            fb_draw_string(20, line_y, "Usage: httpd [start [PORT]|stop]", RGB(255, 100, 100), RGB(10, 10, 35));
+                        }
+
+                        httpd_stats_t hs;
+                        httpd_get_stats(&hs);
+                        line_y += 20;
+                        if (httpd_port()) sprintf(buf, "HTTP server: port %u, %u active", httpd_port(), hs.active);
+                        else sprintf(buf, "HTTP server: stopped");
+                        fb_draw_string(20, line_y, buf, RGB(0, 255, 255), RGB(10, 10, 35));
+                        line_y += 20;
+                        sprintf(buf, "  accepted %u  rejected %u  reaped idle %u",
+                                hs.accepted, hs.rejected, hs.reaped);
+                        fb_draw_string(20, line_y, buf, RGB(200, 200, 200), RGB(10, 10, 35));
+                        line_y += 20;
+                        sprintf(buf, "  requests %u (%u on kept connections)  2xx %u  4xx %u  5xx %u",
+                                hs.requests, hs.reused, hs.status_2xx, hs.status_4xx, hs.status_5xx);
+                        fb_draw_string(20, line_y, buf, RGB(200, 200, 200), RGB(10, 10, 35));
+                        line_y += 20;
+                        sprintf(buf, "  %u KB sent  %u events  %u dispatch runs",
+                                (uint32_t)(hs.bytes_out >> 10), hs.events, hs.runs);
+                        fb_draw_string(20, line_y, buf, RGB(150, 150, 150), RGB(10, 10, 35));
+                    }
+                    // dhcp - Lease status: dhcp [renew]
+                    else if (cmd_pos >= 4 && command_buffer[0] == 'd' && command_buffer[1] == 'h' &&
+                             command_buffer[2] == 'c' && command_buffer[3] == 'p' &&
+                             (cmd_pos == 4 || command_buffer[4] == ' ')) {
+                        command_buffer[cmd_pos] = '\0';
+                        char buf[128];
+                        char* arg = command_buffer + 4;
+                        while (*arg == ' ') arg++;
+
+                        if (net_init() != 0) {
+                            line_y += 20;
+                            fb_draw_string(20, line_y, "Network init failed", RGB(255, 100, 100), RGB(10, 10, 35));
+                        } else {
+                            if (strcmp(arg, "renew") == 0) {
+                                // Drop the lease and wait for the new one
+                                dhcp_restart();
+                                line_y += 20;
+                                fb_draw_string(20, line_y, "Discovering...", RGB(200, 200, 200), RGB(10, 10, 35));
+                                dhcp_wait(DHCP_WAIT_MS);
+                            } else if (*arg) {
+                                line_y += 20;
+                                fb_draw_string(20, line_y, "Usage: dhcp [renew]", RGB(255, 100, 100), RGB(10, 10, 35));
+                            }
+
+                            dhcp_info_t dhcp;
+                            dhcp_get_info(&dhcp);
+                            char ip_str[16], mask_str[16], gw_str[16], dns_str[16];
+                            ip_to_string(dhcp.ip, ip_str);
+                            ip_to_string(dhcp.netmask, mask_str);
+                            ip_to_string(dhcp.gateway, gw_str);
+                            ip_to_string(dhcp.dns, dns_str);
+
+                            line_y += 20;
+                            sprintf(buf, "DHCP: %s%s", dhcp_state_name(dhcp.state),
+                                    dhcp.fallback ? ", no server: static defaults in use" : "");
+                            fb_draw_string(20, line_y, buf, RGB(0, 255, 255), RGB(10, 10, 35));
+                            if (dhcp.ip) {
+                                line_y += 20;
+                                sprintf(buf, "  address %s/%s  gateway %s  dns %s", ip_str, mask_str, gw_str, dns_str);
+                                fb_draw_string(20, line_y, buf, RGB(0, 255, 100), RGB(10, 10, 35));
+                            }
+                            if (dhcp.lease_secs == 0xFFFFFFFF) {
+                                ip_to_string(dhcp.server, ip_str);
+                                line_y += 20;
+                                sprintf(buf, "  server %s  lease infinite", ip_str);
+                                fb_draw_string(20, line_y, buf, RGB(200, 200, 200), RGB(10, 10, 35));
+                            } else if (dhcp.lease_secs) {
+                                ip_to_string(dhcp.server, ip_str);
+                                line_y += 20;
+                                sprintf(buf, "  server %s  lease %u s, %u s left  renew at %u s, rebind at %u s",
+                                        ip_str, dhcp.lease_secs, dhcp.remaining_secs, dhcp.t1_secs, dhcp.t2_secs);
+                                fb_draw_string(20, line_y, buf, RGB(200, 200, 200), RGB(10, 10, 35));
+                            }
+                            line_y += 20;
+                            sprintf(buf, "  discover %u  offer %u  request %u  ack %u  nak %u  renewed %u  expired %u",
+                                    dhcp.discovers, dhcp.offers, dhcp.requests, dhcp.acks, dhcp.naks,
+                                    dhcp.renewals, dhcp.expired);
+                            fb_draw_string(20, line_y, buf, RGB(150, 150, 150), RGB(10, 10, 35));
+                        }
+                    }
+                    // nslookup - Resolve names: nslookup [-flush] [NAME ...]
+                    else if (cmd_pos >= 8 && command_buffer[0] == 'n' && command_buffer[1] == 's' &&
+                             command_buffer[2] == 'l' && command_buffer[3] == 'o' && command_buffer[4] == 'o' &&
+                             command_buffer[5] == 'k' && command_buffer[6] == 'u' && command_buffer[7] == 'p' &&
+                             (cmd_pos == 8 || command_buffer[8] == ' ')) {
+                        command_buffer[cmd_pos] = '\0';
+                        char buf[128];
+                        int names = 0;
+
+                        if (net_init() != 0) {
+                            line_y += 20;
+                            fb_draw_string(20, line_y, "Network init failed", RGB(255, 100, 100), RGB(10, 10, 35));
+                        } else {
+                            char* p = command_buffer + 8;
+                            while (*p && line_y < (int)fb->height - 100) {
+                                while (*p == ' ') p++;
+                                if (!*p) break;
+                                char* name = p;
+                                while (*p && *p != ' ') p++;
+                                if (*p) *p++ = '\0';
+
+                                if (strcmp(name, "-flush") == 0) {
+                                    dns_flush();
+                                    line_y += 20;
+                                    fb_draw_string(20, line_y, "Cache flushed", RGB(0, 255, 100), RGB(10, 10, 35));
+                                    continue;
+                                }
+                                if (names++ == 0) dhcp_wait(DHCP_WAIT_MS);
+
+                                // Timed so a cache hit shows against a query
+                                dns_stats_t before, after;
+                                dns_get_stats(&before);
+                                uint64_t t0 = rdtsc();
+                                uint32_t ip;
+                                int err = dns_resolve(name, &ip);
+                                uint32_t us = (uint32_t)timer_cycles_to_us(rdtsc() - t0);
+                                dns_get_stats(&after);
+                                const char* how = after.hits + after.negative_hits != before.hits + before.negative_hits
+                                                  ? "cache" : after.coalesced != before.coalesced ? "shared query" : "query";
+
+                                line_y += 20;
+                                if (err < 0) {
+                                    // Names this long were rejected; show only what fits buf
+                                    if (strlen(name) >= DNS_NAME_MAX) name[DNS_NAME_MAX - 1] = '\0';
+                                    sprintf(buf, "%s: %s (%s, %u.%03u ms)", name, dns_strerror(err), how, us / 1000, us % 1000);
+                                    fb_draw_string(20, line_y, buf, RGB(255, 100, 100), RGB(10, 10, 35));
+                                } else {
+                                    char ip_str[16];
+                                    ip_to_string(ip, ip_str);
+                                    sprintf(buf, "%s has address %s (%s, %u.%03u ms)", name, ip_str, how, us / 1000, us % 1000);
+                                    fb_draw_string(20, line_y, buf, RGB(0, 255, 100), RGB(10, 10, 35));
+                                }
+                            }
+                        }
+
+                        // Without names: the cache and counters
+                        if (!names) {
+                            char ip_str[16];
+                            ip_to_string(dns_get_server(), ip_str);
+                            line_y += 20;
+                            sprintf(buf, "Nameserver %s", dns_get_server() ? ip_str : "(none)");
+                            fb_draw_string(20, line_y, buf, RGB(0, 255, 255), RGB(10, 10, 35));
+
+                            dns_entry_info_t entries[DNS_CACHE_SIZE];
+                            uint32_t n = dns_get_entries(entries, DNS_CACHE_SIZE);
+                            for (uint32_t i = 0; i < n && line_y < (int)fb->height - 120; i++) {
+                                ip_to_string(entries[i].ip, ip_str);
+                                line_y += 20;
+                                if (entries[i].state == DNS_POSITIVE) {
+                                    sprintf(buf, "  %-32s %-15s ttl %u s  hits %u", entries[i].name, ip_str,
+                                            entries[i].ttl, entries[i].hits);
+                                } else if (entries[i].state == DNS_NEGATIVE) {
+                                    sprintf(buf, "  %-32s %-15s ttl %u s  hits %u", entries[i].name, "(none)",
+                                            entries[i].ttl, entries[i].hits);
+                                } else {
+                                    sprintf(buf, "  %-32s (query in flight)", entries[i].name);
+                                }
+                                fb_draw_string(20, line_y, buf, RGB(200, 200, 200), RGB(10, 10, 35));
+                            }
+
+                            dns_stats_t ds;
+                            dns_get_stats(&ds);
+                            line_y += 20;
+                            sprintf(buf, "  lookups %u  hits %u (+%u negative)  misses %u  coalesced %u  evicted %u  expired %u",
+                                    ds.lookups, ds.hits, ds.negative_hits, ds.misses, ds.coalesced,
+                                    ds.evictions, ds.expired);
+                            fb_draw_string(20, line_y, buf, RGB(150, 150, 150), RGB(10, 10, 35));
+                            line_y += 20;
+                            sprintf(buf, "  queries %u (%u retransmitted)  answers %u  nxdomain %u  timeouts %u  failures %u",
+                                    ds.queries, ds.retransmits, ds.answers, ds.nxdomain, ds.timeouts, ds.failures);
+                            fb_draw_string(20, line_y, buf, RGB(150, 150, 150), RGB(10, 10, 35));
+                        }
+                    }
                     // Unknown
                     else {
                         line_y += 20;
@@ -991,8 +2363,8 @@ void kernel_main(uint32_t magic, void* multiboot_info) {
                     }
                 } else {
                     // Command completion
-                    const char* commands[] = {"help", "clear", "ls", "cat", "uname", "uptime", "echo", "free", "touch", "rm", "top", "edit", "ping", "ifconfig", "wget"};
-                    int num_commands = 15;
+                    const char* commands[] = {"help", "clear", "ls", "cat", "uname", "uptime", "echo", "free", "touch", "rm", "top", "edit", "ping", "ifconfig", "wget", "smp", "smpbench", "schedbench", "lockstat", "rcubench", "irqstat", "irqlat", "lspci", "pcibench", "netstat", "txbench", "rssbench", "arp", "route", "udpbench", "tcpbench", "httpd", "dhcp", "nslookup"};
+                    int num_commands = 34;
                     
                     for (int i = 0; i < num_commands; i++) {
                         // Check if command starts with buffer
@@ -1045,6 +2417,7 @@ void kernel_main(uint32_t magic, void* multiboot_info) {
             }
         }
         
-        for (volatile int d = 0; d < 10000; d++);
+        // Idle point: run queued kernel tasks, account idle time
+        sched_idle_wait(20);
     }
 }
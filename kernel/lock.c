@@ -0,0 +1,287 @@
+#include "lock.h"
+#include "smp.h"
+#include "timer.h"
+#include "string.h"
+#include <stddef.h>
+
+static inline void cpu_relax(void) {
+    __asm__ volatile ("pause" : : : "memory");
+}
+
+#ifdef LOCK_STATS
+
+// Per-CPU slots so recording a sample never bounces a shared line
+typedef struct {
+    uint64_t acquires;
+    uint64_t contended;
+    uint64_t spin_cycles;
+    uint64_t hold_cycles;
+    uint64_t max_hold;
+} __attribute__((aligned(64))) lock_cpu_stats_t;
+
+struct lock_class {
+    const char* name;
+    lock_cpu_stats_t cpu[MAX_CPUS];
+};
+
+static lock_class_t lock_classes[LOCK_CLASS_MAX];
+static volatile uint32_t lock_class_used = 0;    // Published after the slot's name
+static volatile uint32_t lock_class_busy = 0;    // Serializes registration
+
+static lock_class_t* lock_class_find(const char* name, uint32_t used) {
+    for (uint32_t i = 0; i < used; i++) {
+        if (strcmp(lock_classes[i].name, name) == 0) {
+            return &lock_classes[i];
+        }
+    }
+    return NULL;
+}
+
+// Locks with the same name share a class. Lookups are lock-free; a new
+// class is added under a bare test-and-set lock (the spinlock would
+// recurse into this) so two CPUs registering one name get one class.
+static lock_class_t* lock_class_lookup(const char* name) {
+    if (!name) return NULL;
+
+    lock_class_t* cls = lock_class_find(name, __atomic_load_n(&lock_class_used, __ATOMIC_ACQUIRE));
+    if (cls) return cls;
+
+    uint32_t flags = irq_save();
+    while (__atomic_exchange_n(&lock_class_busy, 1, __ATOMIC_ACQUIRE)) {
+        cpu_relax();
+    }
+
+    uint32_t used = lock_class_used;
+    cls = lock_class_find(name, used);
+    if (!cls && used < LOCK_CLASS_MAX) {
+        cls = &lock_classes[used];
+        cls->name = name;
+        __atomic_store_n(&lock_class_used, used + 1, __ATOMIC_RELEASE);
+    }
+
+    __atomic_store_n(&lock_class_busy, 0, __ATOMIC_RELEASE);
+    irq_restore(flags);
+    return cls;
+}
+
+static inline void stats_acquired(lock_class_t* cls, uint64_t* acquired_at,
+                                  uint64_t start, int contended) {
+    uint64_t now = rdtsc();
+    *acquired_at = now;
+    if (!cls) return;
+
+    lock_cpu_stats_t* s = &cls->cpu[smp_cpu_id()];
+    s->acquires++;
+    if (contended) {
+        s->contended++;
+        s->spin_cycles += now - start;
+    }
+}
+
+static inline void stats_released(lock_class_t* cls, uint64_t acquired_at) {
+    if (!cls) return;
+
+    uint64_t hold = rdtsc() - acquired_at;
+    lock_cpu_stats_t* s = &cls->cpu[smp_cpu_id()];
+    s->hold_cycles += hold;
+    if (hold > s->max_hold) {
+        s->max_hold = hold;
+    }
+}
+
+#define STATS_START()                uint64_t stats_start = rdtsc()
+#define STATS_ACQUIRED(l, contended) stats_acquired((l)->cls, &(l)->acquired_at, stats_start, contended)
+#define STATS_RELEASED(l)            stats_released((l)->cls, (l)->acquired_at)
+#define STATS_INIT(l, name)          ((l)->cls = lock_class_lookup(name), (l)->acquired_at = 0)
+
+#else
+
+#define STATS_START()                do { } while (0)
+#define STATS_ACQUIRED(l, contended) do { (void)(contended); } while (0)
+#define STATS_RELEASED(l)            do { } while (0)
+#define STATS_INIT(l, name)          do { (void)(name); } while (0)
+
+#endif
+
+// ---- Spinlock -----------------------------------------------------------
+
+void spin_lock_init(spinlock_t* lock, const char* name) {
+    lock->locked = 0;
+    STATS_INIT(lock, name);
+}
+
+void spin_lock(spinlock_t* lock) {
+    STATS_START();
+    int contended = 0;
+
+    while (__atomic_exchange_n(&lock->locked, 1, __ATOMIC_ACQUIRE)) {
+        contended = 1;
+        // Spin on a plain read so the line stays shared while we wait
+        while (__atomic_load_n(&lock->locked, __ATOMIC_RELAXED)) {
+            cpu_relax();
+        }
+    }
+
+    STATS_ACQUIRED(lock, contended);
+}
+
+int spin_trylock(spinlock_t* lock) {
+    STATS_START();
+    if (__atomic_load_n(&lock->locked, __ATOMIC_RELAXED) ||
+        __atomic_exchange_n(&lock->locked, 1, __ATOMIC_ACQUIRE)) {
+        return 0;
+    }
+    STATS_ACQUIRED(lock, 0);
+    return 1;
+}
+
+void spin_unlock(spinlock_t* lock) {
+    STATS_RELEASED(lock);
+    __atomic_store_n(&lock->locked, 0, __ATOMIC_RELEASE);
+}
+
+uint32_t spin_lock_irqsave(spinlock_t* lock) {
+    uint32_t flags = irq_save();
+    spin_lock(lock);
+    return flags;
+}
+
+void spin_unlock_irqrestore(spinlock_t* lock, uint32_t flags) {
+    spin_unlock(lock);
+    irq_restore(flags);
+}
+
+// ---- Ticket lock --------------------------------------------------------
+
+void ticket_lock_init(ticket_lock_t* lock, const char* name) {
+    lock->next = 0;
+    lock->owner = 0;
+    STATS_INIT(lock, name);
+}
+
+void ticket_lock(ticket_lock_t* lock) {
+    STATS_START();
+    uint32_t ticket = __atomic_fetch_add(&lock->next, 1, __ATOMIC_RELAXED);
+    int contended = 0;
+
+    while (__atomic_load_n(&lock->owner, __ATOMIC_ACQUIRE) != ticket) {
+        contended = 1;
+        cpu_relax();
+    }
+
+    STATS_ACQUIRED(lock, contended);
+}
+
+void ticket_unlock(ticket_lock_t* lock) {
+    STATS_RELEASED(lock);
+    // Only the holder writes owner, so a plain increment is enough
+    __atomic_store_n(&lock->owner, lock->owner + 1, __ATOMIC_RELEASE);
+}
+
+// ---- MCS lock -----------------------------------------------------------
+
+void mcs_lock_init(mcs_lock_t* lock, const char* name) {
+    lock->tail = NULL;
+    STATS_INIT(lock, name);
+}
+
+void mcs_lock(mcs_lock_t* lock, mcs_node_t* node) {
+    STATS_START();
+    node->next = NULL;
+    node->locked = 1;
+
+    mcs_node_t* prev = __atomic_exchange_n(&lock->tail, node, __ATOMIC_ACQ_REL);
+    int contended = prev != NULL;
+
+    if (prev) {
+        // Queue behind the previous waiter and spin on our own node
+        __atomic_store_n(&prev->next, node, __ATOMIC_RELEASE);
+        while (__atomic_load_n(&node->locked, __ATOMIC_ACQUIRE)) {
+            cpu_relax();
+        }
+    }
+
+    STATS_ACQUIRED(lock, contended);
+}
+
+void mcs_unlock(mcs_lock_t* lock, mcs_node_t* node) {
+    STATS_RELEASED(lock);
+
+    mcs_node_t* next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE);
+    if (!next) {
+        // No known successor: try to swing the tail back to empty
+        mcs_node_t* expected = node;
+        if (__atomic_compare_exchange_n(&lock->tail, &expected, NULL, 0,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+            return;
+        }
+        // A successor is linking itself in; wait for it
+        while (!(next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE))) {
+            cpu_relax();
+        }
+    }
+
+    __atomic_store_n(&next->locked, 0, __ATOMIC_RELEASE);
+}
+
+// ---- Statistics ---------------------------------------------------------
+
+#ifdef LOCK_STATS
+
+int lock_stats_enabled(void) {
+    return 1;
+}
+
+uint32_t lock_class_count(void) {
+    return __atomic_load_n(&lock_class_used, __ATOMIC_ACQUIRE);
+}
+
+const char* lock_class_get(uint32_t index, lock_stats_t* stats) {
+    if (index >= lock_class_count()) return NULL;
+
+    lock_class_t* cls = &lock_classes[index];
+    stats->acquires = 0;
+    stats->contended = 0;
+    stats->spin_cycles = 0;
+    stats->hold_cycles = 0;
+    stats->max_hold = 0;
+
+    for (int c = 0; c < MAX_CPUS; c++) {
+        lock_cpu_stats_t* s = &cls->cpu[c];
+        stats->acquires += s->acquires;
+        stats->contended += s->contended;
+        stats->spin_cycles += s->spin_cycles;
+        stats->hold_cycles += s->hold_cycles;
+        if (s->max_hold > stats->max_hold) {
+            stats->max_hold = s->max_hold;
+        }
+    }
+    return cls->name;
+}
+
+void lock_stats_reset(void) {
+    for (uint32_t i = 0; i < lock_class_count(); i++) {
+        memset(lock_classes[i].cpu, 0, sizeof(lock_classes[i].cpu));
+    }
+}
+
+#else
+
+int lock_stats_enabled(void) {
+    return 0;
+}
+
+uint32_t lock_class_count(void) {
+    return 0;
+}
+
+const char* lock_class_get(uint32_t index, lock_stats_t* stats) {
+    (void)index;
+    (void)stats;
+    return NULL;
+}
+
+void lock_stats_reset(void) {
+}
+
+#endif
@@ -1,6 +1,7 @@
 #include "multiboot2.h"
 #include "framebuffer.h"
 #include "serial.h"
+#include "acpi.h"
 
 void multiboot2_parse(uint32_t magic, void* mbi) {
     if (magic != MULTIBOOT2_MAGIC) {
@@ -77,6 +78,14 @@ void multiboot2_parse(uint32_t magic, void* mbi) {
                 serial_write(" KB\n");
                 break;
             }
+
+            case MULTIBOOT_TAG_TYPE_ACPI_OLD:
+            case MULTIBOOT_TAG_TYPE_ACPI_NEW: {
+                struct multiboot_tag_acpi* acpi_tag = (struct multiboot_tag_acpi*)tag;
+                serial_write("Multiboot2: ACPI RSDP found\n");
+                acpi_set_rsdp(acpi_tag->rsdp);
+                break;
+            }
         }
         
         // Move to next tag (align to 8 bytes)
@@ -1,21 +1,67 @@
 #include "net.h"
 #include "e1000.h"
+#include "e1000e.h"
+#include "virtio_net.h"
+#include "string.h"
+#include "checksum.h"
+#include "arp.h"
+#include "ip.h"
+#include "icmp.h"
+#include "udp.h"
+#include "tcp.h"
+#include "dhcp.h"
+#include "dns.h"
+#include "timer.h"
 #include "serial.h"
 #include <stddef.h>
 
 static net_interface_t net_if;
+static int net_state = -2;   // -2 before net_init(), then its result
+
+// Receive dispatch by ethertype
+typedef struct {
+    uint16_t ethertype;
+    net_rx_handler_t handler;
+} net_proto_t;
+
+static net_proto_t protocols[NET_MAX_PROTOCOLS];
+static uint32_t num_protocols = 0;
+static net_stats_t stats;
+
+// Device every transmit goes through; 0 without a NIC
+static netdev_t* netdev = NULL;
+
+// Whether the NIC inserts transmit checksums
+static int tx_csum_offload = 0;
+
+// Protocol timers, driven by the timer softirq
+static void net_tick(void) {
+    arp_tick();
+    tcp_tick();
+    dhcp_tick();
+}
 
 int net_init(void) {
+    // Called at boot and again by network commands; bring the NIC up once
+    if (net_state != -2) return net_state;
+
     serial_write("Network: Initializing...\n");
     
-    // Initialize E1000 driver
-    int result = e1000_driver_init();
-    if (result == 0) {
-        // Get MAC from hardware
-        e1000_get_mac(net_if.mac);
-        serial_write("Network: Using hardware MAC\n");
+    // Paravirtual NIC first: it needs no register emulation per packet,
+    // so when QEMU offers both it is the faster path
+    netdev = virtio_net_driver_init();
+    if (!netdev) netdev = e1000e_driver_init();
+    if (!netdev) netdev = e1000_driver_init();
+
+    int result = netdev ? 0 : -1;
+    if (netdev) {
+        memcpy(net_if.mac, netdev->mac, 6);
+        serial_write("Network: Using ");
+        serial_write(netdev->name);
+        serial_write(" with hardware MAC\n");
+        tx_csum_offload = (netdev->features & NETDEV_F_TX_CSUM) != 0;
     } else {
-        serial_write("Network: E1000 init failed, using defaults\n");
+        serial_write("Network: No NIC found, using defaults\n");
         // Fallback MAC address
         net_if.mac[0] = 0x52;
         net_if.mac[1] = 0x54;
@@ -25,19 +71,55 @@ int net_init(void) {
         net_if.mac[5] = 0x56;
     }
     
-    // Default IP: 10.0.2.15 (QEMU default)
-    net_if.ip = (10 << 24) | (0 << 16) | (2 << 8) | 15;
-    net_if.netmask = (255 << 24) | (255 << 16) | (255 << 8) | 0;
-    net_if.gateway = (10 << 24) | (0 << 16) | (2 << 8) | 2;
+    // No address until DHCP leases one (or falls back to the defaults)
+    net_if.ip = 0;
+    net_if.netmask = 0;
+    net_if.gateway = 0;
     
+    if (netdev) {
+        arp_init();
+        ip_init();
+        icmp_init();
+        udp_init();
+        tcp_init();
+        dns_init();
+        timer_add_hook(net_tick);
+    }
+
     serial_write("Network: Initialized\n");
+    net_state = result;
+
+    // Lease an address in the background; net_set_ip() needs net_state
+    if (netdev) dhcp_start();
     return result;
 }
 
+void net_register_protocol(uint16_t ethertype, net_rx_handler_t handler) {
+    for (uint32_t i = 0; i < num_protocols; i++) {
+        if (protocols[i].ethertype == ethertype) {
+            protocols[i].handler = handler;
+            return;
+        }
+    }
+    if (num_protocols < NET_MAX_PROTOCOLS) {
+        protocols[num_protocols].ethertype = ethertype;
+        protocols[num_protocols].handler = handler;
+        num_protocols++;
+    }
+}
+
+void net_get_stats(net_stats_t* out) {
+    *out = stats;
+}
+
 void net_set_ip(uint32_t ip, uint32_t netmask, uint32_t gateway) {
     net_if.ip = ip;
     net_if.netmask = netmask;
     net_if.gateway = gateway;
+    if (net_state == 0) {
+        ip_update_interface();
+        arp_announce();
+    }
 }
 
 void net_get_mac(uint8_t* mac) {
@@ -46,107 +128,138 @@ void net_get_mac(uint8_t* mac) {
     }
 }
 
+void net_get_interface(net_interface_t* nif) {
+    *nif = net_if;
+}
+
 uint16_t net_checksum(void* data, int length) {
-    uint32_t sum = 0;
-    uint16_t* ptr = (uint16_t*)data;
-    
-    while (length > 1) {
-        sum += *ptr++;
-        length -= 2;
-    }
-    
-    if (length > 0) {
-        sum += *(uint8_t*)ptr;
+    return csum_compute(data, (uint32_t)length);
+}
+
+netdev_t* net_get_device(void) {
+    return netdev;
+}
+
+void net_send_packet(uint8_t* data, uint32_t length) {
+    if (net_queue_packet(data, length) == 0) {
+        net_flush();
     }
-    
-    while (sum >> 16) {
-        sum = (sum & 0xFFFF) + (sum >> 16);
+}
+
+int net_queue_packet(uint8_t* data, uint32_t length) {
+    pktbuf_t* pb = pktbuf_alloc();
+    if (!pb) return -1;
+
+    uint8_t* dst = pktbuf_append(pb, length);
+    if (!dst) {
+        pktbuf_put(pb);
+        return -1;
     }
-    
-    return ~sum;
+    memcpy(dst, data, length);
+    return net_xmit(pb);
 }
 
-void net_send_packet(uint8_t* data, uint32_t length) {
-    // Send via E1000 hardware
-    e1000_driver_send(data, length);
-    
-    serial_write("Network: Sent ");
-    char buf[16];
-    int i = 0;
-    uint32_t len = length;
-    if (len == 0) {
-        serial_write("0");
-    } else {
-        while (len > 0) {
-            buf[i++] = '0' + (len % 10);
-            len /= 10;
-        }
-        buf[i] = '\0';
-        // Reverse the string
-        for (int j = 0; j < i / 2; j++) {
-            char tmp = buf[j];
-            buf[j] = buf[i - j - 1];
-            buf[i - j - 1] = tmp;
-        }
-        serial_write(buf);
+void net_set_csum_offload(int enable) {
+    tx_csum_offload = enable && netdev && (netdev->features & NETDEV_F_TX_CSUM);
+}
+
+int net_csum_offload(void) {
+    return tx_csum_offload;
+}
+
+void net_tx_csum(pktbuf_t* pb, uint8_t* start, uint32_t offset) {
+    uint32_t head_off = start - pb->head;
+    uint32_t length = pb->data + pb->len - start;
+
+    // Keep within what every driver can describe (e1000 CSS/CSO are 8-bit
+    // frame offsets); the Ethernet header still to be pushed is at most
+    // PKTBUF_HEADROOM bytes in front of start
+    if (tx_csum_offload && head_off <= PKTBUF_HEADROOM + 64 && offset < 64) {
+        pb->csum_start = head_off;
+        pb->csum_offset = offset;
+        pb->csum_flags |= PKTBUF_CSUM_PARTIAL;
+        stats.tx_csum_offload++;
+        return;
     }
-    serial_write(" bytes\n");
+
+    // The field holds the seed (0 or the pseudo-header sum); fold it in
+    uint16_t* field = (uint16_t*)(start + offset);
+    *field = net_checksum(start, length);
+    stats.tx_csum_sw++;
 }
 
-void net_receive_packet(uint8_t* data, uint32_t length) {
-    (void)data;
-    (void)length;
-    // Process received packet
+int net_rx_csum_ok(pktbuf_t* pb, int layer, void* data, int length, uint32_t seed) {
+    uint8_t ok = (layer == NET_CSUM_IP) ? PKTBUF_CSUM_IP_OK : PKTBUF_CSUM_L4_OK;
+    uint8_t bad = (layer == NET_CSUM_IP) ? PKTBUF_CSUM_IP_BAD : PKTBUF_CSUM_L4_BAD;
+
+    if (pb->csum_flags & ok) {
+        stats.rx_csum_hw++;
+        return 1;
+    }
+    if (pb->csum_flags & bad) {
+        stats.rx_csum_hw_bad++;
+        return 0;
+    }
+
+    // A valid region sums to 0xFFFF, so its complement is zero
+    stats.rx_csum_sw++;
+    return csum_fold(csum_partial(data, (uint32_t)length, seed)) == 0;
 }
 
-int net_ping(uint32_t dest_ip) {
-    serial_write("Network: Sending ICMP echo request to ");
-    
-    char ip_str[16];
-    ip_to_string(dest_ip, ip_str);
-    serial_write(ip_str);
-    serial_write("\n");
-    
-    // Build ICMP packet
-    uint8_t packet[128];
-    eth_header_t* eth = (eth_header_t*)packet;
-    ip_header_t* ip = (ip_header_t*)(packet + sizeof(eth_header_t));
-    icmp_header_t* icmp = (icmp_header_t*)(packet + sizeof(eth_header_t) + sizeof(ip_header_t));
-    
-    // Ethernet header (broadcast for simplicity)
-    for (int i = 0; i < 6; i++) {
-        eth->dest_mac[i] = 0xFF;
-        eth->src_mac[i] = net_if.mac[i];
+int net_xmit(pktbuf_t* pb) {
+    if (!netdev || netdev->ops->xmit(pb) < 0) {
+        pktbuf_put(pb);
+        return -1;
     }
-    eth->ethertype = 0x0008; // IP (big endian)
-    
-    // IP header
-    ip->version_ihl = 0x45; // IPv4, 20 bytes
-    ip->tos = 0;
-    ip->total_length = sizeof(ip_header_t) + sizeof(icmp_header_t);
-    ip->id = 0x1234;
-    ip->flags_fragment = 0;
-    ip->ttl = 64;
-    ip->protocol = 1; // ICMP
-    ip->src_ip = net_if.ip;
-    ip->dest_ip = dest_ip;
-    ip->checksum = 0;
-    ip->checksum = net_checksum(ip, sizeof(ip_header_t));
-    
-    // ICMP header
-    icmp->type = 8; // Echo request
-    icmp->code = 0;
-    icmp->id = 0x1234;
-    icmp->sequence = 1;
-    icmp->checksum = 0;
-    icmp->checksum = net_checksum(icmp, sizeof(icmp_header_t));
-    
-    uint32_t total_length = sizeof(eth_header_t) + sizeof(ip_header_t) + sizeof(icmp_header_t);
-    net_send_packet(packet, total_length);
-    
+    stats.tx_packets++;
     return 0;
 }
 
+int net_eth_xmit(pktbuf_t* pb, const uint8_t* dest_mac, uint16_t ethertype) {
+    eth_header_t* eth = (eth_header_t*)pktbuf_push(pb, sizeof(eth_header_t));
+    if (!eth) {
+        pktbuf_put(pb);
+        return -1;
+    }
+    memcpy(eth->dest_mac, dest_mac, ETH_ALEN);
+    memcpy(eth->src_mac, net_if.mac, ETH_ALEN);
+    eth->ethertype = htons(ethertype);
+    return net_xmit(pb);
+}
+
+void net_flush(void) {
+    if (netdev) netdev->ops->flush();
+}
+
+int net_tx_wait(void) {
+    return netdev ? netdev->ops->tx_wait() : -1;
+}
+
+// Called by the NIC's receive poll loop (NET_RX softirq) with the buffer
+// the frame was DMAed into. Handlers borrow it for the duration of the
+// call and take their own reference to keep it.
+void net_receive(pktbuf_t* pb) {
+    stats.rx_packets++;
+    stats.rx_bytes += pb->len;
+
+    if (pb->len < sizeof(eth_header_t)) {
+        stats.rx_dropped++;
+        pktbuf_put(pb);
+        return;
+    }
+
+    uint16_t ethertype = ((uint16_t)pb->data[12] << 8) | pb->data[13];
+    for (uint32_t i = 0; i < num_protocols; i++) {
+        if (protocols[i].ethertype == ethertype) {
+            protocols[i].handler(pb);
+            pktbuf_put(pb);
+            return;
+        }
+    }
+    stats.rx_unhandled++;
+    pktbuf_put(pb);
+}
+
 uint32_t ip_from_string(const char* str) {
     uint32_t ip = 0;
     uint32_t octet = 0;
@@ -196,50 +309,5 @@ void e1000_init(void) {
 }
 
 void e1000_send(uint8_t* data, uint32_t length) {
-    e1000_driver_send(data, length);
-}
-
-int e1000_receive(uint8_t* buffer, uint32_t max_length) {
-    return e1000_driver_receive(buffer, max_length);
-}
-
-// Simple HTTP GET implementation (simulated)
-int net_http_get(const char* url, char* buffer, int max_size) {
-    serial_write("HTTP: GET ");
-    serial_write(url);
-    serial_write("\n");
-    
-    // Simulated response
-    const char* response = 
-        "HTTP/1.1 200 OK\n"
-        "Content-Type: text/html\n"
-        "\n"
-        "<!DOCTYPE html>\n"
-        "<html>\n"
-        "<head><title>NiceTop OS</title></head>\n"
-        "<body>\n"
-        "<h1>Welcome to NiceTop OS!</h1>\n"
-        "<p>This is a simulated HTTP response.</p>\n"
-        "<p>Requested URL: ";
-    
-    int i = 0;
-    while (response[i] && i < max_size - 1) {
-        buffer[i] = response[i];
-        i++;
-    }
-    
-    // Add URL to response
-    int j = 0;
-    while (url[j] && i < max_size - 20) {
-        buffer[i++] = url[j++];
-    }
-    
-    const char* end = "</p>\n</body>\n</html>\n";
-    j = 0;
-    while (end[j] && i < max_size - 1) {
-        buffer[i++] = end[j++];
-    }
-    
-    buffer[i] = '\0';
-    return i;
+    net_send_packet(data, length);
 }
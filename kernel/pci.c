@@ -1,5 +1,11 @@
 #include "pci.h"
 #include "serial.h"
+#include "smp.h"
+#include "apic.h"
+#include "string.h"
+#include "acpi.h"
+#include "lock.h"
+#include "timer.h"
 
 static inline void outl(uint16_t port, uint32_t val) {
     __asm__ volatile ("outl %0, %1" : : "a"(val), "Nd"(port));
@@ -11,55 +17,556 @@ static inline uint32_t inl(uint16_t port) {
     return ret;
 }
 
-void pci_init(void) {
-    serial_write("PCI: Initializing...\n");
+static pci_device_t devices[PCI_MAX_DEVICES];
+static uint32_t num_devices = 0;
+static int initialized = 0;
+
+// Buses already scanned, so a misconfigured bridge cannot loop
+static uint32_t bus_seen[256 / 32];
+
+// Heads of the vendor/device and class hash chains
+static int16_t id_hash[PCI_HASH_SIZE];
+static int16_t class_hash[PCI_HASH_SIZE];
+
+static inline uint32_t pci_id_bucket(uint16_t vendor_id, uint16_t device_id) {
+    uint32_t key = ((uint32_t)vendor_id << 16) | device_id;
+    return (key * 2654435761u) >> (32 - PCI_HASH_BITS);   // Top bits of a Fibonacci hash
 }
 
-uint32_t pci_read_config(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset) {
+static inline uint32_t pci_class_bucket(uint8_t class_code, uint8_t subclass) {
+    uint32_t key = ((uint32_t)class_code << 8) | subclass;
+    return (key * 2654435761u) >> (32 - PCI_HASH_BITS);
+}
+
+// ECAM window for segment 0, from the ACPI MCFG table
+static volatile uint8_t* ecam_base = 0;
+static uint8_t ecam_start_bus = 0;
+static uint8_t ecam_end_bus = 0;
+static int config_mode = PCI_CONFIG_PORTIO;
+
+// 0xCF8 holds a global address, so the address/data pair must not
+// interleave between CPUs or with an interrupt handler
+static spinlock_t portio_lock;
+
+static uint32_t pci_portio_read(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset) {
     uint32_t address = (uint32_t)((bus << 16) | (slot << 11) | (func << 8) | (offset & 0xFC) | 0x80000000);
+    uint32_t flags = spin_lock_irqsave(&portio_lock);
     outl(PCI_CONFIG_ADDRESS, address);
-    return inl(PCI_CONFIG_DATA);
+    uint32_t value = inl(PCI_CONFIG_DATA);
+    spin_unlock_irqrestore(&portio_lock, flags);
+    return value;
 }
 
-void pci_write_config(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset, uint32_t value) {
+static void pci_portio_write(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset, uint32_t value) {
     uint32_t address = (uint32_t)((bus << 16) | (slot << 11) | (func << 8) | (offset & 0xFC) | 0x80000000);
+    uint32_t flags = spin_lock_irqsave(&portio_lock);
     outl(PCI_CONFIG_ADDRESS, address);
     outl(PCI_CONFIG_DATA, value);
+    spin_unlock_irqrestore(&portio_lock, flags);
 }
 
-pci_device_t* pci_find_device(uint16_t vendor_id, uint16_t device_id) {
-    static pci_device_t device;
-    
-    // Only scan bus 0 for speed
-    for (uint8_t slot = 0; slot < 32; slot++) {
-        uint32_t config = pci_read_config(0, slot, 0, 0);
-        uint16_t vid = config & 0xFFFF;
-        uint16_t did = (config >> 16) & 0xFFFF;
-        
-        if (vid == 0xFFFF) continue;
-        
-        if (vid == vendor_id && did == device_id) {
-            device.vendor_id = vid;
-            device.device_id = did;
-            device.bus = 0;
-            device.slot = slot;
-            device.func = 0;
-            device.bar0 = pci_get_bar(0, slot, 0, 0);
-            device.bar1 = pci_get_bar(0, slot, 0, 1);
-            
-            // Get IRQ
-            uint32_t irq_config = pci_read_config(0, slot, 0, 0x3C);
-            device.irq = irq_config & 0xFF;
-            
-            serial_write("PCI: Found device at slot ");
-            return &device;
+// Address of a config dword in the ECAM window, or NULL when the bus is
+// outside it. Each access is a single independent MMIO load or store.
+static volatile uint32_t* pci_ecam_addr(uint8_t bus, uint8_t slot, uint8_t func, uint16_t offset) {
+    if (!ecam_base || bus < ecam_start_bus || bus > ecam_end_bus) return 0;
+    uint32_t off = ((uint32_t)(bus - ecam_start_bus) << 20) | ((uint32_t)slot << 15) |
+                   ((uint32_t)func << 12) | (offset & 0xFFC);
+    return (volatile uint32_t*)(ecam_base + off);
+}
+
+static uint32_t pci_read_mode(int mode, uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset) {
+    if (mode == PCI_CONFIG_ECAM) {
+        volatile uint32_t* addr = pci_ecam_addr(bus, slot, func, offset);
+        if (addr) return *addr;
+    }
+    return pci_portio_read(bus, slot, func, offset);
+}
+
+uint32_t pci_read_config(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset) {
+    return pci_read_mode(config_mode, bus, slot, func, offset);
+}
+
+void pci_write_config(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset, uint32_t value) {
+    if (config_mode == PCI_CONFIG_ECAM) {
+        volatile uint32_t* addr = pci_ecam_addr(bus, slot, func, offset);
+        if (addr) {
+            *addr = value;
+            return;
         }
     }
-    
+    pci_portio_write(bus, slot, func, offset, value);
+}
+
+uint32_t pci_read_config_ext(uint8_t bus, uint8_t slot, uint8_t func, uint16_t offset) {
+    if (offset < PCI_CONFIG_SPACE_SIZE) return pci_read_config(bus, slot, func, offset);
+
+    volatile uint32_t* addr = pci_ecam_addr(bus, slot, func, offset);
+    if (!addr || offset >= PCI_CONFIG_EXT_SPACE_SIZE) return 0xFFFFFFFF;
+    return *addr;
+}
+
+void pci_write_config_ext(uint8_t bus, uint8_t slot, uint8_t func, uint16_t offset, uint32_t value) {
+    if (offset < PCI_CONFIG_SPACE_SIZE) {
+        pci_write_config(bus, slot, func, offset, value);
+        return;
+    }
+
+    volatile uint32_t* addr = pci_ecam_addr(bus, slot, func, offset);
+    if (addr && offset < PCI_CONFIG_EXT_SPACE_SIZE) *addr = value;
+}
+
+// Pick up the segment 0 ECAM window from MCFG. Needs acpi_init().
+static void pci_ecam_init(void) {
+    acpi_mcfg_t* mcfg = (acpi_mcfg_t*)acpi_find_table("MCFG");
+    if (!mcfg) {
+        serial_write("PCI: No MCFG, using port I/O configuration access\n");
+        return;
+    }
+
+    uint32_t count = (mcfg->header.length - sizeof(acpi_mcfg_t)) / sizeof(acpi_mcfg_entry_t);
+    acpi_mcfg_entry_t* entries = (acpi_mcfg_entry_t*)(mcfg + 1);
+
+    for (uint32_t i = 0; i < count; i++) {
+        acpi_mcfg_entry_t* e = &entries[i];
+
+        // Without paging only windows below 4 GiB are reachable
+        if (e->segment != 0 || (e->base_address >> 32) != 0) continue;
+
+        // The table's base corresponds to bus 0 even when start_bus is not
+        ecam_base = (volatile uint8_t*)(uint32_t)e->base_address + ((uint32_t)e->start_bus << 20);
+        ecam_start_bus = e->start_bus;
+        ecam_end_bus = e->end_bus;
+        config_mode = PCI_CONFIG_ECAM;
+
+        char buf[80];
+        sprintf(buf, "PCI: ECAM at 0x%08x, buses %u-%u\n",
+                (uint32_t)e->base_address, ecam_start_bus, ecam_end_bus);
+        serial_write(buf);
+        return;
+    }
+
+    serial_write("PCI: MCFG has no usable window, using port I/O\n");
+}
+
+int pci_ecam_available(void) {
+    return ecam_base != 0;
+}
+
+int pci_get_config_mode(void) {
+    return config_mode;
+}
+
+int pci_set_config_mode(int mode) {
+    if (mode == PCI_CONFIG_ECAM && !ecam_base) return -1;
+    config_mode = mode;
+    return 0;
+}
+
+int pci_bench_scan(int mode, pci_scan_result_t* result) {
+    if (mode == PCI_CONFIG_ECAM && !ecam_base) return -1;
+
+    uint32_t reads = 0;
+    uint32_t functions = 0;
+    uint64_t start = rdtsc();
+
+    for (uint32_t bus = 0; bus < 256; bus++) {
+        for (uint8_t slot = 0; slot < 32; slot++) {
+            for (uint8_t func = 0; func < 8; func++) {
+                uint32_t id = pci_read_mode(mode, bus, slot, func, PCI_REG_VENDOR);
+                reads++;
+                if ((id & 0xFFFF) == 0xFFFF) {
+                    if (func == 0) break;   // Empty slot
+                    continue;
+                }
+
+                functions++;
+                for (uint8_t off = 4; off < 64; off += 4) {
+                    pci_read_mode(mode, bus, slot, func, off);
+                    reads++;
+                }
+
+                if (func == 0 && !((pci_read_mode(mode, bus, slot, 0, PCI_REG_HEADER) >> 16) &
+                                   PCI_HEADER_MULTIFUNC)) {
+                    break;
+                }
+            }
+        }
+    }
+
+    result->cycles = rdtsc() - start;
+    result->reads = reads;
+    result->functions = functions;
     return 0;
 }
 
 uint32_t pci_get_bar(uint8_t bus, uint8_t slot, uint8_t func, uint8_t bar_num) {
-    uint32_t bar = pci_read_config(bus, slot, func, 0x10 + (bar_num * 4));
+    uint32_t bar = pci_read_config(bus, slot, func, PCI_REG_BAR0 + (bar_num * 4));
     return bar & 0xFFFFFFF0; // Mask off lower bits
 }
+
+static void pci_read_capabilities(pci_device_t* dev) {
+    dev->num_caps = 0;
+
+    uint32_t status = pci_read_config(dev->bus, dev->slot, dev->func, PCI_REG_COMMAND) >> 16;
+    if (!(status & PCI_STATUS_CAP_LIST)) return;
+
+    uint8_t offset = pci_read_config(dev->bus, dev->slot, dev->func, PCI_REG_CAP_PTR) & 0xFC;
+
+    // Bound the walk in case of a malformed (looping) list
+    for (int i = 0; i < 48 && offset >= 0x40 && dev->num_caps < PCI_MAX_CAPS; i++) {
+        uint32_t header = pci_read_config(dev->bus, dev->slot, dev->func, offset);
+        dev->caps[dev->num_caps].id = header & 0xFF;
+        dev->caps[dev->num_caps].offset = offset;
+        dev->num_caps++;
+        offset = (header >> 8) & 0xFC;
+    }
+}
+
+// Size each BAR by writing all ones and reading back the writable mask.
+// Decoding is switched off meanwhile so the probe value never claims
+// address space.
+static void pci_size_bars(pci_device_t* dev, uint32_t num_bars) {
+    uint32_t cmd = pci_read_config(dev->bus, dev->slot, dev->func, PCI_REG_COMMAND) & 0xFFFF;
+    pci_write_config(dev->bus, dev->slot, dev->func, PCI_REG_COMMAND,
+                     cmd & ~(PCI_COMMAND_IO | PCI_COMMAND_MEMORY));
+
+    for (uint32_t i = 0; i < num_bars; i++) {
+        uint8_t reg = PCI_REG_BAR0 + i * 4;
+        uint32_t orig = pci_read_config(dev->bus, dev->slot, dev->func, reg);
+
+        pci_write_config(dev->bus, dev->slot, dev->func, reg, 0xFFFFFFFF);
+        uint32_t mask = pci_read_config(dev->bus, dev->slot, dev->func, reg);
+        pci_write_config(dev->bus, dev->slot, dev->func, reg, orig);
+
+        if (mask == 0 || mask == 0xFFFFFFFF) continue;
+
+        if (orig & PCI_BAR_IO) {
+            dev->bar_is_io |= 1 << i;
+            dev->bar[i] = orig & 0xFFFFFFFC;
+            dev->bar_size[i] = (~(mask & 0xFFFFFFFC) + 1) & 0xFFFF;
+        } else {
+            dev->bar[i] = orig & 0xFFFFFFF0;
+            dev->bar_size[i] = ~(mask & 0xFFFFFFF0) + 1;
+
+            // Skip the upper half of a 64-bit BAR so it is not mistaken for
+            // a BAR of its own. Above 4 GiB the window is unreachable
+            // without paging, so report it as unassigned.
+            if ((orig & 0x6) == PCI_BAR_MEM_TYPE_64 && i + 1 < num_bars) {
+                i++;
+                if (pci_read_config(dev->bus, dev->slot, dev->func, reg + 4) != 0) {
+                    dev->bar[i - 1] = 0;
+                }
+            }
+        }
+    }
+
+    pci_write_config(dev->bus, dev->slot, dev->func, PCI_REG_COMMAND, cmd);
+}
+
+static void pci_scan_bus(uint8_t bus);
+
+static void pci_add_function(uint8_t bus, uint8_t slot, uint8_t func, uint32_t id) {
+    if (num_devices >= PCI_MAX_DEVICES) {
+        serial_write("PCI: Device table full\n");
+        return;
+    }
+
+    pci_device_t* dev = &devices[num_devices];
+    memset(dev, 0, sizeof(*dev));
+    dev->vendor_id = id & 0xFFFF;
+    dev->device_id = id >> 16;
+    dev->bus = bus;
+    dev->slot = slot;
+    dev->func = func;
+
+    uint32_t class_reg = pci_read_config(bus, slot, func, PCI_REG_CLASS);
+    dev->revision = class_reg & 0xFF;
+    dev->prog_if = (class_reg >> 8) & 0xFF;
+    dev->subclass = (class_reg >> 16) & 0xFF;
+    dev->class_code = class_reg >> 24;
+    dev->header_type = (pci_read_config(bus, slot, func, PCI_REG_HEADER) >> 16) & PCI_HEADER_TYPE_MASK;
+
+    // Type 0 headers have six BARs, bridges two
+    pci_size_bars(dev, dev->header_type == PCI_HEADER_TYPE_NORMAL ? PCI_NUM_BARS : 2);
+
+    dev->irq = pci_read_config(bus, slot, func, PCI_REG_INTERRUPT) & 0xFF;
+
+    pci_read_capabilities(dev);
+    dev->msi_cap = pci_find_capability(dev, PCI_CAP_ID_MSI);
+    dev->msix_cap = pci_find_capability(dev, PCI_CAP_ID_MSIX);
+
+    // Chain onto both hashes, appending so lookups return devices in
+    // bus order
+    int16_t index = (int16_t)num_devices;
+    dev->id_next = -1;
+    dev->class_next = -1;
+
+    int16_t* link = &id_hash[pci_id_bucket(dev->vendor_id, dev->device_id)];
+    while (*link >= 0) link = &devices[*link].id_next;
+    *link = index;
+
+    link = &class_hash[pci_class_bucket(dev->class_code, dev->subclass)];
+    while (*link >= 0) link = &devices[*link].class_next;
+    *link = index;
+
+    num_devices++;
+
+    // Descend behind PCI-to-PCI bridges
+    if (dev->header_type == PCI_HEADER_TYPE_BRIDGE &&
+        dev->class_code == PCI_CLASS_BRIDGE && dev->subclass == PCI_SUBCLASS_PCI_BRIDGE) {
+        uint8_t secondary = (pci_read_config(bus, slot, func, PCI_REG_BUS_NUMBERS) >> 8) & 0xFF;
+        if (secondary != 0) {
+            pci_scan_bus(secondary);
+        }
+    }
+}
+
+static void pci_scan_slot(uint8_t bus, uint8_t slot) {
+    uint32_t id = pci_read_config(bus, slot, 0, PCI_REG_VENDOR);
+    if ((id & 0xFFFF) == 0xFFFF) return;
+
+    pci_add_function(bus, slot, 0, id);
+
+    uint32_t header = pci_read_config(bus, slot, 0, PCI_REG_HEADER) >> 16;
+    if (!(header & PCI_HEADER_MULTIFUNC)) return;
+
+    for (uint8_t func = 1; func < 8; func++) {
+        id = pci_read_config(bus, slot, func, PCI_REG_VENDOR);
+        if ((id & 0xFFFF) == 0xFFFF) continue;
+        pci_add_function(bus, slot, func, id);
+    }
+}
+
+static void pci_scan_bus(uint8_t bus) {
+    if (bus_seen[bus / 32] & (1u << (bus % 32))) return;
+    bus_seen[bus / 32] |= 1u << (bus % 32);
+
+    for (uint8_t slot = 0; slot < 32; slot++) {
+        pci_scan_slot(bus, slot);
+    }
+}
+
+void pci_init(void) {
+    if (initialized) return;
+
+    serial_write("PCI: Initializing...\n");
+
+    spin_lock_init(&portio_lock, "pci_cf8");
+    pci_ecam_init();
+
+    for (int i = 0; i < PCI_HASH_SIZE; i++) {
+        id_hash[i] = -1;
+        class_hash[i] = -1;
+    }
+
+    // A multi-function host bridge means one root bus per function
+    uint32_t header = pci_read_config(0, 0, 0, PCI_REG_HEADER) >> 16;
+    if (header & PCI_HEADER_MULTIFUNC) {
+        for (uint8_t func = 0; func < 8; func++) {
+            if ((pci_read_config(0, 0, func, PCI_REG_VENDOR) & 0xFFFF) == 0xFFFF) continue;
+            pci_scan_bus(func);
+        }
+    } else {
+        pci_scan_bus(0);
+    }
+
+    initialized = 1;
+
+    char buf[48];
+    sprintf(buf, "PCI: %u functions found\n", num_devices);
+    serial_write(buf);
+    serial_write("PCI: Initialized successfully\n");
+}
+
+pci_device_t* pci_find_device(uint16_t vendor_id, uint16_t device_id) {
+    pci_init();
+
+    int16_t i = id_hash[pci_id_bucket(vendor_id, device_id)];
+    while (i >= 0) {
+        if (devices[i].vendor_id == vendor_id && devices[i].device_id == device_id) {
+            return &devices[i];
+        }
+        i = devices[i].id_next;
+    }
+    return 0;
+}
+
+pci_device_t* pci_find_next_device(pci_device_t* prev) {
+    int16_t i = prev->id_next;
+    while (i >= 0) {
+        if (devices[i].vendor_id == prev->vendor_id && devices[i].device_id == prev->device_id) {
+            return &devices[i];
+        }
+        i = devices[i].id_next;
+    }
+    return 0;
+}
+
+pci_device_t* pci_find_class(uint8_t class_code, uint8_t subclass) {
+    pci_init();
+
+    int16_t i = class_hash[pci_class_bucket(class_code, subclass)];
+    while (i >= 0) {
+        if (devices[i].class_code == class_code && devices[i].subclass == subclass) {
+            return &devices[i];
+        }
+        i = devices[i].class_next;
+    }
+    return 0;
+}
+
+pci_device_t* pci_find_next_class(pci_device_t* prev) {
+    int16_t i = prev->class_next;
+    while (i >= 0) {
+        if (devices[i].class_code == prev->class_code && devices[i].subclass == prev->subclass) {
+            return &devices[i];
+        }
+        i = devices[i].class_next;
+    }
+    return 0;
+}
+
+uint32_t pci_device_count(void) {
+    return num_devices;
+}
+
+pci_device_t* pci_get_device(uint32_t index) {
+    return index < num_devices ? &devices[index] : 0;
+}
+
+const char* pci_class_name(uint8_t class_code, uint8_t subclass) {
+    switch (class_code) {
+    case 0x01:
+        if (subclass == 0x01) return "IDE controller";
+        if (subclass == 0x06) return "SATA controller";
+        if (subclass == 0x08) return "NVMe controller";
+        return "Storage controller";
+    case 0x02:
+        return subclass == 0x00 ? "Ethernet controller" : "Network controller";
+    case 0x03:
+        return "VGA controller";
+    case 0x04:
+        return "Multimedia controller";
+    case 0x05:
+        return "Memory controller";
+    case 0x06:
+        if (subclass == 0x00) return "Host bridge";
+        if (subclass == 0x01) return "ISA bridge";
+        if (subclass == 0x04) return "PCI bridge";
+        return "Bridge";
+    case 0x0C:
+        if (subclass == 0x03) return "USB controller";
+        if (subclass == 0x05) return "SMBus";
+        return "Serial bus controller";
+    default:
+        return "Unclassified device";
+    }
+}
+
+uint8_t pci_find_capability(pci_device_t* dev, uint8_t cap_id) {
+    for (uint32_t i = 0; i < dev->num_caps; i++) {
+        if (dev->caps[i].id == cap_id) {
+            return dev->caps[i].offset;
+        }
+    }
+    return 0;
+}
+
+static uint16_t pci_read_config16(pci_device_t* dev, uint8_t offset) {
+    uint32_t value = pci_read_config(dev->bus, dev->slot, dev->func, offset & 0xFC);
+    return (value >> ((offset & 2) * 8)) & 0xFFFF;
+}
+
+// Read-modify-write of a 16-bit register inside a capability
+static void pci_write_config16(pci_device_t* dev, uint8_t offset, uint16_t value) {
+    uint32_t dword = pci_read_config(dev->bus, dev->slot, dev->func, offset & 0xFC);
+    uint32_t shift = (offset & 2) * 8;
+    dword = (dword & ~(0xFFFFu << shift)) | ((uint32_t)value << shift);
+    pci_write_config(dev->bus, dev->slot, dev->func, offset & 0xFC, dword);
+}
+
+// Update the command register without touching the RW1C status bits
+static void pci_update_command(pci_device_t* dev, uint16_t set, uint16_t clear) {
+    uint16_t cmd = pci_read_config16(dev, PCI_REG_COMMAND);
+    cmd = (cmd & ~clear) | set;
+    pci_write_config(dev->bus, dev->slot, dev->func, PCI_REG_COMMAND, cmd);
+}
+
+static uint8_t pci_msi_dest(uint32_t cpu) {
+    if (cpu == 0 || cpu >= smp_num_cpus()) {
+        return lapic_available() ? lapic_id() : 0;
+    }
+    return cpus[cpu].apic_id;
+}
+
+int pci_enable_msi(pci_device_t* dev, uint8_t vector, uint32_t cpu) {
+    uint8_t cap = dev->msi_cap;
+    if (!cap) return -1;
+
+    uint16_t ctrl = pci_read_config16(dev, cap + 2);
+    uint32_t address = MSI_ADDRESS_BASE | ((uint32_t)pci_msi_dest(cpu) << 12);
+
+    // Fixed delivery, edge triggered, single message
+    pci_write_config(dev->bus, dev->slot, dev->func, cap + 4, address);
+    if (ctrl & PCI_MSI_CTRL_64BIT) {
+        pci_write_config(dev->bus, dev->slot, dev->func, cap + 8, 0);
+        pci_write_config16(dev, cap + 12, vector);
+    } else {
+        pci_write_config16(dev, cap + 8, vector);
+    }
+
+    ctrl &= ~PCI_MSI_CTRL_MME_MASK;
+    ctrl |= PCI_MSI_CTRL_ENABLE;
+    pci_write_config16(dev, cap + 2, ctrl);
+
+    pci_update_command(dev, PCI_COMMAND_INTX_DISABLE | PCI_COMMAND_MASTER, 0);
+    return 0;
+}
+
+void pci_disable_msi(pci_device_t* dev) {
+    if (!dev->msi_cap) return;
+    uint16_t ctrl = pci_read_config16(dev, dev->msi_cap + 2);
+    pci_write_config16(dev, dev->msi_cap + 2, ctrl & ~PCI_MSI_CTRL_ENABLE);
+    pci_update_command(dev, 0, PCI_COMMAND_INTX_DISABLE);
+}
+
+uint32_t pci_msix_table_size(pci_device_t* dev) {
+    if (!dev->msix_cap) return 0;
+    return (pci_read_config16(dev, dev->msix_cap + 2) & PCI_MSIX_CTRL_TABLE_SIZE) + 1;
+}
+
+int pci_enable_msix(pci_device_t* dev, uint16_t entry, uint8_t vector, uint32_t cpu) {
+    uint8_t cap = dev->msix_cap;
+    if (!cap || entry >= pci_msix_table_size(dev)) return -1;
+
+    // The table lives in a memory BAR selected by the low three bits
+    uint32_t table = pci_read_config(dev->bus, dev->slot, dev->func, cap + 4);
+    uint32_t bir = table & 0x7;
+    if (bir >= PCI_NUM_BARS || (dev->bar_is_io & (1 << bir))) return -1;
+    uint32_t bar = dev->bar[bir];
+    if (bar == 0) return -1;
+
+    volatile uint32_t* slot = (volatile uint32_t*)(bar + (table & ~0x7u) +
+                                                   entry * PCI_MSIX_ENTRY_SIZE);
+
+    // Mask the whole function while the entry is rewritten
+    uint16_t ctrl = pci_read_config16(dev, cap + 2);
+    pci_write_config16(dev, cap + 2, ctrl | PCI_MSIX_CTRL_ENABLE | PCI_MSIX_CTRL_FUNC_MASK);
+    pci_update_command(dev, PCI_COMMAND_INTX_DISABLE | PCI_COMMAND_MASTER | PCI_COMMAND_MEMORY, 0);
+
+    slot[3] |= PCI_MSIX_ENTRY_MASKED;
+    slot[0] = MSI_ADDRESS_BASE | ((uint32_t)pci_msi_dest(cpu) << 12);
+    slot[1] = 0;
+    slot[2] = vector;
+    slot[3] &= ~PCI_MSIX_ENTRY_MASKED;
+
+    pci_write_config16(dev, cap + 2, (ctrl | PCI_MSIX_CTRL_ENABLE) & ~PCI_MSIX_CTRL_FUNC_MASK);
+    return 0;
+}
+
+void pci_disable_msix(pci_device_t* dev) {
+    if (!dev->msix_cap) return;
+    uint16_t ctrl = pci_read_config16(dev, dev->msix_cap + 2);
+    pci_write_config16(dev, dev->msix_cap + 2, ctrl & ~PCI_MSIX_CTRL_ENABLE);
+    pci_update_command(dev, 0, PCI_COMMAND_INTX_DISABLE);
+}
@@ -0,0 +1,111 @@
+#include "pktbuf.h"
+#include "lock.h"
+#include "heap.h"
+#include "serial.h"
+#include "string.h"
+#include <stddef.h>
+
+static pktbuf_t* free_list = NULL;
+static uint32_t total_count = 0;
+static uint32_t free_count = 0;
+static uint32_t slab_count = 0;
+static uint32_t allocs = 0;
+static uint32_t alloc_failures = 0;
+
+// Taken from the NIC's softirq and from task context
+static spinlock_t pool_lock;
+
+uint32_t pktbuf_grow(uint32_t count) {
+    if (count == 0) return 0;
+
+    // Slots are packed back to back in one contiguous, page-aligned slab
+    // (two per 4 KiB page), so a deep ring spans as few pages as possible
+    uint8_t* slab = (uint8_t*)dma_alloc(count * PKTBUF_SIZE, 0x1000);
+    pktbuf_t* meta = (pktbuf_t*)kmalloc(count * sizeof(pktbuf_t));
+    if (!slab || !meta) {
+        serial_write("Pktbuf: Out of DMA memory\n");
+        if (meta) kfree(meta);
+        return 0;
+    }
+
+    // Chain the new buffers locally, then splice them in one step
+    for (uint32_t i = 0; i < count; i++) {
+        meta[i].head = slab + i * PKTBUF_SIZE;
+        meta[i].data = meta[i].head;
+        meta[i].len = 0;
+        meta[i].refcnt = 0;
+        meta[i].next = (i + 1 < count) ? &meta[i + 1] : NULL;
+    }
+
+    uint32_t flags = spin_lock_irqsave(&pool_lock);
+    meta[count - 1].next = free_list;
+    free_list = &meta[0];
+    free_count += count;
+    total_count += count;
+    slab_count++;
+    spin_unlock_irqrestore(&pool_lock, flags);
+
+    char buf[64];
+    sprintf(buf, "Pktbuf: Slab of %u buffers at 0x%08x\n", count, (uint32_t)slab);
+    serial_write(buf);
+    return count;
+}
+
+void pktbuf_init(void) {
+    serial_write("Pktbuf: Initializing...\n");
+    spin_lock_init(&pool_lock, "pktbuf");
+    pktbuf_grow(PKTBUF_POOL_SIZE);
+    serial_write("Pktbuf: Initialized successfully\n");
+}
+
+static pktbuf_t* pktbuf_take(void) {
+    uint32_t flags = spin_lock_irqsave(&pool_lock);
+    pktbuf_t* pb = free_list;
+    if (pb) {
+        free_list = pb->next;
+        free_count--;
+        allocs++;
+    } else {
+        alloc_failures++;
+    }
+    spin_unlock_irqrestore(&pool_lock, flags);
+
+    if (pb) {
+        pb->next = NULL;
+        pb->len = 0;
+        pb->refcnt = 1;
+        pb->csum_flags = 0;
+    }
+    return pb;
+}
+
+pktbuf_t* pktbuf_alloc(void) {
+    pktbuf_t* pb = pktbuf_take();
+    if (pb) pb->data = pb->head + PKTBUF_HEADROOM;
+    return pb;
+}
+
+pktbuf_t* pktbuf_alloc_rx(void) {
+    pktbuf_t* pb = pktbuf_take();
+    if (pb) pb->data = pb->head;
+    return pb;
+}
+
+void pktbuf_put(pktbuf_t* pb) {
+    if (!pb) return;
+    if (__atomic_sub_fetch(&pb->refcnt, 1, __ATOMIC_ACQ_REL) != 0) return;
+
+    uint32_t flags = spin_lock_irqsave(&pool_lock);
+    pb->next = free_list;
+    free_list = pb;
+    free_count++;
+    spin_unlock_irqrestore(&pool_lock, flags);
+}
+
+void pktbuf_get_stats(pktbuf_stats_t* stats) {
+    stats->total = total_count;
+    stats->slabs = slab_count;
+    stats->free = free_count;
+    stats->allocs = allocs;
+    stats->alloc_failures = alloc_failures;
+}
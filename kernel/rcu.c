@@ -0,0 +1,225 @@
+#include "rcu.h"
+#include "smp.h"
+#include "apic.h"
+#include "lock.h"
+#include "heap.h"
+#include "timer.h"
+#include "serial.h"
+#include "string.h"
+#include "div64.h"
+#include <stddef.h>
+
+// Pause iterations synchronize_rcu() waits before nudging lagging CPUs
+#define RCU_NUDGE_SPINS 1000
+
+rcu_cpu_t rcu_cpu[MAX_CPUS];
+volatile uint32_t rcu_gp_seq = 0;
+
+// Target sequence of the grace period in progress (0 if none)
+static volatile uint32_t rcu_gp_waiting = 0;
+static spinlock_t rcu_gp_lock;
+static rcu_stats_t rcu_stats;
+
+void rcu_init(void) {
+    serial_write("RCU: Initializing...\n");
+    spin_lock_init(&rcu_gp_lock, "rcu_gp");
+    serial_write("RCU: Initialized successfully\n");
+}
+
+static inline int rcu_cpu_passed(uint32_t cpu, uint32_t seq) {
+    rcu_cpu_t* r = &rcu_cpu[cpu];
+    return (int32_t)(r->qs_seq - seq) >= 0 || r->idle;
+}
+
+// Send a wakeup IPI to every CPU that has not yet reported for seq
+static void rcu_nudge(uint32_t seq) {
+    uint32_t self = smp_cpu_id();
+    for (uint32_t c = 0; c < smp_num_cpus(); c++) {
+        if (c == self || rcu_cpu_passed(c, seq)) continue;
+        lapic_send_ipi(cpus[c].apic_id, IPI_VECTOR_WAKEUP);
+        rcu_stats.nudges++;
+    }
+}
+
+void rcu_idle_enter(void) {
+    __asm__ volatile("" : : : "memory");
+    rcu_cpu[smp_cpu_id()].idle = 1;
+}
+
+void rcu_idle_exit(void) {
+    rcu_cpu_t* r = &rcu_cpu[smp_cpu_id()];
+    r->idle = 0;
+    // Order the flag store before any later read of a protected pointer
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    r->qs_seq = rcu_gp_seq;
+}
+
+void rcu_tick(void) {
+    uint32_t seq = rcu_gp_waiting;
+    if (seq) {
+        rcu_nudge(seq);
+    }
+}
+
+void synchronize_rcu(void) {
+    uint32_t ncpus = smp_num_cpus();
+
+    // With one CPU, being here outside a read-side section already
+    // means no reader can be running
+    if (ncpus <= 1) return;
+
+    spin_lock(&rcu_gp_lock);
+
+    uint64_t start = rdtsc();
+
+    // The locked add orders the caller's unpublish before the reads of
+    // the per-CPU state below
+    uint32_t seq = __atomic_add_fetch(&rcu_gp_seq, 1, __ATOMIC_SEQ_CST);
+    if (seq == 0) {
+        seq = __atomic_add_fetch(&rcu_gp_seq, 1, __ATOMIC_SEQ_CST);
+    }
+    rcu_cpu[smp_cpu_id()].qs_seq = seq;
+    rcu_gp_waiting = seq;
+
+    uint32_t spins = 0;
+    for (uint32_t c = 0; c < ncpus; c++) {
+        while (!rcu_cpu_passed(c, seq)) {
+            // One early nudge; after that the timer tick keeps nudging
+            if (++spins == RCU_NUDGE_SPINS) {
+                rcu_nudge(seq);
+            }
+            __asm__ volatile("pause");
+        }
+    }
+
+    rcu_gp_waiting = 0;
+
+    uint32_t us = (uint32_t)timer_cycles_to_us(rdtsc() - start);
+    rcu_stats.grace_periods++;
+    if (us > rcu_stats.max_gp_us) {
+        rcu_stats.max_gp_us = us;
+    }
+
+    spin_unlock(&rcu_gp_lock);
+}
+
+void rcu_get_stats(rcu_stats_t* stats) {
+    *stats = rcu_stats;
+}
+
+// ---- Read-side benchmark -------------------------------------------------
+
+#define RCU_BENCH_US      200000
+#define RCU_BENCH_ENTRIES 16
+
+// Readers report a quiescent state this often in their loop
+#define RCU_BENCH_QS_INTERVAL 256
+
+typedef struct {
+    uint32_t values[RCU_BENCH_ENTRIES];
+} bench_table_t;
+
+typedef struct {
+    volatile uint32_t* stop;
+    int use_rcu;
+    uint64_t reads;
+    uint32_t sink;
+} __attribute__((aligned(64))) bench_reader_t;
+
+static bench_table_t* volatile bench_table = NULL;
+static spinlock_t bench_lock;
+
+static void bench_reader(void* arg) {
+    bench_reader_t* r = (bench_reader_t*)arg;
+    uint64_t reads = 0;
+    uint32_t sum = 0;
+
+    if (r->use_rcu) {
+        while (!*r->stop) {
+            rcu_read_lock();
+            bench_table_t* t = rcu_dereference(bench_table);
+            sum += t->values[reads & (RCU_BENCH_ENTRIES - 1)];
+            rcu_read_unlock();
+
+            // A long-running loop has to announce its quiescent states
+            if ((++reads & (RCU_BENCH_QS_INTERVAL - 1)) == 0) {
+                rcu_quiescent_state();
+            }
+        }
+    } else {
+        while (!*r->stop) {
+            spin_lock(&bench_lock);
+            sum += bench_table->values[reads & (RCU_BENCH_ENTRIES - 1)];
+            spin_unlock(&bench_lock);
+            reads++;
+        }
+    }
+
+    r->reads = reads;
+    r->sink = sum;
+}
+
+uint32_t rcu_bench(uint32_t ncpus, int use_rcu, uint32_t* updates) {
+    static bench_reader_t readers[MAX_CPUS];
+    volatile uint32_t stop = 0;
+
+    if (updates) *updates = 0;
+    if (ncpus > smp_num_cpus()) ncpus = smp_num_cpus();
+    if (ncpus < 2) return 0;
+
+    spin_lock_init(&bench_lock, "rcu_bench");
+    bench_table = (bench_table_t*)kmalloc(sizeof(bench_table_t));
+    if (!bench_table) return 0;
+    memset(bench_table, 0, sizeof(bench_table_t));
+
+    for (uint32_t c = 1; c < ncpus; c++) {
+        readers[c].stop = &stop;
+        readers[c].use_rcu = use_rcu;
+        readers[c].reads = 0;
+        smp_call_on_cpu(c, bench_reader, &readers[c]);
+    }
+
+    // The boot CPU is the updater: copy, modify, publish, reclaim
+    uint32_t done = 0;
+    uint64_t start = rdtsc();
+    uint64_t us = 0;
+    while (us < RCU_BENCH_US) {
+        bench_table_t* fresh = (bench_table_t*)kmalloc(sizeof(bench_table_t));
+        if (!fresh) break;
+
+        bench_table_t* old;
+        if (use_rcu) {
+            old = bench_table;
+            memcpy(fresh, old, sizeof(bench_table_t));
+            fresh->values[done & (RCU_BENCH_ENTRIES - 1)]++;
+            rcu_assign_pointer(bench_table, fresh);
+            synchronize_rcu();
+        } else {
+            spin_lock(&bench_lock);
+            old = bench_table;
+            memcpy(fresh, old, sizeof(bench_table_t));
+            fresh->values[done & (RCU_BENCH_ENTRIES - 1)]++;
+            bench_table = fresh;
+            spin_unlock(&bench_lock);
+        }
+        kfree(old);
+        done++;
+
+        us = timer_cycles_to_us(rdtsc() - start);
+    }
+
+    stop = 1;
+    uint64_t reads = 0;
+    for (uint32_t c = 1; c < ncpus; c++) {
+        smp_wait_cpu(c);
+        reads += readers[c].reads;
+    }
+    us = timer_cycles_to_us(rdtsc() - start);
+    if (us == 0) us = 1;
+
+    kfree(bench_table);
+    bench_table = NULL;
+
+    if (updates) *updates = (uint32_t)div_u64((uint64_t)done * 1000000, (uint32_t)us);
+    return (uint32_t)div_u64(reads * 1000000, (uint32_t)us);
+}
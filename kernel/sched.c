@@ -0,0 +1,474 @@
+#include "sched.h"
+#include "smp.h"
+#include "apic.h"
+#include "timer.h"
+#include "serial.h"
+#include "div64.h"
+#include "rcu.h"
+#include "softirq.h"
+#include <stddef.h>
+
+#define DEQUE_MASK (SCHED_DEQUE_SIZE - 1)
+
+// Pause iterations an idle CPU keeps looking for work before halting
+#define SCHED_IDLE_SPINS 2000
+
+// Per-CPU run queue. Aligned so neighbouring CPUs never share a line.
+typedef struct {
+    // Chase-Lev deque: the owner pushes and takes at bottom, thieves
+    // steal from top. top and bottom live on separate cache lines.
+    volatile int32_t top;
+    uint8_t pad0[60];
+    volatile int32_t bottom;
+    uint8_t pad1[60];
+    task_t* volatile buffer[SCHED_DEQUE_SIZE];
+
+    // Tasks handed over by other CPUs or IRQ context (LIFO stack)
+    task_t* volatile inbox;
+
+    // Load accounting
+    volatile uint64_t idle_cycles;
+    volatile uint64_t idle_since;   // Non-zero while idle
+    uint64_t sample_tsc;
+    uint64_t sample_idle;
+
+    sched_stats_t stats;
+    uint32_t rng;
+} __attribute__((aligned(64))) runqueue_t;
+
+static runqueue_t runqueues[MAX_CPUS];
+static volatile uint32_t active_cpus = MAX_CPUS;
+static volatile uint32_t idle_mask = 0;
+
+static inline runqueue_t* this_rq(void) {
+    return &runqueues[smp_cpu_id()];
+}
+
+// ---- Chase-Lev deque -------------------------------------------------
+
+static int deque_push(runqueue_t* rq, task_t* task) {
+    int32_t b = __atomic_load_n(&rq->bottom, __ATOMIC_RELAXED);
+    int32_t t = __atomic_load_n(&rq->top, __ATOMIC_ACQUIRE);
+    if (b - t >= SCHED_DEQUE_SIZE) {
+        return -1;
+    }
+    rq->buffer[b & DEQUE_MASK] = task;
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&rq->bottom, b + 1, __ATOMIC_RELAXED);
+    return 0;
+}
+
+static task_t* deque_take(runqueue_t* rq) {
+    int32_t b = __atomic_load_n(&rq->bottom, __ATOMIC_RELAXED) - 1;
+    __atomic_store_n(&rq->bottom, b, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int32_t t = __atomic_load_n(&rq->top, __ATOMIC_RELAXED);
+
+    task_t* task = NULL;
+    if (t <= b) {
+        task = rq->buffer[b & DEQUE_MASK];
+        if (t == b) {
+            // Last element: race against thieves for it
+            if (!__atomic_compare_exchange_n(&rq->top, &t, t + 1, 0,
+                                             __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+                task = NULL;
+            }
+            __atomic_store_n(&rq->bottom, b + 1, __ATOMIC_RELAXED);
+        }
+    } else {
+        __atomic_store_n(&rq->bottom, b + 1, __ATOMIC_RELAXED);
+    }
+    return task;
+}
+
+static task_t* deque_steal(runqueue_t* rq, int* lost_race) {
+    int32_t t = __atomic_load_n(&rq->top, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int32_t b = __atomic_load_n(&rq->bottom, __ATOMIC_ACQUIRE);
+
+    if (t < b) {
+        task_t* task = rq->buffer[t & DEQUE_MASK];
+        if (!__atomic_compare_exchange_n(&rq->top, &t, t + 1, 0,
+                                         __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+            *lost_race = 1;
+            return NULL;
+        }
+        return task;
+    }
+    return NULL;
+}
+
+static int deque_empty(runqueue_t* rq) {
+    return __atomic_load_n(&rq->bottom, __ATOMIC_ACQUIRE) <=
+           __atomic_load_n(&rq->top, __ATOMIC_ACQUIRE);
+}
+
+// ---- Task execution ----------------------------------------------------
+
+static void run_task(runqueue_t* rq, task_t* task) {
+    // The waiter may release the task storage once the group drops, so
+    // read everything we need before running it
+    task_group_t* group = task->group;
+
+    task->fn(task->arg);
+    rq->stats.tasks_run++;
+
+    if (group) {
+        __atomic_sub_fetch(&group->pending, 1, __ATOMIC_RELEASE);
+    }
+}
+
+// Move remotely submitted tasks into the local deque, oldest first
+static void drain_inbox(runqueue_t* rq) {
+    if (!__atomic_load_n(&rq->inbox, __ATOMIC_RELAXED)) return;
+
+    task_t* list = __atomic_exchange_n(&rq->inbox, NULL, __ATOMIC_ACQUIRE);
+    task_t* reversed = NULL;
+    while (list) {
+        task_t* next = list->next;
+        list->next = reversed;
+        reversed = list;
+        list = next;
+    }
+
+    while (reversed) {
+        task_t* next = reversed->next;
+        if (deque_push(rq, reversed) < 0) {
+            run_task(rq, reversed);
+        }
+        reversed = next;
+    }
+}
+
+static uint32_t next_random(runqueue_t* rq) {
+    // xorshift32
+    uint32_t x = rq->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    rq->rng = x;
+    return x;
+}
+
+static task_t* steal_work(runqueue_t* rq, uint32_t self) {
+    uint32_t n = smp_num_cpus();
+    uint32_t active = active_cpus;
+    if (n > active) n = active;
+    if (self >= n || n < 2) return NULL;
+
+    // Start at a random victim so thieves spread out
+    uint32_t start = next_random(rq) % n;
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t victim = (start + i) % n;
+        if (victim == self) continue;
+
+        int lost_race = 0;
+        task_t* task = deque_steal(&runqueues[victim], &lost_race);
+        if (task) {
+            rq->stats.steals++;
+            return task;
+        }
+        if (lost_race) {
+            rq->stats.steal_failures++;
+        }
+    }
+    return NULL;
+}
+
+static task_t* find_work(runqueue_t* rq, uint32_t self) {
+    drain_inbox(rq);
+    task_t* task = deque_take(rq);
+    if (!task) {
+        task = steal_work(rq, self);
+    }
+    return task;
+}
+
+static int work_available(uint32_t self) {
+    runqueue_t* rq = &runqueues[self];
+    if (rq->inbox || !deque_empty(rq)) return 1;
+
+    uint32_t n = smp_num_cpus();
+    if (n > active_cpus) n = active_cpus;
+    if (self >= n) return 0;
+
+    for (uint32_t c = 0; c < n; c++) {
+        if (c != self && !deque_empty(&runqueues[c])) return 1;
+    }
+    return 0;
+}
+
+// Wake one halted CPU
+static void wake_cpu(uint32_t cpu) {
+    uint32_t bit = 1u << cpu;
+    if (__atomic_fetch_and(&idle_mask, ~bit, __ATOMIC_SEQ_CST) & bit) {
+        runqueues[smp_cpu_id()].stats.wakeups++;
+        lapic_send_ipi(cpus[cpu].apic_id, IPI_VECTOR_WAKEUP);
+    }
+}
+
+static void wake_idle_thief(void) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    uint32_t mask = __atomic_load_n(&idle_mask, __ATOMIC_RELAXED);
+    uint32_t active = active_cpus;
+    if (active < 32) mask &= (1u << active) - 1;
+    if (mask) {
+        wake_cpu(__builtin_ctz(mask));
+    }
+}
+
+// ---- Public interface --------------------------------------------------
+
+void sched_init(void) {
+    serial_write("Sched: Initializing...\n");
+
+    for (int i = 0; i < MAX_CPUS; i++) {
+        runqueues[i].top = 0;
+        runqueues[i].bottom = 0;
+        runqueues[i].inbox = NULL;
+        runqueues[i].rng = 0x9E3779B9u * (i + 1);
+    }
+
+    serial_write("Sched: Initialized successfully\n");
+}
+
+void sched_spawn(task_group_t* group, task_t* task) {
+    runqueue_t* rq = this_rq();
+
+    task->group = group;
+    if (group) {
+        __atomic_add_fetch(&group->pending, 1, __ATOMIC_RELAXED);
+    }
+
+    if (deque_push(rq, task) < 0) {
+        // Deque full: run inline rather than block
+        run_task(rq, task);
+        return;
+    }
+
+    wake_idle_thief();
+}
+
+void sched_submit(uint32_t cpu, task_t* task) {
+    runqueue_t* rq = &runqueues[cpu];
+
+    if (task->group) {
+        __atomic_add_fetch(&task->group->pending, 1, __ATOMIC_RELAXED);
+    }
+
+    task_t* old = __atomic_load_n(&rq->inbox, __ATOMIC_RELAXED);
+    do {
+        task->next = old;
+    } while (!__atomic_compare_exchange_n(&rq->inbox, &old, task, 1,
+                                          __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+    if (cpu != smp_cpu_id()) {
+        wake_cpu(cpu);
+    }
+}
+
+void sched_wait(task_group_t* group) {
+    uint32_t self = smp_cpu_id();
+    runqueue_t* rq = &runqueues[self];
+
+    // Help out instead of spinning idle
+    while (__atomic_load_n(&group->pending, __ATOMIC_ACQUIRE)) {
+        task_t* task = find_work(rq, self);
+        if (task) {
+            run_task(rq, task);
+        } else {
+            __asm__ volatile("pause");
+        }
+    }
+}
+
+void sched_run(void) {
+    uint32_t self = smp_cpu_id();
+    runqueue_t* rq = &runqueues[self];
+    uint32_t bit = 1u << self;
+    uint32_t spins = 0;
+    uint64_t idle_start = 0;
+
+    rq->sample_tsc = rdtsc();
+
+    while (1) {
+        // Between tasks this CPU holds no RCU references
+        rcu_quiescent_state();
+        do_softirq();
+        smp_process_calls();
+
+        task_t* task = find_work(rq, self);
+        if (task) {
+            if (idle_start) {
+                rq->idle_cycles += rdtsc() - idle_start;
+                rq->idle_since = 0;
+                idle_start = 0;
+            }
+            run_task(rq, task);
+            spins = 0;
+            continue;
+        }
+
+        if (!idle_start) {
+            idle_start = rdtsc();
+            rq->idle_since = idle_start;
+        }
+
+        if (++spins < SCHED_IDLE_SPINS) {
+            __asm__ volatile("pause");
+            continue;
+        }
+
+        // Advertise as idle, re-check, then halt until an IPI arrives.
+        // sti;hlt is atomic so a wakeup sent after the check is not lost.
+        __asm__ volatile("cli");
+        __atomic_fetch_or(&idle_mask, bit, __ATOMIC_SEQ_CST);
+        if (!work_available(self) && !this_cpu()->call_pending && !softirq_pending()) {
+            rcu_idle_enter();
+            __asm__ volatile("sti; hlt");
+            rcu_idle_exit();
+        } else {
+            __asm__ volatile("sti");
+        }
+        __atomic_fetch_and(&idle_mask, ~bit, __ATOMIC_SEQ_CST);
+        spins = 0;
+    }
+}
+
+void sched_idle_wait(uint32_t us) {
+    runqueue_t* rq = this_rq();
+
+    rcu_quiescent_state();
+    do_softirq();
+
+    // Run whatever was queued locally (the BSP does not steal here so
+    // the shell stays responsive)
+    drain_inbox(rq);
+    task_t* task;
+    while ((task = deque_take(rq)) != NULL) {
+        run_task(rq, task);
+    }
+
+    uint64_t start = rdtsc();
+    rq->idle_since = start;
+    timer_udelay(us);
+    rq->idle_since = 0;
+    rq->idle_cycles += rdtsc() - start;
+}
+
+uint32_t sched_cpu_load(uint32_t cpu) {
+    runqueue_t* rq = &runqueues[cpu];
+    uint64_t now = rdtsc();
+    uint64_t idle = rq->idle_cycles;
+    uint64_t since = rq->idle_since;
+
+    // Count an ongoing idle period up to now
+    if (since && since < now) {
+        idle += now - since;
+    }
+
+    uint64_t prev = rq->sample_tsc;
+    uint64_t elapsed = now - prev;
+    uint64_t idle_delta = idle - rq->sample_idle;
+    rq->sample_tsc = now;
+    rq->sample_idle = idle;
+
+    // First sample only opens the window
+    if (prev == 0 || elapsed == 0) return 0;
+    if (idle_delta >= elapsed) return 0;
+
+    uint64_t busy = elapsed - idle_delta;
+    while (elapsed >> 32) {
+        elapsed >>= 1;
+        busy >>= 1;
+    }
+    uint32_t load = (uint32_t)div_u64(busy * 100, (uint32_t)elapsed);
+    return load > 100 ? 100 : load;
+}
+
+void sched_set_active_cpus(uint32_t ncpus) {
+    active_cpus = ncpus;
+}
+
+void sched_get_stats(uint32_t cpu, sched_stats_t* stats) {
+    *stats = runqueues[cpu].stats;
+}
+
+void sched_reset_stats(void) {
+    for (int i = 0; i < MAX_CPUS; i++) {
+        runqueues[i].stats.tasks_run = 0;
+        runqueues[i].stats.steals = 0;
+        runqueues[i].stats.steal_failures = 0;
+        runqueues[i].stats.wakeups = 0;
+    }
+}
+
+// ---- Fork/join benchmark -----------------------------------------------
+
+#define FIB_N      27
+#define FIB_CUTOFF 12
+
+typedef struct {
+    uint32_t n;
+    uint32_t result;
+} fib_arg_t;
+
+static uint32_t fib_seq(uint32_t n) {
+    return n < 2 ? n : fib_seq(n - 1) + fib_seq(n - 2);
+}
+
+static void fib_task(void* arg) {
+    fib_arg_t* a = (fib_arg_t*)arg;
+    if (a->n < FIB_CUTOFF) {
+        a->result = fib_seq(a->n);
+        return;
+    }
+
+    // Fork the left branch, compute the right one here, then join
+    fib_arg_t left = { a->n - 1, 0 };
+    fib_arg_t right = { a->n - 2, 0 };
+    task_group_t group = { 0 };
+    task_t task;
+
+    task_init(&task, fib_task, &left);
+    sched_spawn(&group, &task);
+    fib_task(&right);
+    sched_wait(&group);
+
+    a->result = left.result + right.result;
+}
+
+uint32_t sched_bench_forkjoin(uint32_t ncpus, uint32_t* steals) {
+    uint32_t online = smp_num_cpus();
+    if (ncpus == 0) ncpus = 1;
+    if (ncpus > online) ncpus = online;
+
+    sched_set_active_cpus(ncpus);
+    sched_reset_stats();
+
+    // Get the thieves spinning before the root task starts forking
+    for (uint32_t c = 1; c < ncpus; c++) {
+        wake_cpu(c);
+    }
+
+    fib_arg_t root = { FIB_N, 0 };
+    uint64_t start = rdtsc();
+    fib_task(&root);
+    uint64_t us = timer_cycles_to_us(rdtsc() - start);
+    if (us == 0) us = 1;
+
+    sched_set_active_cpus(MAX_CPUS);
+
+    uint32_t tasks = 0;
+    uint32_t total_steals = 0;
+    for (uint32_t c = 0; c < online; c++) {
+        // Every spawned task is counted once on the CPU that ran it; the
+        // root task ran outside the scheduler
+        tasks += runqueues[c].stats.tasks_run;
+        total_steals += runqueues[c].stats.steals;
+    }
+    tasks++;
+
+    if (steals) *steals = total_steals;
+    return (uint32_t)div_u64((uint64_t)tasks * 1000000, (uint32_t)us);
+}
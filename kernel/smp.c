@@ -0,0 +1,203 @@
+#include "smp.h"
+#include "acpi.h"
+#include "apic.h"
+#include "gdt.h"
+#include "idt.h"
+#include "timer.h"
+#include "sched.h"
+#include "framebuffer.h"
+#include "serial.h"
+#include "string.h"
+#include "div64.h"
+#include <stddef.h>
+
+cpu_t cpus[MAX_CPUS];
+static uint32_t num_cpus = 1;
+
+// Kernel stacks for the application processors
+static uint8_t ap_stacks[MAX_CPUS][AP_STACK_SIZE] __attribute__((aligned(16)));
+
+// Parameter block at the end of the trampoline (see trampoline.asm)
+typedef struct {
+    uint32_t stack_top;
+    uint32_t entry;
+    uint32_t cpu;
+} __attribute__((packed)) ap_params_t;
+
+extern uint8_t ap_trampoline_start[];
+extern uint8_t ap_trampoline_end[];
+extern uint8_t ap_trampoline_params[];
+
+// Run a pending cross-CPU call on this CPU. Returns 1 if one ran.
+int smp_process_calls(void) {
+    cpu_t* cpu = this_cpu();
+    if (!__atomic_load_n(&cpu->call_pending, __ATOMIC_ACQUIRE)) {
+        return 0;
+    }
+
+    smp_call_fn_t fn = cpu->call_fn;
+    fn(cpu->call_arg);
+    __atomic_store_n(&cpu->call_pending, 0, __ATOMIC_RELEASE);
+    return 1;
+}
+
+// C entry point of an application processor (called by the trampoline)
+static void ap_main(uint32_t cpu) {
+    gdt_init_cpu(cpu);
+    idt_load();
+    lapic_init();
+
+    __atomic_store_n(&cpus[cpu].online, 1, __ATOMIC_RELEASE);
+    __asm__ volatile("sti");
+
+    // Become a worker: run tasks, steal from peers, halt when idle
+    sched_run();
+}
+
+static int ap_start(uint32_t index, uint8_t apic_id) {
+    ap_params_t* params = (ap_params_t*)(AP_TRAMPOLINE_ADDR +
+                                         (ap_trampoline_params - ap_trampoline_start));
+
+    cpus[index].apic_id = apic_id;
+    cpus[index].online = 0;
+
+    params->stack_top = (uint32_t)&ap_stacks[index][AP_STACK_SIZE];
+    params->entry = (uint32_t)ap_main;
+    params->cpu = index;
+
+    // INIT-SIPI-SIPI as described in the Intel MP specification
+    lapic_send_init(apic_id);
+    timer_udelay(10000);
+
+    for (int attempt = 0; attempt < 2; attempt++) {
+        lapic_send_startup(apic_id, AP_TRAMPOLINE_ADDR);
+        timer_udelay(200);
+        if (__atomic_load_n(&cpus[index].online, __ATOMIC_ACQUIRE)) break;
+    }
+
+    // Give the AP up to 100 ms to reach ap_main()
+    for (int wait = 0; wait < 1000; wait++) {
+        if (__atomic_load_n(&cpus[index].online, __ATOMIC_ACQUIRE)) return 0;
+        timer_udelay(100);
+    }
+
+    // Park the AP again so it cannot pick up later parameters
+    lapic_send_init(apic_id);
+    return -1;
+}
+
+int smp_init(void) {
+    serial_write("SMP: Initializing...\n");
+
+    cpus[0].online = 1;
+
+    const acpi_madt_info_t* madt = acpi_get_madt();
+    if (!madt || madt->num_cpus <= 1) {
+        serial_write("SMP: Single CPU system\n");
+        return 0;
+    }
+
+    lapic_init();
+    cpus[0].apic_id = lapic_id();
+
+    // Copy the trampoline to low memory where the STARTUP IPI can reach it
+    memcpy((void*)AP_TRAMPOLINE_ADDR, ap_trampoline_start,
+           ap_trampoline_end - ap_trampoline_start);
+
+    for (uint32_t i = 0; i < madt->num_cpus && num_cpus < MAX_CPUS; i++) {
+        uint8_t apic_id = madt->cpu_apic_ids[i];
+        if (apic_id == cpus[0].apic_id) continue;
+
+        if (ap_start(num_cpus, apic_id) == 0) {
+            num_cpus++;
+        } else {
+            serial_write("SMP: AP failed to start\n");
+        }
+    }
+
+    char buf[48];
+    sprintf(buf, "SMP: %u CPU(s) online\n", num_cpus);
+    serial_write(buf);
+    return 0;
+}
+
+uint32_t smp_num_cpus(void) {
+    return num_cpus;
+}
+
+int smp_call_on_cpu(uint32_t cpu, smp_call_fn_t fn, void* arg) {
+    if (cpu >= num_cpus || !cpus[cpu].online || cpus[cpu].call_pending) {
+        return -1;
+    }
+
+    cpus[cpu].call_fn = fn;
+    cpus[cpu].call_arg = arg;
+    __atomic_store_n(&cpus[cpu].call_pending, 1, __ATOMIC_RELEASE);
+    lapic_send_ipi(cpus[cpu].apic_id, IPI_VECTOR_WAKEUP);
+    return 0;
+}
+
+void smp_wait_cpu(uint32_t cpu) {
+    while (__atomic_load_n(&cpus[cpu].call_pending, __ATOMIC_ACQUIRE)) {
+        __asm__ volatile("pause");
+    }
+}
+
+// Benchmark: every participating CPU fills a horizontal band of the
+// framebuffer, so the work splits with no shared cache lines.
+typedef struct {
+    uint32_t* base;
+    uint32_t stride;   // In pixels
+    uint32_t width;
+    uint32_t y0;
+    uint32_t y1;
+    uint32_t color;
+} fill_slice_t;
+
+static void fill_slice(void* arg) {
+    fill_slice_t* s = (fill_slice_t*)arg;
+    for (uint32_t y = s->y0; y < s->y1; y++) {
+        uint32_t* row = s->base + y * s->stride;
+        for (uint32_t x = 0; x < s->width; x++) {
+            row[x] = s->color;
+        }
+    }
+}
+
+uint32_t smp_bench_fill(uint32_t ncpus, uint32_t frames) {
+    framebuffer_info_t* fb = framebuffer_get_info();
+    if (!fb || fb->width == 0 || frames == 0) return 0;
+    if (ncpus == 0) ncpus = 1;
+    if (ncpus > num_cpus) ncpus = num_cpus;
+
+    fill_slice_t slices[MAX_CPUS];
+    uint64_t start = rdtsc();
+
+    for (uint32_t f = 0; f < frames; f++) {
+        uint32_t color = RGB((f * 16) & 0xFF, 40, 80);
+
+        for (uint32_t c = 0; c < ncpus; c++) {
+            slices[c].base = fb->address;
+            slices[c].stride = fb->pitch / 4;
+            slices[c].width = fb->width;
+            slices[c].y0 = fb->height * c / ncpus;
+            slices[c].y1 = fb->height * (c + 1) / ncpus;
+            slices[c].color = color;
+        }
+
+        for (uint32_t c = 1; c < ncpus; c++) {
+            smp_call_on_cpu(c, fill_slice, &slices[c]);
+        }
+        fill_slice(&slices[0]);
+        for (uint32_t c = 1; c < ncpus; c++) {
+            smp_wait_cpu(c);
+        }
+    }
+
+    uint64_t us = timer_cycles_to_us(rdtsc() - start);
+    if (us == 0) us = 1;
+
+    // Bytes per microsecond == MB/s
+    uint64_t bytes = (uint64_t)fb->pitch * fb->height * frames;
+    return (uint32_t)div_u64(bytes, (uint32_t)us);
+}
@@ -0,0 +1,88 @@
+#include "softirq.h"
+#include "smp.h"
+#include "lock.h"
+#include "timer.h"
+#include "serial.h"
+#include "string.h"
+#include <stddef.h>
+
+// Per-CPU softirq state. Aligned so neighbouring CPUs never share a line.
+typedef struct {
+    volatile uint32_t pending;
+    volatile uint32_t active;       // do_softirq() is running on this CPU
+    softirq_stats_t stats;
+} __attribute__((aligned(64))) softirq_cpu_t;
+
+static softirq_cpu_t softirq_cpu[MAX_CPUS];
+static softirq_fn_t softirq_vec[NR_SOFTIRQS];
+
+void softirq_init(void) {
+    serial_write("Softirq: Initializing...\n");
+    for (int i = 0; i < NR_SOFTIRQS; i++) {
+        softirq_vec[i] = NULL;
+    }
+    serial_write("Softirq: Initialized successfully\n");
+}
+
+void open_softirq(uint32_t nr, softirq_fn_t fn) {
+    if (nr >= NR_SOFTIRQS) return;
+    softirq_vec[nr] = fn;
+}
+
+void raise_softirq(uint32_t nr) {
+    if (nr >= NR_SOFTIRQS) return;
+    __atomic_fetch_or(&softirq_cpu[smp_cpu_id()].pending, 1u << nr, __ATOMIC_RELAXED);
+}
+
+int softirq_pending(void) {
+    return softirq_cpu[smp_cpu_id()].pending != 0;
+}
+
+void do_softirq(void) {
+    uint32_t flags = irq_save();
+    softirq_cpu_t* sc = &softirq_cpu[smp_cpu_id()];
+
+    // A hard IRQ that lands while softirqs run must not recurse here
+    if (sc->active || !sc->pending) {
+        irq_restore(flags);
+        return;
+    }
+    sc->active = 1;
+
+    uint64_t start = rdtsc();
+    for (int round = 0; round < SOFTIRQ_MAX_RESTART; round++) {
+        uint32_t pending = __atomic_exchange_n(&sc->pending, 0, __ATOMIC_RELAXED);
+        if (!pending) break;
+
+        // Handlers run with interrupts on, so hard IRQs stay short
+        __asm__ volatile("sti");
+        for (uint32_t nr = 0; pending; nr++, pending >>= 1) {
+            if ((pending & 1) && softirq_vec[nr]) {
+                softirq_vec[nr]();
+                sc->stats.runs[nr]++;
+            }
+        }
+        __asm__ volatile("cli");
+    }
+
+    uint64_t cycles = rdtsc() - start;
+    sc->stats.cycles += cycles;
+    if (cycles > sc->stats.max_cycles) {
+        sc->stats.max_cycles = cycles;
+    }
+
+    // Anything still pending is picked up by the scheduler loop
+    sc->active = 0;
+    irq_restore(flags);
+}
+
+void softirq_get_stats(uint32_t cpu, softirq_stats_t* stats) {
+    if (cpu >= MAX_CPUS) return;
+    *stats = softirq_cpu[cpu].stats;
+}
+
+void softirq_reset_stats(void) {
+    for (int c = 0; c < MAX_CPUS; c++) {
+        memset(&softirq_cpu[c].stats, 0, sizeof(softirq_stats_t));
+    }
+}
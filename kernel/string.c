@@ -0,0 +1,209 @@
+#include "string.h"
+#include "div64.h"
+#include <stdint.h>
+
+int strcmp(const char* s1, const char* s2) {
+    while (*s1 && *s1 == *s2) {
+        s1++;
+        s2++;
+    }
+    return (unsigned char)*s1 - (unsigned char)*s2;
+}
+
+int strncmp(const char* s1, const char* s2, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        if (s1[i] != s2[i] || !s1[i]) {
+            return (unsigned char)s1[i] - (unsigned char)s2[i];
+        }
+    }
+    return 0;
+}
+
+size_t strlen(const char* str) {
+    size_t len = 0;
+    while (str[len]) len++;
+    return len;
+}
+
+char* strcpy(char* dest, const char* src) {
+    size_t i = 0;
+    while (src[i]) {
+        dest[i] = src[i];
+        i++;
+    }
+    dest[i] = '\0';
+    return dest;
+}
+
+char* strncpy(char* dest, const char* src, size_t n) {
+    size_t i = 0;
+    for (; i < n && src[i]; i++) {
+        dest[i] = src[i];
+    }
+    for (; i < n; i++) {
+        dest[i] = '\0';
+    }
+    return dest;
+}
+
+void* memset(void* ptr, int value, size_t num) {
+    uint8_t* p = (uint8_t*)ptr;
+    while (num--) {
+        *p++ = (uint8_t)value;
+    }
+    return ptr;
+}
+
+void* memcpy(void* dest, const void* src, size_t n) {
+    uint8_t* d = (uint8_t*)dest;
+    const uint8_t* s = (const uint8_t*)src;
+
+    // Copy dwords while both sides are aligned, then finish bytewise
+    if ((((uint32_t)d | (uint32_t)s) & 3) == 0) {
+        while (n >= 4) {
+            *(uint32_t*)d = *(const uint32_t*)s;
+            d += 4;
+            s += 4;
+            n -= 4;
+        }
+    }
+    while (n--) {
+        *d++ = *s++;
+    }
+    return dest;
+}
+
+int memcmp(const void* s1, const void* s2, size_t n) {
+    const uint8_t* a = (const uint8_t*)s1;
+    const uint8_t* b = (const uint8_t*)s2;
+    for (size_t i = 0; i < n; i++) {
+        if (a[i] != b[i]) return a[i] - b[i];
+    }
+    return 0;
+}
+
+// Write an unsigned number in the given base, right-aligned to width
+static char* format_number(char* out, uint64_t value, uint32_t base, int width,
+                           char pad, int negative, int upper) {
+    const char* digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+    char temp[24];
+    int len = 0;
+
+    do {
+        uint32_t rem;
+        value = div_u64_rem(value, base, &rem);
+        temp[len++] = digits[rem];
+    } while (value);
+
+    if (negative) {
+        if (pad == '0') {
+            *out++ = '-';
+        } else {
+            temp[len++] = '-';
+        }
+        width--;
+    }
+
+    while (width-- > len) {
+        *out++ = pad;
+    }
+    while (len > 0) {
+        *out++ = temp[--len];
+    }
+    return out;
+}
+
+// Supports %d %i %u %x %X %s %c %% with optional '0'/'-' flags,
+// field width and the 'l' / 'll' length modifiers.
+int vsprintf(char* str, const char* format, va_list ap) {
+    char* out = str;
+
+    for (const char* f = format; *f; f++) {
+        if (*f != '%') {
+            *out++ = *f;
+            continue;
+        }
+        f++;
+
+        char pad = ' ';
+        int left = 0;
+        if (*f == '-') {
+            left = 1;
+            f++;
+        }
+        if (*f == '0') {
+            pad = '0';
+            f++;
+        }
+
+        int width = 0;
+        while (*f >= '0' && *f <= '9') {
+            width = width * 10 + (*f - '0');
+            f++;
+        }
+
+        int longs = 0;
+        while (*f == 'l') {
+            longs++;
+            f++;
+        }
+
+        char* field = out;
+        switch (*f) {
+            case 'd':
+            case 'i': {
+                int64_t v = (longs >= 2) ? va_arg(ap, int64_t) : va_arg(ap, int32_t);
+                int neg = v < 0;
+                out = format_number(out, neg ? (uint64_t)-v : (uint64_t)v, 10,
+                                    left ? 0 : width, pad, neg, 0);
+                break;
+            }
+            case 'u':
+            case 'x':
+            case 'X': {
+                uint64_t v = (longs >= 2) ? va_arg(ap, uint64_t) : va_arg(ap, uint32_t);
+                out = format_number(out, v, (*f == 'u') ? 10 : 16,
+                                    left ? 0 : width, pad, 0, *f == 'X');
+                break;
+            }
+            case 's': {
+                const char* s = va_arg(ap, const char*);
+                if (!s) s = "(null)";
+                int len = (int)strlen(s);
+                if (!left) {
+                    while (width-- > len) *out++ = ' ';
+                }
+                while (*s) *out++ = *s++;
+                break;
+            }
+            case 'c':
+                *out++ = (char)va_arg(ap, int);
+                break;
+            case '%':
+                *out++ = '%';
+                break;
+            case '\0':
+                f--;
+                break;
+            default:
+                *out++ = '%';
+                *out++ = *f;
+                break;
+        }
+
+        if (left) {
+            while (out - field < width) *out++ = ' ';
+        }
+    }
+
+    *out = '\0';
+    return out - str;
+}
+
+int sprintf(char* str, const char* format, ...) {
+    va_list ap;
+    va_start(ap, format);
+    int len = vsprintf(str, format, ap);
+    va_end(ap);
+    return len;
+}
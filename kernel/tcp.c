@@ -0,0 +1,1771 @@
+#include "tcp.h"
+#include "ip.h"
+#include "net.h"
+#include "checksum.h"
+#include "timer.h"
+#include "lock.h"
+#include "string.h"
+#include "serial.h"
+#include <stddef.h>
+
+#define TCP_EPHEMERAL_FIRST  49152
+#define TCP_EPHEMERAL_LAST   65535
+#define TCP_CLOCK_GRANULARITY_US (TCP_TICK_MS * 1000)
+
+// Receive queues keep NIC buffers until the reader drains them
+#define TCP_PKTBUF_EXTRA     512
+
+// Send queue segment control block
+#define SEG_SEQ(pb)     ((pb)->cb[0])
+#define SEG_OFF(pb)     ((pb)->cb[1])    // Payload offset from pb->head
+#define SEG_EPOCH(pb)   ((pb)->cb[2])    // Recovery epoch it was last resent in
+#define SEG_LEN(pb)     ((pb)->cb[3])
+#define SNDQ(c, i)      ((c)->sndq[(i) & (TCP_SNDQ_SLOTS - 1)])
+
+// Parsed incoming segment
+typedef struct {
+    uint32_t seq;
+    uint32_t ack;
+    uint32_t wnd;                // Raw window field
+    uint32_t len;                // Payload bytes
+    uint8_t flags;
+    uint16_t mss;                // 0 if no option
+    int8_t wscale;               // -1 if no option
+    uint8_t sack_ok;
+    uint32_t num_sack;
+    uint32_t sack[TCP_SACK_BLOCKS][2];
+} tcp_seg_t;
+
+// The connection pool, the lookup hash (by local port and remote
+// address; there is one interface) and every reference count are
+// guarded by table_lock. Each connection's protocol state by its own lock,
+// taken after table_lock is released, or nested inside it never.
+static tcp_conn_t conns[TCP_MAX_CONNS];
+static tcp_conn_t* hash_table[TCP_HASH_SIZE];
+static spinlock_t table_lock;
+static uint16_t next_ephemeral = TCP_EPHEMERAL_FIRST;
+static uint32_t iss_secret;
+static tcp_stats_t stats;
+
+static const tcp_cong_ops_t* const cong_algos[] = { &tcp_cubic, &tcp_newreno };
+static const tcp_cong_ops_t* default_cong = &tcp_cubic;
+
+static inline uint32_t tcp_hash(uint16_t local_port, uint32_t remote_ip, uint16_t remote_port) {
+    uint32_t h = remote_ip ^ ((uint32_t)local_port << 16 | remote_port);
+    h ^= h >> 16;
+    h *= 0x45D9F3B;
+    h ^= h >> 16;
+    return h & (TCP_HASH_SIZE - 1);
+}
+
+static inline uint32_t ms_to_ticks(uint32_t ms) {
+    uint32_t t = (ms + TCP_TICK_MS - 1) / TCP_TICK_MS;
+    return t ? t : 1;
+}
+
+// Deadline ms from now; never 0, which means stopped
+static inline uint32_t tcp_deadline(uint32_t ms) {
+    uint32_t d = timer_get_ticks() + ms_to_ticks(ms);
+    return d ? d : 1;
+}
+
+static inline int tcp_expired(uint32_t deadline, uint32_t now) {
+    return deadline && (int32_t)(now - deadline) >= 0;
+}
+
+static inline uint32_t min_u32(uint32_t a, uint32_t b) { return a < b ? a : b; }
+static inline uint32_t max_u32(uint32_t a, uint32_t b) { return a > b ? a : b; }
+
+// ---------------------------------------------------------------------------
+// Connection table
+// ---------------------------------------------------------------------------
+
+// Called with table_lock held. Remote port 0 finds a listener.
+static tcp_conn_t* tcp_lookup(uint16_t local_port, uint32_t remote_ip, uint16_t remote_port) {
+    tcp_conn_t* c = hash_table[tcp_hash(local_port, remote_ip, remote_port)];
+    while (c && (c->local_port != local_port || c->remote_port != remote_port ||
+                 c->remote_ip != remote_ip)) {
+        c = c->hash_next;
+    }
+    return c;
+}
+
+static void tcp_purge_list(pktbuf_t* pb) {
+    while (pb) {
+        pktbuf_t* next = pb->next;
+        pb->next = NULL;
+        pktbuf_put(pb);
+        pb = next;
+    }
+}
+
+static void tcp_sndq_purge(tcp_conn_t* c) {
+    while (c->sndq_head != c->sndq_tail) {
+        pktbuf_put(SNDQ(c, c->sndq_head));
+        SNDQ(c, c->sndq_head) = NULL;
+        c->sndq_head++;
+    }
+    c->snd_unsent = c->sndq_head;
+    c->sndq_bytes = 0;
+}
+
+// Drop a reference; the last one returns the slot to the pool
+static void tcp_conn_put(tcp_conn_t* c) {
+    uint32_t flags = spin_lock_irqsave(&table_lock);
+    if (--c->refcnt == 0) {
+        tcp_sndq_purge(c);
+        tcp_purge_list(c->rcvq);
+        tcp_purge_list(c->oooq);
+        c->rcvq = c->rcvq_tail = c->oooq = NULL;
+        c->in_use = 0;
+    }
+    spin_unlock_irqrestore(&table_lock, flags);
+}
+
+// Called with table_lock held. The slot starts with one reference for
+// the hash and one for the owner; the caller hashes it once set up.
+static tcp_conn_t* tcp_conn_alloc(void) {
+    for (uint32_t i = 0; i < TCP_MAX_CONNS; i++) {
+        tcp_conn_t* c = &conns[i];
+        if (c->in_use) continue;
+
+        spinlock_t lock = c->lock;
+        memset(c, 0, sizeof(*c));
+        c->lock = lock;
+        c->in_use = 1;
+        c->refcnt = 2;
+        c->mss = TCP_MSS_DEFAULT;
+        c->rto_ms = TCP_RTO_INITIAL;
+        c->ssthresh = 0x7FFFFFFF;
+        c->cong = default_cong;
+
+        // Smallest shift that lets the whole receive buffer be offered
+        while ((TCP_RCVBUF >> c->rcv_wscale) > 0xFFFF) c->rcv_wscale++;
+        return c;
+    }
+    stats.conns_exhausted++;
+    return NULL;
+}
+
+// Called with table_lock held
+static void tcp_hash_insert(tcp_conn_t* c) {
+    uint32_t b = tcp_hash(c->local_port, c->remote_ip, c->remote_port);
+    c->hash_next = hash_table[b];
+    hash_table[b] = c;
+    c->hashed = 1;
+}
+
+// Remove from the table and drop its reference. Callers hold their own.
+static void tcp_unhash(tcp_conn_t* c) {
+    uint32_t flags = spin_lock_irqsave(&table_lock);
+    if (c->hashed) {
+        tcp_conn_t** link = &hash_table[tcp_hash(c->local_port, c->remote_ip, c->remote_port)];
+        while (*link && *link != c) link = &(*link)->hash_next;
+        if (*link) *link = c->hash_next;
+        c->hash_next = NULL;
+        c->hashed = 0;
+        c->refcnt--;
+    }
+    spin_unlock_irqrestore(&table_lock, flags);
+}
+
+// RFC 6528: a 4 us clock plus a keyed hash of the connection
+static uint32_t tcp_new_iss(tcp_conn_t* c) {
+    uint32_t h = iss_secret ^ c->remote_ip ^ ((uint32_t)c->local_port << 16 | c->remote_port);
+    h ^= h >> 15;
+    h *= 0x2C1B3C6D;
+    h ^= h >> 12;
+    return (uint32_t)(timer_cycles_to_us(rdtsc()) >> 2) + h;
+}
+
+// ---------------------------------------------------------------------------
+// Output
+// ---------------------------------------------------------------------------
+
+static uint32_t tcp_rcv_space(tcp_conn_t* c) {
+    uint32_t used = c->rcvq_bytes + c->oooq_bytes;
+    return used < TCP_RCVBUF ? TCP_RCVBUF - used : 0;
+}
+
+static uint32_t tcp_rcv_wnd(tcp_conn_t* c) {
+    return tcp_seq_gt(c->rcv_adv, c->rcv_nxt) ? c->rcv_adv - c->rcv_nxt : 0;
+}
+
+// Window field for an outgoing segment. The offered right edge never
+// moves back, and only moves forward by a useful amount (receiver-side
+// silly window avoidance, RFC 9293 3.8.6.2.2).
+static uint16_t tcp_select_window(tcp_conn_t* c, int syn) {
+    uint32_t space = tcp_rcv_space(c);
+    if (syn) {
+        space = min_u32(space, 0xFFFF);
+        c->rcv_adv = c->rcv_nxt + space;
+        return (uint16_t)space;
+    }
+
+    uint32_t cur = tcp_rcv_wnd(c);
+    if (space < cur || space - cur < min_u32(c->mss, TCP_RCVBUF / 2)) space = cur;
+    uint32_t field = (space + (1u << c->rcv_wscale) - 1) >> c->rcv_wscale;
+    if (field > 0xFFFF) field = 0xFFFF;
+    c->rcv_adv = c->rcv_nxt + (field << c->rcv_wscale);
+    return (uint16_t)field;
+}
+
+// SACK blocks describing the out-of-order queue, the range holding the
+// latest arrival first (RFC 2018 section 4). Returns the block count.
+static uint32_t tcp_build_sacks(tcp_conn_t* c, uint32_t blocks[][2], uint32_t max) {
+    uint32_t ranges[TCP_SACK_BLOCKS][2];
+    uint32_t n = 0;
+    for (pktbuf_t* pb = c->oooq; pb; pb = pb->next) {
+        uint32_t start = pb->cb[0], end = pb->cb[0] + pb->len;
+        if (n && tcp_seq_leq(start, ranges[n - 1][1])) {
+            if (tcp_seq_gt(end, ranges[n - 1][1])) ranges[n - 1][1] = end;
+        } else if (n < TCP_SACK_BLOCKS) {
+            ranges[n][0] = start;
+            ranges[n][1] = end;
+            n++;
+        } else {
+            break;
+        }
+    }
+
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        if (tcp_seq_geq(c->ooo_last, ranges[i][0]) && tcp_seq_lt(c->ooo_last, ranges[i][1])) {
+            blocks[count][0] = ranges[i][0];
+            blocks[count][1] = ranges[i][1];
+            count++;
+            ranges[i][1] = ranges[i][0];    // Emitted
+            break;
+        }
+    }
+    for (uint32_t i = 0; i < n && count < max; i++) {
+        if (ranges[i][0] == ranges[i][1]) continue;
+        blocks[count][0] = ranges[i][0];
+        blocks[count][1] = ranges[i][1];
+        count++;
+    }
+    return count;
+}
+
+static uint32_t tcp_write_options(tcp_conn_t* c, uint8_t* opt, uint8_t flags) {
+    uint32_t len = 0;
+    if (flags & TCP_SYN) {
+        opt[len++] = TCP_OPT_MSS;
+        opt[len++] = 4;
+        opt[len++] = TCP_MSS_LOCAL >> 8;
+        opt[len++] = TCP_MSS_LOCAL & 0xFF;
+        // A SYN-ACK only echoes the options the peer offered; rcv_wscale
+        // is nonzero exactly when scaling is in use
+        if (!(flags & TCP_ACK) || c->rcv_wscale) {
+            opt[len++] = TCP_OPT_NOP;
+            opt[len++] = TCP_OPT_WSCALE;
+            opt[len++] = 3;
+            opt[len++] = c->rcv_wscale;
+        }
+        if (!(flags & TCP_ACK) || c->sack_ok) {
+            opt[len++] = TCP_OPT_NOP;
+            opt[len++] = TCP_OPT_NOP;
+            opt[len++] = TCP_OPT_SACK_OK;
+            opt[len++] = 2;
+        }
+        return len;
+    }
+
+    if (c->sack_ok && c->oooq && (flags & TCP_ACK)) {
+        uint32_t blocks[3][2];
+        uint32_t n = tcp_build_sacks(c, blocks, 3);
+        opt[len++] = TCP_OPT_NOP;
+        opt[len++] = TCP_OPT_NOP;
+        opt[len++] = TCP_OPT_SACK;
+        opt[len++] = (uint8_t)(2 + n * 8);
+        for (uint32_t i = 0; i < n; i++) {
+            uint32_t start = htonl(blocks[i][0]), end = htonl(blocks[i][1]);
+            memcpy(opt + len, &start, 4);
+            memcpy(opt + len + 4, &end, 4);
+            len += 8;
+        }
+    }
+    return len;
+}
+
+// Seed the checksum with the pseudo header and hand the segment to IP;
+// consumes the reference
+static int tcp_csum_output(pktbuf_t* pb, tcp_header_t* th, uint32_t dest_ip) {
+    uint32_t pseudo = csum_tcpudp_nofold(htonl(ip_local_address()), htonl(dest_ip),
+                                         pb->len, IP_PROTO_TCP, 0);
+    th->checksum = (uint16_t)~csum_fold(pseudo);
+    net_tx_csum(pb, (uint8_t*)th, offsetof(tcp_header_t, checksum));
+    stats.out_segs++;
+    return ip_output(pb, dest_ip, IP_PROTO_TCP);
+}
+
+// Prepend the header (pb->data is at the payload) and send. Every
+// segment but the initial SYN carries the current ACK, so any pending
+// acknowledgement is satisfied.
+static int tcp_transmit(tcp_conn_t* c, pktbuf_t* pb, uint32_t seq, uint8_t flags) {
+    uint8_t opt[40];
+    uint32_t olen = tcp_write_options(c, opt, flags);
+    uint32_t hlen = TCP_HLEN + olen;
+
+    tcp_header_t* th = (tcp_header_t*)pktbuf_push(pb, hlen);
+    if (!th) {
+        pktbuf_put(pb);
+        return -1;
+    }
+    th->src_port = htons(c->local_port);
+    th->dest_port = htons(c->remote_port);
+    th->seq = htonl(seq);
+    th->ack = (flags & TCP_ACK) ? htonl(c->rcv_nxt) : 0;
+    th->data_off = (uint8_t)((hlen / 4) << 4);
+    th->flags = flags;
+    th->window = htons(tcp_select_window(c, flags & TCP_SYN));
+    th->urgent = 0;
+    memcpy(th + 1, opt, olen);
+
+    if (flags & TCP_ACK) {
+        c->ack_pending = 0;
+        c->quickack = 0;
+        c->delack_deadline = 0;
+    }
+    c->stats.segs_out++;
+    return tcp_csum_output(pb, th, c->remote_ip);
+}
+
+static void tcp_send_ctl(tcp_conn_t* c, uint32_t seq, uint8_t flags) {
+    pktbuf_t* pb = pktbuf_alloc();
+    if (pb) tcp_transmit(c, pb, seq, flags);
+}
+
+static void tcp_send_ack(tcp_conn_t* c) {
+    tcp_send_ctl(c, c->snd_nxt, TCP_ACK);
+}
+
+static void tcp_send_syn(tcp_conn_t* c) {
+    tcp_send_ctl(c, c->iss, c->state == TCP_SYN_RECEIVED ? TCP_SYN | TCP_ACK : TCP_SYN);
+}
+
+// Reset for a segment no connection wants (RFC 9293 3.10.7.1)
+static void tcp_send_reset(uint32_t dest_ip, uint16_t local_port, uint16_t remote_port,
+                           const tcp_seg_t* seg) {
+    pktbuf_t* pb = pktbuf_alloc();
+    if (!pb) return;
+    tcp_header_t* th = (tcp_header_t*)pktbuf_push(pb, TCP_HLEN);
+    th->src_port = htons(local_port);
+    th->dest_port = htons(remote_port);
+    if (seg->flags & TCP_ACK) {
+        th->seq = htonl(seg->ack);
+        th->ack = 0;
+        th->flags = TCP_RST;
+    } else {
+        uint32_t seglen = seg->len + !!(seg->flags & TCP_SYN) + !!(seg->flags & TCP_FIN);
+        th->seq = 0;
+        th->ack = htonl(seg->seq + seglen);
+        th->flags = TCP_RST | TCP_ACK;
+    }
+    th->data_off = (TCP_HLEN / 4) << 4;
+    th->window = 0;
+    th->urgent = 0;
+    stats.resets_out++;
+    tcp_csum_output(pb, th, dest_ip);
+}
+
+static void tcp_arm_rtx(tcp_conn_t* c) {
+    c->rtx_deadline = tcp_deadline(c->rto_ms);
+}
+
+// Send one queued segment. A buffer still referenced by a NIC ring from
+// its previous transmission is copied; otherwise the queued buffer goes
+// out itself, its headers rebuilt in front of the payload.
+static void tcp_xmit_segment(tcp_conn_t* c, pktbuf_t* seg, int retransmit) {
+    uint32_t seq = SEG_SEQ(seg);
+    uint32_t len = SEG_LEN(seg);
+    uint8_t* payload = seg->head + SEG_OFF(seg);
+
+    pktbuf_t* pb;
+    if (seg->refcnt > 1) {
+        pb = pktbuf_alloc();
+        if (!pb) return;
+        memcpy(pktbuf_append(pb, len), payload, len);
+    } else {
+        pb = seg;
+        pktbuf_get(pb);
+        pb->data = payload;
+        pb->len = len;
+        pb->csum_flags = 0;
+    }
+
+    if (retransmit) {
+        c->stats.retransmits++;
+        stats.retransmits++;
+        c->rtt_timing = 0;          // Karn: the sample would be ambiguous
+    } else {
+        c->stats.bytes_sent += len;
+    }
+    c->stats.data_segs_out++;
+
+    uint8_t flags = TCP_ACK;
+    if (seq + len == c->snd_end) flags |= TCP_PSH;
+    tcp_transmit(c, pb, seq, flags);
+}
+
+// Bytes believed to be in the network. During recovery, data the
+// receiver has SACKed (or, without SACK, one segment per duplicate ACK)
+// has left it.
+static uint32_t tcp_pipe(tcp_conn_t* c) {
+    uint32_t flight = c->snd_nxt - c->snd_una;
+    if (!c->in_recovery) return flight;
+    uint32_t left = c->sack_ok ? c->sacked_bytes : c->dupacks * c->mss;
+    return left < flight ? flight - left : 0;
+}
+
+static int tcp_can_send(tcp_conn_t* c) {
+    switch (c->state) {
+    case TCP_ESTABLISHED:
+    case TCP_CLOSE_WAIT:
+    case TCP_FIN_WAIT_1:
+    case TCP_CLOSING:
+    case TCP_LAST_ACK:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+// Send new data (and the FIN after it) as far as the congestion and
+// peer windows allow
+static void tcp_output(tcp_conn_t* c) {
+    if (!tcp_can_send(c)) return;
+
+    int held = 0;
+    while (c->snd_unsent != c->sndq_tail) {
+        pktbuf_t* seg = SNDQ(c, c->snd_unsent);
+        uint32_t seq = SEG_SEQ(seg);
+        uint32_t len = SEG_LEN(seg);
+        uint32_t pipe = tcp_pipe(c);
+        int retransmit = tcp_seq_lt(seq, c->snd_max);
+
+        if (c->cork && !retransmit && len < c->mss && c->snd_unsent + 1 == c->sndq_tail) {
+            held = 1;
+            break;
+        }
+        if (tcp_seq_gt(seq + len, c->snd_una + c->snd_wnd)) break;
+        if (pipe > 0 && pipe + len > c->cwnd) break;
+
+        tcp_xmit_segment(c, seg, retransmit);
+        if (!retransmit && !c->rtt_timing) {
+            c->rtt_timing = 1;
+            c->rtt_seq = seq + len;
+            c->rtt_tsc = rdtsc();
+        }
+        c->snd_nxt = seq + len;
+        if (tcp_seq_gt(c->snd_nxt, c->snd_max)) c->snd_max = c->snd_nxt;
+        c->snd_unsent++;
+    }
+
+    if (c->fin_queued && c->snd_unsent == c->sndq_tail && c->snd_nxt == c->snd_end) {
+        tcp_send_ctl(c, c->snd_end, TCP_FIN | TCP_ACK);
+        c->snd_nxt = c->snd_end + 1;
+        if (tcp_seq_gt(c->snd_nxt, c->snd_max)) c->snd_max = c->snd_nxt;
+    }
+
+    // Retransmission timer while data is out, persist timer while the
+    // peer's window holds queued data back
+    if (!c->rtx_deadline && (c->snd_nxt != c->snd_una || (c->snd_unsent != c->sndq_tail && !held))) {
+        tcp_arm_rtx(c);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Loss recovery
+// ---------------------------------------------------------------------------
+
+static int tcp_is_sacked(tcp_conn_t* c, uint32_t start, uint32_t end) {
+    for (uint32_t i = 0; i < c->num_sacked; i++) {
+        if (tcp_seq_leq(c->sacked[i][0], start) && tcp_seq_leq(end, c->sacked[i][1])) return 1;
+    }
+    return 0;
+}
+
+static void tcp_sack_recount(tcp_conn_t* c) {
+    c->sacked_bytes = 0;
+    for (uint32_t i = 0; i < c->num_sacked; i++) {
+        c->sacked_bytes += c->sacked[i][1] - c->sacked[i][0];
+    }
+}
+
+// Merge the peer's SACK blocks into the scoreboard, kept sorted and
+// disjoint. When it overflows the highest ranges are forgotten: holes
+// near snd_una matter most.
+static void tcp_sack_update(tcp_conn_t* c, const tcp_seg_t* seg) {
+    for (uint32_t b = 0; b < seg->num_sack; b++) {
+        uint32_t start = seg->sack[b][0], end = seg->sack[b][1];
+        if (!tcp_seq_lt(start, end) || tcp_seq_leq(end, c->snd_una) ||
+            tcp_seq_gt(end, c->snd_max)) {
+            continue;    // D-SACK or bogus
+        }
+        if (tcp_seq_lt(start, c->snd_una)) start = c->snd_una;
+        c->stats.sack_blocks_in++;
+
+        uint32_t merged[TCP_SACK_BLOCKS + 1][2];
+        uint32_t n = 0, placed = 0;
+        for (uint32_t i = 0; i <= c->num_sacked; i++) {
+            uint32_t s, e;
+            if (i < c->num_sacked && (placed || tcp_seq_lt(c->sacked[i][0], start))) {
+                s = c->sacked[i][0];
+                e = c->sacked[i][1];
+            } else if (!placed) {
+                s = start;
+                e = end;
+                placed = 1;
+                i--;
+            } else {
+                break;
+            }
+            if (n && tcp_seq_leq(s, merged[n - 1][1])) {
+                if (tcp_seq_gt(e, merged[n - 1][1])) merged[n - 1][1] = e;
+            } else {
+                merged[n][0] = s;
+                merged[n][1] = e;
+                n++;
+            }
+        }
+        if (n > TCP_SACK_BLOCKS) n = TCP_SACK_BLOCKS;
+        memcpy(c->sacked, merged, n * sizeof(merged[0]));
+        c->num_sacked = n;
+    }
+    tcp_sack_recount(c);
+}
+
+// Forget scoreboard ranges below the cumulative ACK
+static void tcp_sack_prune(tcp_conn_t* c) {
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < c->num_sacked; i++) {
+        if (tcp_seq_leq(c->sacked[i][1], c->snd_una)) continue;
+        c->sacked[n][0] = tcp_seq_lt(c->sacked[i][0], c->snd_una) ? c->snd_una : c->sacked[i][0];
+        c->sacked[n][1] = c->sacked[i][1];
+        n++;
+    }
+    c->num_sacked = n;
+    tcp_sack_recount(c);
+}
+
+// Resend what the receiver is missing below the recovery point, each
+// segment once per recovery episode, while the pipe leaves room. With
+// SACK a hole is any unSACKed segment below the highest SACKed byte;
+// without it only the segment at snd_una is known lost (NewReno).
+static void tcp_retransmit_holes(tcp_conn_t* c) {
+    uint32_t high = c->num_sacked ? c->sacked[c->num_sacked - 1][1] : c->snd_una + 1;
+    uint32_t pipe = tcp_pipe(c);
+
+    for (uint32_t i = c->sndq_head; i != c->snd_unsent; i++) {
+        pktbuf_t* seg = SNDQ(c, i);
+        uint32_t seq = SEG_SEQ(seg), len = SEG_LEN(seg);
+        if (!tcp_seq_lt(seq, c->recover) || !tcp_seq_lt(seq, high)) break;
+        if (SEG_EPOCH(seg) == c->recovery_epoch || tcp_is_sacked(c, seq, seq + len)) continue;
+        if (pipe >= c->cwnd && i != c->sndq_head) break;
+
+        SEG_EPOCH(seg) = c->recovery_epoch;
+        tcp_xmit_segment(c, seg, 1);
+        pipe += len;
+    }
+}
+
+static int tcp_loss_detected(tcp_conn_t* c) {
+    if (c->in_recovery || c->snd_max == c->snd_una) return 0;
+    // One reduction per window of data (RFC 6582 section 4.1)
+    if (tcp_seq_lt(c->snd_una, c->recover)) return 0;
+    return c->dupacks >= 3 || (c->sack_ok && c->sacked_bytes >= 3u * c->mss);
+}
+
+static void tcp_enter_recovery(tcp_conn_t* c) {
+    c->ssthresh = c->cong->ssthresh(c);
+    c->cwnd = c->ssthresh;
+    c->cwnd_cnt = 0;
+    c->recover = c->snd_max;
+    c->in_recovery = 1;
+    c->recovery_epoch++;
+    c->stats.fast_retransmits++;
+    tcp_retransmit_holes(c);
+}
+
+static void tcp_set_rto(tcp_conn_t* c) {
+    uint32_t rto_us = c->srtt_us + max_u32(TCP_CLOCK_GRANULARITY_US, 4 * c->rttvar_us);
+    c->rto_ms = min_u32(max_u32(rto_us / 1000, TCP_RTO_MIN), TCP_RTO_MAX);
+}
+
+// RFC 6298 section 2
+static void tcp_rtt_sample(tcp_conn_t* c, uint32_t rtt_us) {
+    if (c->srtt_us == 0) {
+        c->srtt_us = rtt_us ? rtt_us : 1;
+        c->rttvar_us = rtt_us / 2;
+    } else {
+        uint32_t delta = c->srtt_us > rtt_us ? c->srtt_us - rtt_us : rtt_us - c->srtt_us;
+        c->rttvar_us = (3 * c->rttvar_us + delta) / 4;
+        c->srtt_us = (7 * c->srtt_us + rtt_us) / 8;
+        if (c->srtt_us == 0) c->srtt_us = 1;
+    }
+    tcp_set_rto(c);
+}
+
+// Free or trim segments the peer has acknowledged
+static void tcp_sndq_ack(tcp_conn_t* c, uint32_t ack) {
+    while (c->sndq_head != c->sndq_tail) {
+        pktbuf_t* seg = SNDQ(c, c->sndq_head);
+        uint32_t seq = SEG_SEQ(seg), len = SEG_LEN(seg);
+        if (tcp_seq_leq(seq + len, ack)) {
+            c->sndq_bytes -= len;
+            pktbuf_put(seg);
+            SNDQ(c, c->sndq_head) = NULL;
+            c->sndq_head++;
+            continue;
+        }
+        if (tcp_seq_lt(seq, ack)) {
+            uint32_t n = ack - seq;
+            SEG_SEQ(seg) += n;
+            SEG_OFF(seg) += n;
+            SEG_LEN(seg) -= n;
+            c->sndq_bytes -= n;
+        }
+        break;
+    }
+    if ((int32_t)(c->snd_unsent - c->sndq_head) < 0) c->snd_unsent = c->sndq_head;
+}
+
+// ---------------------------------------------------------------------------
+// State changes
+// ---------------------------------------------------------------------------
+
+// Callers hold a reference of their own, so the slot outlives this
+static void tcp_set_closed(tcp_conn_t* c) {
+    c->state = TCP_CLOSED;
+    c->rtx_deadline = 0;
+    c->delack_deadline = 0;
+    c->tw_deadline = 0;
+    tcp_sndq_purge(c);
+    if (c->parent) {
+        // A child that never reached the accept queue: its owner
+        // reference was never handed out
+        tcp_conn_put(c->parent);
+        c->parent = NULL;
+        tcp_conn_put(c);
+    }
+    tcp_unhash(c);
+}
+
+static void tcp_reset_conn(tcp_conn_t* c) {
+    c->reset = 1;
+    tcp_set_closed(c);
+}
+
+static void tcp_enter_time_wait(tcp_conn_t* c) {
+    c->state = TCP_TIME_WAIT;
+    c->rtx_deadline = 0;
+    c->tw_deadline = tcp_deadline(TCP_TIME_WAIT_MS);
+    tcp_sndq_purge(c);
+}
+
+// Handshake complete: initial window (RFC 6928), or one segment if the
+// SYN had to be retransmitted (RFC 6298 section 5.7)
+static void tcp_established(tcp_conn_t* c) {
+    int syn_lost = c->backoff != 0;
+    c->state = TCP_ESTABLISHED;
+    c->retries = 0;
+    c->backoff = 0;
+    c->rtx_deadline = 0;
+    c->recover = c->snd_una;
+    c->cong->init(c);
+    c->cwnd = min_u32(10 * c->mss, max_u32(2 * c->mss, 14600));
+    if (syn_lost) c->cwnd = c->mss;
+    c->rtt_timing = 0;
+}
+
+// Timed handshake segment acknowledged
+static void tcp_syn_rtt(tcp_conn_t* c) {
+    if (c->rtt_timing) tcp_rtt_sample(c, (uint32_t)timer_cycles_to_us(rdtsc() - c->rtt_tsc));
+}
+
+static void tcp_negotiate(tcp_conn_t* c, const tcp_seg_t* seg) {
+    uint32_t mss = seg->mss ? seg->mss : TCP_MSS_DEFAULT;
+    c->mss = (uint16_t)min_u32(max_u32(mss, 64), TCP_MSS_LOCAL);
+    if (seg->wscale >= 0) {
+        c->snd_wscale = (uint8_t)(seg->wscale > 14 ? 14 : seg->wscale);
+    } else {
+        c->snd_wscale = 0;
+        c->rcv_wscale = 0;
+    }
+    c->sack_ok = seg->sack_ok;
+    c->rcv_adv = c->rcv_nxt + min_u32(TCP_RCVBUF, 0xFFFF);    // As offered on our SYN
+}
+
+// Child finished its handshake: hand it to the listener's accept queue.
+// Returns the listener (with the child's reference) for notification.
+static tcp_conn_t* tcp_queue_accept(tcp_conn_t* c) {
+    tcp_conn_t* parent = c->parent;
+    if (!parent) return NULL;
+
+    uint32_t flags = spin_lock_irqsave(&parent->lock);
+    int listening = parent->state == TCP_LISTEN;
+    if (listening) {
+        c->accept_next = NULL;
+        tcp_conn_t** link = &parent->acceptq;
+        while (*link) link = &(*link)->accept_next;
+        *link = c;
+        parent->accept_len++;
+    }
+    spin_unlock_irqrestore(&parent->lock, flags);
+
+    if (!listening) {
+        tcp_send_ctl(c, c->snd_nxt, TCP_RST);
+        stats.resets_out++;
+        tcp_reset_conn(c);
+        return NULL;
+    }
+    c->parent = NULL;    // Its reference on the listener goes to the caller
+    return parent;
+}
+
+// ---------------------------------------------------------------------------
+// Input
+// ---------------------------------------------------------------------------
+
+static void tcp_parse_options(const uint8_t* opt, uint32_t len, tcp_seg_t* seg) {
+    uint32_t i = 0;
+    while (i < len) {
+        uint8_t kind = opt[i];
+        if (kind == TCP_OPT_END) break;
+        if (kind == TCP_OPT_NOP) {
+            i++;
+            continue;
+        }
+        if (i + 1 >= len) break;
+        uint8_t olen = opt[i + 1];
+        if (olen < 2 || i + olen > len) break;
+
+        if (kind == TCP_OPT_MSS && olen == 4 && (seg->flags & TCP_SYN)) {
+            seg->mss = (uint16_t)(opt[i + 2] << 8 | opt[i + 3]);
+        } else if (kind == TCP_OPT_WSCALE && olen == 3 && (seg->flags & TCP_SYN)) {
+            seg->wscale = (int8_t)opt[i + 2];
+        } else if (kind == TCP_OPT_SACK_OK && olen == 2 && (seg->flags & TCP_SYN)) {
+            seg->sack_ok = 1;
+        } else if (kind == TCP_OPT_SACK && olen >= 10 && (olen - 2) % 8 == 0) {
+            for (uint32_t b = 0; b < (uint32_t)(olen - 2) / 8 && seg->num_sack < TCP_SACK_BLOCKS; b++) {
+                uint32_t start, end;
+                memcpy(&start, opt + i + 2 + b * 8, 4);
+                memcpy(&end, opt + i + 6 + b * 8, 4);
+                seg->sack[seg->num_sack][0] = ntohl(start);
+                seg->sack[seg->num_sack][1] = ntohl(end);
+                seg->num_sack++;
+            }
+        }
+        i += olen;
+    }
+}
+
+// RFC 9293 3.10.7.4, first check
+static int tcp_seq_acceptable(tcp_conn_t* c, const tcp_seg_t* seg) {
+    uint32_t wnd = tcp_rcv_wnd(c);
+    uint32_t seglen = seg->len + !!(seg->flags & TCP_FIN);
+    if (seglen == 0) {
+        if (wnd == 0) return seg->seq == c->rcv_nxt;
+        return tcp_seq_geq(seg->seq, c->rcv_nxt) && tcp_seq_lt(seg->seq, c->rcv_nxt + wnd);
+    }
+    if (wnd == 0) return 0;
+    uint32_t last = seg->seq + seglen - 1;
+    return (tcp_seq_geq(seg->seq, c->rcv_nxt) && tcp_seq_lt(seg->seq, c->rcv_nxt + wnd)) ||
+           (tcp_seq_geq(last, c->rcv_nxt) && tcp_seq_lt(last, c->rcv_nxt + wnd));
+}
+
+// Queue a segment beyond a hole, sorted by sequence. Exact or covered
+// duplicates are dropped; partial overlaps are trimmed when drained.
+static void tcp_ooo_insert(tcp_conn_t* c, pktbuf_t* pb, uint32_t seq) {
+    uint32_t end = seq + pb->len;
+    if (c->oooq_bytes + pb->len > TCP_RCVBUF) return;
+
+    pktbuf_t** link = &c->oooq;
+    while (*link && tcp_seq_leq((*link)->cb[0], seq)) {
+        pktbuf_t* q = *link;
+        if (tcp_seq_geq(seq, q->cb[0]) && tcp_seq_leq(end, q->cb[0] + q->len)) return;
+        link = &q->next;
+    }
+    pktbuf_get(pb);
+    pb->cb[0] = seq;
+    pb->next = *link;
+    *link = pb;
+    c->oooq_bytes += pb->len;
+    c->ooo_last = seq;
+    c->stats.ooo_segments++;
+}
+
+static void tcp_rcvq_append(tcp_conn_t* c, pktbuf_t* pb) {
+    pb->next = NULL;
+    if (c->rcvq_tail) c->rcvq_tail->next = pb;
+    else c->rcvq = pb;
+    c->rcvq_tail = pb;
+    c->rcvq_bytes += pb->len;
+    c->rcv_nxt += pb->len;
+    c->stats.bytes_received += pb->len;
+}
+
+// Move out-of-order segments the new data made contiguous
+static void tcp_ooo_drain(tcp_conn_t* c) {
+    while (c->oooq && tcp_seq_leq(c->oooq->cb[0], c->rcv_nxt)) {
+        pktbuf_t* pb = c->oooq;
+        c->oooq = pb->next;
+        c->oooq_bytes -= pb->len;
+
+        uint32_t seq = pb->cb[0];
+        if (tcp_seq_leq(seq + pb->len, c->rcv_nxt)) {
+            pb->next = NULL;
+            pktbuf_put(pb);
+            continue;
+        }
+        pktbuf_pull(pb, c->rcv_nxt - seq);
+        tcp_rcvq_append(c, pb);
+    }
+}
+
+// Payload and FIN of an acceptable segment. Returns events; sets
+// *ack_now when the ACK must not be delayed.
+static uint32_t tcp_data_input(tcp_conn_t* c, tcp_seg_t* seg, pktbuf_t* pb, int* ack_now) {
+    uint32_t seq = seg->seq;
+    uint32_t len = seg->len;
+    int fin = (seg->flags & TCP_FIN) != 0;
+    uint32_t events = 0;
+
+    // Already received: trim the front (a whole duplicate is re-ACKed)
+    if (tcp_seq_lt(seq, c->rcv_nxt)) {
+        uint32_t dup = min_u32(c->rcv_nxt - seq, len);
+        pktbuf_pull(pb, dup);
+        seq += dup;
+        len -= dup;
+        if (tcp_seq_lt(seq, c->rcv_nxt)) fin = 0;
+        *ack_now = 1;
+    }
+    // Beyond the offered window: trim the back
+    uint32_t wnd_end = tcp_seq_gt(c->rcv_adv, c->rcv_nxt) ? c->rcv_adv : c->rcv_nxt;
+    if (tcp_seq_gt(seq + len, wnd_end)) {
+        uint32_t excess = seq + len - wnd_end;
+        len = excess >= len ? 0 : len - excess;
+        fin = 0;
+        *ack_now = 1;
+    }
+    pb->len = len;
+    if (len == 0 && !fin) return 0;
+
+    if (seq != c->rcv_nxt) {
+        // Past a hole: keep it and tell the sender at once, with SACK
+        if (len) tcp_ooo_insert(c, pb, seq);
+        *ack_now = 1;
+        return 0;
+    }
+
+    if (len) {
+        pktbuf_get(pb);
+        tcp_rcvq_append(c, pb);
+        events |= TCP_EV_READABLE;
+    }
+    if (c->oooq) {
+        tcp_ooo_drain(c);
+        *ack_now = 1;    // Hole filled: the sender is waiting to hear
+    }
+    c->ack_pending++;
+
+    if (fin) {
+        c->rcv_nxt++;
+        c->fin_received = 1;
+        *ack_now = 1;
+        events |= TCP_EV_READABLE;
+        if (c->state == TCP_ESTABLISHED) {
+            c->state = TCP_CLOSE_WAIT;
+        } else if (c->state == TCP_FIN_WAIT_1) {
+            c->state = TCP_CLOSING;
+        } else if (c->state == TCP_FIN_WAIT_2) {
+            tcp_enter_time_wait(c);
+        }
+    }
+    return events;
+}
+
+// ACK field of a segment in a synchronized state. Returns events, or
+// -1 to drop the rest of the segment.
+static int32_t tcp_ack_input(tcp_conn_t* c, const tcp_seg_t* seg, int* ack_now) {
+    uint32_t ack = seg->ack;
+    uint32_t events = 0;
+
+    if (tcp_seq_gt(ack, c->snd_max)) {
+        *ack_now = 1;    // Acknowledges something never sent
+        return -1;
+    }
+    if (tcp_seq_lt(ack, c->snd_una)) return 0;    // Old duplicate
+
+    if (c->sack_ok && seg->num_sack) tcp_sack_update(c, seg);
+
+    // Window update (RFC 9293 3.10.7.4, fifth check)
+    int window_changed = 0;
+    if (tcp_seq_lt(c->snd_wl1, seg->seq) ||
+        (c->snd_wl1 == seg->seq && tcp_seq_leq(c->snd_wl2, ack))) {
+        uint32_t wnd = seg->wnd << c->snd_wscale;
+        window_changed = wnd != c->snd_wnd;
+        c->snd_wnd = wnd;
+        c->snd_wl1 = seg->seq;
+        c->snd_wl2 = ack;
+    }
+
+    if (ack == c->snd_una) {
+        // Duplicate ACK as RFC 5681 defines it
+        if (seg->len == 0 && !(seg->flags & (TCP_SYN | TCP_FIN)) && !window_changed &&
+            c->snd_max != c->snd_una) {
+            c->dupacks++;
+            c->stats.dup_acks++;
+        }
+        if (c->in_recovery) tcp_retransmit_holes(c);
+        else if (tcp_loss_detected(c)) tcp_enter_recovery(c);
+        if (window_changed) events |= TCP_EV_WRITABLE;
+        return events;
+    }
+
+    // New data acknowledged
+    uint32_t acked = ack - c->snd_una;
+    uint32_t rtt_us = 0;
+    if (c->rtt_timing && tcp_seq_geq(ack, c->rtt_seq)) {
+        rtt_us = (uint32_t)timer_cycles_to_us(rdtsc() - c->rtt_tsc);
+        tcp_rtt_sample(c, rtt_us);
+        c->rtt_timing = 0;
+    }
+
+    tcp_sndq_ack(c, ack);
+    c->snd_una = ack;
+    if (tcp_seq_lt(c->snd_nxt, ack)) c->snd_nxt = ack;
+    c->stats.bytes_acked += acked;
+    c->retries = 0;
+    if (c->backoff) {
+        c->backoff = 0;
+        if (c->srtt_us) tcp_set_rto(c);
+    }
+    tcp_sack_prune(c);
+
+    if (c->in_recovery) {
+        if (tcp_seq_geq(ack, c->recover)) {
+            c->in_recovery = 0;
+            c->dupacks = 0;
+            c->cong->on_recovered(c);
+        } else {
+            // Partial ACK: the next hole is lost too (RFC 6582 3.2)
+            c->dupacks = 0;
+            tcp_retransmit_holes(c);
+        }
+    } else {
+        c->dupacks = 0;
+        c->cong->on_ack(c, acked, rtt_us);
+        if (tcp_loss_detected(c)) tcp_enter_recovery(c);
+    }
+
+    // Restart the timer for what is still outstanding (RFC 6298 5.3)
+    c->rtx_deadline = 0;
+    if (c->snd_nxt != c->snd_una) tcp_arm_rtx(c);
+
+    // Our FIN acknowledged
+    if (c->fin_queued && tcp_seq_gt(c->snd_una, c->snd_end)) {
+        if (c->state == TCP_FIN_WAIT_1) {
+            // Only tcp_close() sends a FIN, so nobody owns the connection
+            // any more: don't wait forever for the peer's
+            c->state = TCP_FIN_WAIT_2;
+            c->tw_deadline = tcp_deadline(TCP_FIN_WAIT_2_MS);
+        } else if (c->state == TCP_CLOSING) {
+            tcp_enter_time_wait(c);
+        } else if (c->state == TCP_LAST_ACK) {
+            tcp_set_closed(c);
+            return TCP_EV_CLOSED;
+        }
+    }
+
+    if (c->sndq_bytes < TCP_SNDBUF) events |= TCP_EV_WRITABLE;
+    return events;
+}
+
+// Active open: waiting for the SYN-ACK (RFC 9293 3.10.7.3)
+static uint32_t tcp_syn_sent_input(tcp_conn_t* c, const tcp_seg_t* seg) {
+    int ack_ok = 0;
+    if (seg->flags & TCP_ACK) {
+        if (tcp_seq_leq(seg->ack, c->iss) || tcp_seq_gt(seg->ack, c->snd_max)) {
+            if (!(seg->flags & TCP_RST)) {
+                tcp_send_ctl(c, seg->ack, TCP_RST);
+                stats.resets_out++;
+            }
+            return 0;
+        }
+        ack_ok = 1;
+    }
+    if (seg->flags & TCP_RST) {
+        if (!ack_ok) return 0;
+        stats.resets_in++;
+        tcp_reset_conn(c);    // Connection refused
+        return TCP_EV_CLOSED;
+    }
+    if (!(seg->flags & TCP_SYN)) return 0;
+
+    c->irs = seg->seq;
+    c->rcv_nxt = seg->seq + 1;
+    tcp_negotiate(c, seg);
+    c->snd_wnd = seg->wnd;       // Never scaled on a SYN
+    c->snd_wl1 = seg->seq;
+    c->snd_wl2 = seg->ack;
+
+    if (!ack_ok) {
+        // Simultaneous open
+        c->state = TCP_SYN_RECEIVED;
+        tcp_send_syn(c);
+        return 0;
+    }
+
+    c->snd_una = seg->ack;
+    tcp_syn_rtt(c);
+    tcp_established(c);
+    tcp_send_ack(c);
+    return TCP_EV_CONNECTED | TCP_EV_WRITABLE;
+}
+
+// Segment for a connection past SYN_SENT. *accepted is set to the
+// listener to notify when a child completes its handshake.
+static uint32_t tcp_input(tcp_conn_t* c, tcp_seg_t* seg, pktbuf_t* pb, tcp_conn_t** accepted) {
+    if (c->state == TCP_SYN_SENT) return tcp_syn_sent_input(c, seg);
+    if (c->state == TCP_CLOSED) return 0;
+
+    if (c->state == TCP_TIME_WAIT) {
+        // Only a retransmitted FIN is expected: ACK it and restart 2 MSL
+        if (!(seg->flags & TCP_RST)) tcp_send_ack(c);
+        if (seg->flags & TCP_FIN) c->tw_deadline = tcp_deadline(TCP_TIME_WAIT_MS);
+        return 0;
+    }
+
+    int ack_now = 0;
+    uint32_t events = 0;
+
+    // The peer's SYN again: our SYN-ACK was lost. Resend it now instead
+    // of leaving the handshake to the retransmission timer.
+    if (c->state == TCP_SYN_RECEIVED && (seg->flags & (TCP_SYN | TCP_ACK | TCP_RST)) == TCP_SYN &&
+        seg->seq == c->irs) {
+        c->rtt_timing = 0;          // Karn: the reply could answer either copy
+        c->stats.retransmits++;
+        stats.retransmits++;
+        tcp_send_syn(c);
+        return 0;
+    }
+
+    if (!tcp_seq_acceptable(c, seg)) {
+        // Still take the ACK of a zero-window probe's reply
+        if (seg->seq == c->rcv_nxt && (seg->flags & TCP_ACK) && !(seg->flags & TCP_RST)) {
+            seg->len = 0;
+            seg->flags &= ~TCP_FIN;
+            ack_now = 1;
+        } else {
+            if (!(seg->flags & TCP_RST)) tcp_send_ack(c);
+            return 0;
+        }
+    }
+
+    if (seg->flags & TCP_RST) {
+        // RFC 5961: only an exact match resets; in-window gets a challenge
+        if (seg->seq == c->rcv_nxt) {
+            stats.resets_in++;
+            tcp_reset_conn(c);
+            return TCP_EV_CLOSED | TCP_EV_READABLE;
+        }
+        tcp_send_ack(c);
+        return 0;
+    }
+    if (seg->flags & TCP_SYN) {
+        tcp_send_ack(c);    // Challenge ACK (RFC 5961 section 4)
+        return 0;
+    }
+    if (!(seg->flags & TCP_ACK)) return 0;
+
+    if (c->state == TCP_SYN_RECEIVED) {
+        if (tcp_seq_leq(seg->ack, c->snd_una) || tcp_seq_gt(seg->ack, c->snd_max)) {
+            tcp_send_ctl(c, seg->ack, TCP_RST);
+            stats.resets_out++;
+            return 0;
+        }
+        c->snd_una = seg->ack;
+        c->snd_wnd = seg->wnd << c->snd_wscale;
+        c->snd_wl1 = seg->seq;
+        c->snd_wl2 = seg->ack;
+        tcp_syn_rtt(c);
+        tcp_established(c);
+        events |= TCP_EV_CONNECTED | TCP_EV_WRITABLE;
+        *accepted = tcp_queue_accept(c);
+        if (c->state == TCP_CLOSED) return TCP_EV_CLOSED;
+    }
+
+    int32_t ack_events = tcp_ack_input(c, seg, &ack_now);
+    if (ack_events < 0) {
+        if (ack_now) tcp_send_ack(c);
+        return events;
+    }
+    events |= (uint32_t)ack_events;
+    if (c->state == TCP_CLOSED) return events;
+
+    if (c->state == TCP_ESTABLISHED || c->state == TCP_FIN_WAIT_1 || c->state == TCP_FIN_WAIT_2) {
+        events |= tcp_data_input(c, seg, pb, &ack_now);
+    } else if (seg->len || (seg->flags & TCP_FIN)) {
+        ack_now = 1;    // Retransmission of data or FIN already taken
+    }
+
+    tcp_output(c);
+
+    // Acknowledge every second segment at once, the rest after the
+    // delayed-ACK timeout (RFC 1122 4.2.3.2)
+    if (c->ack_pending || ack_now) {
+        if (ack_now || c->quickack || c->ack_pending >= 2) tcp_send_ack(c);
+        else if (!c->delack_deadline) c->delack_deadline = tcp_deadline(TCP_DELACK_MS);
+    }
+    return events;
+}
+
+// SYN for a listener: create the child in SYN_RECEIVED. Returns it with
+// a reference for the caller, who sends the SYN-ACK.
+static tcp_conn_t* tcp_listen_input(tcp_conn_t* l, const tcp_seg_t* seg, uint32_t src_ip,
+                                    uint16_t src_port, uint32_t dest_ip) {
+    if (seg->flags & TCP_RST) return NULL;
+    if (seg->flags & TCP_ACK) {
+        tcp_send_reset(src_ip, l->local_port, src_port, seg);
+        return NULL;
+    }
+    if (!(seg->flags & TCP_SYN)) return NULL;
+    if (l->accept_len >= l->backlog) return NULL;    // The client retries
+
+    uint32_t flags = spin_lock_irqsave(&table_lock);
+    tcp_conn_t* c = tcp_conn_alloc();
+    if (!c) {
+        spin_unlock_irqrestore(&table_lock, flags);
+        return NULL;
+    }
+    c->state = TCP_SYN_RECEIVED;
+    c->local_ip = dest_ip;
+    c->local_port = l->local_port;
+    c->remote_ip = src_ip;
+    c->remote_port = src_port;
+    c->cong = l->cong;
+    c->parent = l;
+    l->refcnt++;
+    c->refcnt++;    // The caller's
+    tcp_hash_insert(c);
+    spin_unlock_irqrestore(&table_lock, flags);
+
+    c->irs = seg->seq;
+    c->rcv_nxt = seg->seq + 1;
+    tcp_negotiate(c, seg);
+    c->snd_wnd = seg->wnd;
+    c->iss = tcp_new_iss(c);
+    c->snd_una = c->iss;
+    c->snd_nxt = c->iss + 1;
+    c->snd_max = c->snd_nxt;
+    c->snd_end = c->snd_nxt;
+    c->recover = c->iss;
+    stats.passive_opens++;
+    return c;
+}
+
+static void tcp_notify(tcp_conn_t* c, uint32_t events,
+                       void (*fn)(tcp_conn_t*, uint32_t, void*), void* arg) {
+    if (events && fn) fn(c, events, arg);
+}
+
+static void tcp_rx(pktbuf_t* pb, ip_header_t* ip) {
+    stats.in_segs++;
+
+    tcp_header_t* th = (tcp_header_t*)pb->data;
+    uint32_t hlen = pb->len >= TCP_HLEN ? (uint32_t)(th->data_off >> 4) * 4 : 0;
+    if (hlen < TCP_HLEN || hlen > pb->len) {
+        stats.in_errors++;
+        return;
+    }
+    uint32_t seed = csum_tcpudp_nofold(ip->src_ip, ip->dest_ip, pb->len, IP_PROTO_TCP, 0);
+    if (!net_rx_csum_ok(pb, NET_CSUM_L4, th, pb->len, seed)) {
+        stats.in_csum_errors++;
+        return;
+    }
+    uint32_t dest_ip = ntohl(ip->dest_ip);
+    if (dest_ip == IP_BROADCAST) return;
+
+    tcp_seg_t seg;
+    seg.seq = ntohl(th->seq);
+    seg.ack = ntohl(th->ack);
+    seg.wnd = ntohs(th->window);
+    seg.flags = th->flags;
+    seg.mss = 0;
+    seg.wscale = -1;
+    seg.sack_ok = 0;
+    seg.num_sack = 0;
+    if (hlen > TCP_HLEN) tcp_parse_options((uint8_t*)(th + 1), hlen - TCP_HLEN, &seg);
+
+    uint32_t src_ip = ntohl(ip->src_ip);
+    uint16_t src_port = ntohs(th->src_port);
+    uint16_t dest_port = ntohs(th->dest_port);
+    pktbuf_pull(pb, hlen);
+    seg.len = pb->len;
+
+    uint32_t flags = spin_lock_irqsave(&table_lock);
+    tcp_conn_t* c = tcp_lookup(dest_port, src_ip, src_port);
+    if (!c) {
+        c = tcp_lookup(dest_port, 0, 0);
+        if (c && c->state != TCP_LISTEN) c = NULL;
+    }
+    if (c) c->refcnt++;
+    spin_unlock_irqrestore(&table_lock, flags);
+
+    if (!c) {
+        stats.no_conn++;
+        if (!(seg.flags & TCP_RST)) tcp_send_reset(src_ip, dest_port, src_port, &seg);
+        net_flush();
+        return;
+    }
+
+    tcp_conn_t* child = NULL;
+    tcp_conn_t* accepted = NULL;
+    uint32_t events = 0;
+
+    flags = spin_lock_irqsave(&c->lock);
+    c->stats.segs_in++;
+    if (c->state == TCP_LISTEN) {
+        child = tcp_listen_input(c, &seg, src_ip, src_port, dest_ip);
+    } else {
+        events = tcp_input(c, &seg, pb, &accepted);
+    }
+    void (*fn)(tcp_conn_t*, uint32_t, void*) = c->event_fn;
+    void* arg = c->event_arg;
+    spin_unlock_irqrestore(&c->lock, flags);
+
+    if (child) {
+        flags = spin_lock_irqsave(&child->lock);
+        tcp_send_syn(child);
+        tcp_arm_rtx(child);
+        child->rtt_timing = 1;
+        child->rtt_tsc = rdtsc();
+        spin_unlock_irqrestore(&child->lock, flags);
+        tcp_conn_put(child);
+    }
+    net_flush();
+
+    tcp_notify(c, events, fn, arg);
+    if (accepted) {
+        flags = spin_lock_irqsave(&accepted->lock);
+        fn = accepted->event_fn;
+        arg = accepted->event_arg;
+        spin_unlock_irqrestore(&accepted->lock, flags);
+        tcp_notify(accepted, TCP_EV_ACCEPT, fn, arg);
+        tcp_conn_put(accepted);
+    }
+    tcp_conn_put(c);
+}
+
+// ---------------------------------------------------------------------------
+// Timers
+// ---------------------------------------------------------------------------
+
+static uint32_t tcp_rtx_timeout(tcp_conn_t* c) {
+    c->rtx_deadline = 0;
+    c->rtt_timing = 0;
+
+    if (c->state == TCP_SYN_SENT || c->state == TCP_SYN_RECEIVED) {
+        if (++c->retries > TCP_SYN_RETRIES) {
+            tcp_reset_conn(c);
+            return TCP_EV_CLOSED;
+        }
+        c->backoff++;
+        c->rto_ms = min_u32(c->rto_ms * 2, TCP_RTO_MAX);
+        c->stats.retransmits++;
+        stats.retransmits++;
+        tcp_send_syn(c);
+        tcp_arm_rtx(c);
+        return 0;
+    }
+    if (!tcp_can_send(c)) return 0;
+
+    if (c->snd_nxt == c->snd_una) {
+        // Persist timer: probe the closed window with the next segment.
+        // snd_nxt stays put, so the segment goes out again normally once
+        // the window opens; an ACK covering it advances snd_nxt instead.
+        if (c->snd_unsent != c->sndq_tail) {
+            pktbuf_t* seg = SNDQ(c, c->snd_unsent);
+            tcp_xmit_segment(c, seg, tcp_seq_lt(SEG_SEQ(seg), c->snd_max));
+            if (tcp_seq_gt(SEG_SEQ(seg) + SEG_LEN(seg), c->snd_max)) {
+                c->snd_max = SEG_SEQ(seg) + SEG_LEN(seg);
+            }
+            c->stats.zero_window_probes++;
+            if (c->backoff < 16) c->backoff++;
+            c->rtx_deadline = tcp_deadline(min_u32(c->rto_ms << c->backoff, TCP_RTO_MAX));
+        }
+        return 0;
+    }
+
+    // Retransmission timeout (RFC 6298 5.4-5.7, RFC 5681 3.1)
+    if (++c->retries > TCP_MAX_RETRIES) {
+        tcp_send_ctl(c, c->snd_nxt, TCP_RST);
+        stats.resets_out++;
+        tcp_reset_conn(c);
+        return TCP_EV_CLOSED;
+    }
+    c->stats.timeouts++;
+    if (c->backoff == 0) c->ssthresh = c->cong->ssthresh(c);
+    c->cong->on_timeout(c);
+    c->in_recovery = 0;
+    c->dupacks = 0;
+    c->recover = c->snd_max;
+    c->num_sacked = 0;
+    c->sacked_bytes = 0;
+    c->backoff++;
+    c->rto_ms = min_u32(c->rto_ms * 2, TCP_RTO_MAX);
+
+    // Go back N from the oldest unacknowledged segment
+    c->snd_nxt = c->snd_una;
+    c->snd_unsent = c->sndq_head;
+    tcp_output(c);
+    if (!c->rtx_deadline) tcp_arm_rtx(c);
+    return 0;
+}
+
+static uint32_t tcp_timers(tcp_conn_t* c, uint32_t now) {
+    if (tcp_expired(c->tw_deadline, now)) {
+        // TIME_WAIT over, or an orphan gave up waiting in FIN_WAIT_2
+        tcp_set_closed(c);
+        return TCP_EV_CLOSED;
+    }
+    if (tcp_expired(c->delack_deadline, now)) {
+        c->delack_deadline = 0;
+        if (c->ack_pending) {
+            tcp_send_ack(c);
+            c->stats.delayed_acks++;
+        }
+    }
+    if (tcp_expired(c->rtx_deadline, now)) return tcp_rtx_timeout(c);
+    return 0;
+}
+
+void tcp_tick(void) {
+    uint32_t now = timer_get_ticks();
+    int sent = 0;
+
+    for (uint32_t i = 0; i < TCP_MAX_CONNS; i++) {
+        tcp_conn_t* c = &conns[i];
+        if (!c->hashed) continue;
+
+        uint32_t flags = spin_lock_irqsave(&table_lock);
+        if (!c->hashed) {
+            spin_unlock_irqrestore(&table_lock, flags);
+            continue;
+        }
+        c->refcnt++;
+        spin_unlock_irqrestore(&table_lock, flags);
+
+        flags = spin_lock_irqsave(&c->lock);
+        uint32_t events = 0;
+        if (c->tw_deadline || c->delack_deadline || c->rtx_deadline) {
+            uint32_t segs = c->stats.segs_out;
+            events = tcp_timers(c, now);
+            sent |= c->stats.segs_out != segs;
+        }
+        void (*fn)(tcp_conn_t*, uint32_t, void*) = c->event_fn;
+        void* arg = c->event_arg;
+        spin_unlock_irqrestore(&c->lock, flags);
+
+        tcp_notify(c, events, fn, arg);
+        tcp_conn_put(c);
+    }
+    if (sent) net_flush();
+}
+
+// ---------------------------------------------------------------------------
+// User interface
+// ---------------------------------------------------------------------------
+
+static int tcp_port_in_use(uint16_t port) {
+    for (uint32_t i = 0; i < TCP_MAX_CONNS; i++) {
+        if (conns[i].hashed && conns[i].local_port == port) return 1;
+    }
+    return 0;
+}
+
+// Connections are told apart by the whole 4-tuple, so only another
+// listener keeps a port from being listened on (e.g. a restarted server
+// whose old connections are still in TIME_WAIT)
+static int tcp_port_listening(uint16_t port) {
+    for (uint32_t i = 0; i < TCP_MAX_CONNS; i++) {
+        if (conns[i].hashed && conns[i].state == TCP_LISTEN && conns[i].local_port == port) return 1;
+    }
+    return 0;
+}
+
+tcp_conn_t* tcp_connect(uint32_t ip, uint16_t port) {
+    uint32_t flags = spin_lock_irqsave(&table_lock);
+    tcp_conn_t* c = tcp_conn_alloc();
+    uint16_t local_port = 0;
+    if (c) {
+        uint32_t range = TCP_EPHEMERAL_LAST - TCP_EPHEMERAL_FIRST + 1;
+        for (uint32_t i = 0; i < range && local_port == 0; i++) {
+            uint16_t candidate = next_ephemeral;
+            next_ephemeral = (candidate == TCP_EPHEMERAL_LAST) ? TCP_EPHEMERAL_FIRST : candidate + 1;
+            if (!tcp_port_in_use(candidate)) local_port = candidate;
+        }
+        if (local_port == 0) c->in_use = 0;
+    }
+    if (!c || local_port == 0) {
+        spin_unlock_irqrestore(&table_lock, flags);
+        return NULL;
+    }
+
+    c->state = TCP_SYN_SENT;
+    c->local_ip = ip_local_address();
+    c->local_port = local_port;
+    c->remote_ip = ip;
+    c->remote_port = port;
+    c->iss = tcp_new_iss(c);
+    c->snd_una = c->iss;
+    c->snd_nxt = c->iss + 1;
+    c->snd_max = c->snd_nxt;
+    c->snd_end = c->snd_nxt;
+    c->recover = c->iss;
+    tcp_hash_insert(c);
+    spin_unlock_irqrestore(&table_lock, flags);
+    stats.active_opens++;
+
+    flags = spin_lock_irqsave(&c->lock);
+    tcp_send_syn(c);
+    tcp_arm_rtx(c);
+    c->rtt_timing = 1;
+    c->rtt_tsc = rdtsc();
+    spin_unlock_irqrestore(&c->lock, flags);
+    net_flush();
+    return c;
+}
+
+tcp_conn_t* tcp_listen(uint16_t port, uint32_t backlog) {
+    uint32_t flags = spin_lock_irqsave(&table_lock);
+    tcp_conn_t* c = NULL;
+    if (port && !tcp_port_listening(port)) c = tcp_conn_alloc();
+    if (c) {
+        c->state = TCP_LISTEN;
+        c->local_ip = ip_local_address();
+        c->local_port = port;
+        c->backlog = backlog ? backlog : 1;
+        tcp_hash_insert(c);
+    }
+    spin_unlock_irqrestore(&table_lock, flags);
+    return c;
+}
+
+tcp_conn_t* tcp_accept(tcp_conn_t* l) {
+    uint32_t flags = spin_lock_irqsave(&l->lock);
+    tcp_conn_t* c = l->acceptq;
+    if (c) {
+        l->acceptq = c->accept_next;
+        c->accept_next = NULL;
+        l->accept_len--;
+    }
+    spin_unlock_irqrestore(&l->lock, flags);
+    return c;
+}
+
+int tcp_send(tcp_conn_t* c, const void* data, uint32_t len) {
+    const uint8_t* src = (const uint8_t*)data;
+    uint32_t done = 0;
+
+    uint32_t flags = spin_lock_irqsave(&c->lock);
+    if (c->reset || c->fin_queued ||
+        (c->state != TCP_ESTABLISHED && c->state != TCP_CLOSE_WAIT)) {
+        int ret = (c->state == TCP_SYN_SENT || c->state == TCP_SYN_RECEIVED) ? 0 : -1;
+        spin_unlock_irqrestore(&c->lock, flags);
+        return ret;
+    }
+
+    while (done < len && c->sndq_bytes < TCP_SNDBUF) {
+        // Top up the last segment while it has never been sent
+        pktbuf_t* seg = NULL;
+        if (c->sndq_tail != c->sndq_head) {
+            pktbuf_t* tail = SNDQ(c, c->sndq_tail - 1);
+            if (tcp_seq_geq(SEG_SEQ(tail), c->snd_max) && SEG_LEN(tail) < c->mss) seg = tail;
+        }
+        if (!seg) {
+            if (c->sndq_tail - c->sndq_head == TCP_SNDQ_SLOTS) break;
+            seg = pktbuf_alloc();
+            if (!seg) break;
+            SEG_SEQ(seg) = c->snd_end;
+            SEG_OFF(seg) = PKTBUF_HEADROOM;
+            SEG_EPOCH(seg) = 0;
+            SEG_LEN(seg) = 0;
+            SNDQ(c, c->sndq_tail) = seg;
+            c->sndq_tail++;
+        }
+
+        uint32_t n = min_u32(len - done, c->mss - SEG_LEN(seg));
+        n = min_u32(n, TCP_SNDBUF - c->sndq_bytes);
+        memcpy(seg->head + SEG_OFF(seg) + SEG_LEN(seg), src + done, n);
+        SEG_LEN(seg) += n;
+        c->snd_end += n;
+        c->sndq_bytes += n;
+        done += n;
+    }
+
+    tcp_output(c);
+    spin_unlock_irqrestore(&c->lock, flags);
+    net_flush();
+    return (int)done;
+}
+
+// Reader freed buffer space: advertise it once it is worth a segment
+static void tcp_window_update(tcp_conn_t* c) {
+    if (c->state != TCP_ESTABLISHED && c->state != TCP_FIN_WAIT_1 && c->state != TCP_FIN_WAIT_2) {
+        return;
+    }
+    uint32_t cur = tcp_rcv_wnd(c);
+    uint32_t space = tcp_rcv_space(c);
+    if (space > cur && space - cur >= min_u32(2 * c->mss, TCP_RCVBUF / 2)) tcp_send_ack(c);
+}
+
+int tcp_recv(tcp_conn_t* c, void* buf, uint32_t len) {
+    uint8_t* dst = (uint8_t*)buf;
+    uint32_t copied = 0;
+
+    uint32_t flags = spin_lock_irqsave(&c->lock);
+    while (copied < len && c->rcvq) {
+        pktbuf_t* pb = c->rcvq;
+        uint32_t n = min_u32(pb->len, len - copied);
+        memcpy(dst + copied, pb->data, n);
+        copied += n;
+        pktbuf_pull(pb, n);
+        c->rcvq_bytes -= n;
+        if (pb->len == 0) {
+            c->rcvq = pb->next;
+            if (!c->rcvq) c->rcvq_tail = NULL;
+            pb->next = NULL;
+            pktbuf_put(pb);
+        }
+    }
+
+    int ret = (int)copied;
+    if (copied) {
+        tcp_window_update(c);
+    } else if (c->fin_received || c->reset || c->state == TCP_CLOSED) {
+        ret = -1;
+    }
+    spin_unlock_irqrestore(&c->lock, flags);
+    if (copied) net_flush();
+    return ret;
+}
+
+pktbuf_t* tcp_recv_pb(tcp_conn_t* c) {
+    uint32_t flags = spin_lock_irqsave(&c->lock);
+    pktbuf_t* pb = c->rcvq;
+    if (pb) {
+        c->rcvq = pb->next;
+        if (!c->rcvq) c->rcvq_tail = NULL;
+        pb->next = NULL;
+        c->rcvq_bytes -= pb->len;
+        tcp_window_update(c);
+    }
+    spin_unlock_irqrestore(&c->lock, flags);
+    if (pb) net_flush();
+    return pb;
+}
+
+static void tcp_close_listener(tcp_conn_t* l) {
+    uint32_t flags = spin_lock_irqsave(&l->lock);
+    tcp_conn_t* pending = l->acceptq;
+    l->acceptq = NULL;
+    l->accept_len = 0;
+    l->event_fn = NULL;
+    tcp_set_closed(l);
+    spin_unlock_irqrestore(&l->lock, flags);
+
+    // Completed connections nobody accepted
+    while (pending) {
+        tcp_conn_t* next = pending->accept_next;
+        pending->accept_next = NULL;
+        tcp_abort(pending);
+        pending = next;
+    }
+    tcp_conn_put(l);
+}
+
+void tcp_set_cork(tcp_conn_t* c, int on) {
+    uint32_t flags = spin_lock_irqsave(&c->lock);
+    c->cork = on != 0;
+    if (!on) tcp_output(c);
+    spin_unlock_irqrestore(&c->lock, flags);
+    if (!on) net_flush();
+}
+
+void tcp_close(tcp_conn_t* c) {
+    if (c->state == TCP_LISTEN) {
+        tcp_close_listener(c);
+        return;
+    }
+
+    uint32_t flags = spin_lock_irqsave(&c->lock);
+    c->event_fn = NULL;
+    c->cork = 0;
+
+    // Unread data is lost: tell the peer with a reset (RFC 2525 2.17)
+    if (c->rcvq_bytes && (c->state == TCP_ESTABLISHED || c->state == TCP_CLOSE_WAIT)) {
+        spin_unlock_irqrestore(&c->lock, flags);
+        tcp_abort(c);
+        return;
+    }
+
+    switch (c->state) {
+    case TCP_SYN_SENT:
+        tcp_set_closed(c);
+        break;
+    case TCP_SYN_RECEIVED:
+    case TCP_ESTABLISHED:
+        c->fin_queued = 1;
+        c->state = TCP_FIN_WAIT_1;
+        tcp_output(c);
+        break;
+    case TCP_CLOSE_WAIT:
+        c->fin_queued = 1;
+        c->state = TCP_LAST_ACK;
+        tcp_output(c);
+        break;
+    default:
+        break;
+    }
+    spin_unlock_irqrestore(&c->lock, flags);
+    net_flush();
+    tcp_conn_put(c);
+}
+
+void tcp_abort(tcp_conn_t* c) {
+    if (c->state == TCP_LISTEN) {
+        tcp_close_listener(c);
+        return;
+    }
+
+    uint32_t flags = spin_lock_irqsave(&c->lock);
+    c->event_fn = NULL;
+    if (c->state != TCP_CLOSED && c->state != TCP_SYN_SENT && c->state != TCP_TIME_WAIT) {
+        tcp_send_ctl(c, c->snd_nxt, TCP_RST | TCP_ACK);
+        stats.resets_out++;
+    }
+    if (c->state != TCP_CLOSED) tcp_set_closed(c);
+    spin_unlock_irqrestore(&c->lock, flags);
+    net_flush();
+    tcp_conn_put(c);
+}
+
+uint32_t tcp_poll(tcp_conn_t* c) {
+    uint32_t flags = spin_lock_irqsave(&c->lock);
+    uint32_t events = 0;
+    if (c->rcvq || c->fin_received || c->reset) events |= TCP_EV_READABLE;
+    if ((c->state == TCP_ESTABLISHED || c->state == TCP_CLOSE_WAIT) && !c->fin_queued &&
+        c->sndq_bytes < TCP_SNDBUF && c->sndq_tail - c->sndq_head < TCP_SNDQ_SLOTS) {
+        events |= TCP_EV_WRITABLE;
+    }
+    if (c->state >= TCP_ESTABLISHED) events |= TCP_EV_CONNECTED;
+    if (c->acceptq) events |= TCP_EV_ACCEPT;
+    if (c->state == TCP_CLOSED || c->reset) events |= TCP_EV_CLOSED;
+    spin_unlock_irqrestore(&c->lock, flags);
+    return events;
+}
+
+void tcp_set_callback(tcp_conn_t* c, void (*fn)(tcp_conn_t*, uint32_t, void*), void* arg) {
+    uint32_t flags = spin_lock_irqsave(&c->lock);
+    c->event_fn = fn;
+    c->event_arg = arg;
+    spin_unlock_irqrestore(&c->lock, flags);
+}
+
+static const tcp_cong_ops_t* tcp_find_cong(const char* name) {
+    for (uint32_t i = 0; i < sizeof(cong_algos) / sizeof(cong_algos[0]); i++) {
+        if (strcmp(cong_algos[i]->name, name) == 0) return cong_algos[i];
+    }
+    return NULL;
+}
+
+int tcp_set_cong(tcp_conn_t* c, const char* name) {
+    const tcp_cong_ops_t* ops = tcp_find_cong(name);
+    if (!ops) return -1;
+    uint32_t flags = spin_lock_irqsave(&c->lock);
+    c->cong = ops;
+    if (c->state >= TCP_ESTABLISHED) {
+        ops->init(c);
+        c->cwnd_cnt = 0;
+    }
+    spin_unlock_irqrestore(&c->lock, flags);
+    return 0;
+}
+
+int tcp_set_default_cong(const char* name) {
+    const tcp_cong_ops_t* ops = tcp_find_cong(name);
+    if (!ops) return -1;
+    default_cong = ops;
+    return 0;
+}
+
+const char* tcp_default_cong(void) {
+    return default_cong->name;
+}
+
+void tcp_get_info(tcp_conn_t* c, tcp_info_t* info) {
+    uint32_t flags = spin_lock_irqsave(&c->lock);
+    info->state = c->state;
+    info->local_ip = c->local_ip;
+    info->remote_ip = c->remote_ip;
+    info->local_port = c->local_port;
+    info->remote_port = c->remote_port;
+    info->mss = c->mss;
+    info->cwnd = c->cwnd;
+    info->ssthresh = c->ssthresh;
+    info->srtt_us = c->srtt_us;
+    info->rttvar_us = c->rttvar_us;
+    info->rto_ms = c->rto_ms;
+    info->snd_wnd = c->snd_wnd;
+    info->rcv_wnd = tcp_rcv_wnd(c);
+    info->in_flight = c->snd_nxt - c->snd_una;
+    info->snd_queued = c->sndq_bytes;
+    info->snd_wscale = c->snd_wscale;
+    info->rcv_wscale = c->rcv_wscale;
+    info->sack_ok = c->sack_ok;
+    info->cong = c->cong->name;
+    info->stats = c->stats;
+    spin_unlock_irqrestore(&c->lock, flags);
+}
+
+uint32_t tcp_get_conns(tcp_info_t* out, uint32_t max) {
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < TCP_MAX_CONNS && n < max; i++) {
+        tcp_conn_t* c = &conns[i];
+        uint32_t flags = spin_lock_irqsave(&table_lock);
+        int live = c->in_use && c->refcnt > 0;
+        if (live) c->refcnt++;
+        spin_unlock_irqrestore(&table_lock, flags);
+        if (!live) continue;
+
+        tcp_get_info(c, &out[n++]);
+        tcp_conn_put(c);
+    }
+    return n;
+}
+
+void tcp_get_stats(tcp_stats_t* out) {
+    *out = stats;
+}
+
+const char* tcp_state_name(tcp_state_t state) {
+    static const char* const names[] = {
+        "CLOSED", "LISTEN", "SYN_SENT", "SYN_RECV", "ESTABLISHED", "FIN_WAIT1",
+        "FIN_WAIT2", "CLOSE_WAIT", "CLOSING", "LAST_ACK", "TIME_WAIT"
+    };
+    return (uint32_t)state < sizeof(names) / sizeof(names[0]) ? names[state] : "?";
+}
+
+void tcp_init(void) {
+    serial_write("TCP: Initializing...\n");
+    spin_lock_init(&table_lock, "tcp");
+    for (uint32_t i = 0; i < TCP_MAX_CONNS; i++) spin_lock_init(&conns[i].lock, "tcp_conn");
+    iss_secret = (uint32_t)rdtsc() * 0x9E3779B9;
+
+    pktbuf_grow(TCP_PKTBUF_EXTRA);
+    ip_register_protocol(IP_PROTO_TCP, tcp_rx);
+    serial_write("TCP: Initialized successfully\n");
+}
@@ -0,0 +1,198 @@
+#include "tcp.h"
+#include "timer.h"
+#include "div64.h"
+
+// Congestion control algorithms. The core calls ssthresh() when it
+// detects a loss and sets cwnd to the result for the recovery; the
+// algorithms own cwnd growth outside recovery and after it.
+
+static uint32_t flight_size(tcp_conn_t* c) {
+    return c->snd_max - c->snd_una;
+}
+
+// Slow start with Appropriate Byte Counting, L = 2 (RFC 3465)
+static void slow_start(tcp_conn_t* c, uint32_t acked) {
+    uint32_t limit = 2u * c->mss;
+    c->cwnd += acked < limit ? acked : limit;
+}
+
+// ---------------------------------------------------------------------------
+// NewReno (RFC 5681, RFC 6582)
+// ---------------------------------------------------------------------------
+
+static void reno_init(tcp_conn_t* c) {
+    c->cwnd_cnt = 0;
+}
+
+static void reno_on_ack(tcp_conn_t* c, uint32_t acked, uint32_t rtt_us) {
+    (void)rtt_us;
+    if (c->cwnd < c->ssthresh) {
+        slow_start(c, acked);
+        return;
+    }
+    // Congestion avoidance: one segment per window of acknowledged bytes
+    c->cwnd_cnt += acked;
+    if (c->cwnd_cnt >= c->cwnd) {
+        c->cwnd_cnt -= c->cwnd;
+        c->cwnd += c->mss;
+    }
+}
+
+static uint32_t reno_ssthresh(tcp_conn_t* c) {
+    uint32_t half = flight_size(c) / 2;
+    return half > 2u * c->mss ? half : 2u * c->mss;
+}
+
+static void reno_on_recovered(tcp_conn_t* c) {
+    c->cwnd = c->ssthresh;
+    c->cwnd_cnt = 0;
+}
+
+static void reno_on_timeout(tcp_conn_t* c) {
+    c->cwnd = c->mss;
+    c->cwnd_cnt = 0;
+}
+
+const tcp_cong_ops_t tcp_newreno = {
+    .name = "newreno",
+    .init = reno_init,
+    .on_ack = reno_on_ack,
+    .ssthresh = reno_ssthresh,
+    .on_recovered = reno_on_recovered,
+    .on_timeout = reno_on_timeout,
+};
+
+// ---------------------------------------------------------------------------
+// CUBIC (RFC 8312) in fixed point: windows in bytes, time in ms.
+// W(t) = C * (t - K)^3 + W_max, C = 0.4 segments/s^3, beta = 0.7.
+// ---------------------------------------------------------------------------
+
+#define CUBIC_BETA          717          // 0.7 * 1024
+#define CUBIC_FRIENDLY      542          // 3 * (1 - beta) / (1 + beta) * 1024
+#define CUBIC_MAX_DELTA_MS  (1u << 17)   // Keeps (t - K)^3 inside 64 bits with room
+
+// Lives in tcp_conn_t.cong_priv
+typedef struct {
+    uint32_t w_max;              // Window before the last reduction
+    uint32_t origin;             // Plateau of the current curve
+    uint32_t k_ms;               // Time to reach the plateau
+    uint32_t epoch_start;        // ms; 0 until the first ACK after a reduction
+    uint32_t w_est;              // Reno-equivalent window (TCP-friendly region)
+    uint32_t est_cnt;            // Bytes acked toward the next w_est step
+} cubic_t;
+
+static inline cubic_t* cubic(tcp_conn_t* c) {
+    return (cubic_t*)c->cong_priv;
+}
+
+// Integer cube root by bisection
+static uint32_t cbrt64(uint64_t n) {
+    uint32_t lo = 0, hi = 1u << 21;
+    while (lo + 1 < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if ((uint64_t)mid * mid * mid <= n) lo = mid;
+        else hi = mid;
+    }
+    return lo;
+}
+
+static void cubic_init(tcp_conn_t* c) {
+    cubic_t* ca = cubic(c);
+    ca->w_max = 0;
+    ca->origin = 0;
+    ca->k_ms = 0;
+    ca->epoch_start = 0;
+    ca->w_est = 0;
+    ca->est_cnt = 0;
+    c->cwnd_cnt = 0;
+}
+
+static void cubic_on_ack(tcp_conn_t* c, uint32_t acked, uint32_t rtt_us) {
+    (void)rtt_us;
+    cubic_t* ca = cubic(c);
+    if (c->cwnd < c->ssthresh) {
+        slow_start(c, acked);
+        return;
+    }
+
+    uint32_t now = timer_get_ticks() * TCP_TICK_MS;
+    if (ca->epoch_start == 0) {
+        ca->epoch_start = now ? now : 1;
+        ca->w_est = c->cwnd;
+        ca->est_cnt = 0;
+        if (c->cwnd < ca->w_max) {
+            // K = cbrt((W_max - cwnd) / C), in ms: segments / 0.4 * 10^9
+            uint64_t k3 = div_u64((uint64_t)(ca->w_max - c->cwnd) * 2500000000ULL, c->mss);
+            ca->k_ms = cbrt64(k3);
+            ca->origin = ca->w_max;
+        } else {
+            ca->k_ms = 0;
+            ca->origin = c->cwnd;
+        }
+    }
+
+    // Window the curve wants one RTT from now
+    uint32_t t = now - ca->epoch_start + c->srtt_us / 1000;
+    uint32_t d = t >= ca->k_ms ? t - ca->k_ms : ca->k_ms - t;
+    if (d > CUBIC_MAX_DELTA_MS) d = CUBIC_MAX_DELTA_MS;
+    uint64_t cube = (uint64_t)d * d * d;
+    uint32_t delta = (uint32_t)div_u64(div_u64(cube, 1000000) * 4 * c->mss, 10000);
+    uint32_t target;
+    if (t >= ca->k_ms) target = ca->origin + delta;
+    else target = delta < ca->origin ? ca->origin - delta : 0;
+
+    // Never slower than Reno would be (RFC 8312 section 4.2)
+    uint32_t per_step = (uint32_t)div_u64((uint64_t)c->cwnd * 1024, CUBIC_FRIENDLY);
+    ca->est_cnt += acked;
+    while (per_step && ca->est_cnt >= per_step) {
+        ca->est_cnt -= per_step;
+        ca->w_est += c->mss;
+    }
+    if (ca->w_est > target) target = ca->w_est;
+
+    // Spread the growth over the next window, at most 1.5x per RTT
+    if (target > c->cwnd + c->cwnd / 2) target = c->cwnd + c->cwnd / 2;
+    uint32_t cnt;
+    if (target > c->cwnd) {
+        cnt = (uint32_t)div_u64((uint64_t)c->cwnd * c->mss, target - c->cwnd);
+        if (cnt == 0) cnt = 1;
+    } else {
+        cnt = c->cwnd < 0x1000000 ? 100 * c->cwnd : 0xFFFFFFFF;    // Plateau: crawl
+    }
+    c->cwnd_cnt += acked;
+    while (c->cwnd_cnt >= cnt) {
+        c->cwnd_cnt -= cnt;
+        c->cwnd += c->mss;
+    }
+}
+
+static uint32_t cubic_ssthresh(tcp_conn_t* c) {
+    cubic_t* ca = cubic(c);
+    ca->epoch_start = 0;
+    // Fast convergence: yield to newer flows when still below the old peak
+    if (c->cwnd < ca->w_max) ca->w_max = (uint32_t)(((uint64_t)c->cwnd * (1024 + CUBIC_BETA)) >> 11);
+    else ca->w_max = c->cwnd;
+
+    uint32_t s = (uint32_t)(((uint64_t)c->cwnd * CUBIC_BETA) >> 10);
+    return s > 2u * c->mss ? s : 2u * c->mss;
+}
+
+static void cubic_on_recovered(tcp_conn_t* c) {
+    c->cwnd = c->ssthresh;
+    c->cwnd_cnt = 0;
+}
+
+static void cubic_on_timeout(tcp_conn_t* c) {
+    cubic(c)->epoch_start = 0;
+    c->cwnd = c->mss;
+    c->cwnd_cnt = 0;
+}
+
+const tcp_cong_ops_t tcp_cubic = {
+    .name = "cubic",
+    .init = cubic_init,
+    .on_ack = cubic_on_ack,
+    .ssthresh = cubic_ssthresh,
+    .on_recovered = cubic_on_recovered,
+    .on_timeout = cubic_on_timeout,
+};
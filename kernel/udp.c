@@ -0,0 +1,215 @@
+#include "udp.h"
+#include "ip.h"
+#include "icmp.h"
+#include "net.h"
+#include "checksum.h"
+#include "heap.h"
+#include "lock.h"
+#include "rcu.h"
+#include "string.h"
+#include "serial.h"
+#include <stddef.h>
+
+// Bound sockets by local port. The receive path walks the chains under
+// RCU; binding and closing serialize on udp_lock.
+static udp_socket_t* udp_hash[UDP_HASH_SIZE];
+static ticket_lock_t udp_lock;
+static uint16_t next_ephemeral = UDP_EPHEMERAL_FIRST;
+static udp_stats_t stats;
+
+static inline uint32_t udp_hash_port(uint16_t port) {
+    return (port ^ (port >> 6)) & (UDP_HASH_SIZE - 1);
+}
+
+// Caller is inside an RCU read-side section or holds udp_lock
+static udp_socket_t* udp_lookup(uint16_t port) {
+    udp_socket_t* sock = rcu_dereference(udp_hash[udp_hash_port(port)]);
+    while (sock && sock->local_port != port) sock = rcu_dereference(sock->hash_next);
+    return sock;
+}
+
+// Producer side of the receive ring (NET_RX softirq, any CPU)
+static int udp_enqueue(udp_socket_t* sock, pktbuf_t* pb) {
+    uint32_t head = __atomic_load_n(&sock->head, __ATOMIC_RELAXED);
+    do {
+        if (head - __atomic_load_n(&sock->tail, __ATOMIC_ACQUIRE) >= UDP_RX_RING_SIZE) return -1;
+    } while (!__atomic_compare_exchange_n(&sock->head, &head, head + 1, 0,
+                                          __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+    __atomic_store_n(&sock->ring[head & (UDP_RX_RING_SIZE - 1)], pb, __ATOMIC_RELEASE);
+    return 0;
+}
+
+// Consumer side: a reserved slot stays empty until its producer has
+// published, so a null pointer simply means nothing to take yet
+static pktbuf_t* udp_dequeue(udp_socket_t* sock) {
+    uint32_t tail = sock->tail;
+    pktbuf_t* volatile* slot = &sock->ring[tail & (UDP_RX_RING_SIZE - 1)];
+    pktbuf_t* pb = __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+    if (!pb) return NULL;
+    *slot = NULL;
+    __atomic_store_n(&sock->tail, tail + 1, __ATOMIC_RELEASE);
+    return pb;
+}
+
+static void udp_rx(pktbuf_t* pb, ip_header_t* ip) {
+    stats.in_datagrams++;
+
+    udp_header_t* udp = (udp_header_t*)pb->data;
+    uint32_t len = pb->len >= UDP_HLEN ? ntohs(udp->length) : 0;
+    if (len < UDP_HLEN || len > pb->len) {
+        stats.in_errors++;
+        return;
+    }
+
+    // A zero checksum means the sender did not compute one
+    if (udp->checksum != 0) {
+        uint32_t seed = csum_tcpudp_nofold(ip->src_ip, ip->dest_ip, len, IP_PROTO_UDP, 0);
+        if (!net_rx_csum_ok(pb, NET_CSUM_L4, udp, len, seed)) {
+            stats.in_csum_errors++;
+            return;
+        }
+    }
+
+    uint32_t src_ip = ntohl(ip->src_ip);
+    uint16_t src_port = ntohs(udp->src_port);
+
+    rcu_read_lock();
+    udp_socket_t* sock = udp_lookup(ntohs(udp->dest_port));
+    if (!sock) {
+        rcu_read_unlock();
+        stats.no_ports++;
+        icmp_send_error(pb, ip, ICMP_DEST_UNREACH, ICMP_PORT_UNREACH);
+        return;
+    }
+    if (sock->remote_port && (sock->remote_ip != src_ip || sock->remote_port != src_port)) {
+        rcu_read_unlock();
+        return;
+    }
+
+    // Queue the receive buffer itself, trimmed to the payload; the
+    // sender's address rides along in the control block
+    pb->len = len;
+    pktbuf_pull(pb, UDP_HLEN);
+    pb->cb[0] = src_ip;
+    pb->cb[1] = src_port;
+    pktbuf_get(pb);
+    if (udp_enqueue(sock, pb) < 0) {
+        sock->stats.rx_ring_full++;
+        pktbuf_put(pb);
+    } else {
+        sock->stats.rx_datagrams++;
+        sock->stats.rx_bytes += pb->len;
+    }
+    rcu_read_unlock();
+}
+
+udp_socket_t* udp_open(uint16_t port) {
+    udp_socket_t* sock = (udp_socket_t*)kmalloc(sizeof(udp_socket_t));
+    if (!sock) return NULL;
+    memset(sock, 0, sizeof(*sock));
+
+    ticket_lock(&udp_lock);
+    if (port == 0) {
+        // Next free ephemeral port, wrapping around the range once
+        uint32_t range = UDP_EPHEMERAL_LAST - UDP_EPHEMERAL_FIRST + 1;
+        for (uint32_t i = 0; i < range && port == 0; i++) {
+            uint16_t candidate = next_ephemeral;
+            next_ephemeral = (candidate == UDP_EPHEMERAL_LAST) ? UDP_EPHEMERAL_FIRST : candidate + 1;
+            if (!udp_lookup(candidate)) port = candidate;
+        }
+    } else if (udp_lookup(port)) {
+        port = 0;
+    }
+    if (port == 0) {
+        ticket_unlock(&udp_lock);
+        kfree(sock);
+        return NULL;
+    }
+
+    sock->local_port = port;
+    uint32_t bucket = udp_hash_port(port);
+    sock->hash_next = udp_hash[bucket];
+    rcu_assign_pointer(udp_hash[bucket], sock);
+    ticket_unlock(&udp_lock);
+    return sock;
+}
+
+void udp_close(udp_socket_t* sock) {
+    ticket_lock(&udp_lock);
+    udp_socket_t** link = &udp_hash[udp_hash_port(sock->local_port)];
+    while (*link && *link != sock) link = &(*link)->hash_next;
+    if (*link) rcu_assign_pointer(*link, sock->hash_next);
+    ticket_unlock(&udp_lock);
+
+    // Receive paths that found the socket have finished enqueueing
+    synchronize_rcu();
+
+    pktbuf_t* pb;
+    while ((pb = udp_dequeue(sock)) != NULL) pktbuf_put(pb);
+    kfree(sock);
+}
+
+void udp_connect(udp_socket_t* sock, uint32_t ip, uint16_t port) {
+    sock->remote_ip = ip;
+    sock->remote_port = port;
+}
+
+int udp_sendto(udp_socket_t* sock, pktbuf_t* pb, uint32_t dest_ip, uint16_t dest_port) {
+    uint32_t len = pb->len + UDP_HLEN;
+    udp_header_t* udp = (udp_header_t*)pktbuf_push(pb, UDP_HLEN);
+    if (!udp || len > 0xFFFF) {
+        sock->stats.tx_errors++;
+        pktbuf_put(pb);
+        return -1;
+    }
+    udp->src_port = htons(sock->local_port);
+    udp->dest_port = htons(dest_port);
+    udp->length = htons(len);
+
+    // Seed with the pseudo-header sum; the NIC or net_tx_csum() finishes
+    uint32_t pseudo = csum_tcpudp_nofold(htonl(ip_local_address()), htonl(dest_ip),
+                                         len, IP_PROTO_UDP, 0);
+    udp->checksum = (uint16_t)~csum_fold(pseudo);
+    net_tx_csum(pb, (uint8_t*)udp, offsetof(udp_header_t, checksum));
+    if (!(pb->csum_flags & PKTBUF_CSUM_PARTIAL) && udp->checksum == 0) {
+        udp->checksum = 0xFFFF;    // Zero would mean "no checksum"
+    }
+
+    if (ip_output(pb, dest_ip, IP_PROTO_UDP) < 0) {
+        sock->stats.tx_errors++;
+        return -1;
+    }
+    sock->stats.tx_datagrams++;
+    sock->stats.tx_bytes += len - UDP_HLEN;
+    stats.out_datagrams++;
+    return 0;
+}
+
+int udp_send(udp_socket_t* sock, const void* data, uint32_t len) {
+    if (len > UDP_MAX_PAYLOAD || !sock->remote_port) return -1;
+
+    pktbuf_t* pb = pktbuf_alloc();
+    if (!pb) return -1;
+    memcpy(pktbuf_append(pb, len), data, len);
+    return udp_sendto(sock, pb, sock->remote_ip, sock->remote_port);
+}
+
+pktbuf_t* udp_recvfrom(udp_socket_t* sock, uint32_t* src_ip, uint16_t* src_port) {
+    pktbuf_t* pb = udp_dequeue(sock);
+    if (pb) {
+        if (src_ip) *src_ip = pb->cb[0];
+        if (src_port) *src_port = (uint16_t)pb->cb[1];
+    }
+    return pb;
+}
+
+void udp_get_stats(udp_stats_t* out) {
+    *out = stats;
+}
+
+void udp_init(void) {
+    serial_write("UDP: Initializing...\n");
+    ticket_lock_init(&udp_lock, "udp");
+    ip_register_protocol(IP_PROTO_UDP, udp_rx);
+    serial_write("UDP: Initialized successfully\n");
+}
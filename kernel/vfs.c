@@ -1,10 +1,44 @@
 #include "vfs.h"
 #include "heap.h"
 #include "serial.h"
+#include "lock.h"
+#include "rcu.h"
 #include <stddef.h>
 
 static file_t files[MAX_FILES];
 
+// Serializes updates; ticket order keeps shell and workers fair
+static ticket_lock_t vfs_lock;
+
+// Name lookup hash. Readers walk it under RCU without taking vfs_lock.
+static file_t* vfs_hash[VFS_HASH_SIZE];
+
+// File contents live in a reference-counted buffer, so a vfs_map()
+// snapshot survives the file being rewritten or deleted under it
+typedef struct {
+    uint32_t refs;              // The file's own + one per mapping
+    uint32_t reserved;
+    char data[];
+} vfs_buf_t;
+
+static inline vfs_buf_t* vfs_buf(const char* data) {
+    return (vfs_buf_t*)(data - offsetof(vfs_buf_t, data));
+}
+
+static char* vfs_buf_alloc(uint32_t capacity) {
+    vfs_buf_t* buf = (vfs_buf_t*)kmalloc(sizeof(vfs_buf_t) + capacity);
+    if (!buf) return NULL;
+    buf->refs = 1;
+    return buf->data;
+}
+
+// Caller holds vfs_lock
+static void vfs_buf_put(const char* data) {
+    if (data && --vfs_buf(data)->refs == 0) {
+        kfree(vfs_buf(data));
+    }
+}
+
 // String functions
 static int str_len(const char* str) {
     int len = 0;
@@ -30,13 +64,42 @@ static int str_cmp(const char* s1, const char* s2) {
     return s1[i] - s2[i];
 }
 
+// FNV-1a over the file name
+static uint32_t vfs_hash_name(const char* name) {
+    uint32_t hash = 2166136261u;
+    while (*name) {
+        hash ^= (uint8_t)*name++;
+        hash *= 16777619u;
+    }
+    return hash & (VFS_HASH_SIZE - 1);
+}
+
+// Caller is inside an RCU read-side section or holds vfs_lock
+static file_t* vfs_lookup(const char* name) {
+    file_t* file = rcu_dereference(vfs_hash[vfs_hash_name(name)]);
+    while (file) {
+        if (str_cmp(file->name, name) == 0) {
+            return file;
+        }
+        file = rcu_dereference(file->hash_next);
+    }
+    return NULL;
+}
+
 void vfs_init(void) {
     serial_write("VFS: Initializing...\n");
     
+    ticket_lock_init(&vfs_lock, "vfs");
+    
     for (int i = 0; i < MAX_FILES; i++) {
         files[i].in_use = false;
         files[i].data = NULL;
         files[i].size = 0;
+        files[i].capacity = 0;
+        files[i].hash_next = NULL;
+    }
+    for (int i = 0; i < VFS_HASH_SIZE; i++) {
+        vfs_hash[i] = NULL;
     }
     
     // Create some default files
@@ -56,11 +119,13 @@ void vfs_init(void) {
 }
 
 file_t* vfs_create(const char* name, file_type_t type) {
+    file_t* file = NULL;
+    ticket_lock(&vfs_lock);
+    
     // Check if file already exists
-    for (int i = 0; i < MAX_FILES; i++) {
-        if (files[i].in_use && str_cmp(files[i].name, name) == 0) {
-            return NULL; // File already exists
-        }
+    if (vfs_lookup(name)) {
+        ticket_unlock(&vfs_lock);
+        return NULL; // File already exists
     }
     
     // Find free slot
@@ -70,33 +135,44 @@ file_t* vfs_create(const char* name, file_type_t type) {
             str_copy(files[i].name, name, MAX_FILENAME);
             files[i].type = type;
             files[i].size = 0;
+            files[i].capacity = 0;
             files[i].data = NULL;
-            return &files[i];
+            file = &files[i];
+            
+            // Publish only once the entry is fully initialized
+            uint32_t bucket = vfs_hash_name(file->name);
+            file->hash_next = vfs_hash[bucket];
+            rcu_assign_pointer(vfs_hash[bucket], file);
+            break;
         }
     }
     
-    return NULL; // No free slots
+    ticket_unlock(&vfs_lock);
+    return file; // NULL if no free slots
 }
 
 file_t* vfs_open(const char* name) {
-    for (int i = 0; i < MAX_FILES; i++) {
-        if (files[i].in_use && str_cmp(files[i].name, name) == 0) {
-            return &files[i];
-        }
-    }
-    return NULL;
+    rcu_read_lock();
+    file_t* file = vfs_lookup(name);
+    rcu_read_unlock();
+    return file;
 }
 
 int vfs_write(file_t* file, const char* data, uint32_t size) {
     if (!file || size > MAX_FILE_SIZE) return -1;
     
+    ticket_lock(&vfs_lock);
+    
     // Allocate or reallocate data
-    if (file->data) {
-        kfree(file->data);
-    }
+    vfs_buf_put(file->data);
     
-    file->data = (char*)kmalloc(size + 1);
-    if (!file->data) return -1;
+    file->data = vfs_buf_alloc(size + 1);
+    if (!file->data) {
+        file->size = 0;
+        file->capacity = 0;
+        ticket_unlock(&vfs_lock);
+        return -1;
+    }
     
     // Copy data
     for (uint32_t i = 0; i < size; i++) {
@@ -104,12 +180,64 @@ int vfs_write(file_t* file, const char* data, uint32_t size) {
     }
     file->data[size] = '\0';
     file->size = size;
+    file->capacity = size + 1;
+    
+    ticket_unlock(&vfs_lock);
+    return size;
+}
+
+int vfs_append(file_t* file, const char* data, uint32_t size) {
+    if (!file) return -1;
+    
+    ticket_lock(&vfs_lock);
+    
+    uint32_t need = file->size + size + 1;
+    if (need < file->size) {
+        ticket_unlock(&vfs_lock);
+        return -1;
+    }
+    
+    if (need > file->capacity) {
+        // Double so a file written in small pieces is copied O(log n)
+        // times; near the heap limit settle for exactly what is needed
+        uint32_t capacity = file->capacity * 2;
+        if (capacity < need) capacity = need;
+        if (capacity < 256) capacity = 256;
+        char* grown = vfs_buf_alloc(capacity);
+        if (!grown && capacity > need) {
+            capacity = need;
+            grown = vfs_buf_alloc(capacity);
+        }
+        if (!grown) {
+            ticket_unlock(&vfs_lock);
+            return -1;
+        }
+        for (uint32_t i = 0; i < file->size; i++) {
+            grown[i] = file->data[i];
+        }
+        vfs_buf_put(file->data);
+        file->data = grown;
+        file->capacity = capacity;
+    }
+    
+    for (uint32_t i = 0; i < size; i++) {
+        file->data[file->size + i] = data[i];
+    }
+    file->size += size;
+    file->data[file->size] = '\0';
     
+    ticket_unlock(&vfs_lock);
     return size;
 }
 
 int vfs_read(file_t* file, char* buffer, uint32_t size) {
-    if (!file || !file->data) return -1;
+    if (!file) return -1;
+    
+    ticket_lock(&vfs_lock);
+    if (!file->data) {
+        ticket_unlock(&vfs_lock);
+        return -1;
+    }
     
     uint32_t read_size = (size < file->size) ? size : file->size;
     
@@ -118,25 +246,64 @@ int vfs_read(file_t* file, char* buffer, uint32_t size) {
     }
     buffer[read_size] = '\0';
     
+    ticket_unlock(&vfs_lock);
     return read_size;
 }
 
+int vfs_map(file_t* file, const char** data, uint32_t* size) {
+    if (!file) return -1;
+    
+    ticket_lock(&vfs_lock);
+    if (!file->in_use) {
+        ticket_unlock(&vfs_lock);
+        return -1;
+    }
+    *data = file->data;
+    *size = file->data ? file->size : 0;
+    if (file->data) {
+        vfs_buf(file->data)->refs++;
+    }
+    ticket_unlock(&vfs_lock);
+    return 0;
+}
+
+void vfs_unmap(const char* data) {
+    if (!data) return;
+    ticket_lock(&vfs_lock);
+    vfs_buf_put(data);
+    ticket_unlock(&vfs_lock);
+}
+
 int vfs_delete(const char* name) {
-    for (int i = 0; i < MAX_FILES; i++) {
-        if (files[i].in_use && str_cmp(files[i].name, name) == 0) {
-            if (files[i].data) {
-                kfree(files[i].data);
-            }
-            files[i].in_use = false;
-            files[i].data = NULL;
-            files[i].size = 0;
-            return 0;
+    int result = -1;
+    ticket_lock(&vfs_lock);
+    
+    file_t** link = &vfs_hash[vfs_hash_name(name)];
+    while (*link) {
+        file_t* file = *link;
+        if (str_cmp(file->name, name) == 0) {
+            // Unlink, then wait out readers before the slot can be reused
+            rcu_assign_pointer(*link, file->hash_next);
+            synchronize_rcu();
+            
+            vfs_buf_put(file->data);
+            file->in_use = false;
+            file->data = NULL;
+            file->size = 0;
+            file->capacity = 0;
+            file->hash_next = NULL;
+            result = 0;
+            break;
         }
+        link = &file->hash_next;
     }
-    return -1;
+    
+    ticket_unlock(&vfs_lock);
+    return result;
 }
 
 void vfs_list(void) {
+    ticket_lock(&vfs_lock);
     for (int i = 0; i < MAX_FILES; i++) {
         if (files[i].in_use) {
             serial_write("  ");
@@ -147,23 +314,32 @@ void vfs_list(void) {
             serial_write("\n");
         }
     }
+    ticket_unlock(&vfs_lock);
 }
 
 int vfs_get_file_count(void) {
     int count = 0;
+    ticket_lock(&vfs_lock);
     for (int i = 0; i < MAX_FILES; i++) {
         if (files[i].in_use) count++;
     }
+    ticket_unlock(&vfs_lock);
     return count;
 }
 
 file_t* vfs_get_file(int index) {
+    file_t* file = NULL;
     int count = 0;
+    ticket_lock(&vfs_lock);
     for (int i = 0; i < MAX_FILES; i++) {
         if (files[i].in_use) {
-            if (count == index) return &files[i];
+            if (count == index) {
+                file = &files[i];
+                break;
+            }
             count++;
         }
     }
-    return NULL;
+    ticket_unlock(&vfs_lock);
+    return file;
 }
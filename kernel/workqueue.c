@@ -0,0 +1,114 @@
+#include "workqueue.h"
+#include "smp.h"
+#include "serial.h"
+#include <stddef.h>
+
+workqueue_t system_wq;
+workqueue_t console_wq;
+
+void workqueue_create(workqueue_t* wq, const char* name, int32_t cpu, int ordered) {
+    wq->name = name;
+    wq->cpu = cpu;
+    wq->ordered = ordered;
+    wq->group.pending = 0;
+    wq->next_cpu = 0;
+    wq->executed = 0;
+
+    spin_lock_init(&wq->lock, name);
+    wq->head = NULL;
+    wq->tail = NULL;
+    wq->scheduled = 0;
+}
+
+void workqueue_init(void) {
+    serial_write("Workqueue: Initializing...\n");
+    workqueue_create(&system_wq, "system_wq", -1, 0);
+    workqueue_create(&console_wq, "console_wq", 0, 1);
+    serial_write("Workqueue: Initialized successfully\n");
+}
+
+// Pick the CPU a work task is handed to. Round-robin skips the boot
+// CPU when others exist, since it only runs tasks while the shell idles.
+static uint32_t workqueue_pick_cpu(workqueue_t* wq) {
+    uint32_t ncpus = smp_num_cpus();
+    if (wq->cpu >= 0 && (uint32_t)wq->cpu < ncpus) {
+        return (uint32_t)wq->cpu;
+    }
+    if (ncpus <= 1) return 0;
+
+    uint32_t n = __atomic_fetch_add(&wq->next_cpu, 1, __ATOMIC_RELAXED);
+    return 1 + n % (ncpus - 1);
+}
+
+// Task body of a concurrent work item
+static void work_run(void* arg) {
+    work_t* work = (work_t*)arg;
+    workqueue_t* wq = work->wq;
+
+    // Clear pending first so the item may requeue itself
+    __atomic_store_n(&work->pending, 0, __ATOMIC_RELEASE);
+    work->fn(work->arg);
+    __atomic_add_fetch(&wq->executed, 1, __ATOMIC_RELAXED);
+}
+
+// Runner task of an ordered workqueue: drain the FIFO one item at a time
+static void workqueue_runner(void* arg) {
+    workqueue_t* wq = (workqueue_t*)arg;
+
+    while (1) {
+        uint32_t flags = spin_lock_irqsave(&wq->lock);
+        work_t* work = wq->head;
+        if (!work) {
+            wq->scheduled = 0;
+            spin_unlock_irqrestore(&wq->lock, flags);
+            return;
+        }
+        wq->head = work->next;
+        if (!wq->head) wq->tail = NULL;
+        spin_unlock_irqrestore(&wq->lock, flags);
+
+        __atomic_store_n(&work->pending, 0, __ATOMIC_RELEASE);
+        work->fn(work->arg);
+        __atomic_add_fetch(&wq->executed, 1, __ATOMIC_RELAXED);
+    }
+}
+
+int queue_work(workqueue_t* wq, work_t* work) {
+    if (__atomic_exchange_n(&work->pending, 1, __ATOMIC_ACQ_REL)) {
+        return 0;
+    }
+
+    work->wq = wq;
+
+    if (!wq->ordered) {
+        task_init(&work->task, work_run, work);
+        work->task.group = &wq->group;
+        sched_submit(workqueue_pick_cpu(wq), &work->task);
+        return 1;
+    }
+
+    uint32_t flags = spin_lock_irqsave(&wq->lock);
+    work->next = NULL;
+    if (wq->tail) {
+        wq->tail->next = work;
+    } else {
+        wq->head = work;
+    }
+    wq->tail = work;
+
+    int start_runner = !wq->scheduled;
+    wq->scheduled = 1;
+    spin_unlock_irqrestore(&wq->lock, flags);
+
+    if (start_runner) {
+        task_init(&wq->runner, workqueue_runner, wq);
+        wq->runner.group = &wq->group;
+        sched_submit(workqueue_pick_cpu(wq), &wq->runner);
+    }
+    return 1;
+}
+
+void flush_workqueue(workqueue_t* wq) {
+    // Runs other tasks (including ours) while waiting
+    sched_wait(&wq->group);
+}
@@ -0,0 +1,60 @@
+#!/usr/bin/env python3
+"""HTTP/1.1 file server for the kernel's wget command.
+
+Serves a directory with persistent connections, so several URLs on one
+wget command line share a connection. Add "?chunked" to a URL to get
+the file with chunked transfer coding instead of Content-Length. With
+QEMU user networking the guest reaches the host's loopback at 10.0.2.2:
+
+    make http-serve              # or: python3 tools/http_serve.py [port] [dir]
+    wget http://10.0.2.2:8000/README.md http://10.0.2.2:8000/Makefile?chunked
+"""
+import functools
+import http.server
+import os
+import sys
+import urllib.parse
+
+CHUNK = 4096
+
+
+class Handler(http.server.SimpleHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+
+    def do_GET(self):
+        url = urllib.parse.urlsplit(self.path)
+        if url.query != "chunked":
+            return super().do_GET()
+
+        path = self.translate_path(url.path)
+        if not os.path.isfile(path):
+            self.send_error(404, "File not found")
+            return
+        with open(path, "rb") as f:
+            self.send_response(200)
+            self.send_header("Content-Type", self.guess_type(path))
+            self.send_header("Transfer-Encoding", "chunked")
+            self.end_headers()
+            while True:
+                data = f.read(CHUNK)
+                if not data:
+                    break
+                self.wfile.write(b"%x\r\n%s\r\n" % (len(data), data))
+            self.wfile.write(b"0\r\n\r\n")
+
+
+def main():
+    port = int(sys.argv[1]) if len(sys.argv) > 1 else 8000
+    root = sys.argv[2] if len(sys.argv) > 2 else "."
+    handler = functools.partial(Handler, directory=root)
+    server = http.server.ThreadingHTTPServer(("127.0.0.1", port), handler)
+    print(f"Serving {os.path.abspath(root)} on 127.0.0.1:{port} "
+          f"(guest: http://10.0.2.2:{port}/)", flush=True)
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
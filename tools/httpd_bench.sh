@@ -0,0 +1,33 @@
+#!/bin/sh
+# Load test for the kernel's httpd, reporting requests/s and p99 latency.
+#
+# In the guest run `httpd start`; make run forwards host port 8080 to it:
+#
+#     make httpd-bench                       # or: tools/httpd_bench.sh URL
+#     make httpd-bench HTTPD_BENCH_PATH=/health
+#
+# Uses wrk when installed, otherwise ab. Both keep connections alive.
+# Tunables: DURATION (wrk, seconds), REQUESTS (ab), CONNECTIONS.
+set -e
+
+URL=${1:-http://127.0.0.1:8080/README.txt}
+DURATION=${DURATION:-10}
+REQUESTS=${REQUESTS:-20000}
+CONNECTIONS=${CONNECTIONS:-32}
+
+if command -v wrk >/dev/null 2>&1; then
+    out=$(wrk -t2 -c"$CONNECTIONS" -d"$DURATION"s --latency "$URL")
+    echo "$out"
+    echo
+    echo "$out" | awk '/Requests\/sec/ { printf "requests/s: %s\n", $2 }
+                       $1 == "99%" { printf "p99 latency: %s\n", $2 }'
+elif command -v ab >/dev/null 2>&1; then
+    out=$(ab -k -n "$REQUESTS" -c "$CONNECTIONS" "$URL")
+    echo "$out"
+    echo
+    echo "$out" | awk '/Requests per second/ { printf "requests/s: %s\n", $4 }
+                       $1 == "99%" { printf "p99 latency: %s ms\n", $2 }'
+else
+    echo "httpd_bench: install wrk or ab (apache2-utils)" >&2
+    exit 1
+fi
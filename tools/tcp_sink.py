@@ -0,0 +1,44 @@
+#!/usr/bin/env python3
+"""TCP discard server for the kernel's tcpbench command.
+
+With QEMU user networking the guest reaches the host's loopback at
+10.0.2.2, so run this on the host and then `tcpbench` in the guest:
+
+    make tcp-sink            # or: python3 tools/tcp_sink.py [port]
+"""
+import socket
+import sys
+import threading
+import time
+
+
+def drain(conn, addr):
+    conn.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 4 << 20)
+    total = 0
+    start = time.monotonic()
+    with conn:
+        while True:
+            data = conn.recv(1 << 20)
+            if not data:
+                break
+            total += len(data)
+    secs = max(time.monotonic() - start, 1e-6)
+    print(f"{addr[0]}:{addr[1]}: {total} bytes in {secs:.2f} s, "
+          f"{total * 8 / secs / 1e6:.1f} Mbit/s", flush=True)
+
+
+def main():
+    port = int(sys.argv[1]) if len(sys.argv) > 1 else 5001
+    srv = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    srv.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    srv.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 4 << 20)
+    srv.bind(("127.0.0.1", port))
+    srv.listen(8)
+    print(f"tcp sink listening on 127.0.0.1:{port}", flush=True)
+    while True:
+        conn, addr = srv.accept()
+        threading.Thread(target=drain, args=(conn, addr), daemon=True).start()
+
+
+if __name__ == "__main__":
+    main()
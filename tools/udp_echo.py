@@ -0,0 +1,31 @@
+#!/usr/bin/env python3
+"""UDP echo server for the kernel's udpbench command.
+
+With QEMU user networking the guest reaches the host's loopback at
+10.0.2.2, so run this on the host and then `udpbench` in the guest:
+
+    make udp-echo            # or: python3 tools/udp_echo.py [port]
+"""
+import socket
+import sys
+
+
+def main():
+    port = int(sys.argv[1]) if len(sys.argv) > 1 else 7777
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 4 << 20)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_SNDBUF, 4 << 20)
+    sock.bind(("127.0.0.1", port))
+    print(f"udp echo listening on 127.0.0.1:{port}", flush=True)
+
+    count = 0
+    while True:
+        data, addr = sock.recvfrom(65535)
+        sock.sendto(data, addr)
+        count += 1
+        if count % 100000 == 0:
+            print(f"{count} datagrams echoed", flush=True)
+
+
+if __name__ == "__main__":
+    main()